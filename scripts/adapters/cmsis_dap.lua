@@ -20,7 +20,7 @@ local vid_pids = {
 -- 连接CMSIS-DAP仿真器
 cmObj:Connect(vid_pids, nil)
 -- 配置CMSIS-DAP Transfer参数
-cmObj:TransferConfig(5, 5, 5)
+cmObj:TransferConfig(5, 5, 64)
 -- SWD参数
 cmObj:SwdConfig(0)
 -- 设置传输频率
@@ -29,82 +29,25 @@
 --
 
 local A = require("Adapter")
+local RISCV = require("RISCV")
 
-local _M = { _VERSION = '0.0.1' }
-local mt = { __index = _M }
+local _M = { _VERSION = '0.0.2' }
 
-function _M.Create(adapter)
+-- 创建DMI对象，DMI访问在C中实现，多次访问流水执行，并自动处理busy
+-- tapIndex：DTM在扫描链上的序号，默认为0
+-- irLen：DTM的IR长度，无法自动探测时需要指定
+-- 返回的DMI对象提供ReadReg(addr)、WriteReg(addr, data)和ReadRegs(addr, count)
+function _M.Create(adapter, tapIndex, irLen)
   assert(adapter, "Invaild adapter object")
-  local obj = {
-    idle = 0,
-    abit = 0,
-  }
 
   local jtag = adapter:GetSkill(A.SKILL_JTAG)
-  -- JTAG 原生方式读取IDCODE
-  jtag:ToState(A.TAP_RESET)	-- TAP到RESET状态，默认连接IDCODE扫描链
-  jtag:ToState(A.TAP_DR_SHIFT)	-- TAP到DR-Shift状态，读取idcode
-  local raw_idcodes = jtag:ExchangeData(string.pack("I4I4I4I4", 0, 0, 0, 0), 128)
-  -- string.unpack 额外返回一个参数是next position，下面这个返回三个参数
-  local idcodes = {string.unpack("I4I4I4I4", raw_idcodes)}
-  for key=1, #idcodes-1 do
-    print(string.format("TAP #%d : 0x%08X", key-1, idcodes[key]))
+  -- 探测扫描链上的TAP
+  local taps = jtag:ScanChain()
+  for key, tap in ipairs(taps) do
+    print(string.format("TAP #%d : 0x%08X, IR length: %d", key-1, tap.IDCODE, tap.IrLen))
   end
 
-  -- 0x10 -> IR
-  jtag:ToState(A.TAP_IR_SHIFT)
-  jtag:ExchangeData(string.pack("I4", 0x10), 0x5)
-
-  -- raw_dtmcs <- DR
-  jtag:ToState(A.TAP_DR_SHIFT)
-  local raw_dtmcs = jtag:ExchangeData(string.pack("I4", 0x0), 32)
-  local dtmcs = string.unpack("I4", raw_dtmcs)
-  print(string.format("DTM Control and Status: 0x%08X", dtmcs))
-  print(string.format(" dtmcs.version: %d", dtmcs & 0xf))
-  print(string.format(" dtmcs.abit: %d", (dtmcs >> 4) & 0x3f))
-  print(string.format(" dtmcs.dmistat: %d", (dtmcs >> 10) & 0x3))
-  print(string.format(" dtmcs.idle: %d", (dtmcs >> 12) & 0x7))
-
-  -- 如果dtmstat不是No Error状态，复位 DTM
-  if (((dtmcs >> 10) & 0x3) ~= 0) then
-    jtag:ToState(A.TAP_DR_SHIFT)
-    jtag:ExchangeData(string.pack("I4", 0x1 << 16), 32)
-  end
-
-  -- 设置IR为DMI寄存器
-  -- 0x11 -> IR (Debug Module Interface Access)
-  jtag:ToState(A.TAP_IR_SHIFT)
-  jtag:ExchangeData(string.pack("I4", 0x11), 0x5)
-
-  obj.abit = (dtmcs >> 4) & 0x3f
-  obj.idle = (dtmcs >> 12) & 0x7
-  obj.jtag = jtag
-
-  return setmetatable(obj, mt)
-end
-
--- TODO:优化速度
-function _M.ReadReg(self, reg)
-  reg = reg & ((1 << self.abit) - 1)
-
-  self.jtag:ToState(A.TAP_DR_SHIFT)
-  self.jtag:ExchangeData(string.pack("I8", (reg << 34) | 0x1), self.abit + 34)
-  self.jtag:ToState(A.TAP_IDLE)
-  self.jtag:Idle(self.idle) -- wait a while
-  self.jtag:ToState(A.TAP_DR_SHIFT)
-  local raw_register = self.jtag:ExchangeData(string.pack("I8", 0), self.abit + 34)
-  local register = string.unpack("I8", raw_register)
-  return (register >> 2) & 0xFFFFFFFF
-end
-
-function _M.WriteReg(self, reg, data)
-  reg = reg & ((1 << self.abit) - 1)
-  data = data & 0xFFFFFFFF
-
-  self.jtag:ToState(A.TAP_DR_SHIFT)
-  self.jtag:ExchangeData(string.pack("I8", (reg << 34) | (data << 0x2) | 0x2), self.abit + 34)
-  self.jtag:ToState(A.TAP_IDLE)
-  self.jtag:Idle(self.idle) -- wait a while
+  return RISCV.CreateDmi(jtag, tapIndex or 0, irLen)
 end
 
 return _M
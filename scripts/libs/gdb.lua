@@ -30,7 +30,6 @@
 
 local loop = require('Loop')
 local tcp = require('Loop.tcp')
-local timer = require('Loop.timer')
 local dqueue = require('libs.dqueue')
 local utils = require('libs.utils')
 
@@ -158,10 +157,6 @@ local function handleCommandMemoryRead(client, command)
   addressInfo[2] = tonumber(addressInfo[2], 16) + addressInfo[1]
   local resp = ''
 
-  -- 备份s0、s1寄存器
-  local s0 = dmObj:AccessGPR(8)
-  local s1 = dmObj:AccessGPR(9)
-
   repeat
     local align = addressInfo[1] & 0x3
     local left = addressInfo[2] - addressInfo[1]
@@ -181,27 +176,13 @@ local function handleCommandMemoryRead(client, command)
     end
     assert(read_len, "Invalid read_len")
 
-    -- print(string.format("address:%x, length: %d, next_addr:%x", addressInfo[1], read_len, addressInfo[1] + read_len))
-
-    if read_len == 4 then
-      local data = dmObj:AccessMemory(addressInfo[1], 4)
-      resp = resp .. string.format("%02X%02X%02X%02X", data & 0xFF, (data >> 8) & 0xFF, (data >> 16) & 0xFF, (data >> 24) & 0xFF)
-      addressInfo[1] = addressInfo[1] + 4
-    elseif read_len == 1 then
-      local data = dmObj:AccessMemory(addressInfo[1], 1)
-      resp = resp .. string.format("%02X", data & 0xFF)
-      addressInfo[1] = addressInfo[1] + 1
-    elseif read_len == 2 then
-      local data = dmObj:AccessMemory(addressInfo[1], 2)
-      resp = resp .. string.format("%02X%02X", data & 0xFF, (data >> 8) & 0xFF)
-      addressInfo[1] = addressInfo[1] + 2
-    end
+    -- 对齐的部分一次读取，支持System Bus Access时在一次提交中流水读取
+    local count = read_len == 4 and left // 4 or 1
+    local data = dmObj:BlockRead(addressInfo[1], read_len, count)
+    resp = resp .. data:gsub('.', function (c) return string.format("%02X", c:byte()) end)
+    addressInfo[1] = addressInfo[1] + read_len * count
   until addressInfo[1] >= addressInfo[2]
 
-  -- 恢复s0、s1寄存器
-  dmObj:AccessGPR(8, s0)
-  dmObj:AccessGPR(9, s1)
-
   ReplyGdbCommand(client, resp)
 end
 
@@ -213,10 +194,6 @@ local function handleCommandMemoryWrite(client, command)
   addressInfo[1] = tonumber(addressInfo[1], 16)
   addressInfo[2] = tonumber(addressInfo[2], 16) + addressInfo[1]
 
-  -- 备份s0、s1寄存器
-  local s0 = dmObj:AccessGPR(8)
-  local s1 = dmObj:AccessGPR(9)
-
   repeat
     local align = addressInfo[1] & 0x3
     local left = addressInfo[2] - addressInfo[1]
@@ -237,47 +214,17 @@ local function handleCommandMemoryWrite(client, command)
     end
     assert(read_len, "Invalid read_len")
 
-    -- print(string.format("address:%x, length: %d, next_addr:%x", addressInfo[1], read_len, addressInfo[1] + read_len))
-
-    if read_len == 4 then
-      local data = string.sub(writeInfo[2], 1, 8)
-      local b = tonumber(data, 16)
-      assert(data ~= nil)
-      b = (b >> 24) | ((b >> 8) & 0xff00) | ((b & 0xff00) << 8) | (b << 24)
-      b = b & 0xffffffff;
-
-      dmObj:AccessMemory(addressInfo[1], 4, b)
+    -- 对齐的部分一次写入，支持System Bus Access时在一次提交中流水写入
+    local count = read_len == 4 and left // 4 or 1
+    local hex = string.sub(writeInfo[2], 1, read_len * count * 2)
+    assert(#hex == read_len * count * 2, "Invalid write data")
+    local data = hex:gsub('..', function (h) return string.char(tonumber(h, 16)) end)
+    dmObj:BlockWrite(addressInfo[1], read_len, data)
 
-      addressInfo[1] = addressInfo[1] + 4
-      writeInfo[2] = string.sub(writeInfo[2], 9)
-    elseif read_len == 1 then
-      local data = string.sub(writeInfo[2], 1, 2)
-      local b = tonumber(data, 16)
-      assert(b ~= nil)
-      b = b & 0xff
-
-      dmObj:AccessMemory(addressInfo[1], 1, b)
-
-      addressInfo[1] = addressInfo[1] + 1
-      writeInfo[2] = string.sub(writeInfo[2], 3)
-    elseif read_len == 2 then
-      local data = string.sub(writeInfo[2], 1, 4)
-      local b = tonumber(data, 16)
-      assert(b ~= nil)
-      b = ((b >> 8) & 0xff) | ((b & 0xff) << 8)
-      b = b & 0xffff
-
-      dmObj:AccessMemory(addressInfo[1], 2, b)
-
-      addressInfo[1] = addressInfo[1] + 2
-      writeInfo[2] = string.sub(writeInfo[2], 5)
-    end
+    addressInfo[1] = addressInfo[1] + read_len * count
+    writeInfo[2] = string.sub(writeInfo[2], read_len * count * 2 + 1)
   until addressInfo[1] >= addressInfo[2]
 
-  -- 恢复s0、s1寄存器
-  dmObj:AccessGPR(8, s0)
-  dmObj:AccessGPR(9, s1)
-
   ReplyGdbCommand(client, 'OK')
 end
 
@@ -286,7 +233,24 @@ local function handleCommandH(client, command)
   ReplyGdbCommand(client, 'OK')
 end
 
-local poll_timer = timer.Create()
+-- hart状态监视器，在C中轮询dmstatus，只在hart停止时回调
+local haltWatcher = nil
+local watchClient = nil
+
+local function watchHalt(client)
+  if haltWatcher == nil then
+    haltWatcher = dmObj:CreateWatcher(function (halted)
+      if halted then
+        haltWatcher:Stop()
+        waitingUserSig = false
+        ReplyGdbCommand(watchClient, 'S02')
+      end
+    end)
+  end
+  watchClient = client
+  -- 刚恢复运行，hart在第一次轮询之前停止也会产生通知
+  haltWatcher:Start(false)
+end
 
 -- 处理GDB命令
 local function handleGdbCommand(client, command)
@@ -300,25 +264,20 @@ local function handleGdbCommand(client, command)
   elseif prefix == 'H' then
     handleCommandH(client, command)
   elseif prefix == '?' then
+    if haltWatcher then
+      haltWatcher:Stop()
+    end
+    -- Halt会等待hart进入halted状态
     dmObj:Halt()
-
-    poll_timer:Start(0, 10, function ()
-      local is_halted = dmObj:IsHalt()
-      if is_halted then
-        poll_timer:Stop()
-        ReplyGdbCommand(client, 'S02')
-      end
-    end)
+    ReplyGdbCommand(client, 'S02')
   elseif prefix == 'g' then
+    -- 寄存器在hart停止时一次读取并缓存
+    local regs, pc = dmObj:ReadRegisters()
     local allReg = ''
-    for i=0,31,1 do
-      allReg = allReg .. reg2hexle(dmObj:AccessGPR(i))
+    for i=1,32,1 do
+      allReg = allReg .. reg2hexle(regs[i])
     end
-
-    local s0 = dmObj:AccessGPR(8)
-    -- read dpc to get current pc
-    allReg = allReg .. reg2hexle(dmObj:AccessCSR(0x7b1))
-    dmObj:AccessGPR(8, s0)
+    allReg = allReg .. reg2hexle(pc)
 
     ReplyGdbCommand(client, allReg)
   elseif prefix == 'm' then
@@ -329,8 +288,6 @@ local function handleGdbCommand(client, command)
     local cmdBody = tonumber(string.sub(command, 2), 16)
     assert(cmdBody >= 0, 'Invalid register index')
 
-    local s0 = dmObj:AccessGPR(8)
-    local s1 = dmObj:AccessGPR(9)
     if cmdBody <= 31 then -- Read GPR
       ReplyGdbCommand(client, reg2hexle(dmObj:AccessGPR(cmdBody)))
     elseif cmdBody == 32 then -- Read PC
@@ -340,20 +297,12 @@ local function handleGdbCommand(client, command)
     else
       ReplyGdbCommand(client, reg2hexle(dmObj:AccessCSR(cmdBody - 65)))
     end
-    dmObj:AccessGPR(8, s0)
-    dmObj:AccessGPR(9, s1)
   elseif prefix == 'c' then
     dmObj:Run()
     ReplyGdbCommand(client, 'OK')
 
     waitingUserSig = true
-    poll_timer:Start(0, 10, function ()
-      local is_halted = dmObj:IsHalt()
-      if is_halted then
-        poll_timer:Stop()
-        ReplyGdbCommand(client, 'S02')
-      end
-    end)
+    watchHalt(client)
   else
     print(string.format("unknow command:%s", command))
     ReplyGdbCommand(client, '')
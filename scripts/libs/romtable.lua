@@ -97,17 +97,15 @@ local dap_infos = {
 	{ 0x1000, 0x343, "TI DAPCTL",                  "", },
 }
 
-function ComponentInfo(memAccessPort, addr)
-	-- 获得对齐后的地址
-    local base_addr = addr & 0xFFFFF000
-    -- 读取pid和cid
-    local cid, pid = memAccessPort:GetCidPid(base_addr)
+-- 打印组件信息，comp为WalkRomTable返回的组件
+function PrintComponent(comp)
+    local cid, pid = comp.CID, comp.PID
     if (cid & 0xFFFF0FFF) ~= 0xB105000D then
         -- 无效的CID
         print("Invaild CID:" .. string.format("0x%08X", cid))
         return
     end
-    print(string.format( "* Component CID:0x%08X, PID:0x%010X.", cid, pid))
+    print(string.format( "* Component 0x%X CID:0x%08X, PID:0x%010X.", comp.Base, cid, pid))
 
     -- 获得当前Component的类型
     local compon_type = (cid >> 12) & 0xF
@@ -122,17 +120,14 @@ function ComponentInfo(memAccessPort, addr)
         end
     end
     if compon_type == 0x1 then    -- ROM Table
-        local mem_type = memAccessPort:Memory32(base_addr + 0xFCC)
+        local mem_type = comp.DevType
         if mem_type & 0x1 == 0x1 then
             print("ROMTable - MEMTYPE system memory present on bus.")
         else
             print("ROMTable - MEMTYPE system memory not present: dedicated debug bus.")
         end
     elseif compon_type == 0x9 then -- CoreSight component
-        -- 读DEVARCH,DEVID,DEVTYPE
-        local dev_arch = memAccessPort:Memory32(base_addr + 0xFBC)
-        local dev_id = memAccessPort:Memory32(base_addr + 0xFC8)
-        local dev_type = memAccessPort:Memory32(base_addr + 0xFCC)
+        local dev_arch, dev_id, dev_type = comp.DevArch, comp.DevId, comp.DevType
         print(string.format( "* DEVARCH:0x%08X, DEVID:0x%08X, DEVTYPE: 0x%08X.", dev_arch, dev_id, dev_type))
         local minor = (dev_type >> 4) & 0x0F
         local major_type, sub_type = "other"
@@ -211,3 +206,28 @@ function ComponentInfo(memAccessPort, addr)
         print("- Type is " .. major_type .. " - " .. sub_type)
     end
 end
+
+-- 打印单个组件的信息
+function ComponentInfo(memAccessPort, addr)
+	-- 获得对齐后的地址
+    local base_addr = addr & 0xFFFFF000
+    -- 读取pid和cid
+    local cid, pid = memAccessPort:GetCidPid(base_addr)
+    PrintComponent({
+        Base = base_addr, CID = cid, PID = pid,
+        DevArch = memAccessPort:Memory32(base_addr + 0xFBC),
+        DevId = memAccessPort:Memory32(base_addr + 0xFC8),
+        DevType = memAccessPort:Memory32(base_addr + 0xFCC),
+    })
+end
+
+-- 遍历ROM Table并打印所有组件，同一层的组件在一次事务中识别
+function PrintRomTable(memAccessPort, addr)
+    local function walk(comp)
+        PrintComponent(comp)
+        for _, child in ipairs(comp.Children) do
+            walk(child)
+        end
+    end
+    walk(memAccessPort:WalkRomTable(addr))
+end
@@ -48,6 +48,7 @@ enum {
   ADPT_ERR_INTERNAL_ERROR,   // 内部错误,不是由于Adapter功能部分造成的失败
   ADPT_ERR_BAD_PARAMETER,    // 无效的参数
   ADPT_ERR_DEVICE_NOT_MATCH, // 设备类型不匹配
+  ADPT_ERR_MISMATCH,         // 值匹配读取在重试次数内没有匹配
 };
 
 /* 仿真器对象 */
@@ -99,6 +99,23 @@ typedef int (*SKILL_DAP_MULTI_READ)(IN DapSkill self, IN enum dapRegType type, I
 typedef int (*SKILL_DAP_MULTI_WRITE)(IN DapSkill self, IN enum dapRegType type, IN int reg,
                                      IN int count, IN uint32_t *data);
 
+/**
+ * DapMatchRead - 值匹配读:反复读取AP或者DP寄存器,直到(值 & mask) == value
+ * 比较在仿真器中完成,重试次数由仿真器决定,只有匹配或者超过重试次数才返回
+ * 会将该动作加入Pending队列,不会立即执行
+ * 超过重试次数仍不匹配时Commit返回ADPT_ERR_MISMATCH
+ * 不支持该功能的仿真器可以将此接口置为NULL
+ * 参数:
+ * 	self:DapSkill对象自身
+ * 	type:寄存器类型,DP还是AP
+ * 	reg:reg地址
+ * 	mask:比较的掩码
+ * 	value:期望的值
+ * 返回:
+ */
+typedef int (*SKILL_DAP_MATCH_READ)(IN DapSkill self, IN enum dapRegType type, IN int reg,
+                                    IN uint32_t mask, IN uint32_t value);
+
 /**
  * DapCommit - 提交Pending的动作
  * 参数:
@@ -129,6 +146,7 @@ struct dapSkill {
   SKILL_DAP_SINGLE_WRITE SingleWrite; // 单次写:AP或者DP,寄存器编号
   SKILL_DAP_MULTI_READ MultiRead;     // 连续读
   SKILL_DAP_MULTI_WRITE MultiWrite;   // 连续写
+  SKILL_DAP_MATCH_READ MatchRead;     // 值匹配读,可以为NULL
   SKILL_DAP_COMMIT Commit;            // 提交Pending动作
   SKILL_DAP_CANCEL Cancel;            // 清除Pending的动作
 };
@@ -34,6 +34,7 @@
 #include <string.h>
 
 #include "Component/ADI/ADIv5.h"
+#include "Library/misc/bitstream.h"
 #include "Library/misc/list.h"
 #include "Library/usb/usb.h"
 #include "Library/log/log.h"
@@ -43,6 +44,8 @@
 #define CMDAP_TRANSFER_RnW (1U << 1)
 #define CMDAP_TRANSFER_A2 (1U << 2)
 #define CMDAP_TRANSFER_A3 (1U << 3)
+#define CMDAP_TRANSFER_MATCH_VALUE (1U << 4) // 读寄存器直到值匹配
+#define CMDAP_TRANSFER_MATCH_MASK (1U << 5)  // 设置值匹配的掩码
 
 // CMSIS-DAP Command IDs
 // V1.0
@@ -278,27 +281,6 @@ SWO Streaming Trace support:
 #define CMDAP_CAP_TEST_DOMAIN_TIMER 6
 #define CMDAP_CAP_TRACE_DATA_MANAGE 7
 
-/**
- * 在一串数据中获得第n个二进制位，n从0开始
- * lsb
- * data:数据存放的位置指针
- * n:第几位，最低位是第0位
- */
-#define GET_Nth_BIT(data, n) ((*(CAST(uint8_t *, (data)) + ((n) >> 3)) >> ((n)&0x7)) & 0x1)
-/**
- * 设置data的第n个二进制位
- * data:数据存放的位置
- * n：要修改哪一位，从0开始
- * val：要设置的位，0或者1，只使用最低位
- */
-#define SET_Nth_BIT(data, n, val)                               \
-  do {                                                          \
-    uint8_t tmp_data = *(CAST(uint8_t *, (data)) + ((n) >> 3)); \
-    tmp_data &= ~(1 << ((n)&0x7));                              \
-    tmp_data |= ((val)&0x1) << ((n)&0x7);                       \
-    *(CAST(uint8_t *, (data)) + ((n) >> 3)) = tmp_data;         \
-  } while (0);
-
 /**
  * 由多少个比特位构造出多少个字节，包括控制字
  * 比如bitCnt=64
@@ -1054,9 +1036,9 @@ MAKE_PACKT:
   packetStartIdx = idx;
   // 统计一些信息
   for (; seqIdx < sequenceCnt; seqIdx++) {
-    data[idx] &= 0xf; // 只保留[3:0]位
-    // 判断是否是读寄存器
-    if ((data[idx] & CMDAP_TRANSFER_RnW) == CMDAP_TRANSFER_RnW) {
+    data[idx] &= 0x3f; // 只保留[5:0]位
+    // 判断是否是读寄存器，值匹配读取附带4字节的比较值，不返回数据
+    if ((data[idx] & (CMDAP_TRANSFER_RnW | CMDAP_TRANSFER_MATCH_VALUE)) == CMDAP_TRANSFER_RnW) {
       // 判断是否超出最大包长度
       if ((3 + readCount + 4) > cmdapObj->PacketSize || (3 + writeCount + 1) > cmdapObj->PacketSize) {
         break;
@@ -1104,6 +1086,7 @@ MAKE_PACKT:
     goto MAKE_PACKT;
 
   BOOL result = TRUE;
+  int lastResponse = CMDAP_TRANSFER_OK;
   // NOTIC 这个循环也就执行一次
   for (int readPackCnt = 0; readPackCnt < sendPackCnt; readPackCnt++) {
     dapRead(cmdapObj, &transferred);
@@ -1113,6 +1096,7 @@ MAKE_PACKT:
       *okSeqCnt += cmdapObj->respBuffer[1];
       if (cmdapObj->respBuffer[1] != packetInfo[readPackCnt].seqCnt) {
         log_warn("Last Response: %d.", cmdapObj->respBuffer[2]);
+        lastResponse = cmdapObj->respBuffer[2];
         result = FALSE;
       }
       // 拷贝数据
@@ -1124,6 +1108,10 @@ MAKE_PACKT:
   }
   if (result == FALSE) {
     free(buff);
+    // 值匹配读取在重试次数内没有匹配，传输本身没有出错
+    if (lastResponse & CMDAP_TRANSFER_MISMATCH) {
+      return ADPT_ERR_MISMATCH;
+    }
     log_error("An error occurred during the transfer.");
     return ADPT_FAILED;
   }
@@ -1303,7 +1291,8 @@ int CmdapSwdConfig(Adapter self, uint8_t cfg) {
 
 /**
  * 解析TMS信息，并写入到buff
- * seqInfo:由JTAG_getTMSSequence函数返回的TMS时序信息
+ * tms:TMS时序，最低位先发送，由JtagGetTmsPath函数生成
+ * bitCount:TMS时序位数
  * seqCnt:
  * 返回写入的字节数
  * Sequence Info: Contains number of TDI bits and fixed TMS value
@@ -1312,28 +1301,23 @@ int CmdapSwdConfig(Adapter self, uint8_t cfg) {
     Bit 7: TDO Capture
  *
  */
-static int parseTMS(uint8_t *buff, TMS_SeqInfo seqInfo, int *seqCnt) {
+static int parseTMS(uint8_t *buff, const uint8_t *tms, int bitCount, int *seqCnt) {
   assert(buff != NULL);
-  uint8_t bitCount = seqInfo & 0xff;
-  uint8_t TMS_Seq = seqInfo >> 8;
-  if (bitCount == 0)
-    return 0;
-  int writeCount = 1;
-  *buff = (TMS_Seq & 0x1) << 6;
-  // sequence 个数+1
-  (*seqCnt)++;
-  while (bitCount--) {
-    (*buff)++;
-    TMS_Seq >>= 1;
-    if (bitCount && (((TMS_Seq & 0x1) << 6) ^ (*buff & 0x40))) {
-      *++buff = 0;
-      *++buff = (TMS_Seq & 0x1) << 6;
-      (*seqCnt)++;
-      writeCount += 2;
+  int writeCount = 0;
+  // 每一段电平相同的TMS生成一个sequence
+  for (int idx = 0; idx < bitCount;) {
+    int level = bitstream_GetBit(tms, idx);
+    int cycles = 0;
+    while (idx < bitCount && bitstream_GetBit(tms, idx) == level && cycles < 64) {
+      idx++;
+      cycles++;
     }
+    *buff++ = (level << 6) | (cycles & 0x3f);
+    *buff++ = 0; // TDI
+    (*seqCnt)++;
+    writeCount += 2;
   }
-  *++buff = 0;
-  return writeCount + 1;
+  return writeCount;
 }
 
 /**
@@ -1364,7 +1348,7 @@ static int parseTDI(uint8_t *buff, uint8_t *TDIData, int bitCnt, int *seqCnt) {
   }
   // 解析最后一位
   *buff++ = 0xC1; // 0xC1 TMS=1 TCLK=1 TDO Capature=1
-  *buff++ = GET_Nth_BIT(TDIData, bitCnt - 1);
+  *buff++ = bitstream_GetBit(TDIData, bitCnt - 1);
   writeCnt += 2;
   (*seqCnt)++;
   return writeCnt;
@@ -1397,6 +1381,9 @@ static int parseIDLEWait(uint8_t *buff, int wait, int *seqCnt) {
   return writeCnt;
 }
 
+// 一次最多合并的连续状态切换个数
+#define CMDAP_TMS_PATH_MAX 16
+
 /**
  * 解析执行JTAG指令队列
  */
@@ -1408,6 +1395,9 @@ static int executeJtagCmd(JtagSkill self) {
   int writeBuffLen = 0;                                             // 生成指令缓冲区的长度
   int readBuffLen = 0;                                              // 需要读的字节个数
   int writeCnt = 0, readCnt = 0;                                    // 写入数据个数，读取数据个数
+  enum JTAG_TAP_State pathStates[CMDAP_TMS_PATH_MAX];               // 待合并的连续状态切换
+  int pathCount = 0;                                                // 待合并的状态个数
+  uint8_t tmsPath[CMDAP_TMS_PATH_MAX];                              // 合并后的TMS时序，每段路径不超过8位
   // 遍历指令，计算解析后的数据长度，开辟空间
   struct JTAG_Command *cmd, *cmd_t;
   list_for_each_entry(cmd, &cmdapObj->JtagInsQueue, list_entry) {
@@ -1487,12 +1477,19 @@ static int executeJtagCmd(JtagSkill self) {
   list_for_each_entry(cmd, &cmdapObj->JtagInsQueue, list_entry) {
     switch (cmd->type) {
     case JTAG_INS_STATUS_MOVE: // 状态机切换
+      pathStates[pathCount++] = cmd->instr.statusMove.toState;
+      // 连续的状态切换合并成一段TMS时序，合并后的电平状态数不会多于分开计算的总和
+      if (pathCount < CMDAP_TMS_PATH_MAX && !list_is_last(&cmd->list_entry, &cmdapObj->JtagInsQueue) &&
+          list_entry(cmd->list_entry.next, struct JTAG_Command, list_entry)->type == JTAG_INS_STATUS_MOVE) {
+        break;
+      }
       do {
-        // 高8位为时序信息
-        TMS_SeqInfo tmsSeq = JtagGetTmsSequence(tempState, cmd->instr.statusMove.toState);
-        writeCnt += parseTMS(writeBuff + writeCnt, tmsSeq, &seqCnt);
+        int tmsBits = JtagGetTmsPath(tempState, pathStates, pathCount, tmsPath, sizeof(tmsPath) << 3);
+        assert(tmsBits >= 0);
+        writeCnt += parseTMS(writeBuff + writeCnt, tmsPath, tmsBits, &seqCnt);
         // 更新当前临时状态机
-        tempState = cmd->instr.statusMove.toState;
+        tempState = pathStates[pathCount - 1];
+        pathCount = 0;
       } while (0);
       break;
     case JTAG_INS_EXCHANGE_DATA: // 交换IO
@@ -1524,20 +1521,14 @@ static int executeJtagCmd(JtagSkill self) {
     if (cmd->type == JTAG_INS_STATUS_MOVE || cmd->type == JTAG_INS_IDLE_WAIT) {
       goto FREE_CMD;
     }
-    // 所占的数据长度
-    int byteCnt = (cmd->instr.exchangeData.bitCount + 7) >> 3;
-    // 剩余二进制位个数
-    int restBit = (cmd->instr.exchangeData.bitCount - 1) & 0x7;
-    memcpy(cmd->instr.exchangeData.data, readBuff + readCnt, byteCnt);
-    readCnt += byteCnt;
-    /**
-     * bitCnt-1之后如果是8的倍数，就不需要组合最后一字节的数据
-     */
-    // 将最后一个字节的数据组合到前一个字节上
-    if (restBit != 0) {
-      *(cmd->instr.exchangeData.data + byteCnt - 1) |= (*(readBuff + readCnt) & 1) << restBit;
+    do {
+      // 除最后一位以外的数据连续存放，最后一位单独占一个字节
+      unsigned int bitCnt = cmd->instr.exchangeData.bitCount - 1;
+      bitstream_Copy(cmd->instr.exchangeData.data, 0, readBuff + readCnt, 0, bitCnt);
+      readCnt += (bitCnt + 7) >> 3;
+      bitstream_Copy(cmd->instr.exchangeData.data, bitCnt, readBuff + readCnt, 0, 1);
       readCnt++;
-    }
+    } while (0);
   FREE_CMD:
     list_del(&cmd->list_entry);
     free(cmd);
@@ -1654,7 +1645,9 @@ REEXEC:;
     switch (cmd->type) {
     case DAP_INS_RW_REG_SINGLE: // 单次读写寄存器
       writeBuffLen += 1;
-      if ((cmd->instr.singleReg.request & 0x2) == 0x2) { // 读操作
+      if (cmd->instr.singleReg.request & CMDAP_TRANSFER_MATCH_VALUE) { // 值匹配读取，附带比较值
+        writeBuffLen += 4;
+      } else if ((cmd->instr.singleReg.request & 0x2) == 0x2) { // 读操作
         readBuffLen += 4;
       } else {
         writeBuffLen += 4;
@@ -1707,8 +1700,8 @@ REEXEC:;
         } while (0);
         */
 
-      // 如果是写操作
-      if ((cmd->instr.singleReg.request & 0x2) == 0) {
+      // 如果是写操作或者值匹配读取
+      if ((cmd->instr.singleReg.request & 0x2) == 0 || (cmd->instr.singleReg.request & CMDAP_TRANSFER_MATCH_VALUE)) {
         // XXX 小端字节序
         memcpy(writeBuff + writeCnt, CAST(uint8_t *, &cmd->instr.singleReg.data.write), 4);
         writeCnt += 4;
@@ -1738,7 +1731,10 @@ REEXEC:;
   switch (thisType) {
   case DAP_INS_RW_REG_SINGLE:
     // 执行指令 DAP_Transfer
-    if (cmdapTransfer(cmdapObj, cmdapObj->tapIndex, seqCnt, writeBuff, readBuff, &okSeqCnt) != ADPT_SUCCESS) {
+    result = cmdapTransfer(cmdapObj, cmdapObj->tapIndex, seqCnt, writeBuff, readBuff, &okSeqCnt);
+    if (result == ADPT_ERR_MISMATCH) {
+      log_debug("DAP_Transfer:Value mismatch. Success:%d, All:%d.", okSeqCnt, seqCnt);
+    } else if (result != ADPT_SUCCESS) {
       log_error(
           "DAP_Transfer:Some DAP Instruction Execute Failed. Success:%d, "
           "All:%d.",
@@ -1769,7 +1765,8 @@ REEXEC:;
       break;
     }
     okSeqCnt--;                                                                              // 只同步执行成功的Seq个数
-    if (cmd->type == DAP_INS_RW_REG_SINGLE && (cmd->instr.singleReg.request & 0x2) == 0x2) { // 单次读寄存器
+    if (cmd->type == DAP_INS_RW_REG_SINGLE &&
+        (cmd->instr.singleReg.request & (0x2 | CMDAP_TRANSFER_MATCH_VALUE)) == 0x2) { // 单次读寄存器
       memcpy(cmd->instr.singleReg.data.read, readBuff + readCnt, 4);
       readCnt += 4;
     } else if (cmd->type == DAP_INS_RW_REG_MULTI && (cmd->instr.multiReg.request & 0x2) == 0x2) { // 多次读寄存器
@@ -1838,6 +1835,32 @@ static int addDapSingleWrite(DapSkill self, enum dapRegType type, int reg, uint3
   return ADPT_SUCCESS;
 }
 
+/* 增加值匹配读寄存器指令：先设置匹配掩码，再读取直到(值 & mask) == value */
+static int addDapMatchRead(DapSkill self, enum dapRegType type, int reg, uint32_t mask, uint32_t value) {
+  struct cmsis_dap *cmdapObj = CMDAP_OBJ_FORM_DAP_SKILL(self);
+
+  // 新建设置掩码的指令
+  struct DAP_Command *command = newDapCommand(cmdapObj);
+  if (command == NULL) {
+    return ADPT_ERR_INTERNAL_ERROR;
+  }
+  command->type = DAP_INS_RW_REG_SINGLE;
+  command->instr.singleReg.request = CMDAP_TRANSFER_MATCH_MASK;
+  command->instr.singleReg.data.write = mask;
+  // 新建值匹配读取的指令
+  command = newDapCommand(cmdapObj);
+  if (command == NULL) {
+    return ADPT_ERR_INTERNAL_ERROR;
+  }
+  command->type = DAP_INS_RW_REG_SINGLE;
+  command->instr.singleReg.request = (reg & 0xC) | 0x2 | CMDAP_TRANSFER_MATCH_VALUE;
+  if (type == SKILL_DAP_AP_REG) {
+    command->instr.singleReg.request |= 0x1;
+  }
+  command->instr.singleReg.data.write = value & mask;
+  return ADPT_SUCCESS;
+}
+
 /* 增加多次读寄存器指令 */
 static int addDapMultiRead(DapSkill self, enum dapRegType type, int reg, int count, uint32_t *data) {
   struct cmsis_dap *cmdapObj = CMDAP_OBJ_FORM_DAP_SKILL(self);
@@ -1969,6 +1992,7 @@ Adapter CreateCmsisDap(void) {
   obj->dapSkillAPI.SingleWrite = addDapSingleWrite;
   obj->dapSkillAPI.MultiRead = addDapMultiRead;
   obj->dapSkillAPI.MultiWrite = addDapMultiWrite;
+  obj->dapSkillAPI.MatchRead = addDapMatchRead;
   obj->dapSkillAPI.Commit = executeDapCmd;
   obj->dapSkillAPI.Cancel = cleanDapInsQueue;
 
@@ -32,6 +32,7 @@
 
 #include "Adapter/ftdi/ftdi.h"
 
+#include "Library/misc/bitstream.h"
 #include "Library/misc/list.h"
 #include "Library/misc/misc.h"
 #include "Library/log/log.h"
@@ -425,27 +426,6 @@ static int parseTMS(uint8_t *buff, TMS_SeqInfo seqInfo) {
   return writeCnt;
 }
 
-/**
- * 在一串数据中获得第n个二进制位，n从0开始
- * lsb
- * data:数据存放的位置指针
- * n:第几位，最低位是第0位
- */
-#define GET_Nth_BIT(data, n) ((*(CAST(uint8_t *, (data)) + ((n) >> 3)) >> ((n)&0x7)) & 0x1)
-/**
- * 设置data的第n个二进制位
- * data:数据存放的位置
- * n：要修改哪一位，从0开始
- * val：要设置的位，0或者1，只使用最低位
- */
-#define SET_Nth_BIT(data, n, val)                               \
-  do {                                                          \
-    uint8_t tmp_data = *(CAST(uint8_t *, (data)) + ((n) >> 3)); \
-    tmp_data &= ~(1 << ((n)&0x7));                              \
-    tmp_data |= ((val)&0x1) << ((n)&0x7);                       \
-    *(CAST(uint8_t *, (data)) + ((n) >> 3)) = tmp_data;         \
-  } while (0);
-
 // 解析TDI数据
 static int parseTDI(uint8_t *buff, uint8_t *TDIData, int bitCnt) {
   assert(buff != NULL);
@@ -467,7 +447,7 @@ static int parseTDI(uint8_t *buff, uint8_t *TDIData, int bitCnt) {
 
       if (bytesCnt > 0) {
         *buff++ = MPSSE_LSB | MPSSE_WRITE_NEG | MPSSE_DO_WRITE | MPSSE_DO_READ;
-        *buff++ = (bytesCnt - 1) % 0xFF;
+        *buff++ = (bytesCnt - 1) & 0xFF;
         *buff++ = (bytesCnt - 1) >> 8;
         memcpy(buff, TDIData + readCnt, bytesCnt);
 
@@ -492,7 +472,7 @@ static int parseTDI(uint8_t *buff, uint8_t *TDIData, int bitCnt) {
   // 解析最后一位
   *buff++ = MPSSE_WRITE_TMS | MPSSE_LSB | MPSSE_BITMODE | MPSSE_WRITE_NEG | MPSSE_DO_READ;
   *buff++ = 0; // 1个bit
-  *buff++ = 0x1 | (GET_Nth_BIT(TDIData, bitCnt - 1) << 7);
+  *buff++ = 0x1 | (bitstream_GetBit(TDIData, bitCnt - 1) << 7);
   writeCnt += 3;
   return writeCnt;
 }
@@ -516,7 +496,7 @@ static int parseIDLEWait(uint8_t *buff, int wait) {
 
       if (bytesCnt > 0) {
         *buff++ = MPSSE_LSB | MPSSE_WRITE_NEG | MPSSE_DO_WRITE;
-        *buff++ = (bytesCnt - 1) % 0xFF;
+        *buff++ = (bytesCnt - 1) & 0xFF;
         *buff++ = (bytesCnt - 1) >> 8;
         memset(buff, 0x0, bytesCnt);
 
@@ -688,19 +668,21 @@ static int ftdiJtagCommit(IN JtagSkill self) {
       goto FREE_CMD;
     }
 
-    int bytesCnt = (cmd->instr.exchangeData.bitCount + 7) >> 3;
-    int restBits = (cmd->instr.exchangeData.bitCount - 1) & 0x7;
-    bytesCnt += restBits > 0 ? 1 : 0;
-    memcpy(cmd->instr.exchangeData.data, readBuff + readCnt, bytesCnt);
-    readCnt += bytesCnt;
-
-    // 将最后一个字节的数据组合到前一个字节上
-    // 倒数第二个字节是高位有效，从高位向低位shift过来，而最后一个字节是只有一个数据，所以
-    // 在最后一位
-    uint8_t last_byte = *(cmd->instr.exchangeData.data + bytesCnt - 1);
-    last_byte = (last_byte >> (8-restBits)) | ((*(readBuff + readCnt) & 0x1) << restBits);
-    *(cmd->instr.exchangeData.data + bytesCnt - 1) = last_byte;
-    readCnt++;
+    do {
+      // 整字节部分按字节读回，剩余的位和最后一位按位模式读回，数据在字节的高位
+      unsigned int bitCnt = cmd->instr.exchangeData.bitCount - 1;
+      unsigned int bytesCnt = bitCnt >> 3;
+      unsigned int restBits = bitCnt & 0x7;
+
+      bitstream_Copy(cmd->instr.exchangeData.data, 0, readBuff + readCnt, 0, bytesCnt << 3);
+      readCnt += bytesCnt;
+      if (restBits > 0) {
+        bitstream_Copy(cmd->instr.exchangeData.data, bytesCnt << 3, readBuff + readCnt, 8 - restBits, restBits);
+        readCnt++;
+      }
+      bitstream_Copy(cmd->instr.exchangeData.data, bitCnt, readBuff + readCnt, 7, 1);
+      readCnt++;
+    } while (0);
   FREE_CMD:
     list_del(&cmd->list_entry);
     free(cmd);
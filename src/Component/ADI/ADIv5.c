@@ -31,9 +31,13 @@
 
 #include "Library/log/log.h"
 #include "smartocd.h"
+#include <inttypes.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "Component/ADI/ADIv5_private.h"
+#include "Component/ADI/ADIv6_private.h"
 
 /**
  * DAP 初始化
@@ -95,10 +99,276 @@ static int dapInit(struct ADIv5_Dap *dap) {
       return ADI_ERR_INTERNAL_ERROR;
     }
   } while ((ctrl_stat & (DP_STAT_CDBGPWRUPACK | DP_STAT_CSYSPWRUPACK)) != (DP_STAT_CDBGPWRUPACK | DP_STAT_CSYSPWRUPACK));
+  dap->ctrlStat.regData = ctrl_stat;
   log_debug("DAP Power up. CTRL_STAT:0x%08X.", ctrl_stat);
+  // 读取DPIDR，DPv2还要读取TARGETID，用于区分拓扑缓存中的不同目标
+  dap->skillObj->SingleRead(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_DPIDR, &dap->idr.regData);
+  if (dap->skillObj->Commit(dap->skillObj) != ADPT_SUCCESS) {
+    // 清理指令队列
+    dap->skillObj->Cancel(dap->skillObj);
+    log_error("Read DP DPIDR register failed!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  if (dap->idr.regInfo.Version >= 2) {
+    // TARGETID位于DP寄存器bank 2
+    dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, DP_REG_TARGETID >> 4);
+    dap->skillObj->SingleRead(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_TARGETID, &dap->targetId);
+    dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, 0);
+    if (dap->skillObj->Commit(dap->skillObj) != ADPT_SUCCESS) {
+      // 清理指令队列
+      dap->skillObj->Cancel(dap->skillObj);
+      log_error("Read DP TARGETID register failed!");
+      return ADI_ERR_INTERNAL_ERROR;
+    }
+  }
+  log_debug("DAP DPIDR:0x%08X, TARGETID:0x%08X.", dap->idr.regData, dap->targetId);
+  // DPv3(ADIv6)的AP通过地址访问，需要获得根组件的基址
+  if (DAP_IS_ADIV6(dap)) {
+    return ADIv6_DpInit(dap);
+  }
+  return ADI_SUCCESS;
+}
+
+/**
+ * 按需写入TAR寄存器
+ * 影子TAR有效且高/低32位和目标地址相同时省略对应的写入
+ * 参数:
+ * 	tar:影子TAR,写入后更新为addr
+ */
+static void apUpdateTar(struct ADIv5_AccessPort *ap, struct ADIv5_TarShadow *tar, uint64_t addr) {
+  if (!tar->valid || (tar->value & 0xFFFFFFFFu) != (addr & 0xFFFFFFFFu)) {
+    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_LSB, addr & 0xFFFFFFFFu);
+  }
+  if (ap->type.memory.config.largeAddress && (!tar->valid || (tar->value >> 32) != (addr >> 32))) {
+    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_MSB, (addr >> 32) & 0xFFFFFFFFu);
+  }
+  tar->value = addr;
+  tar->valid = 1;
+}
+
+/**
+ * 模拟TAR的地址自增
+ * 只有低tarIncBits位保证自增，越过该边界之后TAR的值由实现决定，影子TAR失效
+ * 参数:
+ * 	tar:影子TAR
+ * 	bytes:TAR增加的字节数
+ */
+static void apAdvanceTar(struct ADIv5_AccessPort *ap, struct ADIv5_TarShadow *tar, uint64_t bytes) {
+  uint64_t windowMask = ~((1ull << ap->type.memory.tarIncBits) - 1);
+  if (!tar->valid) {
+    return;
+  }
+  if (((tar->value + bytes) & windowMask) != (tar->value & windowMask)) {
+    tar->valid = 0;
+    return;
+  }
+  tar->value += bytes;
+}
+
+/**
+ * 计算地址之后下一个TAR自增边界
+ * 块传输的每条指令都不能越过该边界
+ */
+static uint64_t apTarBoundary(struct ADIv5_AccessPort *ap, uint64_t addr) {
+  uint64_t window = 1ull << ap->type.memory.tarIncBits;
+  return (addr & ~(window - 1)) + window;
+}
+
+/**
+ * 计算选中AP寄存器bank时SELECT/SELECT1的值
+ * ADIv5下SELECT由APSEL和APBANKSEL组成，DPBANKSEL保持不变；
+ * ADIv6下SELECT和SELECT1组成寄存器所在的地址，AP寄存器位于AP基址+0xD00，bank n对应偏移0xD00+n*16，DPBANKSEL为0
+ */
+static ADIv5_DpSelectRegister apSelectValue(struct ADIv5_AccessPort *ap, const ADIv5_DpSelectRegister *select, uint32_t bank) {
+  ADIv5_DpSelectRegister selectTmp = *select;
+  if (DAP_IS_ADIV6(ap->dap)) {
+    uint64_t addr = ap->base + ADIV6_AP_REG_OFFSET + (bank << 4);
+    selectTmp.regData = (uint32_t)addr & ADIV6_SELECT_ADDR;
+    selectTmp.select1 = addr >> 32;
+  } else {
+    selectTmp.regInfo.AP_Sel = ap->index;
+    selectTmp.regInfo.AP_BankSel = bank;
+  }
+  return selectTmp;
+}
+
+/**
+ * 选中当前AP的寄存器bank
+ * ADIv6下同时按需写入SELECT1
+ */
+void ADIv5_ApSelectBank(struct ADIv5_AccessPort *ap, ADIv5_DpSelectRegister *select, uint32_t bank) {
+  ADIv5_DpSelectRegister selectTmp = apSelectValue(ap, select, bank);
+  if (DAP_IS_ADIV6(ap->dap)) {
+    ADIv6_WriteSelect(ap->dap, select, &selectTmp);
+    return;
+  }
+  if (selectTmp.regData != select->regData) {
+    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, selectTmp.regData);
+    select->regData = selectTmp.regData;
+  }
+}
+
+/**
+ * DP是否通过JTAG访问，没有设置Adapter时按照SW-DP处理
+ */
+static BOOL dapIsJtag(struct ADIv5_Dap *dap) {
+  return (dap->adapter != NULL && dap->adapter->currTransMode == ADPT_MODE_JTAG) ? TRUE : FALSE;
+}
+
+/**
+ * 传输出错之后的恢复
+ * 读取CTRL/STAT获得出错原因,清除粘滞错误标志,然后重新写入SELECT,
+ * 读取CSW和TAR同步影子寄存器。地址自增的传输出错时TAR停在出错的那次总线访问
+ * 参数:
+ * 	tar:出错时TAR的值(可为NULL)
+ * 返回:
+ * 	ADI_SUCCESS:恢复成功,影子寄存器和硬件一致
+ */
+static int apRecover(struct ADIv5_AccessPort *ap, uint64_t *tar) {
+  struct ADIv5_Dap *dap = ap->dap;
+  struct ADIv5_AccessPort *apPos;
+  ADIv5_DpSelectRegister selectTmp, selectUnknown;
+  uint32_t ctrlStat = 0, ctrlNormal, csw = 0, tarLsb = 0, tarMsb = 0;
+
+  // 传输出错可能是目标复位或者掉电引起的,内存的状态未知,作废所有缓存
+  list_for_each_entry(apPos, &dap->apList, list_entry) {
+    if (apPos->apApi.type == AccessPort_Memory && apPos->type.memory.cache != NULL) {
+      ADIv5_MemCacheInvalidate(apPos->type.memory.cache);
+    }
+  }
+  // 清理指令队列中没有执行的指令
+  dap->skillObj->Cancel(dap->skillObj);
+  // TAR和SELECT的状态未知
+  ap->type.memory.tar.valid = 0;
+  selectTmp = apSelectValue(ap, &dap->select, 0x0);
+  selectTmp.regInfo.DP_BankSel = 0;
+  selectUnknown.regData = selectUnknown.select1 = ADIV6_SELECT_UNKNOWN;
+  for (int retry = 0;; retry++) {
+    // 重新写入SELECT,DPBANKSEL为0,然后读取CTRL/STAT
+    if (DAP_IS_ADIV6(dap)) {
+      ADIv6_WriteSelect(dap, &selectUnknown, &selectTmp);
+    } else {
+      dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, selectTmp.regData);
+    }
+    dap->skillObj->SingleRead(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_CTRL_STAT, &ctrlStat);
+    if (dap->skillObj->Commit(dap->skillObj) == ADPT_SUCCESS) {
+      break;
+    }
+    dap->skillObj->Cancel(dap->skillObj);
+    if (retry > 0) {
+      dap->select.regData = dap->select.select1 = ADIV6_SELECT_UNKNOWN;
+      log_error("Read DP CTRL/STAT register failed!");
+      return ADI_ERR_INTERNAL_ERROR;
+    }
+    // AP传输一直WAIT,通过DAPABORT终止
+    dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_ABORT, DP_ABORT_DAPABORT);
+  }
+  dap->select = selectTmp;
+  dap->ctrlStat.regData = ctrlStat;
+  log_warn("DAP transfer failed, CTRL/STAT:0x%08X.", ctrlStat);
+  // 保留控制位，恢复正常传输模式
+  ctrlNormal = ctrlStat & ~(DP_CTRL_TRNMODEMSK | DP_CTRL_MASKLANEMSK | DP_STAT_MASK);
+  if (dapIsJtag(dap)) {
+    // JTAG-DP的ABORT[4:1]应写0，粘滞标志在CTRL/STAT中写1清除
+    dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_CTRL_STAT,
+                               ctrlNormal | DP_STAT_STICKYERR | DP_STAT_STICKYORUN | DP_STAT_STICKYCMP);
+  } else {
+    // SW-DP的CTRL/STAT粘滞标志只读，通过ABORT清除
+    dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_ABORT,
+                               DP_ABORT_STKERRCLR | DP_ABORT_WDERRCLR | DP_ABORT_ORUNERRCLR | DP_ABORT_STKCMPCLR);
+    dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_CTRL_STAT, ctrlNormal);
+  }
+  // 读取CSW和TAR
+  dap->skillObj->SingleRead(dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, &csw);
+  dap->skillObj->SingleRead(dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_LSB, &tarLsb);
+  if (ap->type.memory.config.largeAddress) {
+    dap->skillObj->SingleRead(dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_MSB, &tarMsb);
+  }
+  if (dap->skillObj->Commit(dap->skillObj) != ADPT_SUCCESS) {
+    dap->skillObj->Cancel(dap->skillObj);
+    log_error("Clear DAP sticky error failed!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  ap->type.memory.csw.regData = csw;
+  ap->type.memory.tar.value = ((uint64_t)tarMsb << 32) | tarLsb;
+  ap->type.memory.tar.valid = 1;
+  if (tar != NULL) {
+    *tar = ap->type.memory.tar.value;
+  }
   return ADI_SUCCESS;
 }
 
+/**
+ * 根据出错时TAR的值计算继续传输的起始地址
+ * 写操作出错时TAR停在出错的那次总线访问,之前的数据都已写入;读操作出错时,
+ * 出错的那条指令的数据不会返回,而每条指令都不跨越TAR自增边界,所以从TAR所在的自增窗口开始重新读取。
+ * TAR不在传输范围内,或者TAR仍是传输之前的值(写TAR之前就已出错)时,从头开始
+ * 参数:
+ * 	before:传输之前的影子TAR
+ */
+static uint64_t apResumeAddr(struct ADIv5_AccessPort *ap, const struct ADIv5_TarShadow *before, uint64_t tar,
+                             uint64_t start, uint64_t end, int isRead) {
+  if (tar <= start || tar >= end || (before->valid && before->value == tar)) {
+    return start;
+  }
+  if (isRead) {
+    tar &= ~((1ull << ap->type.memory.tarIncBits) - 1);
+    return tar < start ? start : tar;
+  }
+  return tar;
+}
+
+/**
+ * 块传输出错之后恢复DAP,并从第一个出错的位置继续传输
+ * 地址不增的传输无法确定已经完成的次数,只恢复DAP,不继续传输
+ * 参数:
+ * 	data:块传输的数据,每次DRW访问一个字
+ */
+static int apBlockRecover(struct ADIv5_AccessPort *ap, uint64_t addr, enum addrIncreaseMode mode,
+                          enum dataSize size, unsigned int count, uint8_t *data, int isRead) {
+  struct ADIv5_TarShadow before = ap->type.memory.tar;
+  // 每个元素在地址空间和数据缓冲区中所占字节数,以2为底的对数
+  unsigned int addrShift = mode == AddrInc_Packed ? 2 : size;
+  unsigned int dataShift = size > DataSize_32 ? size : 2;
+  uint64_t tar, resume, done;
+  int ret;
+
+  if (apRecover(ap, &tar) != ADI_SUCCESS || mode == AddrInc_Off) {
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  if (ap->dap->recoverDepth >= ADIV5_RECOVER_RETRY) {
+    log_error("Block transfer still failed after %d retries!", ADIV5_RECOVER_RETRY);
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  resume = apResumeAddr(ap, &before, tar, addr, addr + ((uint64_t)count << addrShift), isRead);
+  done = (resume - addr) >> addrShift;
+  log_info("Resume block transfer from 0x%llX.", (unsigned long long)(addr + (done << addrShift)));
+  ap->dap->recoverDepth++;
+  if (isRead) {
+    ret = ap->apApi.Interface.Memory.BlockRead(&ap->apApi, addr + (done << addrShift), mode, size, count - done,
+                                               data + (done << dataShift));
+  } else {
+    ret = ap->apApi.Interface.Memory.BlockWrite(&ap->apApi, addr + (done << addrShift), mode, size, count - done,
+                                                data + (done << dataShift));
+  }
+  ap->dap->recoverDepth--;
+  return ret;
+}
+
+/**
+ * 写内存之后通知内存缓存作废对应的行
+ * 不同的MEM-AP可能访问同一块内存,所以通知同一个DAP上所有AP的缓存;
+ * 写操作失败时目标内存的状态也是未知的,同样需要作废
+ */
+static void apNotifyWrite(struct ADIv5_AccessPort *ap, uint64_t addr, uint64_t len) {
+  struct ADIv5_AccessPort *apPos;
+  list_for_each_entry(apPos, &ap->dap->apList, list_entry) {
+    if (apPos->apApi.type == AccessPort_Memory && apPos->type.memory.cache != NULL) {
+      ADIv5_MemCacheWriteNotify(apPos->type.memory.cache, addr, len);
+    }
+  }
+}
+
 /**
  * apRead8 读8位数据
  */
@@ -107,6 +377,7 @@ static int apRead8(AccessPort self, uint64_t addr, uint8_t *data) {
   assert(data != NULL);
   ADIv5_DpSelectRegister selectTmp;
   ADIv5_ApCswRegister cswTmp;
+  struct ADIv5_TarShadow tarTmp;
   struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
   // 检查AP类型
   if (self->type != AccessPort_Memory) {
@@ -114,47 +385,42 @@ static int apRead8(AccessPort self, uint64_t addr, uint8_t *data) {
     return ADI_ERR_BAD_PARAMETER;
   }
   // 初始化本地临时变量
-  selectTmp.regData = ap->dap->select.regData;
+  selectTmp = ap->dap->select;
   cswTmp.regData = ap->type.memory.csw.regData;
-  // 选中当前ap
-  selectTmp.regInfo.AP_Sel = ap->index;
-  // 选中当前ap CSW 寄存器 bank
-  selectTmp.regInfo.AP_BankSel = 0x0;
-  // 设置CSW：Size=Word，AddrInc=off
-  cswTmp.regInfo.AddrInc = AP_CSW_NADDRINC; // AddrInc Off
+  tarTmp = ap->type.memory.tar;
+  // 设置CSW：AddrInc=Single，连续地址的访问可以省略TAR的写入
+  cswTmp.regInfo.AddrInc = AP_CSW_SADDRINC; // AddrInc Single
   if (!ap->type.memory.config.lessWordTransfers) {
     log_warn("Couldn't support Less Word Transfers.");
     return ADI_ERR_UNSUPPORT;
   }
   cswTmp.regInfo.Size = AP_CSW_SIZE8; // Byte
-  // 是否需要更新SELECT寄存器?
-  if (ap->dap->select.regData != selectTmp.regData) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, selectTmp.regData);
-  }
+  // 按需更新SELECT寄存器，选中当前AP的寄存器bank 0
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x0);
   // 是否需要更新CSW寄存器？
   if (ap->type.memory.csw.regData != cswTmp.regData) {
     ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, cswTmp.regData);
   }
-  // 写入TAR
-  ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_LSB, addr & 0xFFFFFFFFu);
-  if (ap->type.memory.config.largeAddress) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_MSB, (addr >> 32) & 0xFFFFFFFFu);
-  }
+  // 按需写入TAR
+  apUpdateTar(ap, &tarTmp, addr);
   uint32_t data_tmp = 0;
   // 读DRW寄存器
   ap->dap->skillObj->SingleRead(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, &data_tmp);
+  // 本次访问之后TAR自增1字节
+  apAdvanceTar(ap, &tarTmp, 1);
   // 执行指令队列
   if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
-    // 清理指令队列
-    ap->dap->skillObj->Cancel(ap->dap->skillObj);
+    // 清除粘滞错误标志，同步影子寄存器
+    apRecover(ap, NULL);
     log_error("Execute DAP command failed!");
     return ADI_ERR_INTERNAL_ERROR;
   }
   // 根据byte lane获得数据
   *data = (data_tmp >> ((addr & 3) << 3)) & 0xff;
   // 指令执行成功，同步数据到DAP影子寄存器
-  ap->dap->select.regData = selectTmp.regData;
+  ap->dap->select = selectTmp;
   ap->type.memory.csw.regData = cswTmp.regData;
+  ap->type.memory.tar = tarTmp;
   return ADI_SUCCESS;
 }
 
@@ -166,6 +432,7 @@ static int apRead16(AccessPort self, uint64_t addr, uint16_t *data) {
   assert(data != NULL);
   ADIv5_DpSelectRegister selectTmp;
   ADIv5_ApCswRegister cswTmp;
+  struct ADIv5_TarShadow tarTmp;
   struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
   // 检查AP类型
   if (self->type != AccessPort_Memory) {
@@ -178,47 +445,42 @@ static int apRead16(AccessPort self, uint64_t addr, uint16_t *data) {
     return ADI_ERR_BAD_PARAMETER;
   }
   // 初始化本地临时变量
-  selectTmp.regData = ap->dap->select.regData;
+  selectTmp = ap->dap->select;
   cswTmp.regData = ap->type.memory.csw.regData;
-  // 选中当前ap
-  selectTmp.regInfo.AP_Sel = ap->index;
-  // 选中当前ap CSW 寄存器 bank
-  selectTmp.regInfo.AP_BankSel = 0x0;
-  // 设置CSW：Size=Word，AddrInc=off
-  cswTmp.regInfo.AddrInc = AP_CSW_NADDRINC; // AddrInc Off
+  tarTmp = ap->type.memory.tar;
+  // 设置CSW：AddrInc=Single，连续地址的访问可以省略TAR的写入
+  cswTmp.regInfo.AddrInc = AP_CSW_SADDRINC; // AddrInc Single
   if (!ap->type.memory.config.lessWordTransfers) {
     log_warn("Couldn't support Less Word Transfers.");
     return ADI_ERR_UNSUPPORT;
   }
   cswTmp.regInfo.Size = AP_CSW_SIZE16; // Half Word
-  // 是否需要更新SELECT寄存器?
-  if (ap->dap->select.regData != selectTmp.regData) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, selectTmp.regData);
-  }
+  // 按需更新SELECT寄存器，选中当前AP的寄存器bank 0
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x0);
   // 是否需要更新CSW寄存器？
   if (ap->type.memory.csw.regData != cswTmp.regData) {
     ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, cswTmp.regData);
   }
-  // 写入TAR
-  ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_LSB, addr & 0xFFFFFFFFu);
-  if (ap->type.memory.config.largeAddress) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_MSB, (addr >> 32) & 0xFFFFFFFFu);
-  }
+  // 按需写入TAR
+  apUpdateTar(ap, &tarTmp, addr);
   uint32_t data_tmp = 0;
   // 读DRW寄存器
   ap->dap->skillObj->SingleRead(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, &data_tmp);
+  // 本次访问之后TAR自增2字节
+  apAdvanceTar(ap, &tarTmp, 2);
   // 执行指令队列
   if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
-    // 清理指令队列
-    ap->dap->skillObj->Cancel(ap->dap->skillObj);
+    // 清除粘滞错误标志，同步影子寄存器
+    apRecover(ap, NULL);
     log_error("Execute DAP command failed!");
     return ADI_ERR_INTERNAL_ERROR;
   }
   // 根据byte lane获得数据
   *data = (data_tmp >> ((addr & 3) << 3)) & 0xffff;
   // 指令执行成功，同步数据到DAP影子寄存器
-  ap->dap->select.regData = selectTmp.regData;
+  ap->dap->select = selectTmp;
   ap->type.memory.csw.regData = cswTmp.regData;
+  ap->type.memory.tar = tarTmp;
   return ADI_SUCCESS;
 }
 
@@ -230,6 +492,7 @@ static int apRead32(AccessPort self, uint64_t addr, uint32_t *data) {
   assert(data != NULL);
   ADIv5_DpSelectRegister selectTmp;
   ADIv5_ApCswRegister cswTmp;
+  struct ADIv5_TarShadow tarTmp;
   struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
   // 检查AP类型
   if (self->type != AccessPort_Memory) {
@@ -242,40 +505,35 @@ static int apRead32(AccessPort self, uint64_t addr, uint32_t *data) {
     return ADI_ERR_BAD_PARAMETER;
   }
   // 初始化本地临时变量
-  selectTmp.regData = ap->dap->select.regData;
+  selectTmp = ap->dap->select;
   cswTmp.regData = ap->type.memory.csw.regData;
-  // 选中当前ap
-  selectTmp.regInfo.AP_Sel = ap->index;
-  // 选中当前ap寄存器 bank
-  selectTmp.regInfo.AP_BankSel = 0x0;
-  // 设置CSW：Size=Word，AddrInc=off
-  cswTmp.regInfo.AddrInc = AP_CSW_NADDRINC; // AddrInc Off
+  tarTmp = ap->type.memory.tar;
+  // 设置CSW：AddrInc=Single，连续地址的访问可以省略TAR的写入
+  cswTmp.regInfo.AddrInc = AP_CSW_SADDRINC; // AddrInc Single
   cswTmp.regInfo.Size = AP_CSW_SIZE32;      // Word
-  // 是否需要更新SELECT寄存器?
-  if (ap->dap->select.regData != selectTmp.regData) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, selectTmp.regData);
-  }
+  // 按需更新SELECT寄存器，选中当前AP的寄存器bank 0
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x0);
   // 是否需要更新CSW寄存器？
   if (ap->type.memory.csw.regData != cswTmp.regData) {
     ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, cswTmp.regData);
   }
-  // 写入TAR
-  ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_LSB, addr & 0xFFFFFFFFu);
-  if (ap->type.memory.config.largeAddress) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_MSB, (addr >> 32) & 0xFFFFFFFFu);
-  }
+  // 按需写入TAR
+  apUpdateTar(ap, &tarTmp, addr);
   // 读DRW寄存器, 根据byte lane获得数据
   ap->dap->skillObj->SingleRead(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, data);
+  // 本次访问之后TAR自增4字节
+  apAdvanceTar(ap, &tarTmp, 4);
   // 执行指令队列
   if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
-    // 清理指令队列
-    ap->dap->skillObj->Cancel(ap->dap->skillObj);
+    // 清除粘滞错误标志，同步影子寄存器
+    apRecover(ap, NULL);
     log_error("Execute DAP command failed!");
     return ADI_ERR_INTERNAL_ERROR;
   }
   // 指令执行成功，同步数据到DAP影子寄存器
-  ap->dap->select.regData = selectTmp.regData;
+  ap->dap->select = selectTmp;
   ap->type.memory.csw.regData = cswTmp.regData;
+  ap->type.memory.tar = tarTmp;
   return ADI_SUCCESS;
 }
 
@@ -287,6 +545,7 @@ static int apRead64(AccessPort self, uint64_t addr, uint64_t *data) {
   assert(data != NULL);
   ADIv5_DpSelectRegister selectTmp;
   ADIv5_ApCswRegister cswTmp;
+  struct ADIv5_TarShadow tarTmp;
   struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
   // 检查AP类型
   if (self->type != AccessPort_Memory) {
@@ -299,48 +558,43 @@ static int apRead64(AccessPort self, uint64_t addr, uint64_t *data) {
     return ADI_ERR_BAD_PARAMETER;
   }
   // 初始化本地临时变量
-  selectTmp.regData = ap->dap->select.regData;
+  selectTmp = ap->dap->select;
   cswTmp.regData = ap->type.memory.csw.regData;
-  // 选中当前ap
-  selectTmp.regInfo.AP_Sel = ap->index;
-  // 选中当前ap寄存器 bank
-  selectTmp.regInfo.AP_BankSel = 0x0;
-  // 设置CSW：Size=Word，AddrInc=off
-  cswTmp.regInfo.AddrInc = AP_CSW_NADDRINC; // AddrInc Off
+  tarTmp = ap->type.memory.tar;
+  // 设置CSW：AddrInc=Single，连续地址的访问可以省略TAR的写入
+  cswTmp.regInfo.AddrInc = AP_CSW_SADDRINC; // AddrInc Single
   if (!ap->type.memory.config.largeData) {
     log_warn("Couldn't support Large Word Transfers.");
     return ADI_ERR_UNSUPPORT;
   }
   cswTmp.regInfo.Size = AP_CSW_SIZE64; // Double Word
-  // 是否需要更新SELECT寄存器?
-  if (ap->dap->select.regData != selectTmp.regData) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, selectTmp.regData);
-  }
+  // 按需更新SELECT寄存器，选中当前AP的寄存器bank 0
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x0);
   // 是否需要更新CSW寄存器？
   if (ap->type.memory.csw.regData != cswTmp.regData) {
     ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, cswTmp.regData);
   }
-  // 写入TAR
-  ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_LSB, addr & 0xFFFFFFFFu);
-  if (ap->type.memory.config.largeAddress) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_MSB, (addr >> 32) & 0xFFFFFFFFu);
-  }
+  // 按需写入TAR
+  apUpdateTar(ap, &tarTmp, addr);
   // 读DRW寄存器
   uint32_t data_tmp[2]; // 定义缓冲区
   // 读取数据，第一次读取的是低位，接下来读取高位，必须两次读取后才能完成本次AP Memory access
   ap->dap->skillObj->SingleRead(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, data_tmp);
   ap->dap->skillObj->SingleRead(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, data_tmp + 1);
+  // 本次访问之后TAR自增8字节
+  apAdvanceTar(ap, &tarTmp, 8);
   // 执行指令队列
   if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
-    // 清理指令队列
-    ap->dap->skillObj->Cancel(ap->dap->skillObj);
+    // 清除粘滞错误标志，同步影子寄存器
+    apRecover(ap, NULL);
     log_error("Execute DAP command failed!");
     return ADI_ERR_INTERNAL_ERROR;
   }
   *data = ((uint64_t)data_tmp[1] << 32) | data_tmp[0];
   // 指令执行成功，同步数据到DAP影子寄存器
-  ap->dap->select.regData = selectTmp.regData;
+  ap->dap->select = selectTmp;
   ap->type.memory.csw.regData = cswTmp.regData;
+  ap->type.memory.tar = tarTmp;
   return ADI_SUCCESS;
 }
 
@@ -351,6 +605,7 @@ static int apWrite8(AccessPort self, uint64_t addr, uint8_t data) {
   assert(self != NULL);
   ADIv5_DpSelectRegister selectTmp;
   ADIv5_ApCswRegister cswTmp;
+  struct ADIv5_TarShadow tarTmp;
   struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
   // 检查AP类型
   if (self->type != AccessPort_Memory) {
@@ -358,45 +613,41 @@ static int apWrite8(AccessPort self, uint64_t addr, uint8_t data) {
     return ADI_ERR_BAD_PARAMETER;
   }
   // 初始化本地临时变量
-  selectTmp.regData = ap->dap->select.regData;
+  selectTmp = ap->dap->select;
   cswTmp.regData = ap->type.memory.csw.regData;
-  // 选中当前ap
-  selectTmp.regInfo.AP_Sel = ap->index;
-  // 选中当前ap寄存器 bank
-  selectTmp.regInfo.AP_BankSel = 0x0;
-  // 设置CSW：Size=Word，AddrInc=off
-  cswTmp.regInfo.AddrInc = AP_CSW_NADDRINC; // AddrInc Off
+  tarTmp = ap->type.memory.tar;
+  // 设置CSW：AddrInc=Single，连续地址的访问可以省略TAR的写入
+  cswTmp.regInfo.AddrInc = AP_CSW_SADDRINC; // AddrInc Single
   if (!ap->type.memory.config.lessWordTransfers) {
     log_warn("Couldn't support Less Word Transfers.");
     return ADI_ERR_UNSUPPORT;
   }
   cswTmp.regInfo.Size = AP_CSW_SIZE8; // Byte
-  // 是否需要更新SELECT寄存器?
-  if (ap->dap->select.regData != selectTmp.regData) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, selectTmp.regData);
-  }
+  // 按需更新SELECT寄存器，选中当前AP的寄存器bank 0
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x0);
   // 是否需要更新CSW寄存器？
   if (ap->type.memory.csw.regData != cswTmp.regData) {
     ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, cswTmp.regData);
   }
-  // 写入TAR
-  ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_LSB, addr & 0xFFFFFFFFu);
-  if (ap->type.memory.config.largeAddress) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_MSB, (addr >> 32) & 0xFFFFFFFFu);
-  }
+  // 按需写入TAR
+  apUpdateTar(ap, &tarTmp, addr);
   // 写DRW寄存器
   uint32_t data_tmp = data << ((addr & 3) << 3); // 放到Byte Lane确定的位置
   ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, data_tmp);
+  // 本次访问之后TAR自增1字节
+  apAdvanceTar(ap, &tarTmp, 1);
+  apNotifyWrite(ap, addr, 1);
   // 执行指令队列
   if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
-    // 清理指令队列
-    ap->dap->skillObj->Cancel(ap->dap->skillObj);
+    // 清除粘滞错误标志，同步影子寄存器
+    apRecover(ap, NULL);
     log_error("Execute DAP command failed!");
     return ADI_ERR_INTERNAL_ERROR;
   }
   // 指令执行成功，同步数据到DAP影子寄存器
-  ap->dap->select.regData = selectTmp.regData;
+  ap->dap->select = selectTmp;
   ap->type.memory.csw.regData = cswTmp.regData;
+  ap->type.memory.tar = tarTmp;
   return ADI_SUCCESS;
 }
 
@@ -407,6 +658,7 @@ static int apWrite16(AccessPort self, uint64_t addr, uint16_t data) {
   assert(self != NULL);
   ADIv5_DpSelectRegister selectTmp;
   ADIv5_ApCswRegister cswTmp;
+  struct ADIv5_TarShadow tarTmp;
   struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
   // 检查AP类型
   if (self->type != AccessPort_Memory) {
@@ -419,45 +671,41 @@ static int apWrite16(AccessPort self, uint64_t addr, uint16_t data) {
     return ADI_ERR_BAD_PARAMETER;
   }
   // 初始化本地临时变量
-  selectTmp.regData = ap->dap->select.regData;
+  selectTmp = ap->dap->select;
   cswTmp.regData = ap->type.memory.csw.regData;
-  // 选中当前ap
-  selectTmp.regInfo.AP_Sel = ap->index;
-  // 选中当前ap寄存器 bank
-  selectTmp.regInfo.AP_BankSel = 0x0;
-  // 设置CSW：Size=Word，AddrInc=off
-  cswTmp.regInfo.AddrInc = AP_CSW_NADDRINC; // AddrInc Off
+  tarTmp = ap->type.memory.tar;
+  // 设置CSW：AddrInc=Single，连续地址的访问可以省略TAR的写入
+  cswTmp.regInfo.AddrInc = AP_CSW_SADDRINC; // AddrInc Single
   if (!ap->type.memory.config.lessWordTransfers) {
     log_warn("Couldn't support Less Word Transfers.");
     return ADI_ERR_UNSUPPORT;
   }
   cswTmp.regInfo.Size = AP_CSW_SIZE16; // Half Word
-  // 是否需要更新SELECT寄存器?
-  if (ap->dap->select.regData != selectTmp.regData) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, selectTmp.regData);
-  }
+  // 按需更新SELECT寄存器，选中当前AP的寄存器bank 0
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x0);
   // 是否需要更新CSW寄存器？
   if (ap->type.memory.csw.regData != cswTmp.regData) {
     ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, cswTmp.regData);
   }
-  // 写入TAR
-  ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_LSB, addr & 0xFFFFFFFFu);
-  if (ap->type.memory.config.largeAddress) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_MSB, (addr >> 32) & 0xFFFFFFFFu);
-  }
+  // 按需写入TAR
+  apUpdateTar(ap, &tarTmp, addr);
   // 写DRW寄存器
   uint32_t data_tmp = data << ((addr & 3) << 3); // 放到Byte Lane确定的位置
   ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, data_tmp);
+  // 本次访问之后TAR自增2字节
+  apAdvanceTar(ap, &tarTmp, 2);
+  apNotifyWrite(ap, addr, 2);
   // 执行指令队列
   if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
-    // 清理指令队列
-    ap->dap->skillObj->Cancel(ap->dap->skillObj);
+    // 清除粘滞错误标志，同步影子寄存器
+    apRecover(ap, NULL);
     log_error("Execute DAP command failed!");
     return ADI_ERR_INTERNAL_ERROR;
   }
   // 指令执行成功，同步数据到DAP影子寄存器
-  ap->dap->select.regData = selectTmp.regData;
+  ap->dap->select = selectTmp;
   ap->type.memory.csw.regData = cswTmp.regData;
+  ap->type.memory.tar = tarTmp;
   return ADI_SUCCESS;
 }
 
@@ -468,6 +716,7 @@ static int apWrite32(AccessPort self, uint64_t addr, uint32_t data) {
   assert(self != NULL);
   ADIv5_DpSelectRegister selectTmp;
   ADIv5_ApCswRegister cswTmp;
+  struct ADIv5_TarShadow tarTmp;
   struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
   // 检查AP类型
   if (self->type != AccessPort_Memory) {
@@ -480,40 +729,36 @@ static int apWrite32(AccessPort self, uint64_t addr, uint32_t data) {
     return ADI_ERR_BAD_PARAMETER;
   }
   // 初始化本地临时变量
-  selectTmp.regData = ap->dap->select.regData;
+  selectTmp = ap->dap->select;
   cswTmp.regData = ap->type.memory.csw.regData;
-  // 选中当前ap
-  selectTmp.regInfo.AP_Sel = ap->index;
-  // 选中当前ap寄存器 bank
-  selectTmp.regInfo.AP_BankSel = 0x0;
-  // 设置CSW：Size=Word，AddrInc=off
-  cswTmp.regInfo.AddrInc = AP_CSW_NADDRINC; // AddrInc Off
+  tarTmp = ap->type.memory.tar;
+  // 设置CSW：AddrInc=Single，连续地址的访问可以省略TAR的写入
+  cswTmp.regInfo.AddrInc = AP_CSW_SADDRINC; // AddrInc Single
   cswTmp.regInfo.Size = AP_CSW_SIZE32;      // Word
-  // 是否需要更新SELECT寄存器?
-  if (ap->dap->select.regData != selectTmp.regData) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, selectTmp.regData);
-  }
+  // 按需更新SELECT寄存器，选中当前AP的寄存器bank 0
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x0);
   // 是否需要更新CSW寄存器？
   if (ap->type.memory.csw.regData != cswTmp.regData) {
     ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, cswTmp.regData);
   }
-  // 写入TAR
-  ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_LSB, addr & 0xFFFFFFFFu);
-  if (ap->type.memory.config.largeAddress) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_MSB, (addr >> 32) & 0xFFFFFFFFu);
-  }
+  // 按需写入TAR
+  apUpdateTar(ap, &tarTmp, addr);
   // 写DRW寄存器
   ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, data);
+  // 本次访问之后TAR自增4字节
+  apAdvanceTar(ap, &tarTmp, 4);
+  apNotifyWrite(ap, addr, 4);
   // 执行指令队列
   if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
-    // 清理指令队列
-    ap->dap->skillObj->Cancel(ap->dap->skillObj);
+    // 清除粘滞错误标志，同步影子寄存器
+    apRecover(ap, NULL);
     log_error("Execute DAP command failed!");
     return ADI_ERR_INTERNAL_ERROR;
   }
   // 指令执行成功，同步数据到DAP影子寄存器
-  ap->dap->select.regData = selectTmp.regData;
+  ap->dap->select = selectTmp;
   ap->type.memory.csw.regData = cswTmp.regData;
+  ap->type.memory.tar = tarTmp;
   return ADI_SUCCESS;
 }
 
@@ -524,6 +769,7 @@ static int apWrite64(AccessPort self, uint64_t addr, uint64_t data) {
   assert(self != NULL);
   ADIv5_DpSelectRegister selectTmp;
   ADIv5_ApCswRegister cswTmp;
+  struct ADIv5_TarShadow tarTmp;
   struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
   // 检查AP类型
   if (self->type != AccessPort_Memory) {
@@ -536,45 +782,41 @@ static int apWrite64(AccessPort self, uint64_t addr, uint64_t data) {
     return ADI_ERR_BAD_PARAMETER;
   }
   // 初始化本地临时变量
-  selectTmp.regData = ap->dap->select.regData;
+  selectTmp = ap->dap->select;
   cswTmp.regData = ap->type.memory.csw.regData;
-  // 选中当前ap
-  selectTmp.regInfo.AP_Sel = ap->index;
-  // 选中当前ap寄存器 bank
-  selectTmp.regInfo.AP_BankSel = 0x0;
-  // 设置CSW：Size=Word，AddrInc=off
-  cswTmp.regInfo.AddrInc = AP_CSW_NADDRINC; // AddrInc Off
+  tarTmp = ap->type.memory.tar;
+  // 设置CSW：AddrInc=Single，连续地址的访问可以省略TAR的写入
+  cswTmp.regInfo.AddrInc = AP_CSW_SADDRINC; // AddrInc Single
   if (!ap->type.memory.config.largeData) {
     log_warn("Couldn't support Large Word Transfers.");
     return ADI_ERR_UNSUPPORT;
   }
   cswTmp.regInfo.Size = AP_CSW_SIZE64; // Double Word
-  // 是否需要更新SELECT寄存器?
-  if (ap->dap->select.regData != selectTmp.regData) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, selectTmp.regData);
-  }
+  // 按需更新SELECT寄存器，选中当前AP的寄存器bank 0
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x0);
   // 是否需要更新CSW寄存器？
   if (ap->type.memory.csw.regData != cswTmp.regData) {
     ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, cswTmp.regData);
   }
-  // 写入TAR
-  ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_LSB, addr & 0xFFFFFFFFu);
-  if (ap->type.memory.config.largeAddress) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_MSB, (addr >> 32) & 0xFFFFFFFFu);
-  }
+  // 按需写入TAR
+  apUpdateTar(ap, &tarTmp, addr);
   // 写DRW寄存器，先写低位，再写高位，最后一个高位写完后才初始化Memory access
   ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, data & 0xFFFFFFFFu);
   ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, (data >> 32) & 0xFFFFFFFFu);
+  // 本次访问之后TAR自增8字节
+  apAdvanceTar(ap, &tarTmp, 8);
+  apNotifyWrite(ap, addr, 8);
   // 执行指令队列
   if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
-    // 清理指令队列
-    ap->dap->skillObj->Cancel(ap->dap->skillObj);
+    // 清除粘滞错误标志，同步影子寄存器
+    apRecover(ap, NULL);
     log_error("Execute DAP command failed!");
     return ADI_ERR_INTERNAL_ERROR;
   }
   // 指令执行成功，同步数据到DAP影子寄存器
-  ap->dap->select.regData = selectTmp.regData;
+  ap->dap->select = selectTmp;
   ap->type.memory.csw.regData = cswTmp.regData;
+  ap->type.memory.tar = tarTmp;
   return ADI_SUCCESS;
 }
 
@@ -588,18 +830,16 @@ static int apBlockRead(AccessPort self, uint64_t addr, enum addrIncreaseMode mod
   struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
   ADIv5_DpSelectRegister selectTmp;
   ADIv5_ApCswRegister cswTmp;
+  struct ADIv5_TarShadow tarTmp;
   // 检查AP类型
   if (self->type != AccessPort_Memory) {
     log_error("Not a memory access port!");
     return ADI_ERR_BAD_PARAMETER;
   }
   // 初始化本地临时变量
-  selectTmp.regData = ap->dap->select.regData;
+  selectTmp = ap->dap->select;
   cswTmp.regData = ap->type.memory.csw.regData;
-  // 选中当前ap
-  selectTmp.regInfo.AP_Sel = ap->index;
-  // 选中当前ap寄存器 bank
-  selectTmp.regInfo.AP_BankSel = 0x0;
+  tarTmp = ap->type.memory.tar;
   // some checks
   switch (size) {
   case DataSize_8:
@@ -635,6 +875,22 @@ static int apBlockRead(AccessPort self, uint64_t addr, enum addrIncreaseMode mod
   case DataSize_64:
   case DataSize_128:
   case DataSize_256:
+    // Large Data Extension:每次总线传输需要连续访问DRW 2/4/8次
+    if (!ap->type.memory.config.largeData || (size == DataSize_128 && !ap->type.memory.config.largeData128) ||
+        (size == DataSize_256 && !ap->type.memory.config.largeData256)) {
+      log_warn("Couldn't support large data transfers.");
+      return ADI_ERR_UNSUPPORT;
+    }
+    if (addr & ((1u << (AP_CSW_SIZE64 + size - DataSize_64)) - 1)) {
+      log_warn("Memory address is not aligned to the data size!");
+      return ADI_ERR_BAD_PARAMETER;
+    }
+    if (mode == AddrInc_Packed) {
+      log_warn("Packed transfers is not support on large data.");
+      return ADI_ERR_UNSUPPORT;
+    }
+    cswTmp.regInfo.Size = AP_CSW_SIZE64 + size - DataSize_64;
+    break;
   default:
     log_warn("Specified data size is not support.");
     return ADI_ERR_UNSUPPORT;
@@ -654,30 +910,27 @@ static int apBlockRead(AccessPort self, uint64_t addr, enum addrIncreaseMode mod
     log_warn("Specified address increase mode is not support.");
     return ADI_ERR_UNSUPPORT;
   }
-  // 是否需要更新SELECT寄存器?
-  if (ap->dap->select.regData != selectTmp.regData) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, selectTmp.regData);
-  }
+  // 按需更新SELECT寄存器，选中当前AP的寄存器bank 0
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x0);
   // 是否需要更新CSW寄存器？
   if (ap->type.memory.csw.regData != cswTmp.regData) {
     ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, cswTmp.regData);
   }
 
-  // 处理地址自增模式下超过1kb边界的情况，超过1kb的边界了需要拆分，每次地址自增控制在1kb以内
+  // 处理地址自增模式下超过TAR自增边界的情况，需要拆分，每次地址自增控制在tarIncBits以内
   uint64_t addrCurr = addr, addrEnd;          // 当前地址，结束地址
-  uint64_t addrNextBoundary;                  // 地址的下一个1kb边界
+  uint64_t addrNextBoundary;                  // 地址的下一个TAR自增边界
   unsigned int thisTimeTransCnt, dataPos = 0; // 指向data_out的偏移
+  // 每次总线传输访问DRW的次数(以2为底的对数)，小于等于字时为1次
+  unsigned int drwShift = cswTmp.regInfo.Size > AP_CSW_SIZE32 ? cswTmp.regInfo.Size - AP_CSW_SIZE32 : 0;
 
   if (cswTmp.regInfo.AddrInc == AP_CSW_SADDRINC) {
     // 每次写DRW，发起一次memory access，之后自增TAR
     addrEnd = addr + (count << cswTmp.regInfo.Size); 
     while (addrCurr < addrEnd) {
-      addrNextBoundary = ((addrCurr >> 10) + 1) << 10; // 找到下一个1kb边界
-      // 写入TAR
-      ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_LSB, addrCurr & 0xFFFFFFFFu);
-      if (ap->type.memory.config.largeAddress) {
-        ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_MSB, (addrCurr >> 32) & 0xFFFFFFFFu);
-      }
+      addrNextBoundary = apTarBoundary(ap, addrCurr); // 找到下一个TAR自增边界
+      // 按需写入TAR
+      apUpdateTar(ap, &tarTmp, addrCurr);
       // log_debug("SINGLE:CurrAddr:0x%08X;next boundary:0x%08X.", addrCurr, addrNextBoundary);
       // 如果下一个边界大于结束地址
       if (addrNextBoundary > addrEnd) {
@@ -689,18 +942,16 @@ static int apBlockRead(AccessPort self, uint64_t addr, enum addrIncreaseMode mod
       }
       // log_debug("SINGLE:dataPos:%d;thisTimeTransCnt:%d.", dataPos, thisTimeTransCnt);
       // 读取block
-      ap->dap->skillObj->MultiRead(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, thisTimeTransCnt, data_out + dataPos);
-      dataPos += thisTimeTransCnt;
+      ap->dap->skillObj->MultiRead(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, thisTimeTransCnt << drwShift, data_out + dataPos);
+      apAdvanceTar(ap, &tarTmp, (uint64_t)thisTimeTransCnt << cswTmp.regInfo.Size);
+      dataPos += thisTimeTransCnt << drwShift;
     }
   } else if (cswTmp.regInfo.AddrInc == AP_CSW_PADDRINC) {
     addrEnd = addr + (count << 2); // 每次写DRW，发起多次memory access，每次Memory access成功后自增TAR
     while (addrCurr < addrEnd) {
-      addrNextBoundary = ((addrCurr >> 10) + 1) << 10; // 找到下一个1kb边界
-      // 写入TAR
-      ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_LSB, addrCurr & 0xFFFFFFFFu);
-      if (ap->type.memory.config.largeAddress) {
-        ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_MSB, (addrCurr >> 32) & 0xFFFFFFFFu);
-      }
+      addrNextBoundary = apTarBoundary(ap, addrCurr); // 找到下一个TAR自增边界
+      // 按需写入TAR
+      apUpdateTar(ap, &tarTmp, addrCurr);
       // log_debug("PACKED:CurrAddr:0x%08X;next boundary:0x%08X.", addrCurr, addrNextBoundary);
       // 如果下一个边界大于结束地址
       if (addrNextBoundary > addrEnd) {
@@ -713,26 +964,23 @@ static int apBlockRead(AccessPort self, uint64_t addr, enum addrIncreaseMode mod
       // log_debug("PACKED:dataPos:%d;thisTimeTransCnt:%d.", dataPos, thisTimeTransCnt);
       // 读取block
       ap->dap->skillObj->MultiRead(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, thisTimeTransCnt, data_out + dataPos);
+      apAdvanceTar(ap, &tarTmp, (uint64_t)thisTimeTransCnt << 2);
       dataPos += thisTimeTransCnt;
     }
   } else { // 地址不增 XXX 没测试
-    // 写入TAR
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_LSB, addr & 0xFFFFFFFFu);
-    if (ap->type.memory.config.largeAddress) {
-      ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_MSB, (addr >> 32) & 0xFFFFFFFFu);
-    }
-    ap->dap->skillObj->MultiRead(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, count, data_out);
+    // 按需写入TAR，地址不增时TAR保持不变
+    apUpdateTar(ap, &tarTmp, addr);
+    ap->dap->skillObj->MultiRead(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, count << drwShift, data_out);
   }
   // 执行指令队列
   if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
-    // 清理指令队列
-    ap->dap->skillObj->Cancel(ap->dap->skillObj);
     log_error("Execute DAP command failed!");
-    return ADI_ERR_INTERNAL_ERROR;
+    return apBlockRecover(ap, addr, mode, size, count, data, 1);
   }
   // 指令执行成功，同步数据到DAP影子寄存器
-  ap->dap->select.regData = selectTmp.regData;
+  ap->dap->select = selectTmp;
   ap->type.memory.csw.regData = cswTmp.regData;
+  ap->type.memory.tar = tarTmp;
   return ADI_SUCCESS;
 }
 
@@ -746,18 +994,16 @@ static int apBlockWrite(AccessPort self, uint64_t addr, enum addrIncreaseMode mo
   struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
   ADIv5_DpSelectRegister selectTmp;
   ADIv5_ApCswRegister cswTmp;
+  struct ADIv5_TarShadow tarTmp;
   // 检查AP类型
   if (self->type != AccessPort_Memory) {
     log_error("Not a memory access port!");
     return ADI_ERR_BAD_PARAMETER;
   }
   // 初始化本地临时变量
-  selectTmp.regData = ap->dap->select.regData;
+  selectTmp = ap->dap->select;
   cswTmp.regData = ap->type.memory.csw.regData;
-  // 选中当前ap
-  selectTmp.regInfo.AP_Sel = ap->index;
-  // 选中当前ap寄存器 bank
-  selectTmp.regInfo.AP_BankSel = 0x0;
+  tarTmp = ap->type.memory.tar;
   // some checks
   switch (size) {
   case DataSize_8:
@@ -793,6 +1039,22 @@ static int apBlockWrite(AccessPort self, uint64_t addr, enum addrIncreaseMode mo
   case DataSize_64:
   case DataSize_128:
   case DataSize_256:
+    // Large Data Extension:每次总线传输需要连续访问DRW 2/4/8次
+    if (!ap->type.memory.config.largeData || (size == DataSize_128 && !ap->type.memory.config.largeData128) ||
+        (size == DataSize_256 && !ap->type.memory.config.largeData256)) {
+      log_warn("Couldn't support large data transfers.");
+      return ADI_ERR_UNSUPPORT;
+    }
+    if (addr & ((1u << (AP_CSW_SIZE64 + size - DataSize_64)) - 1)) {
+      log_warn("Memory address is not aligned to the data size!");
+      return ADI_ERR_BAD_PARAMETER;
+    }
+    if (mode == AddrInc_Packed) {
+      log_warn("Packed transfers is not support on large data.");
+      return ADI_ERR_UNSUPPORT;
+    }
+    cswTmp.regInfo.Size = AP_CSW_SIZE64 + size - DataSize_64;
+    break;
   default:
     log_warn("Specified data size is not support.");
     return ADI_ERR_UNSUPPORT;
@@ -812,29 +1074,26 @@ static int apBlockWrite(AccessPort self, uint64_t addr, enum addrIncreaseMode mo
     log_warn("Specified address increase mode is not support.");
     return ADI_ERR_UNSUPPORT;
   }
-  // 是否需要更新SELECT寄存器?
-  if (ap->dap->select.regData != selectTmp.regData) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, selectTmp.regData);
-  }
+  // 按需更新SELECT寄存器，选中当前AP的寄存器bank 0
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x0);
   // 是否需要更新CSW寄存器？
   if (ap->type.memory.csw.regData != cswTmp.regData) {
     ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, cswTmp.regData);
   }
 
-  // 处理地址自增模式下超过1kb边界的情况，超过1kb的边界了需要拆分，每次地址自增控制在1kb以内
+  // 处理地址自增模式下超过TAR自增边界的情况，需要拆分，每次地址自增控制在tarIncBits以内
   uint64_t addrCurr = addr, addrEnd;          // 当前地址，结束地址
-  uint64_t addrNextBoundary;                  // 地址的下一个1kb边界
+  uint64_t addrNextBoundary;                  // 地址的下一个TAR自增边界
   unsigned int thisTimeTransCnt, dataPos = 0; // 指向data_out的偏移
+  // 每次总线传输访问DRW的次数(以2为底的对数)，小于等于字时为1次
+  unsigned int drwShift = cswTmp.regInfo.Size > AP_CSW_SIZE32 ? cswTmp.regInfo.Size - AP_CSW_SIZE32 : 0;
 
   if (cswTmp.regInfo.AddrInc == AP_CSW_SADDRINC) {
     addrEnd = addr + (count << cswTmp.regInfo.Size); // 每次写DRW，发起一次memory access，之后自增TAR
     while (addrCurr < addrEnd) {
-      addrNextBoundary = ((addrCurr >> 10) + 1) << 10; // 找到下一个1kb边界
-      // 写入TAR
-      ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_LSB, addrCurr & 0xFFFFFFFFu);
-      if (ap->type.memory.config.largeAddress) {
-        ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_MSB, (addrCurr >> 32) & 0xFFFFFFFFu);
-      }
+      addrNextBoundary = apTarBoundary(ap, addrCurr); // 找到下一个TAR自增边界
+      // 按需写入TAR
+      apUpdateTar(ap, &tarTmp, addrCurr);
       log_debug("SINGLE:CurrAddr:0x%08X;next boundary:0x%08X.", addrCurr, addrNextBoundary);
       // 如果下一个边界大于结束地址
       if (addrNextBoundary > addrEnd) {
@@ -846,18 +1105,16 @@ static int apBlockWrite(AccessPort self, uint64_t addr, enum addrIncreaseMode mo
       }
       // log_debug("SINGLE:dataPos:%d;thisTimeTransCnt:%d.", dataPos, thisTimeTransCnt);
       // 读取block
-      ap->dap->skillObj->MultiWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, thisTimeTransCnt, data_out + dataPos);
-      dataPos += thisTimeTransCnt;
+      ap->dap->skillObj->MultiWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, thisTimeTransCnt << drwShift, data_out + dataPos);
+      apAdvanceTar(ap, &tarTmp, (uint64_t)thisTimeTransCnt << cswTmp.regInfo.Size);
+      dataPos += thisTimeTransCnt << drwShift;
     }
   } else if (cswTmp.regInfo.AddrInc == AP_CSW_PADDRINC) {
     addrEnd = addr + (count << 2); // 每次写DRW，发起多次memory access，每次Memory access成功后自增TAR
     while (addrCurr < addrEnd) {
-      addrNextBoundary = ((addrCurr >> 10) + 1) << 10; // 找到下一个1kb边界
-      // 写入TAR
-      ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_LSB, addrCurr & 0xFFFFFFFFu);
-      if (ap->type.memory.config.largeAddress) {
-        ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_MSB, (addrCurr >> 32) & 0xFFFFFFFFu);
-      }
+      addrNextBoundary = apTarBoundary(ap, addrCurr); // 找到下一个TAR自增边界
+      // 按需写入TAR
+      apUpdateTar(ap, &tarTmp, addrCurr);
       // log_debug("PACKED:CurrAddr:0x%08X;next boundary:0x%08X.", addrCurr, addrNextBoundary);
       // 如果下一个边界大于结束地址
       if (addrNextBoundary > addrEnd) {
@@ -870,170 +1127,778 @@ static int apBlockWrite(AccessPort self, uint64_t addr, enum addrIncreaseMode mo
       // log_debug("PACKED:dataPos:%d;thisTimeTransCnt:%d.", dataPos, thisTimeTransCnt);
       // 读取block
       ap->dap->skillObj->MultiWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, thisTimeTransCnt, data_out + dataPos);
+      apAdvanceTar(ap, &tarTmp, (uint64_t)thisTimeTransCnt << 2);
       dataPos += thisTimeTransCnt;
     }
   } else { // 地址不增 XXX 没有测试过这里的代码
-    // 写入TAR
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_LSB, addr & 0xFFFFFFFFu);
-    if (ap->type.memory.config.largeAddress) {
-      ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_TAR_MSB, (addr >> 32) & 0xFFFFFFFFu);
-    }
-    ap->dap->skillObj->MultiWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, count, data_out);
+    // 按需写入TAR，地址不增时TAR保持不变
+    apUpdateTar(ap, &tarTmp, addr);
+    ap->dap->skillObj->MultiWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, count << drwShift, data_out);
+    addrEnd = addr + (1u << cswTmp.regInfo.Size);
   }
+  apNotifyWrite(ap, addr, addrEnd - addr);
   // 执行指令队列
   if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
-    // 清理指令队列
-    ap->dap->skillObj->Cancel(ap->dap->skillObj);
     log_error("Execute DAP command failed!");
-    return ADI_ERR_INTERNAL_ERROR;
+    return apBlockRecover(ap, addr, mode, size, count, data, 0);
   }
   // 指令执行成功，同步数据到DAP影子寄存器
-  ap->dap->select.regData = selectTmp.regData;
+  ap->dap->select = selectTmp;
   ap->type.memory.csw.regData = cswTmp.regData;
+  ap->type.memory.tar = tarTmp;
   return ADI_SUCCESS;
 }
 
 /**
- * 读CSW
+ * 按需更新CSW的Size和AddrInc,调用前必须已经选中bank 0
  */
-static int apReadCSW(AccessPort self, uint32_t *data) {
-  assert(self != NULL && data != NULL);
-  struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
-  ADIv5_DpSelectRegister selectTmp;
-  selectTmp.regData = ap->dap->select.regData;
-  // 选中当前ap
-  selectTmp.regInfo.AP_Sel = ap->index;
-  // 选中当前ap寄存器 bank
-  selectTmp.regInfo.AP_BankSel = 0x0;
-  // 是否需要更新SELECT寄存器?
-  if (ap->dap->select.regData != selectTmp.regData) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, selectTmp.regData);
-  }
-  // 读CSW
-  ap->dap->skillObj->SingleRead(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, &ap->type.memory.csw.regData);
-  // 执行指令队列
-  if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
-    // 清理指令队列
-    ap->dap->skillObj->Cancel(ap->dap->skillObj);
-    log_error("Execute DAP command failed!");
-    return ADI_ERR_INTERNAL_ERROR;
+static void apUpdateCsw(struct ADIv5_AccessPort *ap, ADIv5_ApCswRegister *csw, uint32_t size, uint32_t addrInc) {
+  ADIv5_ApCswRegister cswTmp;
+  cswTmp.regData = csw->regData;
+  cswTmp.regInfo.Size = size;
+  cswTmp.regInfo.AddrInc = addrInc;
+  if (cswTmp.regData != csw->regData) {
+    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, cswTmp.regData);
+    csw->regData = cswTmp.regData;
   }
-  // 指令执行成功，同步数据到DAP影子寄存器
-  ap->dap->select.regData = selectTmp.regData;
-  *data = ap->type.memory.csw.regData;
-  return ADI_SUCCESS;
 }
 
+/* 紧凑缓冲区传输的处理阶段 */
+enum bufferPass {
+  BufferPass_Count,  // 统计DRW访问次数
+  BufferPass_Queue,  // 插入指令队列,写操作同时打包数据
+  BufferPass_Unpack, // 读操作:从DRW数据中解出紧凑数据
+};
+
 /**
- * 写CSW
+ * 紧凑缓冲区传输
  */
-static int apWriteCSW(AccessPort self, uint32_t data) {
-  assert(self != NULL);
-  struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
-  ADIv5_DpSelectRegister selectTmp;
-  selectTmp.regData = ap->dap->select.regData;
-  // 选中当前ap
-  selectTmp.regInfo.AP_Sel = ap->index;
-  // 选中当前ap寄存器 bank
-  selectTmp.regInfo.AP_BankSel = 0x0;
-  // 是否需要更新SELECT寄存器?
-  if (ap->dap->select.regData != selectTmp.regData) {
-    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, selectTmp.regData);
-  }
-  // 写CSW
-  ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, data);
-  // 执行指令队列
-  if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
-    // 清理指令队列
-    ap->dap->skillObj->Cancel(ap->dap->skillObj);
-    log_error("Execute DAP command failed!");
-    return ADI_ERR_INTERNAL_ERROR;
+struct bufferTransfer {
+  ADIv5_DpSelectRegister select; // SELECT寄存器的值
+  ADIv5_ApCswRegister csw;       // CSW寄存器的值
+  struct ADIv5_TarShadow tar;    // TAR影子寄存器
+  uint64_t addr;                 // 起始地址
+  unsigned int len;              // 字节数
+  unsigned int sizeShift;        // 单次总线访问的最大字节数,以2为底的对数
+  int packed;                    // 小于字的访问是否可以使用packed传输
+  int isRead;                    // 是否为读操作
+  uint8_t *buff;                 // 紧凑缓冲区
+  uint32_t *words;               // 每次DRW访问的数据
+  unsigned int unpackEnd;        // 读操作只解出该偏移之前的数据
+};
+
+/**
+ * 按顺序遍历紧凑缓冲区传输的每一段
+ * 字对齐的主体部分每次DRW访问传输4字节:字宽访问时使用Single自增,
+ * 字节或半字访问时使用packed传输;不能使用这两种方式的部分(头部、尾部等)
+ * 使用自然对齐的最大单次访问,DRW的数据位于地址决定的byte lane
+ * 返回:
+ * 	DRW访问的次数
+ */
+static unsigned int apBufferWalk(struct ADIv5_AccessPort *ap, struct bufferTransfer *xfer, enum bufferPass pass) {
+  uint64_t pos = xfer->addr, end = xfer->addr + xfer->len;
+  unsigned int drwCnt = 0, offset, cnt, width;
+  while (pos < end) {
+    offset = pos - xfer->addr;
+    if ((pos & 0x3) == 0 && end - pos >= 4 && (xfer->sizeShift == AP_CSW_SIZE32 || xfer->packed)) {
+      // 主体部分不能越过TAR自增边界
+      uint64_t boundary = apTarBoundary(ap, pos);
+      cnt = ((boundary < end ? boundary : end) - pos) >> 2;
+      if (pass == BufferPass_Queue) {
+        apUpdateCsw(ap, &xfer->csw, xfer->sizeShift, xfer->sizeShift == AP_CSW_SIZE32 ? AP_CSW_SADDRINC : AP_CSW_PADDRINC);
+        apUpdateTar(ap, &xfer->tar, pos);
+        if (xfer->isRead) {
+          ap->dap->skillObj->MultiRead(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, cnt, xfer->words + drwCnt);
+        } else {
+          memcpy(xfer->words + drwCnt, xfer->buff + offset, cnt << 2);
+          ap->dap->skillObj->MultiWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, cnt, xfer->words + drwCnt);
+        }
+        apAdvanceTar(ap, &xfer->tar, cnt << 2);
+      } else if (pass == BufferPass_Unpack && offset < xfer->unpackEnd) {
+        memcpy(xfer->buff + offset, xfer->words + drwCnt,
+               (cnt << 2) < xfer->unpackEnd - offset ? (cnt << 2) : xfer->unpackEnd - offset);
+      }
+      drwCnt += cnt;
+      pos += cnt << 2;
+    } else {
+      // 自然对齐的最大单次访问
+      width = 1u << xfer->sizeShift;
+      while ((pos & (width - 1)) || pos + width > end) {
+        width >>= 1;
+      }
+      if (pass == BufferPass_Queue) {
+        apUpdateCsw(ap, &xfer->csw, width == 4 ? AP_CSW_SIZE32 : (width == 2 ? AP_CSW_SIZE16 : AP_CSW_SIZE8), AP_CSW_SADDRINC);
+        apUpdateTar(ap, &xfer->tar, pos);
+        if (xfer->isRead) {
+          ap->dap->skillObj->SingleRead(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, xfer->words + drwCnt);
+        } else {
+          xfer->words[drwCnt] = 0;
+          for (unsigned int i = 0; i < width; i++) {
+            xfer->words[drwCnt] |= (uint32_t)xfer->buff[offset + i] << (((pos & 0x3) + i) << 3);
+          }
+          ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, xfer->words[drwCnt]);
+        }
+        apAdvanceTar(ap, &xfer->tar, width);
+      } else if (pass == BufferPass_Unpack) {
+        for (unsigned int i = 0; i < width && offset + i < xfer->unpackEnd; i++) {
+          xfer->buff[offset + i] = (xfer->words[drwCnt] >> (((pos & 0x3) + i) << 3)) & 0xff;
+        }
+      }
+      drwCnt++;
+      pos += width;
+    }
   }
-  // 指令执行成功，同步数据到DAP影子寄存器
-  ap->dap->select.regData = selectTmp.regData;
-  ap->type.memory.csw.regData = data;
-  return ADI_SUCCESS;
+  return drwCnt;
 }
 
 /**
- * 终止本次传输
+ * 紧凑缓冲区传输出错之后恢复DAP,并从第一个出错的位置继续传输
+ * 读操作只解出继续传输位置之前的数据,之后的DRW数据可能没有读到
  */
-static int apAbort(AccessPort self) {
-  assert(self != NULL);
-  struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
-  // 写DP Abort
-  ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_ABORT, 0x1);
-  // 执行指令队列
-  if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
-    // 清理指令队列
-    ap->dap->skillObj->Cancel(ap->dap->skillObj);
-    log_error("Execute DAP command failed!");
+static int apBufferRecover(struct ADIv5_AccessPort *ap, struct bufferTransfer *xfer, enum dataSize size) {
+  struct ADIv5_TarShadow before = ap->type.memory.tar;
+  uint64_t tar, done;
+  int ret;
+
+  if (apRecover(ap, &tar) != ADI_SUCCESS) {
     return ADI_ERR_INTERNAL_ERROR;
   }
-  return ADI_SUCCESS;
+  if (ap->dap->recoverDepth >= ADIV5_RECOVER_RETRY) {
+    log_error("Buffer transfer still failed after %d retries!", ADIV5_RECOVER_RETRY);
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  done = apResumeAddr(ap, &before, tar, xfer->addr, xfer->addr + xfer->len, xfer->isRead) - xfer->addr;
+  log_info("Resume buffer transfer from 0x%llX.", (unsigned long long)(xfer->addr + done));
+  ap->dap->recoverDepth++;
+  if (xfer->isRead) {
+    // 出错之前已经完成的读取指令的数据有效
+    xfer->unpackEnd = done;
+    apBufferWalk(ap, xfer, BufferPass_Unpack);
+    ret = ap->apApi.Interface.Memory.ReadBuffer(&ap->apApi, xfer->addr + done, size, xfer->len - done, xfer->buff + done);
+  } else {
+    ret = ap->apApi.Interface.Memory.WriteBuffer(&ap->apApi, xfer->addr + done, size, xfer->len - done, xfer->buff + done);
+  }
+  ap->dap->recoverDepth--;
+  return ret;
 }
 
 /**
- * fillApConfig 填充AP的配置信息:CSW,CFG
- * 此函数默认AP_BankSel=0xF
+ * 读写紧凑缓冲区
  */
-static int fillApConfig(struct ADIv5_Dap *dapObj, struct ADIv5_AccessPort *ap) {
-  assert(dapObj != NULL);
-  assert(ap != NULL);
-  if (ap->apApi.type == AccessPort_Memory) {
-    uint32_t temp = 0, temp_2 = 0;
-    // 读CFG寄存器,并初始化相关标志位
-    dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_CFG, &temp);
-    // 读ROM_LSB寄存器
-    dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_ROM_LSB, &temp_2);
-    if (dapObj->skillObj->Commit(dapObj->skillObj) != ADPT_SUCCESS) {
-      // 清理指令队列
-      ap->dap->skillObj->Cancel(ap->dap->skillObj);
-      log_error("Read AP register failed!");
-      return ADI_ERR_INTERNAL_ERROR;
+static int apBufferAccess(AccessPort self, uint64_t addr, enum dataSize size, unsigned int len, uint8_t *buff, int isRead) {
+  assert(self != NULL && buff != NULL);
+  struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
+  struct bufferTransfer xfer;
+  unsigned int drwCnt;
+  // 检查AP类型
+  if (self->type != AccessPort_Memory) {
+    log_error("Not a memory access port!");
+    return ADI_ERR_BAD_PARAMETER;
+  }
+  if (len == 0) {
+    return ADI_SUCCESS;
+  }
+  switch (size) {
+  case DataSize_8:
+    xfer.sizeShift = AP_CSW_SIZE8;
+    break;
+  case DataSize_16:
+    // 半字访问不能拆成字节访问
+    if ((addr | len) & 0x1) {
+      log_warn("Memory address or length is not half word aligned!");
+      return ADI_ERR_BAD_PARAMETER;
     }
-    ap->type.memory.config.largeAddress = !!(temp & AP_CFG_LARGE_ADDRESS);
-    ap->type.memory.config.largeData = !!(temp & AP_CFG_LARGE_DATA);
-    ap->type.memory.config.bigEndian = !!(temp & AP_CFG_BIG_ENDIAN);
-    // 读ROM_MSB寄存器
-    if (ap->type.memory.config.largeAddress) {
-      dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_ROM_MSB, &temp);
-      if (dapObj->skillObj->Commit(dapObj->skillObj) != ADPT_SUCCESS) {
-        // 清理指令队列
-        ap->dap->skillObj->Cancel(ap->dap->skillObj);
-        log_error("Read AP register failed!");
-        return ADI_ERR_INTERNAL_ERROR;
-      }
-      ap->type.memory.rom = ((uint64_t)temp << 32) | temp_2;
+    xfer.sizeShift = AP_CSW_SIZE16;
+    break;
+  case DataSize_32:
+    xfer.sizeShift = AP_CSW_SIZE32;
+    break;
+  default:
+    log_warn("Specified data size is not support.");
+    return ADI_ERR_UNSUPPORT;
+  }
+  // 小于字的访问
+  if ((xfer.sizeShift != AP_CSW_SIZE32 || ((addr | len) & 0x3)) && !ap->type.memory.config.lessWordTransfers) {
+    log_warn("Couldn't support less word transfers.");
+    return ADI_ERR_UNSUPPORT;
+  }
+  xfer.select = ap->dap->select;
+  xfer.csw.regData = ap->type.memory.csw.regData;
+  xfer.tar = ap->type.memory.tar;
+  xfer.addr = addr;
+  xfer.len = len;
+  xfer.packed = ap->type.memory.config.packedTransfers;
+  xfer.isRead = isRead;
+  xfer.buff = buff;
+  xfer.words = NULL;
+  xfer.unpackEnd = len;
+
+  drwCnt = apBufferWalk(ap, &xfer, BufferPass_Count);
+  xfer.words = malloc(drwCnt * sizeof(uint32_t));
+  if (xfer.words == NULL) {
+    log_error("Failed to alloc DRW buffer!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  // 选中当前ap寄存器 bank 0
+  ADIv5_ApSelectBank(ap, &xfer.select, 0x0);
+  apBufferWalk(ap, &xfer, BufferPass_Queue);
+  if (!isRead) {
+    apNotifyWrite(ap, addr, len);
+  }
+  // 执行指令队列
+  if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
+    int ret;
+    log_error("Execute DAP command failed!");
+    ret = apBufferRecover(ap, &xfer, size);
+    free(xfer.words);
+    return ret;
+  }
+  if (isRead) {
+    apBufferWalk(ap, &xfer, BufferPass_Unpack);
+  }
+  free(xfer.words);
+  // 指令执行成功，同步数据到DAP影子寄存器
+  ap->dap->select = xfer.select;
+  ap->type.memory.csw.regData = xfer.csw.regData;
+  ap->type.memory.tar = xfer.tar;
+  return ADI_SUCCESS;
+}
+
+/**
+ * 读取连续内存到紧凑缓冲区
+ */
+static int apReadBuffer(AccessPort self, uint64_t addr, enum dataSize size, unsigned int len, uint8_t *buff) {
+  return apBufferAccess(self, addr, size, len, buff, 1);
+}
+
+/**
+ * 将紧凑缓冲区写入连续内存
+ */
+static int apWriteBuffer(AccessPort self, uint64_t addr, enum dataSize size, unsigned int len, uint8_t *buff) {
+  return apBufferAccess(self, addr, size, len, buff, 0);
+}
+
+/**
+ * 读CSW
+ */
+static int apReadCSW(AccessPort self, uint32_t *data) {
+  assert(self != NULL && data != NULL);
+  struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
+  ADIv5_DpSelectRegister selectTmp;
+  selectTmp = ap->dap->select;
+  // 按需更新SELECT寄存器，选中当前AP的寄存器bank 0
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x0);
+  // 读CSW
+  ap->dap->skillObj->SingleRead(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, &ap->type.memory.csw.regData);
+  // 执行指令队列
+  if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
+    // 清理指令队列
+    ap->dap->skillObj->Cancel(ap->dap->skillObj);
+    log_error("Execute DAP command failed!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  // 指令执行成功，同步数据到DAP影子寄存器
+  ap->dap->select = selectTmp;
+  *data = ap->type.memory.csw.regData;
+  return ADI_SUCCESS;
+}
+
+/**
+ * 写CSW
+ */
+static int apWriteCSW(AccessPort self, uint32_t data) {
+  assert(self != NULL);
+  struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
+  ADIv5_DpSelectRegister selectTmp;
+  selectTmp = ap->dap->select;
+  // 按需更新SELECT寄存器，选中当前AP的寄存器bank 0
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x0);
+  // 写CSW
+  ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, data);
+  // 执行指令队列
+  if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
+    // 清理指令队列
+    ap->dap->skillObj->Cancel(ap->dap->skillObj);
+    log_error("Execute DAP command failed!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  // 指令执行成功，同步数据到DAP影子寄存器
+  ap->dap->select = selectTmp;
+  ap->type.memory.csw.regData = data;
+  return ADI_SUCCESS;
+}
+
+/**
+ * 终止本次传输
+ */
+static int apAbort(AccessPort self) {
+  assert(self != NULL);
+  struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
+  // 被终止的传输是否已经使TAR自增无法确定
+  ap->type.memory.tar.valid = 0;
+  // 写DP Abort
+  ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_ABORT, 0x1);
+  // 执行指令队列
+  if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
+    // 清理指令队列
+    ap->dap->skillObj->Cancel(ap->dap->skillObj);
+    log_error("Execute DAP command failed!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  return ADI_SUCCESS;
+}
+
+/**
+ * 判断通过BD寄存器访问addr是否比通过DRW访问代价更小
+ * TAR已经指向addr所在的16字节窗口,并且TAR不等于addr(DRW访问需要重写TAR)
+ * 或者已经选中BD所在的bank 1(DRW访问需要重写SELECT)
+ */
+static int apBankedHit(struct ADIv5_AccessPort *ap, ADIv5_DpSelectRegister *select, struct ADIv5_TarShadow *tar, uint64_t addr) {
+  if (!tar->valid || (tar->value & ~0xFull) != (addr & ~0xFull)) {
+    return 0;
+  }
+  if (tar->value != addr) {
+    return 1;
+  }
+  ADIv5_DpSelectRegister bank1 = apSelectValue(ap, select, 0x1);
+  return select->regData == bank1.regData && select->select1 == bank1.select1;
+}
+
+/**
+ * 插入通过BD0-BD3访问16字节窗口的指令
+ * CSW(Size=Word)和TAR(窗口基址)位于bank 0,只在需要时写入;BD0-BD3位于bank 1。
+ * BDn访问的地址是TAR[31:4]+4n,访问之后TAR不自增
+ * 参数:
+ * 	addr:起始地址,字对齐
+ * 	count:访问的字数,不能越过16字节窗口
+ */
+static void apQueueBanked(struct ADIv5_AccessPort *ap, ADIv5_DpSelectRegister *select, ADIv5_ApCswRegister *csw,
+                          struct ADIv5_TarShadow *tar, uint64_t addr, unsigned int count, uint32_t *data, int isRead) {
+  ADIv5_ApCswRegister cswTmp;
+  uint64_t windowBase = addr & ~0xFull;
+  cswTmp.regData = csw->regData;
+  cswTmp.regInfo.Size = AP_CSW_SIZE32; // BD访问的数据大小由CSW决定
+  if (cswTmp.regData != csw->regData || !tar->valid || (tar->value & ~0xFull) != windowBase) {
+    ADIv5_ApSelectBank(ap, select, 0x0);
+    if (cswTmp.regData != csw->regData) {
+      ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, cswTmp.regData);
+      csw->regData = cswTmp.regData;
+    }
+    if (!tar->valid || (tar->value & ~0xFull) != windowBase) {
+      apUpdateTar(ap, tar, windowBase);
+    }
+  }
+  ADIv5_ApSelectBank(ap, select, 0x1);
+  for (unsigned int i = 0, bd = (addr >> 2) & 0x3; i < count; i++, bd++) {
+    if (isRead) {
+      ap->dap->skillObj->SingleRead(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_BD0 + (bd << 2), data + i);
     } else {
-      ap->type.memory.rom = temp_2;
+      ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_BD0 + (bd << 2), data[i]);
     }
+  }
+}
 
+/**
+ * 通过BD寄存器读写16字节窗口
+ */
+static int apWindowAccess(AccessPort self, uint64_t addr, unsigned int count, uint32_t *data, int isRead) {
+  assert(self != NULL && data != NULL);
+  ADIv5_DpSelectRegister selectTmp;
+  ADIv5_ApCswRegister cswTmp;
+  struct ADIv5_TarShadow tarTmp;
+  struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
+  // 检查AP类型
+  if (self->type != AccessPort_Memory) {
+    log_error("Not a memory access port!");
+    return ADI_ERR_BAD_PARAMETER;
+  }
+  // 检查对齐
+  if (addr & 0x3) {
+    log_warn("Memory address is not word aligned!");
+    return ADI_ERR_BAD_PARAMETER;
+  }
+  // 检查窗口边界
+  if (count == 0 || ((addr & 0xF) >> 2) + count > 4) {
+    log_warn("Banked data access out of the 16 bytes window!");
+    return ADI_ERR_BAD_PARAMETER;
+  }
+  // 初始化本地临时变量
+  selectTmp = ap->dap->select;
+  cswTmp.regData = ap->type.memory.csw.regData;
+  tarTmp = ap->type.memory.tar;
+  apQueueBanked(ap, &selectTmp, &cswTmp, &tarTmp, addr, count, data, isRead);
+  if (!isRead) {
+    apNotifyWrite(ap, addr, count << 2);
+  }
+  // 执行指令队列
+  if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
+    // 清除粘滞错误标志，同步影子寄存器
+    apRecover(ap, NULL);
+    log_error("Execute DAP command failed!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  // 指令执行成功，同步数据到DAP影子寄存器
+  ap->dap->select = selectTmp;
+  ap->type.memory.csw.regData = cswTmp.regData;
+  ap->type.memory.tar = tarTmp;
+  return ADI_SUCCESS;
+}
+
+/**
+ * 通过BD寄存器读16字节窗口
+ */
+static int apWindowRead(AccessPort self, uint64_t addr, unsigned int count, uint32_t *data) {
+  return apWindowAccess(self, addr, count, data, 1);
+}
+
+/**
+ * 通过BD寄存器写16字节窗口
+ */
+static int apWindowWrite(AccessPort self, uint64_t addr, unsigned int count, uint32_t *data) {
+  return apWindowAccess(self, addr, count, data, 0);
+}
+
+/**
+ * 开始事务
+ * 以当前影子寄存器的值作为事务中SELECT和CSW的初值
+ */
+static int apTransBegin(AccessPort self) {
+  assert(self != NULL);
+  struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
+  // 检查AP类型
+  if (self->type != AccessPort_Memory) {
+    log_error("Not a memory access port!");
+    return ADI_ERR_BAD_PARAMETER;
+  }
+  if (ap->type.memory.trans.active) {
+    log_warn("Transaction already began!");
+    return ADI_ERR_BAD_PARAMETER;
+  }
+  ap->type.memory.trans.select = ap->dap->select;
+  ap->type.memory.trans.csw.regData = ap->type.memory.csw.regData;
+  ap->type.memory.trans.tar = ap->type.memory.tar;
+  ap->type.memory.trans.active = 1;
+  return ADI_SUCCESS;
+}
+
+/**
+ * 在事务中访问一个字
+ * 当TAR已经指向同一个16字节窗口时，通过BD寄存器访问可以省略TAR的写入，
+ * 否则按需写SELECT、CSW、TAR之后通过DRW访问。
+ * SELECT、CSW和事务中上一次写入的值相同时不再重复写入
+ */
+static int apTransAccessWord(struct ADIv5_AccessPort *ap, uint64_t addr, uint32_t *data, int isRead) {
+  ADIv5_ApCswRegister cswTmp;
+  int ret;
+  if (!ap->type.memory.trans.active) {
+    log_warn("Transaction not began!");
+    return ADI_ERR_BAD_PARAMETER;
+  }
+  // 检查对齐
+  if (addr & 0x3) {
+    log_warn("Memory address is not word aligned!");
+    return ADI_ERR_BAD_PARAMETER;
+  }
+  if (!isRead) {
+    apNotifyWrite(ap, addr, 4);
+  }
+  if (apBankedHit(ap, &ap->type.memory.trans.select, &ap->type.memory.trans.tar, addr)) {
+    apQueueBanked(ap, &ap->type.memory.trans.select, &ap->type.memory.trans.csw, &ap->type.memory.trans.tar,
+                  addr, 1, data, isRead);
+    return ADI_SUCCESS;
+  }
+  cswTmp.regData = ap->type.memory.trans.csw.regData;
+  // 设置CSW：Size=Word，AddrInc=Single
+  cswTmp.regInfo.AddrInc = AP_CSW_SADDRINC;
+  cswTmp.regInfo.Size = AP_CSW_SIZE32;
+  ADIv5_ApSelectBank(ap, &ap->type.memory.trans.select, 0x0);
+  if (ap->type.memory.trans.csw.regData != cswTmp.regData) {
+    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, cswTmp.regData);
+    ap->type.memory.trans.csw.regData = cswTmp.regData;
+  }
+  // 按需写入TAR，本次访问之后TAR自增4字节
+  apUpdateTar(ap, &ap->type.memory.trans.tar, addr);
+  apAdvanceTar(ap, &ap->type.memory.trans.tar, 4);
+  // 读写DRW寄存器，读取的数据在Commit之后才写入data
+  if (isRead) {
+    ret = ap->dap->skillObj->SingleRead(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, data);
+  } else {
+    ret = ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, *data);
+  }
+  if (ret != ADPT_SUCCESS) {
+    log_error("Insert to instruction queue failed!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  return ADI_SUCCESS;
+}
+
+/**
+ * 事务中读32位数据
+ */
+static int apTransRead32(AccessPort self, uint64_t addr, uint32_t *data) {
+  assert(self != NULL && data != NULL);
+  struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
+  return apTransAccessWord(ap, addr, data, 1);
+}
+
+/**
+ * 事务中写32位数据
+ */
+static int apTransWrite32(AccessPort self, uint64_t addr, uint32_t data) {
+  assert(self != NULL);
+  struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
+  return apTransAccessWord(ap, addr, &data, 0);
+}
+
+/**
+ * 提交事务
+ */
+static int apTransCommit(AccessPort self) {
+  assert(self != NULL);
+  struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
+  if (!ap->type.memory.trans.active) {
+    log_warn("Transaction not began!");
+    return ADI_ERR_BAD_PARAMETER;
+  }
+  ap->type.memory.trans.active = 0;
+  // 执行指令队列
+  if (ap->dap->skillObj->Commit(ap->dap->skillObj) != ADPT_SUCCESS) {
+    // 清除粘滞错误标志，同步影子寄存器
+    apRecover(ap, NULL);
+    log_error("Execute DAP command failed!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  // 指令执行成功，同步数据到DAP影子寄存器
+  ap->dap->select = ap->type.memory.trans.select;
+  ap->type.memory.csw.regData = ap->type.memory.trans.csw.regData;
+  ap->type.memory.tar = ap->type.memory.trans.tar;
+  return ADI_SUCCESS;
+}
+
+/**
+ * 放弃事务
+ */
+static int apTransCancel(AccessPort self) {
+  assert(self != NULL);
+  struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
+  if (!ap->type.memory.trans.active) {
+    return ADI_SUCCESS;
+  }
+  ap->type.memory.trans.active = 0;
+  ap->dap->skillObj->Cancel(ap->dap->skillObj);
+  return ADI_SUCCESS;
+}
+
+// pushed-compare每轮比较的次数
+#define AP_POLL_PUSHED_BATCH 16
+
+/**
+ * 获得单调时钟的毫秒数，用于轮询超时
+ */
+static uint64_t apPollTimeMs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * 将32位掩码转换为DP CTRL/STAT的MASKLANE
+ * pushed-compare只能按字节通道屏蔽，每个字节必须全为0或者全为1
+ * 返回:
+ * 	MASKLANE的值，掩码无法用字节通道表示时返回-1
+ */
+static int apPollMaskLane(uint32_t mask) {
+  int lane = 0;
+  for (int i = 0; i < 4; i++) {
+    uint8_t byte = (mask >> (i << 3)) & 0xFF;
+    if (byte == 0xFF) {
+      lane |= 1 << i;
+    } else if (byte != 0x00) {
+      return -1;
+    }
+  }
+  return lane;
+}
+
+/**
+ * 执行一轮轮询
+ * 仿真器支持值匹配读时，比较在仿真器中完成，重试次数由仿真器决定；
+ * 否则掩码可以用字节通道表示时使用DP的pushed-compare，一轮比较AP_POLL_PUSHED_BATCH次；
+ * 都不满足时读取一次再比较
+ * 返回:
+ * 	ADI_SUCCESS:匹配
+ * 	ADI_FAILED:本轮没有匹配
+ * 	其他:出错
+ */
+static int apPollRound(struct ADIv5_AccessPort *ap, uint64_t addr, uint32_t mask, uint32_t value) {
+  ADIv5_DpSelectRegister selectTmp;
+  ADIv5_ApCswRegister cswTmp;
+  struct ADIv5_TarShadow tarTmp;
+  uint32_t ctrlStat = 0, ctrlNormal, data;
+  int maskLane = apPollMaskLane(mask), ret;
+
+  if (ap->dap->skillObj->MatchRead == NULL && maskLane < 0) {
+    ret = apRead32(&ap->apApi, addr, &data);
+    if (ret != ADI_SUCCESS) {
+      return ret;
+    }
+    return (data & mask) == (value & mask) ? ADI_SUCCESS : ADI_FAILED;
+  }
+  // 初始化本地临时变量
+  selectTmp = ap->dap->select;
+  cswTmp.regData = ap->type.memory.csw.regData;
+  tarTmp = ap->type.memory.tar;
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x0);
+  // 设置CSW：Size=Word，AddrInc=Off，重复访问DRW时TAR保持不变
+  cswTmp.regInfo.AddrInc = AP_CSW_NADDRINC;
+  cswTmp.regInfo.Size = AP_CSW_SIZE32;
+  if (ap->type.memory.csw.regData != cswTmp.regData) {
+    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, cswTmp.regData);
+  }
+  apUpdateTar(ap, &tarTmp, addr);
+  if (ap->dap->skillObj->MatchRead != NULL) {
+    ap->dap->skillObj->MatchRead(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, mask, value);
+  } else {
+    uint32_t compare[AP_POLL_PUSHED_BATCH];
+    for (int i = 0; i < AP_POLL_PUSHED_BATCH; i++) {
+      compare[i] = value;
+    }
+    // 以CTRL/STAT影子寄存器为基础，只修改传输模式和MASKLANE，不改变ORUNDETECT等其他控制位；
+    // 去掉状态位，避免JTAG-DP上写1清除了STICKYCMP以外的粘滞标志
+    ctrlNormal = ap->dap->ctrlStat.regData & ~(DP_CTRL_TRNMODEMSK | DP_CTRL_MASKLANEMSK | DP_STAT_MASK);
+    // 清除STICKYCMP：SW-DP通过ABORT，JTAG-DP由下面写CTRL/STAT时写1清除
+    if (!dapIsJtag(ap->dap)) {
+      ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_ABORT, DP_ABORT_STKCMPCLR);
+    }
+    // 进入pushed-compare模式，写DRW会读取TAR处的数据并和写入的值比较，匹配时置位STICKYCMP
+    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_CTRL_STAT,
+                                   ctrlNormal | DP_STAT_STICKYCMP | DP_CTRL_TRNCOMPARE |
+                                       ((uint32_t)maskLane << 8));
+    ap->dap->skillObj->MultiWrite(ap->dap->skillObj, SKILL_DAP_AP_REG, AP_REG_DRW, AP_POLL_PUSHED_BATCH, compare);
+    // 恢复正常传输模式并读取比较结果
+    ap->dap->skillObj->SingleWrite(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_CTRL_STAT, ctrlNormal);
+    ap->dap->skillObj->SingleRead(ap->dap->skillObj, SKILL_DAP_DP_REG, DP_REG_CTRL_STAT, &ctrlStat);
+  }
+  // 执行指令队列
+  ret = ap->dap->skillObj->Commit(ap->dap->skillObj);
+  if (ret != ADPT_SUCCESS && ret != ADPT_ERR_MISMATCH) {
+    // 清除粘滞错误标志，同步影子寄存器
+    apRecover(ap, NULL);
+    log_error("Execute DAP command failed!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  // 不匹配时值匹配读取之前的指令都已执行，清理剩下的值匹配读取
+  if (ret == ADPT_ERR_MISMATCH) {
+    ap->dap->skillObj->Cancel(ap->dap->skillObj);
+  }
+  // 同步数据到DAP影子寄存器
+  ap->dap->select = selectTmp;
+  ap->type.memory.csw.regData = cswTmp.regData;
+  ap->type.memory.tar = tarTmp;
+  if (ap->dap->skillObj->MatchRead != NULL) {
+    return ret == ADPT_SUCCESS ? ADI_SUCCESS : ADI_FAILED;
+  }
+  return (ctrlStat & DP_STAT_STICKYCMP) ? ADI_SUCCESS : ADI_FAILED;
+}
+
+/**
+ * 轮询内存直到(值 & mask) == (value & mask)或者超时
+ */
+static int apPoll32(AccessPort self, uint64_t addr, uint32_t mask, uint32_t value, unsigned int timeout) {
+  assert(self != NULL);
+  struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
+  uint64_t start;
+  int ret;
+  // 检查AP类型
+  if (self->type != AccessPort_Memory) {
+    log_error("Not a memory access port!");
+    return ADI_ERR_BAD_PARAMETER;
+  }
+  // 检查对齐
+  if (addr & 0x3) {
+    log_warn("Memory address is not word aligned!");
+    return ADI_ERR_BAD_PARAMETER;
+  }
+  start = apPollTimeMs();
+  do {
+    ret = apPollRound(ap, addr, mask, value);
+    if (ret != ADI_FAILED) {
+      return ret;
+    }
+  } while (apPollTimeMs() - start < timeout);
+  return ADI_ERR_TIMEOUT;
+}
+
+/**
+ * 根据AP的拓扑信息设置MEM-AP的配置
+ */
+static void apApplyInfo(struct ADIv5_AccessPort *ap, const struct ADIv5_ApInfo *info) {
+  ap->type.memory.config.largeAddress = !!(info->cfg & AP_CFG_LARGE_ADDRESS);
+  ap->type.memory.config.largeData = !!(info->cfg & AP_CFG_LARGE_DATA);
+  ap->type.memory.config.bigEndian = !!(info->cfg & AP_CFG_BIG_ENDIAN);
+  ap->type.memory.config.packedTransfers = info->packedTransfers;
+  ap->type.memory.config.lessWordTransfers = info->lessWordTransfers;
+  ap->type.memory.config.largeData128 = info->largeData128;
+  ap->type.memory.config.largeData256 = info->largeData256;
+  ap->type.memory.rom = ap->type.memory.config.largeAddress ? info->rom : (info->rom & 0xFFFFFFFFu);
+}
+
+/**
+ * fillApConfig 填充AP的配置信息:CSW,CFG,JTAG-AP只读取CSW和PORTSEL
+ * 第一次执行读取CFG、ROM和CSW，第二次执行探测CSW支持的Size和AddrInc并恢复CSW，
+ * 探测的结果记录到AP的拓扑信息中
+ * 此函数默认已经选中AP的bank 0xF
+ */
+static int fillApConfig(struct ADIv5_Dap *dapObj, struct ADIv5_AccessPort *ap) {
+  assert(dapObj != NULL);
+  assert(ap != NULL);
+  uint32_t portSel = 0;
+  if (ap->apApi.type == AccessPort_Memory) {
+    struct ADIv5_ApInfo *info = &dapObj->topology.ap[ap->index];
+    uint32_t romLsb = 0, romMsb = 0, cswOrig, cswPacked = 0, csw128 = 0, csw256 = 0;
+    ADIv5_ApCswRegister cswTmp;
+    // 读CFG、ROM_LSB、ROM_MSB寄存器，不支持Large Address时ROM_MSB为保留寄存器，读取为0
+    dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_CFG, &info->cfg);
+    dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_ROM_LSB, &romLsb);
+    dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_ROM_MSB, &romMsb);
     // 读CSW寄存器
-    dapObj->select.regInfo.AP_BankSel = 0x0;
-    dapObj->skillObj->SingleWrite(dapObj->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, dapObj->select.regData);
+    ADIv5_ApSelectBank(ap, &dapObj->select, 0x0);
     dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, &ap->type.memory.csw.regData);
     if (dapObj->skillObj->Commit(dapObj->skillObj) != ADPT_SUCCESS) {
       // 清理指令队列
-      ap->dap->skillObj->Cancel(ap->dap->skillObj);
-      log_error("Read/Write AP register failed!");
+      dapObj->skillObj->Cancel(dapObj->skillObj);
+      log_error("Read AP register failed!");
       return ADI_ERR_INTERNAL_ERROR;
     }
+    info->rom = ((uint64_t)romMsb << 32) | romLsb;
     // 判断DeviceEn位
     if ((ap->type.memory.csw.regData & AP_CSW_DEVENABLE) == 0) {
       log_warn("This AP is not enabled.");
       return ADI_FAILED;
     }
 
-    temp = ap->type.memory.csw.regData; // 备份CSW寄存器的初始值
+    cswOrig = ap->type.memory.csw.regData; // 备份CSW寄存器的初始值
     // 测试Packed和Less word transfer
-    ap->type.memory.csw.regInfo.AddrInc = AP_CSW_PADDRINC;
-    ap->type.memory.csw.regInfo.Size = AP_CSW_SIZE8;
-    dapObj->skillObj->SingleWrite(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, ap->type.memory.csw.regData); // 写
-    dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, &ap->type.memory.csw.regData); // 读
+    cswTmp.regData = cswOrig;
+    cswTmp.regInfo.AddrInc = AP_CSW_PADDRINC;
+    cswTmp.regInfo.Size = AP_CSW_SIZE8;
+    dapObj->skillObj->SingleWrite(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, cswTmp.regData); // 写
+    dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, &cswPacked);     // 读
+    // 支持Large Data时，测试是否支持128位和256位传输，不支持的Size写入后读回的值不同
+    if (info->cfg & AP_CFG_LARGE_DATA) {
+      cswTmp.regData = cswOrig;
+      cswTmp.regInfo.Size = AP_CSW_SIZE128;
+      dapObj->skillObj->SingleWrite(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, cswTmp.regData);
+      dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, &csw128);
+      cswTmp.regInfo.Size = AP_CSW_SIZE256;
+      dapObj->skillObj->SingleWrite(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, cswTmp.regData);
+      dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, &csw256);
+    }
+    // 恢复CSW记录的数据
+    dapObj->skillObj->SingleWrite(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, cswOrig);
     if (dapObj->skillObj->Commit(dapObj->skillObj) != ADPT_SUCCESS) {
       // 清理指令队列
-      ap->dap->skillObj->Cancel(ap->dap->skillObj);
+      dapObj->skillObj->Cancel(dapObj->skillObj);
       log_error("Read/Write AP register failed!");
       return ADI_ERR_INTERNAL_ERROR;
     }
@@ -1046,26 +1911,124 @@ static int fillApConfig(struct ADIv5_Dap *dapObj, struct ADIv5_AccessPort *ap) {
      * If the MEM-AP Large Data Extention is not supported, then when a MEM-AP implementation
      * supports different sized access, it MUST support word, halfword and byte accesses.
      */
-    if (ap->type.memory.csw.regInfo.AddrInc == AP_CSW_PADDRINC) {
-      ap->type.memory.config.packedTransfers = 1;
-      ap->type.memory.config.lessWordTransfers = 1;
+    cswTmp.regData = cswPacked;
+    if (cswTmp.regInfo.AddrInc == AP_CSW_PADDRINC) {
+      info->packedTransfers = 1;
+      info->lessWordTransfers = 1;
     } else {
-      ap->type.memory.config.lessWordTransfers = ap->type.memory.csw.regInfo.Size == AP_CSW_SIZE8 ? 1 : 0;
+      info->packedTransfers = 0;
+      info->lessWordTransfers = cswTmp.regInfo.Size == AP_CSW_SIZE8 ? 1 : 0;
     }
-
-    ap->type.memory.csw.regData = temp;                                                                         // 恢复CSW记录的数据
-    dapObj->skillObj->SingleWrite(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, ap->type.memory.csw.regData); // 写
+    info->largeData128 = (info->cfg & AP_CFG_LARGE_DATA) && (csw128 & AP_CSW_SIZEMSK) == AP_CSW_SIZE128;
+    info->largeData256 = (info->cfg & AP_CFG_LARGE_DATA) && (csw256 & AP_CSW_SIZEMSK) == AP_CSW_SIZE256;
+    info->probed = 1;
+    apApplyInfo(ap, info);
+    ap->type.memory.csw.regData = cswOrig;
+    return ADI_SUCCESS;
+  } else {
+    // JTAG-AP:读取CSW和PORTSEL的当前值
+    ADIv5_ApSelectBank(ap, &dapObj->select, 0x0);
+    dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, JTAG_AP_REG_CSW, &ap->type.jtag.csw);
+    dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, JTAG_AP_REG_PORTSEL, &portSel);
     if (dapObj->skillObj->Commit(dapObj->skillObj) != ADPT_SUCCESS) {
       // 清理指令队列
-      ap->dap->skillObj->Cancel(ap->dap->skillObj);
-      log_error("Read/Write AP register failed!");
+      dapObj->skillObj->Cancel(dapObj->skillObj);
+      log_error("Read JTAG-AP register failed!");
       return ADI_ERR_INTERNAL_ERROR;
     }
+    ap->type.jtag.portSel = portSel & 0xFF;
     return ADI_SUCCESS;
-  } else {
-    // TODO 增加JTAG相关的初始化
+  }
+}
+
+/**
+ * 使用拓扑缓存中的配置初始化MEM-AP
+ * 在一次执行中校验AP的IDR、CFG和ROM基址并读取CSW的当前值。
+ * DPv1没有TARGETID，DP相同的不同芯片对应同一条缓存记录，因此ROM基址也要校验
+ * 返回:
+ * 	ADI_SUCCESS:成功
+ * 	ADI_FAILED:与缓存的不同，缓存的拓扑已经过期
+ * 	ADI_ERR_UNSUPPORT:AP没有使能
+ */
+static int apWarmAttach(struct ADIv5_Dap *dapObj, struct ADIv5_AccessPort *ap) {
+  const struct ADIv5_ApInfo *info = &dapObj->topology.ap[ap->index];
+  uint32_t idr = 0, cfg = 0, romLsb = 0, romMsb = 0;
+  uint64_t rom;
+  ADIv5_ApSelectBank(ap, &dapObj->select, 0xF); // IDR寄存器的Bank
+  dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_IDR, &idr);
+  dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_CFG, &cfg);
+  dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_ROM_LSB, &romLsb);
+  dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_ROM_MSB, &romMsb);
+  ADIv5_ApSelectBank(ap, &dapObj->select, 0x0);
+  dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_CSW, &ap->type.memory.csw.regData);
+  if (dapObj->skillObj->Commit(dapObj->skillObj) != ADPT_SUCCESS) {
+    // 清理指令队列
+    dapObj->skillObj->Cancel(dapObj->skillObj);
+    log_error("Read AP register failed!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  rom = ((uint64_t)romMsb << 32) | romLsb;
+  if (idr != info->idr || cfg != info->cfg || rom != info->rom) {
+    log_warn("AP[%d] IDR 0x%08X CFG 0x%08X ROM 0x%" PRIX64 " mismatch the topology cache.", ap->index, idr, cfg, rom);
+    return ADI_FAILED;
+  }
+  if ((ap->type.memory.csw.regData & AP_CSW_DEVENABLE) == 0) {
+    log_warn("This AP is not enabled.");
     return ADI_ERR_UNSUPPORT;
   }
+  apApplyInfo(ap, info);
+  return ADI_SUCCESS;
+}
+
+/**
+ * 搜索所有AP
+ * 所有AP的SELECT写入和IDR读取在一次执行中完成，第一个IDR为0的AP之后的AP视为不存在
+ */
+static int apScan(struct ADIv5_Dap *dapObj) {
+  uint32_t *idr = calloc(ADIV5_MAX_AP, sizeof(uint32_t));
+  unsigned int index;
+  if (idr == NULL) {
+    log_error("Failed to alloc AP IDR buffer!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  dapObj->select.regInfo.AP_BankSel = 0xF; // IDR寄存器的Bank
+  for (index = 0; index < ADIV5_MAX_AP; index++) {
+    // 写SELECT
+    dapObj->select.regInfo.AP_Sel = index;
+    dapObj->skillObj->SingleWrite(dapObj->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, dapObj->select.regData);
+    // 读 APIDR
+    dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_IDR, &idr[index]);
+  }
+  if (dapObj->skillObj->Commit(dapObj->skillObj) != ADPT_SUCCESS) {
+    // 清理指令队列
+    dapObj->skillObj->Cancel(dapObj->skillObj);
+    log_error("Read AP IDR register failed!");
+    free(idr);
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  memset(dapObj->topology.ap, 0, sizeof(dapObj->topology.ap));
+  for (index = 0; index < ADIV5_MAX_AP && idr[index] != 0; index++) {
+    dapObj->topology.ap[index].idr = idr[index];
+    log_debug("AP[%d] IDR: 0x%08X.", index, idr[index]);
+  }
+  free(idr);
+  dapObj->topology.count = index;
+  dapObj->topology.scanned = 1;
+  return ADI_SUCCESS;
+}
+
+/**
+ * 丢弃当前的拓扑信息，重新搜索AP并保存到缓存文件
+ * ADIv6从根组件遍历ROM Table
+ */
+static int dapTopologyScan(struct ADIv5_Dap *dapObj) {
+  int ret = DAP_IS_ADIV6(dapObj) ? ADIv6_ApScan(dapObj) : apScan(dapObj);
+  if (ret != ADI_SUCCESS) {
+    return ret;
+  }
+  dapObj->topology.loaded = 0;
+  ADIv5_TopologySave(dapObj);
+  return ADI_SUCCESS;
 }
 
 /**
@@ -1092,6 +2055,7 @@ static int findAP(DAP self, enum AccessPortType type, enum busType bus, AccessPo
   assert(self != NULL);
   struct ADIv5_AccessPort *ap, *ap_t = NULL;
   struct ADIv5_Dap *dapObj = container_of(self, struct ADIv5_Dap, dapApi);
+  BOOL rescanned = FALSE, restart;
   // 先在链表中搜索,如果没有,则尝试创建新的AP,插入链表
   list_for_each_entry(ap, &dapObj->apList, list_entry) {
     if (checkApType(ap->idr, type, bus) == ADI_SUCCESS) {
@@ -1110,6 +2074,8 @@ static int findAP(DAP self, enum AccessPortType type, enum busType bus, AccessPo
   ap_t->dap = dapObj;
   switch (type) {
   case AccessPort_Memory:
+    // ADIv5只保证地址自增在低10位(1KB)内有效，块传输按tarIncBits拆分
+    ap_t->type.memory.tarIncBits = 10;
     ap_t->apApi.Interface.Memory.ReadCSW = apReadCSW;
     ap_t->apApi.Interface.Memory.WriteCSW = apWriteCSW;
     ap_t->apApi.Interface.Memory.Abort = apAbort;
@@ -1125,9 +2091,20 @@ static int findAP(DAP self, enum AccessPortType type, enum busType bus, AccessPo
     ap_t->apApi.Interface.Memory.Write32 = apWrite32;
     ap_t->apApi.Interface.Memory.Write64 = apWrite64;
     ap_t->apApi.Interface.Memory.BlockWrite = apBlockWrite;
+    ap_t->apApi.Interface.Memory.ReadBuffer = apReadBuffer;
+    ap_t->apApi.Interface.Memory.WriteBuffer = apWriteBuffer;
+    ap_t->apApi.Interface.Memory.WindowRead = apWindowRead;
+    ap_t->apApi.Interface.Memory.WindowWrite = apWindowWrite;
+    ap_t->apApi.Interface.Memory.Poll32 = apPoll32;
+
+    ap_t->apApi.Interface.Memory.TransBegin = apTransBegin;
+    ap_t->apApi.Interface.Memory.TransRead32 = apTransRead32;
+    ap_t->apApi.Interface.Memory.TransWrite32 = apTransWrite32;
+    ap_t->apApi.Interface.Memory.TransCommit = apTransCommit;
+    ap_t->apApi.Interface.Memory.TransCancel = apTransCancel;
     break;
   case AccessPort_JTAG:
-    // TODO 设置接口
+    ADIv5_JtagApInit(ap_t);
     break;
   default:
     log_error("Unknow AP type!");
@@ -1135,45 +2112,69 @@ static int findAP(DAP self, enum AccessPortType type, enum busType bus, AccessPo
     return ADI_ERR_BAD_PARAMETER;
   }
 
-  // 搜索AP
-  dapObj->select.regInfo.AP_BankSel = 0xF; // IDR寄存器的Bank
-  for (ap_t->index = 0; ap_t->index < 256; ap_t->index++) {
-    // 写SELECT
-    dapObj->select.regInfo.AP_Sel = ap_t->index;
-    dapObj->skillObj->SingleWrite(dapObj->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, dapObj->select.regData);
-    // 读 APIDR
-    dapObj->skillObj->SingleRead(dapObj->skillObj, SKILL_DAP_AP_REG, AP_REG_IDR, &ap_t->idr.regData);
-    if (dapObj->skillObj->Commit(dapObj->skillObj) != ADPT_SUCCESS) {
-      // 清理指令队列
-      ap->dap->skillObj->Cancel(ap->dap->skillObj);
-      log_error("Read AP IDR register failed!");
+  // 获得AP列表：优先使用拓扑缓存，否则搜索所有AP
+  if (!dapObj->topology.scanned && ADIv5_TopologyLoad(dapObj) != ADI_SUCCESS) {
+    if (dapTopologyScan(dapObj) != ADI_SUCCESS) {
       free(ap_t);
       return ADI_ERR_INTERNAL_ERROR;
     }
-    // 检查AP是否存在
-    if (ap_t->idr.regData == 0) {
-      log_warn("Arrive at the end of the AP list!");
-      free(ap_t);
-      return ADI_FAILED;
-    }
-    log_debug("AP[%d] IDR: 0x%08X.", ap_t->index, ap_t->idr.regData);
-    // 检查AP类型
-    if (checkApType(ap_t->idr, type, bus) != ADI_SUCCESS) {
-      continue;
+  }
+  do {
+    restart = FALSE;
+    for (ap_t->index = 0; ap_t->index < dapObj->topology.count; ap_t->index++) {
+      struct ADIv5_ApInfo *info = &dapObj->topology.ap[ap_t->index];
+      int ret;
+      ap_t->idr.regData = info->idr;
+      ap_t->base = info->base;
+      // 检查AP类型
+      if (checkApType(ap_t->idr, type, bus) != ADI_SUCCESS) {
+        continue;
+      }
+      // 填充AccessPort对象数据，缓存中有探测结果时只做校验
+      if (info->probed) {
+        ret = apWarmAttach(dapObj, ap_t);
+        if (ret == ADI_FAILED && !rescanned) {
+          // 缓存的拓扑已经过期，丢弃整个拓扑重新搜索，从第一个AP重新查找
+          log_warn("Topology cache is stale, rescan all APs.");
+          if (dapTopologyScan(dapObj) != ADI_SUCCESS) {
+            free(ap_t);
+            return ADI_ERR_INTERNAL_ERROR;
+          }
+          rescanned = restart = TRUE;
+          break;
+        }
+      } else {
+        ADIv5_ApSelectBank(ap_t, &dapObj->select, 0xF);
+        ret = fillApConfig(dapObj, ap_t);
+        if (ret == ADI_SUCCESS) {
+          ADIv5_TopologySave(dapObj);
+        }
+      }
+      if (ret == ADI_SUCCESS) {
+        // 初始化接口的ROM Table常量
+        if (type == AccessPort_Memory) {
+          INTERFACE_CONST_INIT(uint64_t, ap_t->apApi.Interface.Memory.RomTableBase, ap_t->type.memory.rom);
+        }
+        // 插入AccessPort链表
+        list_add_tail(&ap_t->list_entry, &dapObj->apList);
+        *apOut = (AccessPort)&ap_t->apApi;
+        return ADI_SUCCESS;
+      } else {
+        free(ap_t);
+        return ADI_ERR_INTERNAL_ERROR;
+      }
     }
-    // 填充AccessPort对象数据
-    if (fillApConfig(dapObj, ap_t) == ADI_SUCCESS) {
-      // 初始化接口的ROM Table常量
-      INTERFACE_CONST_INIT(uint64_t, ap_t->apApi.Interface.Memory.RomTableBase, ap_t->type.memory.rom);
-      // 插入AccessPort链表
-      list_add_tail(&ap_t->list_entry, &dapObj->apList);
-      *apOut = (AccessPort)&ap_t->apApi;
-      return ADI_SUCCESS;
-    } else {
-      free(ap_t);
-      return ADI_ERR_INTERNAL_ERROR;
+    // DPv1的TARGETID为0，DPIDR相同的不同芯片共用一条缓存记录，缓存中没有需要的AP时重新搜索一次
+    if (!restart && !rescanned && dapObj->topology.loaded) {
+      log_warn("No matching AP in the topology cache, rescan all APs.");
+      if (dapTopologyScan(dapObj) != ADI_SUCCESS) {
+        free(ap_t);
+        return ADI_ERR_INTERNAL_ERROR;
+      }
+      rescanned = restart = TRUE;
     }
-  }
+  } while (restart);
+  log_warn("Arrive at the end of the AP list!");
   free(ap_t);
   return ADI_FAILED;
 }
@@ -1198,6 +2199,15 @@ DAP ADIv5_CreateDap(DapSkill skillObj) {
   return (DAP)&dap->dapApi;
 }
 
+/**
+ * 设置DAP所属的Adapter
+ */
+void ADIv5_SetAdapter(DAP self, Adapter adapter) {
+  assert(self != NULL);
+  struct ADIv5_Dap *dapObj = container_of(self, struct ADIv5_Dap, dapApi);
+  dapObj->adapter = adapter;
+}
+
 // DestoryDap 销毁Dap对象
 void ADIv5_DestoryDap(DAP *self) {
   assert(self != NULL);
@@ -1207,18 +2217,27 @@ void ADIv5_DestoryDap(DAP *self) {
   // 释放链表
   list_for_each_entry_safe(ap, ap_t, &dapObj->apList, list_entry) {
     list_del(&ap->list_entry); // 将链表中删除
+    if (ap->apApi.type == AccessPort_Memory) {
+      free(ap->type.memory.romCache.components);
+    } else if (ap->apApi.type == AccessPort_JTAG) {
+      ADIv5_JtagApRelease(ap);
+    }
     free(ap);
   }
+  free(dapObj->topology.cachePath);
   free(dapObj);
   *self = NULL;
 }
 
 /**
  * 读取Component ID和Peripheral ID
+ * 所有ID寄存器在一个事务中读取,只与仿真器交互一次
  */
 int ADIv5_ReadCidPid(AccessPort self, uint64_t componentBase, uint32_t *cid, uint64_t *pid) {
   assert(self != NULL && cid != NULL && pid != NULL);
-  jmp_buf exception;
+  // ID寄存器偏移:CID0-3, PID0-4, XXX pid5-7全是0，所以不用读
+  static const uint16_t idRegOffset[] = {0xFF0, 0xFF4, 0xFF8, 0xFFC, 0xFE0, 0xFE4, 0xFE8, 0xFEC, 0xFD0};
+  uint32_t idReg[sizeof(idRegOffset) / sizeof(idRegOffset[0])];
   if ((componentBase & 0xFFF) != 0) {
     log_warn("Component base address is not 4KB aligned!");
     return ADI_ERR_BAD_PARAMETER;
@@ -1226,48 +2245,23 @@ int ADIv5_ReadCidPid(AccessPort self, uint64_t componentBase, uint32_t *cid, uin
 
   *cid = 0;
   *pid = 0;
-  uint32_t cid0, cid1, cid2, cid3;
-  uint32_t pid0, pid1, pid2, pid3, pid4; // XXX pid5-7全是0，所以不用读
-  // 错误处理
-  switch (setjmp(exception)) {
-  case 1:
-    log_error("DAP_ReadMem32:Read Component ID Failed!");
-    return ADI_FAILED;
-  case 2:
-    log_error("DAP_ReadMem32:Read Peripheral ID Failed!");
+  if (apTransBegin(self) != ADI_SUCCESS) {
     return ADI_FAILED;
-  case 3:
-    log_error("DAP_Execute:Failed!");
-    return ADI_FAILED;
-  default:
-    log_error("Unknow Error.");
+  }
+  for (unsigned int i = 0; i < sizeof(idRegOffset) / sizeof(idRegOffset[0]); i++) {
+    if (apTransRead32(self, componentBase + idRegOffset[i], &idReg[i]) != ADI_SUCCESS) {
+      apTransCancel(self);
+      log_error("Read Component ID and Peripheral ID Failed!");
+      return ADI_FAILED;
+    }
+  }
+  if (apTransCommit(self) != ADI_SUCCESS) {
+    log_error("Read Component ID and Peripheral ID Failed!");
     return ADI_FAILED;
-  case 0:
-    break;
   }
-  // 读取Component ID
-  if (apRead32(self, componentBase + 0xFF0, &cid0) != ADI_SUCCESS)
-    longjmp(exception, 1);
-  if (apRead32(self, componentBase + 0xFF4, &cid1) != ADI_SUCCESS)
-    longjmp(exception, 1);
-  if (apRead32(self, componentBase + 0xFF8, &cid2) != ADI_SUCCESS)
-    longjmp(exception, 1);
-  if (apRead32(self, componentBase + 0xFFC, &cid3) != ADI_SUCCESS)
-    longjmp(exception, 1);
-  // 读取Peripheral ID
-  if (apRead32(self, componentBase + 0xFE0, &pid0) != ADI_SUCCESS)
-    longjmp(exception, 2);
-  if (apRead32(self, componentBase + 0xFE4, &pid1) != ADI_SUCCESS)
-    longjmp(exception, 2);
-  if (apRead32(self, componentBase + 0xFE8, &pid2) != ADI_SUCCESS)
-    longjmp(exception, 2);
-  if (apRead32(self, componentBase + 0xFEC, &pid3) != ADI_SUCCESS)
-    longjmp(exception, 2);
-  if (apRead32(self, componentBase + 0xFD0, &pid4) != ADI_SUCCESS)
-    longjmp(exception, 2);
-
-  *cid = (cid3 & 0xff) << 24 | (cid2 & 0xff) << 16 | (cid1 & 0xff) << 8 | (cid0 & 0xff);
-  *pid = (uint64_t)(pid4 & 0xff) << 32 | (pid3 & 0xff) << 24 | (pid2 & 0xff) << 16 |
-         (pid1 & 0xff) << 8 | (pid0 & 0xff);
+
+  *cid = (idReg[3] & 0xff) << 24 | (idReg[2] & 0xff) << 16 | (idReg[1] & 0xff) << 8 | (idReg[0] & 0xff);
+  *pid = (uint64_t)(idReg[8] & 0xff) << 32 | (idReg[7] & 0xff) << 24 | (idReg[6] & 0xff) << 16 |
+         (idReg[5] & 0xff) << 8 | (idReg[4] & 0xff);
   return ADI_SUCCESS;
 }
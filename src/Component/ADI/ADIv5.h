@@ -35,6 +35,7 @@
 #include "smartocd.h"
 
 #include "Adapter/adapter_dap.h"
+#include "Adapter/adapter_jtag.h"
 
 #ifdef _IMPORTED_ARM_ADI_DEFINES_
 #error "Already imported ADI defines!!"
@@ -87,6 +88,14 @@
 #define AP_REG_CFG			0xF5U		// CFG Register
 #define AP_REG_ROM_LSB		0xF9U		// Debug ROM Address LSByte
 #define AP_REG_IDR			0xFDU		// Identification Register
+/* JTAG-AP寄存器 bit0 = 1 */
+#define JTAG_AP_REG_CSW		0x01U		// Control and Status Word
+#define JTAG_AP_REG_PORTSEL	0x05U		// Port Select
+#define JTAG_AP_REG_PSTA	0x09U		// Port Status
+#define JTAG_AP_REG_BFIFO1	0x11U		// Byte FIFO,每次访问1个字节
+#define JTAG_AP_REG_BFIFO2	0x15U		// Byte FIFO,每次访问2个字节
+#define JTAG_AP_REG_BFIFO3	0x19U		// Byte FIFO,每次访问3个字节
+#define JTAG_AP_REG_BFIFO4	0x1DU		// Byte FIFO,每次访问4个字节
 
 /**
  * 错误码
@@ -97,6 +106,7 @@ enum {
 	ADI_ERR_INTERNAL_ERROR,	// 不是由ADI的逻辑造成的错误
 	ADI_ERR_BAD_PARAMETER,	// 无效的参数
 	ADI_ERR_UNSUPPORT,	// 不支持的操作
+	ADI_ERR_TIMEOUT,	// 等待超时
 };
 
 // DAP类型预定义
@@ -309,7 +319,7 @@ enum dataSize{
  * 	mode:地址自增模式
  * 	size:单次总线请求的数据长度
  * 	count:传输的总次数
- * 	data:数据存放地址
+ * 	data:数据存放地址,每次DRW访问占用一个字;64/128/256位传输每次占用2/4/8个字,低位在前
  */
 typedef int (*ADIv5_MEM_AP_BLOCK_READ)(
 		IN AccessPort self,
@@ -328,7 +338,7 @@ typedef int (*ADIv5_MEM_AP_BLOCK_READ)(
  * 	mode:地址自增模式
  * 	size:单次总线请求的数据长度
  * 	count:传输的总次数
- * 	data:数据存放地址
+ * 	data:数据存放地址,每次DRW访问占用一个字;64/128/256位传输每次占用2/4/8个字,低位在前
  */
 typedef int (*ADIv5_MEM_AP_BLOCK_WRITE)(
 		IN AccessPort self,
@@ -339,6 +349,42 @@ typedef int (*ADIv5_MEM_AP_BLOCK_WRITE)(
 		IN uint8_t *data
 );
 
+/**
+ * 读取连续内存到紧凑缓冲区
+ * 地址和长度可以不对齐,字对齐的主体部分每次DRW访问传输4字节(size小于字时使用packed传输),
+ * 不对齐的头部和尾部使用最少的单次访问完成
+ * 参数:
+ * 	self:AccessPort对象
+ * 	addr:起始地址
+ * 	size:单次总线访问的最大数据长度,DataSize_8/16/32
+ * 	len:读取的字节数
+ * 	buff:紧凑缓冲区,长度为len
+ */
+typedef int (*ADIv5_MEM_AP_READ_BUFFER)(
+		IN AccessPort self,
+		IN uint64_t addr,
+		IN enum dataSize size,
+		IN unsigned int len,
+		OUT uint8_t *buff
+);
+
+/**
+ * 将紧凑缓冲区写入连续内存
+ * 参数:
+ * 	self:AccessPort对象
+ * 	addr:起始地址
+ * 	size:单次总线访问的最大数据长度,DataSize_8/16/32
+ * 	len:写入的字节数
+ * 	buff:紧凑缓冲区,长度为len
+ */
+typedef int (*ADIv5_MEM_AP_WRITE_BUFFER)(
+		IN AccessPort self,
+		IN uint64_t addr,
+		IN enum dataSize size,
+		IN unsigned int len,
+		IN uint8_t *buff
+);
+
 /**
  * 读CSW寄存器
  * 参数:
@@ -370,6 +416,140 @@ typedef int (*ADIv5_MEM_AP_ABORT)(
 		IN AccessPort self
 );
 
+/**
+ * 通过Banked Data寄存器(BD0-BD3)读取16字节对齐窗口内的数据
+ * 只写一次TAR(窗口基址),每个字通过一个BD寄存器读取,适合读取小而集中的结构体
+ * 参数:
+ * 	self:AccessPort对象
+ * 	addr:起始地址,必须字对齐
+ * 	count:读取的字数,从addr开始不能越过16字节窗口
+ * 	data:数据存放地址
+ */
+typedef int (*ADIv5_MEM_AP_WINDOW_READ)(
+		IN AccessPort self,
+		IN uint64_t addr,
+		IN unsigned int count,
+		OUT uint32_t *data
+);
+
+/**
+ * 通过Banked Data寄存器(BD0-BD3)写入16字节对齐窗口内的数据
+ * 参数:
+ * 	self:AccessPort对象
+ * 	addr:起始地址,必须字对齐
+ * 	count:写入的字数,从addr开始不能越过16字节窗口
+ * 	data:要写入的数据
+ */
+typedef int (*ADIv5_MEM_AP_WINDOW_WRITE)(
+		IN AccessPort self,
+		IN uint64_t addr,
+		IN unsigned int count,
+		IN uint32_t *data
+);
+
+/**
+ * 轮询32位内存直到(值 & mask) == (value & mask)
+ * 仿真器支持值匹配读时在仿真器中完成比较,否则尽量使用DP的pushed-compare,
+ * 每次往返可以比较多次,适合等待Flash忙标志、内核停止状态等
+ * 参数:
+ * 	self:AccessPort对象
+ * 	addr:地址,必须字对齐
+ * 	mask:比较的掩码
+ * 	value:期望的值
+ * 	timeout:超时时间,单位毫秒
+ * 返回:
+ * 	ADI_SUCCESS:匹配
+ * 	ADI_ERR_TIMEOUT:超时仍不匹配
+ */
+typedef int (*ADIv5_MEM_AP_POLL_32)(
+		IN AccessPort self,
+		IN uint64_t addr,
+		IN uint32_t mask,
+		IN uint32_t value,
+		IN unsigned int timeout
+);
+
+/**
+ * 开始一次MEM-AP事务
+ * 事务开始后，TransRead32/TransWrite32只把操作插入指令队列而不执行，
+ * 直到TransCommit时一次性执行，整个事务只和仿真器交互一次。
+ * 事务期间不可以调用同一个DAP下其他AP的读写接口
+ * 参数:
+ * 	self:AccessPort对象
+ */
+typedef int (*ADIv5_MEM_AP_TRANS_BEGIN)(
+		IN AccessPort self
+);
+
+/**
+ * 事务中读32位数据
+ * 参数:
+ * 	self:AccessPort对象
+ * 	addr:要读的地址
+ * 	data:数据存放地址,TransCommit成功后才有效,在此之前必须保持可访问
+ */
+typedef int (*ADIv5_MEM_AP_TRANS_READ_32)(
+		IN AccessPort self,
+		IN uint64_t addr,
+		OUT uint32_t *data
+);
+
+/**
+ * 事务中写32位数据
+ * 参数:
+ * 	self:AccessPort对象
+ * 	addr:要写的地址
+ * 	data:要写入的数据
+ */
+typedef int (*ADIv5_MEM_AP_TRANS_WRITE_32)(
+		IN AccessPort self,
+		IN uint64_t addr,
+		IN uint32_t data
+);
+
+/**
+ * 提交事务,执行事务中记录的全部操作
+ * 无论成功与否,事务都会结束
+ * 参数:
+ * 	self:AccessPort对象
+ */
+typedef int (*ADIv5_MEM_AP_TRANS_COMMIT)(
+		IN AccessPort self
+);
+
+/**
+ * 放弃事务,丢弃事务中记录的全部操作
+ * 参数:
+ * 	self:AccessPort对象
+ */
+typedef int (*ADIv5_MEM_AP_TRANS_CANCEL)(
+		IN AccessPort self
+);
+
+/**
+ * JTAG-AP 选择JTAG端口
+ * 写PORTSEL寄存器,然后发送5个TMS=1使端口上的TAP进入Test-Logic-Reset状态
+ * 参数:
+ * 	self:AccessPort对象
+ * 	port:端口号,0-7
+ */
+typedef int (*ADIv5_JTAG_AP_SELECT_PORT)(
+		IN AccessPort self,
+		IN unsigned int port
+);
+
+/**
+ * JTAG-AP 读取并清除PSTA寄存器
+ * 端口在上次清除之后被断开或者掉电时,对应的位为1
+ * 参数:
+ * 	self:AccessPort对象
+ * 	status:PSTA寄存器的值
+ */
+typedef int (*ADIv5_JTAG_AP_PORT_STATUS)(
+		IN AccessPort self,
+		OUT uint8_t *status
+);
+
 /**
  * Access Port接口定义
  */
@@ -396,13 +576,221 @@ struct accessPort{
 			ADIv5_MEM_AP_WRITE_32 Write32;
 			ADIv5_MEM_AP_WRITE_64 Write64;
 			ADIv5_MEM_AP_BLOCK_WRITE BlockWrite;
+			// 紧凑缓冲区读写
+			ADIv5_MEM_AP_READ_BUFFER ReadBuffer;
+			ADIv5_MEM_AP_WRITE_BUFFER WriteBuffer;
+
+			// 16字节窗口读写
+			ADIv5_MEM_AP_WINDOW_READ WindowRead;
+			ADIv5_MEM_AP_WINDOW_WRITE WindowWrite;
+
+			// 轮询等待
+			ADIv5_MEM_AP_POLL_32 Poll32;
+
+			// 事务接口:多次读写只执行一次Commit
+			ADIv5_MEM_AP_TRANS_BEGIN TransBegin;
+			ADIv5_MEM_AP_TRANS_READ_32 TransRead32;
+			ADIv5_MEM_AP_TRANS_WRITE_32 TransWrite32;
+			ADIv5_MEM_AP_TRANS_COMMIT TransCommit;
+			ADIv5_MEM_AP_TRANS_CANCEL TransCancel;
 		}Memory;
 		// JTAG-AP
 		struct {
-			// TODO 增加JTAG-AP的相关接口
+			// JTAG能力集,通过JTAG-AP访问选中的端口,只读!不可修改
+			const JtagSkill Skill;
+			ADIv5_JTAG_AP_SELECT_PORT SelectPort;
+			ADIv5_JTAG_AP_PORT_STATUS PortStatus;
 		}Jtag;
 	} Interface;
 };
 
 
+/**
+ * 设置DAP拓扑缓存文件
+ * 缓存文件中以DPIDR和TARGETID区分不同的目标，记录AP的IDR、CFG、ROM基址以及探测到的传输能力，
+ * 再次连接同一目标时省略AP的搜索和探测，只校验AP的IDR
+ * 参数:
+ * 	self:DAP对象
+ * 	path:缓存文件路径，NULL表示不使用缓存文件
+ */
+int ADIv5_SetTopologyCache(
+		IN DAP self,
+		IN const char *path
+);
+
+/**
+ * 设置DAP所属的Adapter
+ * JTAG-DP和SW-DP清除粘滞标志的方式不同，需要通过Adapter获得当前的传输方式
+ * 参数:
+ * 	self:DAP对象
+ * 	adapter:Adapter对象，NULL表示按照SW-DP处理
+ */
+void ADIv5_SetAdapter(
+		IN DAP self,
+		IN Adapter adapter
+);
+
+/**
+ * ROM Table遍历得到的CoreSight组件
+ * 组件按照广度优先的顺序排列,通过parent索引组成树
+ */
+struct romComponent {
+	uint64_t base;		// 组件基址,4KB对齐
+	uint32_t cid;		// Component ID,读取失败时为0
+	uint64_t pid;		// Peripheral ID
+	uint32_t devArch;	// DEVARCH寄存器(0xFBC)
+	uint32_t devId;		// DEVID寄存器(0xFC8)
+	uint32_t devType;	// DEVTYPE寄存器(0xFCC),Class 0x1 ROM Table为MEMTYPE
+	int parent;		// 父组件的索引,根组件为-1
+	unsigned int depth;	// 在ROM Table中的层级,根组件为0
+};
+
+/**
+ * 遍历ROM Table,识别所有CoreSight组件
+ * 支持Class 0x1和Class 0x9的ROM Table,同一层的所有组件ID寄存器在一次事务中读取。
+ * 结果缓存在AP中,再次遍历同一个基址时直接返回缓存
+ * 参数:
+ * 	self:AccessPort对象
+ * 	base:ROM Table基址
+ * 	refresh:是否忽略缓存重新遍历
+ * 	components:组件数组,由AP管理,不要释放
+ * 	count:组件个数
+ */
+int ADIv5_WalkRomTable(
+		IN AccessPort self,
+		IN uint64_t base,
+		IN int refresh,
+		OUT const struct romComponent **components,
+		OUT unsigned int *count
+);
+
+// 内存缓存类型预定义
+typedef struct memCache *MemCache;
+
+/**
+ * 地址区域的缓存策略
+ * MemCache_Cacheable:可缓存,目标停止运行时内容只会被调试器修改
+ * MemCache_Volatile:易变外设,不缓存,写入时作废所有缓存行(可能使内核恢复运行、复位或者改变其他内存)
+ * MemCache_Never:不缓存,写入只作废重叠的缓存行
+ */
+enum memCachePolicy {
+	MemCache_Cacheable = 0,
+	MemCache_Volatile,
+	MemCache_Never,
+};
+
+/**
+ * 内存缓存统计信息
+ */
+struct memCacheStats {
+	uint64_t hits;		// 命中的行数
+	uint64_t misses;	// 从目标填充的行数
+	uint64_t bypass;	// 不经过缓存读取的字节数
+	unsigned int lines;	// 当前缓存的行数
+};
+
+/**
+ * 在MEM-AP上创建写直达的内存缓存,以64字节为一行
+ * 缓存需要调用者手动打开:ADI层不知道内核的运行状态,只能由调用者在确认目标停止运行之后打开,
+ * 在恢复运行、单步或者复位之前关闭。新建的缓存是关闭的,关闭时所有读取都直接访问目标。
+ * 每个AP只能有一个缓存,通过同一个DAP上任何AP的写操作都会作废相应的缓存行,
+ * DAP传输出错恢复时作废所有缓存行。
+ * 没有设置策略的地址按照MemCache_Volatile处理
+ * 参数:
+ * 	ap:AccessPort对象
+ * 返回:
+ * 	缓存对象,失败返回NULL
+ */
+MemCache ADIv5_CreateMemCache(
+		IN AccessPort ap
+);
+
+/**
+ * 销毁内存缓存
+ */
+void ADIv5_DestroyMemCache(
+		IN MemCache *cache
+);
+
+/**
+ * 打开或者关闭缓存
+ * 只能在目标停止运行时打开,恢复运行、单步或者复位之前必须关闭。关闭时作废所有缓存行
+ * 参数:
+ * 	cache:缓存对象
+ * 	enable:TRUE打开,FALSE关闭
+ */
+void ADIv5_MemCacheEnable(
+		IN MemCache cache,
+		IN BOOL enable
+);
+
+/**
+ * 设置地址区域的缓存策略,后设置的区域优先
+ * 参数:
+ * 	cache:缓存对象
+ * 	base:区域基址
+ * 	size:区域大小
+ * 	policy:缓存策略
+ */
+int ADIv5_MemCacheSetRegion(
+		IN MemCache cache,
+		IN uint64_t base,
+		IN uint64_t size,
+		IN enum memCachePolicy policy
+);
+
+/**
+ * 通过缓存读内存
+ * 参数:
+ * 	cache:缓存对象
+ * 	addr:起始地址
+ * 	len:读取的字节数
+ * 	buff:数据存放地址
+ */
+int ADIv5_MemCacheRead(
+		IN MemCache cache,
+		IN uint64_t addr,
+		IN unsigned int len,
+		OUT uint8_t *buff
+);
+
+/**
+ * 通过缓存写内存,数据直接写入目标
+ * 参数:
+ * 	cache:缓存对象
+ * 	addr:起始地址
+ * 	len:写入的字节数
+ * 	buff:要写入的数据
+ */
+int ADIv5_MemCacheWrite(
+		IN MemCache cache,
+		IN uint64_t addr,
+		IN unsigned int len,
+		IN uint8_t *buff
+);
+
+/**
+ * 作废所有缓存行,目标恢复运行、单步或者复位时调用
+ */
+void ADIv5_MemCacheInvalidate(
+		IN MemCache cache
+);
+
+/**
+ * 作废和指定范围重叠的缓存行
+ */
+void ADIv5_MemCacheInvalidateRange(
+		IN MemCache cache,
+		IN uint64_t addr,
+		IN uint64_t len
+);
+
+/**
+ * 获得缓存统计信息
+ */
+void ADIv5_MemCacheGetStats(
+		IN MemCache cache,
+		OUT struct memCacheStats *stats
+);
+
 #endif /* SRC_ARCH_ARM_ADI_ADIV5_H_ */
@@ -33,6 +33,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "Component/adapter/adapter_api.h"
 #include "Component/component.h"
@@ -43,6 +44,8 @@
 #define ADIV5_LUA_OBJECT_TYPE "arch.ARM.ADIv5"
 #define ADIV5_AP_MEM_LUA_OBJECT_TYPE "arch.ARM.ADIv5.AccessPort.Memory"
 #define ADIV5_AP_JTAG_LUA_OBJECT_TYPE "arch.ARM.ADIv5.AccessPort.Jtag"
+#define ADIV5_AP_MEM_TRANS_LUA_OBJECT_TYPE "arch.ARM.ADIv5.AccessPort.Memory.Transaction"
+#define ADIV5_AP_MEM_CACHE_LUA_OBJECT_TYPE "arch.ARM.ADIv5.AccessPort.Memory.Cache"
 
 /**
  * 创建DAP对象
@@ -67,6 +70,14 @@ static int luaApi_adiv5_create_dap(lua_State *L) {
 
   luaL_setmetatable(L, ADIV5_LUA_OBJECT_TYPE);
 
+  // 通过Skill引用的Adapter获得传输方式
+  lua_getiuservalue(L, 1, 1); // +1
+  udata = LuaApi_check_object_type(L, -1, ADAPTER_LUA_OBJECT_TYPE);
+  if (udata != NULL) {
+    ADIv5_SetAdapter(*dapObj, *CAST(Adapter *, udata));
+  }
+  lua_pop(L, 1); // -1
+
   // 引用DapSkill对象
   lua_pushvalue(L, 1);         // +1
   lua_setiuservalue(L, -2, 1); // -1
@@ -74,6 +85,21 @@ static int luaApi_adiv5_create_dap(lua_State *L) {
   return 1; // 返回压到栈中的返回值个数
 }
 
+/**
+ * 设置DAP拓扑缓存文件，需要在FindAccessPort之前调用
+ * 参数:
+ * 	1# DAP对象
+ * 	2# 缓存文件路径(nil表示不使用缓存文件)
+ */
+static int luaApi_adiv5_topology_cache(lua_State *L) {
+  DAP dapObj = *CAST(DAP *, luaL_checkudata(L, 1, ADIV5_LUA_OBJECT_TYPE));
+  const char *path = luaL_optstring(L, 2, NULL);
+  if (ADIv5_SetTopologyCache(dapObj, path) != ADI_SUCCESS) {
+    return luaL_error(L, "Set topology cache failed!");
+  }
+  return 0;
+}
+
 /**
  * 搜素AP,并返回AP对象
  * 参数:
@@ -98,7 +124,7 @@ static int luaApi_adiv5_find_access_port(lua_State *L) {
   if (type == AccessPort_Memory) {
     luaL_setmetatable(L, ADIV5_AP_MEM_LUA_OBJECT_TYPE); // 0
   } else if (type == AccessPort_JTAG) {
-    // TODO ...
+    luaL_setmetatable(L, ADIV5_AP_JTAG_LUA_OBJECT_TYPE); // 0
   }
 
   // 增加DAP的引用
@@ -108,6 +134,51 @@ static int luaApi_adiv5_find_access_port(lua_State *L) {
   return 1;
 }
 
+/**
+ * 选择JTAG-AP的端口，TAP状态机复位到Test-Logic-Reset
+ * 1#:AP对象
+ * 2#:端口号(0~7)
+ */
+static int luaApi_adiv5_ap_jtag_select_port(lua_State *L) {
+  AccessPort apObj = *CAST(AccessPort *, luaL_checkudata(L, 1, ADIV5_AP_JTAG_LUA_OBJECT_TYPE));
+  unsigned int port = CAST(unsigned int, luaL_checkinteger(L, 2));
+  if (apObj->Interface.Jtag.SelectPort(apObj, port) != ADI_SUCCESS) {
+    return luaL_error(L, "Select JTAG-AP port %d failed!", port);
+  }
+  return 0;
+}
+
+/**
+ * 读取并清除JTAG-AP的PSTA寄存器
+ * 1#:AP对象
+ * 返回：
+ * 1#:PSTA，每一位表示对应的端口在选中期间曾经断开
+ */
+static int luaApi_adiv5_ap_jtag_port_status(lua_State *L) {
+  AccessPort apObj = *CAST(AccessPort *, luaL_checkudata(L, 1, ADIV5_AP_JTAG_LUA_OBJECT_TYPE));
+  uint8_t status = 0;
+  if (apObj->Interface.Jtag.PortStatus(apObj, &status) != ADI_SUCCESS) {
+    return luaL_error(L, "Read JTAG-AP PSTA failed!");
+  }
+  lua_pushinteger(L, status);
+  return 1;
+}
+
+/**
+ * 获得JTAG-AP的JTAG能力集对象，可以和适配器的JTAG能力集一样使用
+ * 1#:AP对象
+ * 返回：
+ * 1#:JTAG能力集对象
+ */
+static int luaApi_adiv5_ap_jtag_skill(lua_State *L) {
+  AccessPort apObj = *CAST(AccessPort *, luaL_checkudata(L, 1, ADIV5_AP_JTAG_LUA_OBJECT_TYPE));
+  LuaApi_create_jtag_skill_object(L, CAST(const struct skill *, apObj->Interface.Jtag.Skill)); // +1
+  // 绑定AP对象，防止过早被GC释放
+  lua_pushvalue(L, 1);
+  lua_setiuservalue(L, -2, 1);
+  return 1;
+}
+
 /**
  * 返回当前AP的rom table
  * 1#：skill对象
@@ -243,6 +314,36 @@ static int luaApi_adiv5_ap_mem_rw_32(lua_State *L) {
   }
 }
 
+static int luaApi_adiv5_ap_mem_rw_64(lua_State *L) {
+  AccessPort apObj = *CAST(AccessPort *, luaL_checkudata(L, 1, ADIV5_AP_MEM_LUA_OBJECT_TYPE));
+  uint64_t addr = luaL_checkinteger(L, 2);
+  uint64_t data;
+  if (apObj->type != AccessPort_Memory) {
+    return luaL_error(L, "Not a memory access port.");
+  }
+  if (lua_isnone(L, 3)) { // 读内存
+    if (apObj->Interface.Memory.Read64(apObj, addr, &data) != ADI_SUCCESS) {
+      return luaL_error(L, "Read double word memory %p failed!", addr);
+    }
+    lua_pushinteger(L, data);
+    return 1;
+  } else { // 写内存
+    data = (uint64_t)luaL_checkinteger(L, 3);
+    if (apObj->Interface.Memory.Write64(apObj, addr, data) != ADI_SUCCESS) {
+      return luaL_error(L, "Write double word memory %p failed!", addr);
+    }
+    return 0;
+  }
+}
+
+/**
+ * 每次总线传输在数据缓冲区中占用的字节数
+ * 小于等于字的传输每次占用一个字，64/128/256位传输每次占用2/4/8个字
+ */
+static size_t adiv5_trans_bytes(int dataSize) {
+  return dataSize > DataSize_32 ? sizeof(uint32_t) << (dataSize - DataSize_32) : sizeof(uint32_t);
+}
+
 /**
  * 读取内存块
  * 1#:skill对象
@@ -262,12 +363,16 @@ static int luaApi_adiv5_ap_read_mem_block(lua_State *L) {
   if (apObj->type != AccessPort_Memory) {
     return luaL_error(L, "Not a memory access port.");
   }
-  uint8_t *buff = (uint8_t *)lua_newuserdata(L, transCnt * sizeof(uint32_t));
+  if (dataSize < DataSize_8 || dataSize > DataSize_256 || transCnt < 0) {
+    return luaL_error(L, "Data size or count is illegal!");
+  }
+  size_t buffLen = transCnt * adiv5_trans_bytes(dataSize);
+  uint8_t *buff = (uint8_t *)lua_newuserdata(L, buffLen);
   if (apObj->Interface.Memory.BlockRead(apObj, addr, addrIncMode, dataSize, transCnt,
                                         buff) != ADI_SUCCESS) {
     return luaL_error(L, "Block read failed!");
   }
-  lua_pushlstring(L, CAST(const char *, buff), transCnt * sizeof(uint32_t));
+  lua_pushlstring(L, CAST(const char *, buff), buffLen);
   return 1;
 }
 
@@ -289,16 +394,206 @@ static int luaApi_adiv5_ap_write_mem_block(lua_State *L) {
   if (apObj->type != AccessPort_Memory) {
     return luaL_error(L, "Not a memory access port.");
   }
-  if (transCnt & 0x3) {
-    return luaL_error(L, "The length of the data to be written is not a multiple of the word.");
+  if (dataSize < DataSize_8 || dataSize > DataSize_256) {
+    return luaL_error(L, "Data size is illegal!");
+  }
+  if (transCnt % adiv5_trans_bytes(dataSize)) {
+    return luaL_error(L, "The length of the data to be written is not a multiple of the transfer size.");
   }
   if (apObj->Interface.Memory.BlockWrite(apObj, addr, addrIncMode, dataSize,
-                                         (int)transCnt >> 2, buff) != ADI_SUCCESS) {
+                                         (int)(transCnt / adiv5_trans_bytes(dataSize)), buff) != ADI_SUCCESS) {
     return luaL_error(L, "Block write failed!");
   }
   return 0;
 }
 
+/**
+ * 读取连续内存，地址和长度可以不对齐
+ * 1#:AP对象
+ * 2#:要读取的地址
+ * 3#:读取的字节数
+ * 4#:单次总线访问的最大数据长度(Optional，默认DataSize_32)
+ * 返回：
+ * 1#:读取的数据 字符串形式
+ */
+static int luaApi_adiv5_ap_read_buffer(lua_State *L) {
+  AccessPort apObj = *CAST(AccessPort *, luaL_checkudata(L, 1, ADIV5_AP_MEM_LUA_OBJECT_TYPE));
+  uint64_t addr = luaL_checkinteger(L, 2);
+  lua_Integer len = luaL_checkinteger(L, 3);
+  int dataSize = (int)luaL_optinteger(L, 4, DataSize_32);
+  if (apObj->type != AccessPort_Memory) {
+    return luaL_error(L, "Not a memory access port.");
+  }
+  if (len < 0 || len > UINT32_MAX) {
+    return luaL_error(L, "Read length is illegal!");
+  }
+  uint8_t *buff = (uint8_t *)lua_newuserdata(L, len);
+  if (apObj->Interface.Memory.ReadBuffer(apObj, addr, dataSize, (unsigned int)len, buff) != ADI_SUCCESS) {
+    return luaL_error(L, "Read memory %p failed!", addr);
+  }
+  lua_pushlstring(L, CAST(const char *, buff), len);
+  return 1;
+}
+
+/**
+ * 写入连续内存，地址和长度可以不对齐
+ * 1#:AP对象
+ * 2#:要写入的地址
+ * 3#:要写的数据（字符串）
+ * 4#:单次总线访问的最大数据长度(Optional，默认DataSize_32)
+ */
+static int luaApi_adiv5_ap_write_buffer(lua_State *L) {
+  AccessPort apObj = *CAST(AccessPort *, luaL_checkudata(L, 1, ADIV5_AP_MEM_LUA_OBJECT_TYPE));
+  uint64_t addr = luaL_checkinteger(L, 2);
+  size_t len;
+  const char *data = luaL_checklstring(L, 3, &len);
+  int dataSize = (int)luaL_optinteger(L, 4, DataSize_32);
+  if (apObj->type != AccessPort_Memory) {
+    return luaL_error(L, "Not a memory access port.");
+  }
+  if (apObj->Interface.Memory.WriteBuffer(apObj, addr, dataSize, (unsigned int)len, CAST(uint8_t *, data)) != ADI_SUCCESS) {
+    return luaL_error(L, "Write memory %p failed!", addr);
+  }
+  return 0;
+}
+
+/**
+ * 轮询32位内存直到(值 & mask) == (value & mask)
+ * 1#:AP对象
+ * 2#:addr:地址，字对齐
+ * 3#:mask:比较的掩码
+ * 4#:value:期望的值
+ * 5#:timeout:超时时间，单位毫秒(Optional，默认1000)
+ * 返回:
+ * 1#:是否匹配 boolean
+ */
+static int luaApi_adiv5_ap_poll_32(lua_State *L) {
+  AccessPort apObj = *CAST(AccessPort *, luaL_checkudata(L, 1, ADIV5_AP_MEM_LUA_OBJECT_TYPE));
+  uint64_t addr = luaL_checkinteger(L, 2);
+  uint32_t mask = (uint32_t)luaL_checkinteger(L, 3);
+  uint32_t value = (uint32_t)luaL_checkinteger(L, 4);
+  unsigned int timeout = (unsigned int)luaL_optinteger(L, 5, 1000);
+  if (apObj->type != AccessPort_Memory) {
+    return luaL_error(L, "Not a memory access port.");
+  }
+  int ret = apObj->Interface.Memory.Poll32(apObj, addr, mask, value, timeout);
+  if (ret != ADI_SUCCESS && ret != ADI_ERR_TIMEOUT) {
+    return luaL_error(L, "Poll memory %p failed!", addr);
+  }
+  lua_pushboolean(L, ret == ADI_SUCCESS);
+  return 1;
+}
+
+/**
+ * 通过BD寄存器读取16字节窗口
+ * 1#:AP对象
+ * 2#:addr:起始地址，字对齐
+ * 3#:count:读取的字数(1-4)，不能越过16字节窗口
+ * 返回:
+ * 1-4#:读取的数据
+ */
+static int luaApi_adiv5_ap_window_read(lua_State *L) {
+  AccessPort apObj = *CAST(AccessPort *, luaL_checkudata(L, 1, ADIV5_AP_MEM_LUA_OBJECT_TYPE));
+  uint64_t addr = luaL_checkinteger(L, 2);
+  int count = (int)luaL_checkinteger(L, 3);
+  uint32_t data[4];
+  if (apObj->type != AccessPort_Memory) {
+    return luaL_error(L, "Not a memory access port.");
+  }
+  if (count <= 0 || count > 4) {
+    return luaL_error(L, "Window access count is illegal!");
+  }
+  if (apObj->Interface.Memory.WindowRead(apObj, addr, count, data) != ADI_SUCCESS) {
+    return luaL_error(L, "Window read %p failed!", addr);
+  }
+  for (int i = 0; i < count; i++) {
+    lua_pushinteger(L, data[i]);
+  }
+  return count;
+}
+
+/**
+ * 通过BD寄存器写入16字节窗口
+ * 1#:AP对象
+ * 2#:addr:起始地址，字对齐
+ * 3-6#:要写入的数据，个数决定写入的字数，不能越过16字节窗口
+ */
+static int luaApi_adiv5_ap_window_write(lua_State *L) {
+  AccessPort apObj = *CAST(AccessPort *, luaL_checkudata(L, 1, ADIV5_AP_MEM_LUA_OBJECT_TYPE));
+  uint64_t addr = luaL_checkinteger(L, 2);
+  int count = lua_gettop(L) - 2;
+  uint32_t data[4];
+  if (apObj->type != AccessPort_Memory) {
+    return luaL_error(L, "Not a memory access port.");
+  }
+  if (count <= 0 || count > 4) {
+    return luaL_error(L, "Window access count is illegal!");
+  }
+  for (int i = 0; i < count; i++) {
+    data[i] = (uint32_t)luaL_checkinteger(L, 3 + i);
+  }
+  if (apObj->Interface.Memory.WindowWrite(apObj, addr, count, data) != ADI_SUCCESS) {
+    return luaL_error(L, "Window write %p failed!", addr);
+  }
+  return 0;
+}
+
+/**
+ * 遍历ROM Table
+ * 1#:AP对象
+ * 2#:ROM Table基址(Optional，默认为AP的ROM Table)
+ * 3#:是否忽略缓存重新遍历(Optional，默认false)
+ * 返回:
+ * 1#:根组件，组件为table：Base、CID、PID、Class、DevArch、DevId、DevType、Depth、Children
+ */
+static int luaApi_adiv5_ap_walk_rom_table(lua_State *L) {
+  AccessPort apObj = *CAST(AccessPort *, luaL_checkudata(L, 1, ADIV5_AP_MEM_LUA_OBJECT_TYPE));
+  const struct romComponent *components;
+  unsigned int count;
+  if (apObj->type != AccessPort_Memory) {
+    return luaL_error(L, "Not a memory access port.");
+  }
+  uint64_t base = luaL_optinteger(L, 2, apObj->Interface.Memory.RomTableBase);
+  int refresh = lua_toboolean(L, 3);
+  if (ADIv5_WalkRomTable(apObj, base, refresh, &components, &count) != ADI_SUCCESS) {
+    return luaL_error(L, "Walk ROM Table %p failed!", base);
+  }
+  // 先按顺序创建所有组件，再挂到父组件的Children中
+  lua_createtable(L, count, 0); // +1 组件数组
+  for (unsigned int i = 0; i < count; i++) {
+    const struct romComponent *comp = &components[i];
+    lua_createtable(L, 0, 9); // +1
+    lua_pushinteger(L, comp->base);
+    lua_setfield(L, -2, "Base");
+    lua_pushinteger(L, comp->cid);
+    lua_setfield(L, -2, "CID");
+    lua_pushinteger(L, comp->pid);
+    lua_setfield(L, -2, "PID");
+    lua_pushinteger(L, (comp->cid >> 12) & 0xF);
+    lua_setfield(L, -2, "Class");
+    lua_pushinteger(L, comp->devArch);
+    lua_setfield(L, -2, "DevArch");
+    lua_pushinteger(L, comp->devId);
+    lua_setfield(L, -2, "DevId");
+    lua_pushinteger(L, comp->devType);
+    lua_setfield(L, -2, "DevType");
+    lua_pushinteger(L, comp->depth);
+    lua_setfield(L, -2, "Depth");
+    lua_newtable(L);
+    lua_setfield(L, -2, "Children");
+    if (comp->parent >= 0) {
+      lua_rawgeti(L, -2, comp->parent + 1);   // +1 父组件
+      lua_getfield(L, -1, "Children");        // +1
+      lua_pushvalue(L, -3);                   // +1
+      lua_rawseti(L, -2, luaL_len(L, -2) + 1); // -1
+      lua_pop(L, 2);                          // -2
+    }
+    lua_rawseti(L, -2, i + 1); // -1
+  }
+  lua_rawgeti(L, -1, 1); // +1 根组件
+  return 1;
+}
+
 /**
  * 读取Component ID 和 Peripheral ID
  * 1#：skill对象
@@ -320,6 +615,326 @@ static int luaApi_adiv5_ap_get_pid_cid(lua_State *L) {
   return 2;
 }
 
+/* 事务对象中记录的一次字访问 */
+struct ap_trans_op {
+  uint64_t addr; // 访问地址
+  uint32_t data; // 写入的数据或读取的结果
+  int isRead;    // 是否为读操作
+};
+
+/**
+ * MEM-AP事务对象
+ * 记录多次字读写，在Commit时作为一个MEM-AP事务执行，
+ * 重复的SELECT、CSW写入被省略，整个事务只执行一次Commit
+ */
+struct ap_trans {
+  AccessPort apObj;         // 所属的AP
+  int count;                // 已记录的操作个数
+  int capacity;             // 操作数组容量
+  int resultCount;          // 读操作个数
+  struct ap_trans_op *ops; // 操作数组
+};
+
+static struct ap_trans *luaApi_check_ap_trans(lua_State *L, int index) {
+  return CAST(struct ap_trans *, luaL_checkudata(L, index, ADIV5_AP_MEM_TRANS_LUA_OBJECT_TYPE));
+}
+
+/**
+ * 在事务对象中新增一个操作
+ * 失败抛出错误
+ */
+static struct ap_trans_op *ap_trans_new_op(lua_State *L, struct ap_trans *trans, int isRead) {
+  struct ap_trans_op *op;
+  uint64_t addr = luaL_checkinteger(L, 2);
+  if (addr & 0x3) {
+    luaL_error(L, "Memory address %p is not word aligned!", addr);
+    return NULL;
+  }
+  if (trans->count == trans->capacity) {
+    int newCapacity = trans->capacity ? trans->capacity << 1 : 16;
+    struct ap_trans_op *newOps = realloc(trans->ops, newCapacity * sizeof(struct ap_trans_op));
+    if (newOps == NULL) {
+      luaL_error(L, "Transaction op buff alloc Failed!");
+      return NULL;
+    }
+    trans->ops = newOps;
+    trans->capacity = newCapacity;
+  }
+  op = &trans->ops[trans->count++];
+  op->addr = addr;
+  op->data = 0;
+  op->isRead = isRead;
+  return op;
+}
+
+/**
+ * 创建MEM-AP事务对象
+ * 1#:AP对象
+ * 返回:
+ * 1#:事务对象
+ */
+static int luaApi_adiv5_ap_mem_transaction(lua_State *L) {
+  AccessPort apObj = *CAST(AccessPort *, luaL_checkudata(L, 1, ADIV5_AP_MEM_LUA_OBJECT_TYPE));
+  if (apObj->type != AccessPort_Memory) {
+    return luaL_error(L, "Not a memory access port.");
+  }
+
+  struct ap_trans *trans = CAST(struct ap_trans *, lua_newuserdatauv(L, sizeof(struct ap_trans), 1)); // +1
+  memset(trans, 0, sizeof(struct ap_trans));
+  trans->apObj = apObj;
+
+  luaL_setmetatable(L, ADIV5_AP_MEM_TRANS_LUA_OBJECT_TYPE);
+
+  // 引用AP对象，防止被回收
+  lua_pushvalue(L, 1);         // +1
+  lua_setiuservalue(L, -2, 1); // -1
+
+  return 1;
+}
+
+/**
+ * 记录读32位数据
+ * 1#:事务对象
+ * 2#:addr:地址64位
+ * 返回:
+ * 1#:该操作的结果在Commit返回值中的序号
+ */
+static int luaApi_ap_trans_read_32(lua_State *L) {
+  struct ap_trans *trans = luaApi_check_ap_trans(L, 1);
+
+  ap_trans_new_op(L, trans, 1);
+  lua_pushinteger(L, ++trans->resultCount);
+  return 1;
+}
+
+/**
+ * 记录写32位数据
+ * 1#:事务对象
+ * 2#:addr:地址64位
+ * 3#:data:要写的数据
+ */
+static int luaApi_ap_trans_write_32(lua_State *L) {
+  struct ap_trans *trans = luaApi_check_ap_trans(L, 1);
+  uint32_t data = (uint32_t)luaL_checkinteger(L, 3);
+
+  ap_trans_new_op(L, trans, 0)->data = data;
+  return 0;
+}
+
+/**
+ * 执行事务对象中记录的全部操作
+ * 执行完毕后事务对象被清空，可以继续记录
+ * 1#:事务对象
+ * 返回:
+ * 1#:按记录顺序排列的读取结果表
+ */
+static int luaApi_ap_trans_commit(lua_State *L) {
+  struct ap_trans *trans = luaApi_check_ap_trans(L, 1);
+  AccessPort apObj = trans->apObj;
+  int ret;
+
+  ret = apObj->Interface.Memory.TransBegin(apObj);
+  for (int i = 0; i < trans->count && ret == ADI_SUCCESS; i++) {
+    struct ap_trans_op *op = &trans->ops[i];
+    if (op->isRead) {
+      ret = apObj->Interface.Memory.TransRead32(apObj, op->addr, &op->data);
+    } else {
+      ret = apObj->Interface.Memory.TransWrite32(apObj, op->addr, op->data);
+    }
+  }
+  if (ret != ADI_SUCCESS) {
+    apObj->Interface.Memory.TransCancel(apObj);
+    trans->count = trans->resultCount = 0;
+    return luaL_error(L, "Record transaction failed!");
+  }
+
+  if (apObj->Interface.Memory.TransCommit(apObj) != ADI_SUCCESS) {
+    trans->count = trans->resultCount = 0;
+    return luaL_error(L, "Commit transaction failed!");
+  }
+
+  // 构造返回值
+  int idx = 1;
+  lua_createtable(L, trans->resultCount, 0);
+  for (int i = 0; i < trans->count; i++) {
+    if (trans->ops[i].isRead) {
+      lua_pushinteger(L, trans->ops[i].data);
+      lua_rawseti(L, -2, idx++);
+    }
+  }
+
+  trans->count = trans->resultCount = 0;
+  return 1;
+}
+
+/**
+ * 丢弃事务对象中记录的全部操作
+ * 1#:事务对象
+ */
+static int luaApi_ap_trans_reset(lua_State *L) {
+  struct ap_trans *trans = luaApi_check_ap_trans(L, 1);
+  trans->count = trans->resultCount = 0;
+  return 0;
+}
+
+/**
+ * 事务对象垃圾回收函数
+ */
+static int luaApi_ap_trans_gc(lua_State *L) {
+  struct ap_trans *trans = luaApi_check_ap_trans(L, 1);
+  log_trace("[GC] MEM-AP transaction");
+  free(trans->ops);
+  trans->ops = NULL;
+  trans->count = trans->capacity = trans->resultCount = 0;
+  return 0;
+}
+
+/**
+ * 创建MEM-AP内存缓存对象，每个AP只能有一个
+ * 新建的缓存是关闭的，需要在目标停止运行之后调用Enable(true)打开
+ * 1#:AP对象
+ * 返回:
+ * 1#:缓存对象
+ */
+static int luaApi_adiv5_ap_mem_cache(lua_State *L) {
+  AccessPort apObj = *CAST(AccessPort *, luaL_checkudata(L, 1, ADIV5_AP_MEM_LUA_OBJECT_TYPE));
+  if (apObj->type != AccessPort_Memory) {
+    return luaL_error(L, "Not a memory access port.");
+  }
+
+  MemCache *cache = CAST(MemCache *, lua_newuserdatauv(L, sizeof(MemCache), 1)); // +1
+  *cache = ADIv5_CreateMemCache(apObj);
+  if (*cache == NULL) {
+    return luaL_error(L, "Create memory cache failed!");
+  }
+
+  luaL_setmetatable(L, ADIV5_AP_MEM_CACHE_LUA_OBJECT_TYPE);
+
+  // 引用AP对象，防止被回收
+  lua_pushvalue(L, 1);         // +1
+  lua_setiuservalue(L, -2, 1); // -1
+
+  return 1;
+}
+
+/**
+ * 通过缓存读内存
+ * 1#:缓存对象
+ * 2#:要读取的地址
+ * 3#:读取的字节数
+ * 返回：
+ * 1#:读取的数据 字符串形式
+ */
+static int luaApi_mem_cache_read(lua_State *L) {
+  MemCache cache = *CAST(MemCache *, luaL_checkudata(L, 1, ADIV5_AP_MEM_CACHE_LUA_OBJECT_TYPE));
+  uint64_t addr = luaL_checkinteger(L, 2);
+  lua_Integer len = luaL_checkinteger(L, 3);
+  if (len < 0 || len > UINT32_MAX) {
+    return luaL_error(L, "Read length is illegal!");
+  }
+  uint8_t *buff = (uint8_t *)lua_newuserdata(L, len);
+  if (ADIv5_MemCacheRead(cache, addr, (unsigned int)len, buff) != ADI_SUCCESS) {
+    return luaL_error(L, "Read memory %p failed!", addr);
+  }
+  lua_pushlstring(L, CAST(const char *, buff), len);
+  return 1;
+}
+
+/**
+ * 通过缓存写内存
+ * 1#:缓存对象
+ * 2#:要写入的地址
+ * 3#:要写的数据（字符串）
+ */
+static int luaApi_mem_cache_write(lua_State *L) {
+  MemCache cache = *CAST(MemCache *, luaL_checkudata(L, 1, ADIV5_AP_MEM_CACHE_LUA_OBJECT_TYPE));
+  uint64_t addr = luaL_checkinteger(L, 2);
+  size_t len;
+  const char *data = luaL_checklstring(L, 3, &len);
+  if (ADIv5_MemCacheWrite(cache, addr, (unsigned int)len, CAST(uint8_t *, data)) != ADI_SUCCESS) {
+    return luaL_error(L, "Write memory %p failed!", addr);
+  }
+  return 0;
+}
+
+/**
+ * 打开或者关闭缓存
+ * 确认目标停止运行之后打开，恢复运行、单步或者复位之前关闭，关闭时作废所有缓存
+ * 1#:缓存对象
+ * 2#:TRUE打开，FALSE关闭
+ */
+static int luaApi_mem_cache_enable(lua_State *L) {
+  MemCache cache = *CAST(MemCache *, luaL_checkudata(L, 1, ADIV5_AP_MEM_CACHE_LUA_OBJECT_TYPE));
+  luaL_checktype(L, 2, LUA_TBOOLEAN);
+  ADIv5_MemCacheEnable(cache, lua_toboolean(L, 2) ? TRUE : FALSE);
+  return 0;
+}
+
+/**
+ * 设置地址区域的缓存策略
+ * 1#:缓存对象
+ * 2#:区域基址
+ * 3#:区域大小
+ * 4#:缓存策略 Cache_Cacheable/Cache_Volatile/Cache_Never
+ */
+static int luaApi_mem_cache_region(lua_State *L) {
+  MemCache cache = *CAST(MemCache *, luaL_checkudata(L, 1, ADIV5_AP_MEM_CACHE_LUA_OBJECT_TYPE));
+  uint64_t base = luaL_checkinteger(L, 2);
+  uint64_t size = luaL_checkinteger(L, 3);
+  int policy = (int)luaL_checkinteger(L, 4);
+  if (ADIv5_MemCacheSetRegion(cache, base, size, policy) != ADI_SUCCESS) {
+    return luaL_error(L, "Set cache region failed!");
+  }
+  return 0;
+}
+
+/**
+ * 作废缓存
+ * 目标恢复运行、单步或者复位之后调用
+ * 1#:缓存对象
+ * 2#:起始地址(Optional，不指定时作废全部缓存)
+ * 3#:长度(Optional)
+ */
+static int luaApi_mem_cache_invalidate(lua_State *L) {
+  MemCache cache = *CAST(MemCache *, luaL_checkudata(L, 1, ADIV5_AP_MEM_CACHE_LUA_OBJECT_TYPE));
+  if (lua_isnoneornil(L, 2)) {
+    ADIv5_MemCacheInvalidate(cache);
+  } else {
+    ADIv5_MemCacheInvalidateRange(cache, luaL_checkinteger(L, 2), luaL_checkinteger(L, 3));
+  }
+  return 0;
+}
+
+/**
+ * 获得缓存统计信息
+ * 1#:缓存对象
+ * 返回：
+ * 1#:命中的行数
+ * 2#:未命中的行数
+ * 3#:不经过缓存读取的字节数
+ * 4#:当前缓存的行数
+ */
+static int luaApi_mem_cache_stats(lua_State *L) {
+  MemCache cache = *CAST(MemCache *, luaL_checkudata(L, 1, ADIV5_AP_MEM_CACHE_LUA_OBJECT_TYPE));
+  struct memCacheStats stats;
+  ADIv5_MemCacheGetStats(cache, &stats);
+  lua_pushinteger(L, stats.hits);
+  lua_pushinteger(L, stats.misses);
+  lua_pushinteger(L, stats.bypass);
+  lua_pushinteger(L, stats.lines);
+  return 4;
+}
+
+/**
+ * 缓存对象垃圾回收函数
+ */
+static int luaApi_mem_cache_gc(lua_State *L) {
+  MemCache *cache = CAST(MemCache *, luaL_checkudata(L, 1, ADIV5_AP_MEM_CACHE_LUA_OBJECT_TYPE));
+  log_trace("[GC] MEM-AP cache");
+  ADIv5_DestroyMemCache(cache);
+  return 0;
+}
+
 /**
  * ADIv5垃圾回收函数
  */
@@ -355,12 +970,17 @@ static const luaApi_regConst lib_adiv5_const[] = {
     {"DataSize_64", DataSize_64},
     {"DataSize_128", DataSize_128},
     {"DataSize_256", DataSize_256},
+    // 内存缓存策略
+    {"Cache_Cacheable", MemCache_Cacheable},
+    {"Cache_Volatile", MemCache_Volatile},
+    {"Cache_Never", MemCache_Never},
     {NULL, 0}};
 
 // 模块的面向对象方法
 static const luaL_Reg lib_adiv5_oo[] = {
     // 基本函数
     {"FindAccessPort", luaApi_adiv5_find_access_port},
+    {"TopologyCache", luaApi_adiv5_topology_cache},
     {NULL, NULL}};
 
 // 模块的面向对象方法
@@ -370,20 +990,56 @@ static const luaL_Reg lib_access_port_oo[] = {
     {"CSW", luaApi_adiv5_ap_mem_csw},
     {"Abort", luaApi_adiv5_ap_mem_abort},
     {"GetCidPid", luaApi_adiv5_ap_get_pid_cid},
+    {"WalkRomTable", luaApi_adiv5_ap_walk_rom_table},
 
     {"Memory8", luaApi_adiv5_ap_mem_rw_8},
     {"Memory16", luaApi_adiv5_ap_mem_rw_16},
     {"Memory32", luaApi_adiv5_ap_mem_rw_32},
-    // TODO {"Memory64", luaApi_adiv5_find_access_port},
+    {"Memory64", luaApi_adiv5_ap_mem_rw_64},
 
     {"BlockRead", luaApi_adiv5_ap_read_mem_block},
     {"BlockWrite", luaApi_adiv5_ap_write_mem_block},
+    {"ReadMemory", luaApi_adiv5_ap_read_buffer},
+    {"WriteMemory", luaApi_adiv5_ap_write_buffer},
+    {"WindowRead", luaApi_adiv5_ap_window_read},
+    {"WindowWrite", luaApi_adiv5_ap_window_write},
+    {"Poll32", luaApi_adiv5_ap_poll_32},
+    {"Transaction", luaApi_adiv5_ap_mem_transaction},
+    {"Cache", luaApi_adiv5_ap_mem_cache},
+    {NULL, NULL}};
+
+// JTAG-AP的面向对象方法
+static const luaL_Reg lib_jtag_ap_oo[] = {
+    {"SelectPort", luaApi_adiv5_ap_jtag_select_port},
+    {"PortStatus", luaApi_adiv5_ap_jtag_port_status},
+    {"JtagSkill", luaApi_adiv5_ap_jtag_skill},
+    {NULL, NULL}};
+
+// 事务对象的面向对象方法
+static const luaL_Reg lib_ap_trans_oo[] = {
+    {"Read32", luaApi_ap_trans_read_32},
+    {"Write32", luaApi_ap_trans_write_32},
+    {"Commit", luaApi_ap_trans_commit},
+    {"Reset", luaApi_ap_trans_reset},
+    {NULL, NULL}};
+
+// 缓存对象的面向对象方法
+static const luaL_Reg lib_mem_cache_oo[] = {
+    {"Read", luaApi_mem_cache_read},
+    {"Write", luaApi_mem_cache_write},
+    {"Enable", luaApi_mem_cache_enable},
+    {"Region", luaApi_mem_cache_region},
+    {"Invalidate", luaApi_mem_cache_invalidate},
+    {"Stats", luaApi_mem_cache_stats},
     {NULL, NULL}};
 
 // 初始化ADIv5库
 int luaopen_adiv5(lua_State *L) {
   LuaApi_create_new_type(L, ADIV5_LUA_OBJECT_TYPE, luaApi_adiv5_gc, lib_adiv5_oo, NULL);
   LuaApi_create_new_type(L, ADIV5_AP_MEM_LUA_OBJECT_TYPE, NULL, lib_access_port_oo, NULL);
+  LuaApi_create_new_type(L, ADIV5_AP_JTAG_LUA_OBJECT_TYPE, NULL, lib_jtag_ap_oo, NULL);
+  LuaApi_create_new_type(L, ADIV5_AP_MEM_TRANS_LUA_OBJECT_TYPE, luaApi_ap_trans_gc, lib_ap_trans_oo, NULL);
+  LuaApi_create_new_type(L, ADIV5_AP_MEM_CACHE_LUA_OBJECT_TYPE, luaApi_mem_cache_gc, lib_mem_cache_oo, NULL);
 
   lua_createtable(L, 0, sizeof(lib_adiv5_const) / sizeof(lib_adiv5_const[0]));
   // 注册常量到模块中
@@ -0,0 +1,389 @@
+/**
+ * Copyright (c) 2023, Virus.V <virusv@live.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of SmartOCD nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * Copyright 2023 Virus.V <virusv@live.com>
+ */
+
+
+#include "Library/log/log.h"
+#include "smartocd.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "Component/ADI/ADIv5_private.h"
+
+#define CACHE_LINE_SIZE 64u                    // 缓存行大小
+#define CACHE_LINE_MASK ((uint64_t)CACHE_LINE_SIZE - 1)
+#define CACHE_HASH_BUCKETS 256u                // 哈希桶个数
+#define CACHE_MAX_LINES 4096u                  // 最多缓存的行数,256KB
+#define CACHE_MAX_FILL (CACHE_LINE_SIZE * 64u) // 一次填充的最大字节数
+
+/**
+ * 缓存行
+ */
+struct cacheLine {
+  uint64_t addr;               // 行地址,64字节对齐
+  struct hlist_node hashEntry; // 哈希桶节点
+  struct list_head lruEntry;   // LRU链表节点,表头是最近使用的行
+  uint8_t data[CACHE_LINE_SIZE];
+};
+
+/**
+ * 地址区域的缓存策略
+ */
+struct cacheRegion {
+  uint64_t base;
+  uint64_t size;
+  enum memCachePolicy policy;
+};
+
+/**
+ * 内存缓存对象
+ */
+struct memCache {
+  struct ADIv5_AccessPort *ap;                   // 所属的MEM-AP
+  struct hlist_head buckets[CACHE_HASH_BUCKETS]; // 行哈希表
+  struct list_head lru;                          // LRU链表
+  unsigned int lineCount;                        // 当前缓存的行数
+  struct cacheRegion *regions;                   // 区域策略,后设置的优先
+  unsigned int regionCount;
+  BOOL enabled;               // 调用者确认目标已经停止运行,关闭时所有读取都不经过缓存
+  struct memCacheStats stats; // 统计信息
+};
+
+/**
+ * 两个闭区间[first1, last1]和[first2, last2]是否重叠
+ * 使用区间的最后一个地址,避免区间结束于地址空间末尾时溢出
+ */
+static inline int rangeOverlap(uint64_t first1, uint64_t last1, uint64_t first2, uint64_t last2) {
+  return first1 <= last2 && first2 <= last1;
+}
+
+static inline struct hlist_head *lineBucket(struct memCache *cache, uint64_t lineAddr) {
+  return &cache->buckets[(lineAddr / CACHE_LINE_SIZE) % CACHE_HASH_BUCKETS];
+}
+
+/**
+ * 查找缓存行,命中时移动到LRU表头
+ */
+static struct cacheLine *lookupLine(struct memCache *cache, uint64_t lineAddr) {
+  struct cacheLine *line;
+  struct hlist_node *node;
+  hlist_for_each_entry(line, node, lineBucket(cache, lineAddr), hashEntry) {
+    if (line->addr == lineAddr) {
+      list_move(&line->lruEntry, &cache->lru);
+      return line;
+    }
+  }
+  return NULL;
+}
+
+static void freeLine(struct memCache *cache, struct cacheLine *line) {
+  hlist_del(&line->hashEntry);
+  list_del(&line->lruEntry);
+  free(line);
+  cache->lineCount--;
+}
+
+/**
+ * 插入缓存行,超过容量时淘汰最久没有使用的行
+ */
+static void insertLine(struct memCache *cache, uint64_t lineAddr, const uint8_t *data) {
+  struct cacheLine *line;
+  if (cache->lineCount >= CACHE_MAX_LINES) {
+    freeLine(cache, list_entry(cache->lru.prev, struct cacheLine, lruEntry));
+  }
+  line = malloc(sizeof(struct cacheLine));
+  if (line == NULL) {
+    // 只是少缓存一行,不影响正确性
+    return;
+  }
+  line->addr = lineAddr;
+  memcpy(line->data, data, CACHE_LINE_SIZE);
+  hlist_add_head(&line->hashEntry, lineBucket(cache, lineAddr));
+  list_add(&line->lruEntry, &cache->lru);
+  cache->lineCount++;
+}
+
+/**
+ * 查找地址所在区域的策略,没有设置的地址按照易变外设处理
+ * 参数:
+ * 	index:返回区域的下标,没有找到时为-1
+ */
+static enum memCachePolicy regionPolicy(struct memCache *cache, uint64_t addr, int *index) {
+  for (int i = (int)cache->regionCount - 1; i >= 0; i--) {
+    if (addr - cache->regions[i].base < cache->regions[i].size) {
+      *index = i;
+      return cache->regions[i].policy;
+    }
+  }
+  *index = -1;
+  return MemCache_Volatile;
+}
+
+/**
+ * 整行是否可以缓存
+ * 行首所在区域可缓存并且覆盖整行,而且没有优先级更高的不可缓存区域和该行重叠
+ */
+static int lineCacheable(struct memCache *cache, uint64_t lineAddr) {
+  int index;
+  uint64_t lineLast = lineAddr + CACHE_LINE_MASK;
+  if (regionPolicy(cache, lineAddr, &index) != MemCache_Cacheable) {
+    return 0;
+  }
+  if (lineLast - cache->regions[index].base >= cache->regions[index].size) {
+    return 0;
+  }
+  for (unsigned int i = index + 1; i < cache->regionCount; i++) {
+    struct cacheRegion *region = &cache->regions[i];
+    if (region->policy != MemCache_Cacheable &&
+        rangeOverlap(lineAddr, lineLast, region->base, region->base + region->size - 1)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * 创建内存缓存
+ */
+MemCache ADIv5_CreateMemCache(AccessPort ap) {
+  assert(ap != NULL);
+  struct ADIv5_AccessPort *apObj = container_of(ap, struct ADIv5_AccessPort, apApi);
+  if (ap->type != AccessPort_Memory) {
+    log_error("Not a memory access port!");
+    return NULL;
+  }
+  if (apObj->type.memory.cache != NULL) {
+    log_error("This access port already has a memory cache!");
+    return NULL;
+  }
+  struct memCache *cache = calloc(1, sizeof(struct memCache));
+  if (cache == NULL) {
+    log_error("Failed to create memory cache object!");
+    return NULL;
+  }
+  for (unsigned int i = 0; i < CACHE_HASH_BUCKETS; i++) {
+    INIT_HLIST_HEAD(&cache->buckets[i]);
+  }
+  INIT_LIST_HEAD(&cache->lru);
+  cache->ap = apObj;
+  apObj->type.memory.cache = cache;
+  return cache;
+}
+
+/**
+ * 销毁内存缓存
+ */
+void ADIv5_DestroyMemCache(MemCache *cache) {
+  assert(cache != NULL && *cache != NULL);
+  ADIv5_MemCacheInvalidate(*cache);
+  (*cache)->ap->type.memory.cache = NULL;
+  free((*cache)->regions);
+  free(*cache);
+  *cache = NULL;
+}
+
+/**
+ * 打开或者关闭缓存
+ * 关闭时作废所有缓存行
+ */
+void ADIv5_MemCacheEnable(MemCache cache, BOOL enable) {
+  assert(cache != NULL);
+  if (!enable) {
+    ADIv5_MemCacheInvalidate(cache);
+  }
+  cache->enabled = enable;
+}
+
+/**
+ * 设置区域的缓存策略
+ */
+int ADIv5_MemCacheSetRegion(MemCache cache, uint64_t base, uint64_t size, enum memCachePolicy policy) {
+  assert(cache != NULL);
+  struct cacheRegion *regions;
+  if (size == 0 || policy < MemCache_Cacheable || policy > MemCache_Never) {
+    return ADI_ERR_BAD_PARAMETER;
+  }
+  regions = realloc(cache->regions, (cache->regionCount + 1) * sizeof(struct cacheRegion));
+  if (regions == NULL) {
+    log_error("Failed to alloc cache region!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  cache->regions = regions;
+  cache->regions[cache->regionCount].base = base;
+  cache->regions[cache->regionCount].size = size;
+  cache->regions[cache->regionCount].policy = policy;
+  cache->regionCount++;
+  // 策略改变之后,已经缓存的行可能不再可以缓存
+  ADIv5_MemCacheInvalidateRange(cache, base, size);
+  return ADI_SUCCESS;
+}
+
+/**
+ * 作废所有缓存行
+ */
+void ADIv5_MemCacheInvalidate(MemCache cache) {
+  assert(cache != NULL);
+  struct cacheLine *line, *tmp;
+  list_for_each_entry_safe(line, tmp, &cache->lru, lruEntry) {
+    freeLine(cache, line);
+  }
+}
+
+/**
+ * 作废和指定范围重叠的缓存行
+ */
+void ADIv5_MemCacheInvalidateRange(MemCache cache, uint64_t addr, uint64_t len) {
+  assert(cache != NULL);
+  struct cacheLine *line, *tmp;
+  if (len == 0) {
+    return;
+  }
+  // 范围比缓存的行多时遍历LRU链表更快
+  if (len / CACHE_LINE_SIZE >= cache->lineCount) {
+    list_for_each_entry_safe(line, tmp, &cache->lru, lruEntry) {
+      if (rangeOverlap(line->addr, line->addr + CACHE_LINE_MASK, addr, addr + len - 1)) {
+        freeLine(cache, line);
+      }
+    }
+    return;
+  }
+  uint64_t lastLine = (addr + len - 1) & ~CACHE_LINE_MASK;
+  for (uint64_t lineAddr = addr & ~CACHE_LINE_MASK;; lineAddr += CACHE_LINE_SIZE) {
+    if ((line = lookupLine(cache, lineAddr)) != NULL) {
+      freeLine(cache, line);
+    }
+    if (lineAddr == lastLine) {
+      break;
+    }
+  }
+}
+
+/**
+ * MEM-AP写内存时的通知
+ * 写入易变外设区域(例如内核调试控制寄存器、Flash控制器)可能改变其他内存的内容,
+ * 或者使内核恢复运行、单步、复位,此时作废所有缓存行;否则只作废重叠的行
+ */
+void ADIv5_MemCacheWriteNotify(MemCache cache, uint64_t addr, uint64_t len) {
+  assert(cache != NULL);
+  int index;
+  if (len == 0) {
+    return;
+  }
+  if (regionPolicy(cache, addr, &index) == MemCache_Volatile ||
+      regionPolicy(cache, addr + len - 1, &index) == MemCache_Volatile) {
+    ADIv5_MemCacheInvalidate(cache);
+    return;
+  }
+  for (unsigned int i = 0; i < cache->regionCount; i++) {
+    struct cacheRegion *region = &cache->regions[i];
+    if (region->policy == MemCache_Volatile &&
+        rangeOverlap(addr, addr + len - 1, region->base, region->base + region->size - 1)) {
+      ADIv5_MemCacheInvalidate(cache);
+      return;
+    }
+  }
+  ADIv5_MemCacheInvalidateRange(cache, addr, len);
+}
+
+/**
+ * 通过缓存读内存
+ * 缓存关闭时直接读取目标;
+ * 命中的行直接从缓存复制,连续缺失的可缓存行和连续的不可缓存行各自合并为一次读取
+ */
+int ADIv5_MemCacheRead(MemCache cache, uint64_t addr, unsigned int len, uint8_t *buff) {
+  assert(cache != NULL && buff != NULL);
+  AccessPort ap = &cache->ap->apApi;
+  uint64_t pos = addr, end = addr + len, lineAddr, chunkEnd;
+  struct cacheLine *line;
+  if (!cache->enabled) {
+    cache->stats.bypass += len;
+    return ap->Interface.Memory.ReadBuffer(ap, addr, DataSize_32, len, buff) == ADI_SUCCESS ? ADI_SUCCESS : ADI_FAILED;
+  }
+  while (pos < end) {
+    lineAddr = pos & ~CACHE_LINE_MASK;
+    chunkEnd = lineAddr + CACHE_LINE_SIZE < end ? lineAddr + CACHE_LINE_SIZE : end;
+    if (!lineCacheable(cache, lineAddr)) {
+      while (chunkEnd < end && !lineCacheable(cache, chunkEnd)) {
+        chunkEnd = chunkEnd + CACHE_LINE_SIZE < end ? chunkEnd + CACHE_LINE_SIZE : end;
+      }
+      cache->stats.bypass += chunkEnd - pos;
+      if (ap->Interface.Memory.ReadBuffer(ap, pos, DataSize_32, chunkEnd - pos, buff + (pos - addr)) != ADI_SUCCESS) {
+        return ADI_FAILED;
+      }
+    } else if ((line = lookupLine(cache, lineAddr)) != NULL) {
+      cache->stats.hits++;
+      memcpy(buff + (pos - addr), line->data + (pos - lineAddr), chunkEnd - pos);
+    } else {
+      uint64_t fillEnd = lineAddr + CACHE_LINE_SIZE;
+      uint8_t *fill;
+      while (fillEnd < end && fillEnd - lineAddr < CACHE_MAX_FILL && lineCacheable(cache, fillEnd) &&
+             lookupLine(cache, fillEnd) == NULL) {
+        fillEnd += CACHE_LINE_SIZE;
+      }
+      fill = malloc(fillEnd - lineAddr);
+      if (fill == NULL) {
+        log_error("Failed to alloc cache fill buffer!");
+        return ADI_ERR_INTERNAL_ERROR;
+      }
+      if (ap->Interface.Memory.ReadBuffer(ap, lineAddr, DataSize_32, fillEnd - lineAddr, fill) != ADI_SUCCESS) {
+        free(fill);
+        return ADI_FAILED;
+      }
+      for (uint64_t fillAddr = lineAddr; fillAddr < fillEnd; fillAddr += CACHE_LINE_SIZE) {
+        insertLine(cache, fillAddr, fill + (fillAddr - lineAddr));
+        cache->stats.misses++;
+      }
+      chunkEnd = fillEnd < end ? fillEnd : end;
+      memcpy(buff + (pos - addr), fill + (pos - lineAddr), chunkEnd - pos);
+      free(fill);
+    }
+    pos = chunkEnd;
+  }
+  return ADI_SUCCESS;
+}
+
+/**
+ * 通过缓存写内存
+ * 直接写入目标,缓存行由MEM-AP的写通知作废
+ */
+int ADIv5_MemCacheWrite(MemCache cache, uint64_t addr, unsigned int len, uint8_t *buff) {
+  assert(cache != NULL && buff != NULL);
+  AccessPort ap = &cache->ap->apApi;
+  return ap->Interface.Memory.WriteBuffer(ap, addr, DataSize_32, len, buff);
+}
+
+/**
+ * 获得统计信息
+ */
+void ADIv5_MemCacheGetStats(MemCache cache, struct memCacheStats *stats) {
+  assert(cache != NULL && stats != NULL);
+  *stats = cache->stats;
+  stats->lines = cache->lineCount;
+}
@@ -0,0 +1,569 @@
+/**
+ * Copyright (c) 2023, Virus.V <virusv@live.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of SmartOCD nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * Copyright 2023 Virus.V <virusv@live.com>
+ */
+
+
+#include "Library/log/log.h"
+#include "Library/misc/bitstream.h"
+#include "Library/misc/misc.h"
+#include "smartocd.h"
+#include <stdlib.h>
+#include <string.h>
+
+#include "Component/ADI/ADIv5_private.h"
+
+#define JTAG_AP_OBJ_FROM_SKILL(skill) container_of((skill), struct ADIv5_AccessPort, type.jtag.skillApi)
+
+// JTAG指令类型
+enum jtagApInstrType {
+  JTAG_AP_INS_TO_STATE,      // 状态机切换
+  JTAG_AP_INS_EXCHANGE_DATA, // 交换TDI和TDO
+  JTAG_AP_INS_IDLE_WAIT,     // Idle等待
+};
+
+// JTAG指令对象
+struct jtagApCommand {
+  enum jtagApInstrType type;   // JTAG指令类型
+  struct list_head list_entry; // JTAG指令链表对象
+  union {
+    enum JTAG_TAP_State toState; // 目标状态
+    struct {
+      uint8_t *data;         // 需要交换的数据地址
+      unsigned int bitCount; // 交换的二进制位个数
+    } exchangeData;
+    unsigned int clkCount; // Idle等待的时钟个数
+  } instr;
+};
+
+/**
+ * JTAG引擎的命令字节流
+ * tdoSrc记录每个TDO字节对应的TDI字节在流中的位置,JTAG引擎消耗该字节之后才会产生这个TDO字节
+ */
+struct jtagApStream {
+  uint8_t *data;         // 命令字节
+  unsigned int len, cap; // 长度和容量
+  unsigned int *tdoSrc;  // 每个TDO字节对应的TDI字节位置
+  unsigned int tdoLen;   // TDO字节个数
+  uint32_t tmsBits;      // 还没有打包的TMS位
+  unsigned int tmsCount; // 还没有打包的TMS位数
+};
+
+static int streamPush(struct jtagApStream *stream, uint8_t byte) {
+  if (stream->len == stream->cap) {
+    unsigned int newCap = stream->cap ? stream->cap << 1 : 64;
+    uint8_t *newData = realloc(stream->data, newCap);
+    if (newData == NULL) {
+      log_error("Failed to alloc JTAG-AP command buffer!");
+      return ADPT_ERR_INTERNAL_ERROR;
+    }
+    stream->data = newData;
+    stream->cap = newCap;
+  }
+  stream->data[stream->len++] = byte;
+  return ADPT_SUCCESS;
+}
+
+/**
+ * 把TMS位打包成TMS包
+ * 参数:
+ * 	all:是否把不足一个包的TMS位也打包
+ */
+static int streamFlushTms(struct jtagApStream *stream, int all) {
+  while (stream->tmsCount >= JTAG_AP_TMS_MAX_BITS || (all && stream->tmsCount > 0)) {
+    unsigned int bits = stream->tmsCount < JTAG_AP_TMS_MAX_BITS ? stream->tmsCount : JTAG_AP_TMS_MAX_BITS;
+    uint8_t packet = JTAG_AP_TMS_PACKET | (1u << bits) | (stream->tmsBits & ((1u << bits) - 1));
+    if (streamPush(stream, packet) != ADPT_SUCCESS) {
+      return ADPT_ERR_INTERNAL_ERROR;
+    }
+    stream->tmsBits >>= bits;
+    stream->tmsCount -= bits;
+  }
+  return ADPT_SUCCESS;
+}
+
+/**
+ * 加入TMS位,低位先发
+ */
+static int streamAddTms(struct jtagApStream *stream, uint32_t tms, unsigned int count) {
+  assert(count <= 8);
+  stream->tmsBits |= tms << stream->tmsCount;
+  stream->tmsCount += count;
+  return streamFlushTms(stream, 0);
+}
+
+/**
+ * 加入TDI_TDO包,捕获TDO
+ * 超过32768位的数据拆分成多个包,只有最后一个包的最后一位TMS=1
+ */
+static int streamAddTdi(struct jtagApStream *stream, const uint8_t *data, unsigned int bitCount) {
+  if (streamFlushTms(stream, 1) != ADPT_SUCCESS) {
+    return ADPT_ERR_INTERNAL_ERROR;
+  }
+  for (unsigned int offset = 0; offset < bitCount; offset += JTAG_AP_TDI_MAX_BITS) {
+    unsigned int len = bitCount - offset < JTAG_AP_TDI_MAX_BITS ? bitCount - offset : JTAG_AP_TDI_MAX_BITS;
+    unsigned int bytes = (len + 7) >> 3, n = len - 1;
+    int ret = streamPush(stream, JTAG_AP_TDI_RTDO | (offset + len == bitCount ? JTAG_AP_TDI_UTMS : 0));
+    // 长度减1,小于128时用1个字节,否则用2个字节,第一个字节的bit7表示还有第二个字节
+    if (n < 128) {
+      ret |= streamPush(stream, n);
+    } else {
+      ret |= streamPush(stream, 0x80 | (n & 0x7F));
+      ret |= streamPush(stream, n >> 7);
+    }
+    for (unsigned int i = 0; i < bytes && ret == ADPT_SUCCESS; i++) {
+      uint8_t byte = data[(offset >> 3) + i];
+      if (i == bytes - 1 && (len & 0x7)) {
+        byte &= (1u << (len & 0x7)) - 1;
+      }
+      ret = streamPush(stream, byte);
+      stream->tdoSrc[stream->tdoLen++] = stream->len - 1;
+    }
+    if (ret != ADPT_SUCCESS) {
+      return ADPT_ERR_INTERNAL_ERROR;
+    }
+  }
+  return ADPT_SUCCESS;
+}
+
+/**
+ * 把指令队列转换成JTAG引擎的命令字节流
+ * 参数:
+ * 	endState:执行之后JTAG状态机的状态
+ */
+static int jtagApBuildStream(struct ADIv5_AccessPort *ap, struct jtagApStream *stream, enum JTAG_TAP_State *endState) {
+  enum JTAG_TAP_State tempState = ap->type.jtag.skillApi.currState;
+  struct jtagApCommand *cmd;
+  unsigned int tdoBytes = 0;
+
+  list_for_each_entry(cmd, &ap->type.jtag.queue, list_entry) {
+    if (cmd->type == JTAG_AP_INS_EXCHANGE_DATA) {
+      tdoBytes += (cmd->instr.exchangeData.bitCount + 7) >> 3;
+    }
+  }
+  stream->tdoSrc = malloc((tdoBytes ? tdoBytes : 1) * sizeof(unsigned int));
+  if (stream->tdoSrc == NULL) {
+    log_error("Failed to alloc JTAG-AP TDO buffer!");
+    return ADPT_ERR_INTERNAL_ERROR;
+  }
+
+  list_for_each_entry(cmd, &ap->type.jtag.queue, list_entry) {
+    switch (cmd->type) {
+    case JTAG_AP_INS_TO_STATE:
+      if (cmd->instr.toState != tempState) {
+        TMS_SeqInfo tmsSeq = JtagGetTmsSequence(tempState, cmd->instr.toState);
+        if (streamAddTms(stream, tmsSeq >> 8, tmsSeq & 0xff) != ADPT_SUCCESS) {
+          return ADPT_ERR_INTERNAL_ERROR;
+        }
+        tempState = cmd->instr.toState;
+      }
+      break;
+    case JTAG_AP_INS_EXCHANGE_DATA:
+      if (tempState != JTAG_TAP_DRSHIFT && tempState != JTAG_TAP_IRSHIFT) {
+        log_error("Current TAP status is not JTAG_TAP_DRSHIFT or JTAG_TAP_IRSHIFT!");
+        return ADPT_FAILED;
+      }
+      if (cmd->instr.exchangeData.bitCount == 0) {
+        break;
+      }
+      if (streamAddTdi(stream, cmd->instr.exchangeData.data, cmd->instr.exchangeData.bitCount) != ADPT_SUCCESS) {
+        return ADPT_ERR_INTERNAL_ERROR;
+      }
+      // 最后一位TMS=1,SHIFT-xR跳转到EXIT1-xR
+      tempState++;
+      break;
+    case JTAG_AP_INS_IDLE_WAIT:
+      if (tempState != JTAG_TAP_IDLE) {
+        log_error("Current TAP status is not JTAG_TAP_IDLE!");
+        return ADPT_FAILED;
+      }
+      for (unsigned int n = cmd->instr.clkCount; n > 0;) {
+        unsigned int bits = n < 8 ? n : 8;
+        if (streamAddTms(stream, 0, bits) != ADPT_SUCCESS) {
+          return ADPT_ERR_INTERNAL_ERROR;
+        }
+        n -= bits;
+      }
+      break;
+    }
+  }
+  if (streamFlushTms(stream, 1) != ADPT_SUCCESS) {
+    return ADPT_ERR_INTERNAL_ERROR;
+  }
+  *endState = tempState;
+  return ADPT_SUCCESS;
+}
+
+/**
+ * 把命令字节流写入BFIFO,并读取TDO
+ * 写FIFO和读FIFO都只有4个字节,FIFO满时AP访问会被阻塞,所以每写入一个字的命令之后
+ * 立即读出这些命令产生的全部TDO字节,保证JTAG引擎不会因为读FIFO满而停止消耗写FIFO。
+ * 连续不产生TDO的整字通过一次MultiWrite写入BFIFO4
+ * 参数:
+ * 	words:按字打包的命令字节流,执行完成之前必须保持可访问
+ * 	tdoWords:每次读BFIFO得到的数据
+ * 	tdoCounts:每次读BFIFO的字节数
+ * 返回:
+ * 	读BFIFO的次数
+ */
+static unsigned int jtagApQueueStream(struct ADIv5_AccessPort *ap, const struct jtagApStream *stream, uint32_t *words,
+                                      uint32_t *tdoWords, uint8_t *tdoCounts) {
+  DapSkill skillObj = ap->dap->skillObj;
+  unsigned int written = 0, tdoRead = 0, reads = 0;
+
+  while (written < stream->len) {
+    unsigned int remain = stream->len - written;
+    if (remain >= 4) {
+      // 计算不产生TDO的连续整字个数,最后一个字可以产生TDO
+      unsigned int count = 1;
+      while (written + (count + 1) * 4 <= stream->len &&
+             (tdoRead >= stream->tdoLen || stream->tdoSrc[tdoRead] >= written + count * 4)) {
+        count++;
+      }
+      if (count > 1) {
+        skillObj->MultiWrite(skillObj, SKILL_DAP_AP_REG, JTAG_AP_REG_BFIFO4, count, words + (written >> 2));
+      } else {
+        skillObj->SingleWrite(skillObj, SKILL_DAP_AP_REG, JTAG_AP_REG_BFIFO4, words[written >> 2]);
+      }
+      written += count * 4;
+    } else {
+      // 尾部不足一个字,BFIFOn一次写入n个字节
+      skillObj->SingleWrite(skillObj, SKILL_DAP_AP_REG, JTAG_AP_REG_BFIFO1 + ((remain - 1) << 2), words[written >> 2]);
+      written += remain;
+    }
+    // 读出已写入的命令产生的TDO
+    while (tdoRead < stream->tdoLen && stream->tdoSrc[tdoRead] < written) {
+      unsigned int n = 1;
+      while (n < 4 && tdoRead + n < stream->tdoLen && stream->tdoSrc[tdoRead + n] < written) {
+        n++;
+      }
+      skillObj->SingleRead(skillObj, SKILL_DAP_AP_REG, JTAG_AP_REG_BFIFO1 + ((n - 1) << 2), &tdoWords[reads]);
+      tdoCounts[reads++] = n;
+      tdoRead += n;
+    }
+  }
+  return reads;
+}
+
+/**
+ * 执行JTAG指令队列
+ * 整个队列转换成JTAG引擎的命令之后,通过一次DAP Commit执行
+ */
+static int jtagApCommit(JtagSkill self) {
+  struct ADIv5_AccessPort *ap = JTAG_AP_OBJ_FROM_SKILL(self);
+  struct ADIv5_Dap *dap = ap->dap;
+  struct jtagApStream stream;
+  struct jtagApCommand *cmd, *cmd_t;
+  enum JTAG_TAP_State endState;
+  ADIv5_DpSelectRegister selectTmp = dap->select;
+  uint32_t *words = NULL, *tdoWords = NULL, psta = 0;
+  uint8_t *tdoCounts = NULL, *tdo = NULL;
+  unsigned int reads, tdoOffset = 0;
+  int ret = ADPT_ERR_INTERNAL_ERROR;
+
+  memset(&stream, 0, sizeof(stream));
+  if (list_empty(&ap->type.jtag.queue)) {
+    return ADPT_SUCCESS;
+  }
+  ret = jtagApBuildStream(ap, &stream, &endState);
+  if (ret != ADPT_SUCCESS) {
+    goto EXIT;
+  }
+  ret = ADPT_ERR_INTERNAL_ERROR;
+  words = calloc((stream.len >> 2) + 1, sizeof(uint32_t));
+  tdoWords = calloc(stream.tdoLen + 1, sizeof(uint32_t));
+  tdoCounts = calloc(stream.tdoLen + 1, sizeof(uint8_t));
+  tdo = calloc(stream.tdoLen + 1, sizeof(uint8_t));
+  if (words == NULL || tdoWords == NULL || tdoCounts == NULL || tdo == NULL) {
+    log_error("Failed to alloc JTAG-AP transfer buffer!");
+    goto EXIT;
+  }
+  // 命令字节低位在前打包成字
+  for (unsigned int i = 0; i < stream.len; i++) {
+    words[i >> 2] |= (uint32_t)stream.data[i] << ((i & 0x3) << 3);
+  }
+  // BFIFO位于bank 1
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x1);
+  reads = jtagApQueueStream(ap, &stream, words, tdoWords, tdoCounts);
+  // 读PSTA,检查端口在执行过程中是否断开
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x0);
+  dap->skillObj->SingleRead(dap->skillObj, SKILL_DAP_AP_REG, JTAG_AP_REG_PSTA, &psta);
+  if (dap->skillObj->Commit(dap->skillObj) != ADPT_SUCCESS) {
+    // 清理指令队列
+    dap->skillObj->Cancel(dap->skillObj);
+    log_error("Execute JTAG-AP command failed!");
+    goto EXIT;
+  }
+  dap->select = selectTmp;
+  if (psta & ap->type.jtag.portSel) {
+    log_error("JTAG-AP port disconnected, PSTA:0x%02X.", psta);
+    ret = ADPT_FAILED;
+    goto EXIT;
+  }
+  // 拆分TDO字节
+  for (unsigned int i = 0, n = 0; i < reads; i++) {
+    for (unsigned int b = 0; b < tdoCounts[i]; b++) {
+      tdo[n++] = (tdoWords[i] >> (b << 3)) & 0xFF;
+    }
+  }
+  // 同步数据,删除执行成功的指令
+  list_for_each_entry_safe(cmd, cmd_t, &ap->type.jtag.queue, list_entry) {
+    if (cmd->type == JTAG_AP_INS_EXCHANGE_DATA) {
+      bitstream_Copy(cmd->instr.exchangeData.data, 0, tdo + tdoOffset, 0, cmd->instr.exchangeData.bitCount);
+      tdoOffset += (cmd->instr.exchangeData.bitCount + 7) >> 3;
+    }
+    list_del(&cmd->list_entry);
+    free(cmd);
+  }
+  // 更新当前TAP状态机
+  INTERFACE_CONST_INIT(enum JTAG_TAP_State, ap->type.jtag.skillApi.currState, endState);
+  ret = ADPT_SUCCESS;
+EXIT:
+  free(stream.data);
+  free(stream.tdoSrc);
+  free(words);
+  free(tdoWords);
+  free(tdoCounts);
+  free(tdo);
+  return ret;
+}
+
+// 创建新的JTAG指令对象，并将其插入JTAG指令队列尾部
+static struct jtagApCommand *newJtagApCommand(struct ADIv5_AccessPort *ap, enum jtagApInstrType type) {
+  struct jtagApCommand *command = calloc(1, sizeof(struct jtagApCommand));
+  if (command == NULL) {
+    log_error("Failed to create a new JTAG Command object.");
+    return NULL;
+  }
+  command->type = type;
+  list_add_tail(&command->list_entry, &ap->type.jtag.queue);
+  return command;
+}
+
+/**
+ * 交换TDI和TDO的数据，在传输完成后会自动将状态机从SHIFT-xR跳转到EXIT1-xR
+ */
+static int jtagApExchangeData(JtagSkill self, uint8_t *data, unsigned int bitCount) {
+  struct jtagApCommand *command = newJtagApCommand(JTAG_AP_OBJ_FROM_SKILL(self), JTAG_AP_INS_EXCHANGE_DATA);
+  if (command == NULL) {
+    return ADPT_ERR_INTERNAL_ERROR;
+  }
+  command->instr.exchangeData.data = data;
+  command->instr.exchangeData.bitCount = bitCount;
+  return ADPT_SUCCESS;
+}
+
+/**
+ * JTAG Idle
+ */
+static int jtagApIdle(JtagSkill self, unsigned int clkCount) {
+  struct jtagApCommand *command = newJtagApCommand(JTAG_AP_OBJ_FROM_SKILL(self), JTAG_AP_INS_IDLE_WAIT);
+  if (command == NULL) {
+    return ADPT_ERR_INTERNAL_ERROR;
+  }
+  command->instr.clkCount = clkCount;
+  return ADPT_SUCCESS;
+}
+
+/**
+ * JTAG to state
+ */
+static int jtagApToState(JtagSkill self, enum JTAG_TAP_State toState) {
+  struct jtagApCommand *command = newJtagApCommand(JTAG_AP_OBJ_FROM_SKILL(self), JTAG_AP_INS_TO_STATE);
+  if (command == NULL) {
+    return ADPT_ERR_INTERNAL_ERROR;
+  }
+  command->instr.toState = toState;
+  return ADPT_SUCCESS;
+}
+
+/**
+ * JTAG Clean pending
+ */
+static int jtagApCancel(JtagSkill self) {
+  ADIv5_JtagApRelease(JTAG_AP_OBJ_FROM_SKILL(self));
+  return ADPT_SUCCESS;
+}
+
+/**
+ * 读写JTAG引脚
+ * JTAG-AP只能通过CSW的TRST_OUT和SRST_OUT控制选中端口的nTRST和nRESET，
+ * 引脚为低电平表示复位有效
+ */
+static int jtagApPins(JtagSkill self, uint8_t pinMask, uint8_t pinDataOut, uint8_t *pinDataIn, unsigned int pinWait) {
+  struct ADIv5_AccessPort *ap = JTAG_AP_OBJ_FROM_SKILL(self);
+  struct ADIv5_Dap *dap = ap->dap;
+  ADIv5_DpSelectRegister selectTmp = dap->select;
+  uint32_t csw = ap->type.jtag.csw;
+
+  if (pinMask & ~(JTAG_PIN_nTRST | JTAG_PIN_nRESET)) {
+    log_warn("JTAG-AP can only drive nTRST and nRESET.");
+    return ADPT_ERR_UNSUPPORT;
+  }
+  if (pinMask & JTAG_PIN_nTRST) {
+    csw = (pinDataOut & JTAG_PIN_nTRST) ? csw & ~JTAG_AP_CSW_TRST_OUT : csw | JTAG_AP_CSW_TRST_OUT;
+  }
+  if (pinMask & JTAG_PIN_nRESET) {
+    csw = (pinDataOut & JTAG_PIN_nRESET) ? csw & ~JTAG_AP_CSW_SRST_OUT : csw | JTAG_AP_CSW_SRST_OUT;
+  }
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x0);
+  if (csw != ap->type.jtag.csw) {
+    dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_AP_REG, JTAG_AP_REG_CSW, csw);
+  }
+  if (dap->skillObj->Commit(dap->skillObj) != ADPT_SUCCESS) {
+    // 清理指令队列
+    dap->skillObj->Cancel(dap->skillObj);
+    log_error("Write JTAG-AP CSW register failed!");
+    return ADPT_ERR_INTERNAL_ERROR;
+  }
+  dap->select = selectTmp;
+  ap->type.jtag.csw = csw;
+  if (pinWait > 0) {
+    msleep((pinWait + 999) / 1000);
+  }
+  if (pinDataIn != NULL) {
+    *pinDataIn = ((csw & JTAG_AP_CSW_TRST_OUT) ? 0 : JTAG_PIN_nTRST) | ((csw & JTAG_AP_CSW_SRST_OUT) ? 0 : JTAG_PIN_nRESET);
+  }
+  return ADPT_SUCCESS;
+}
+
+/**
+ * 选择JTAG端口
+ */
+static int jtagApSelectPort(AccessPort self, unsigned int port) {
+  assert(self != NULL);
+  struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
+  struct ADIv5_Dap *dap = ap->dap;
+  ADIv5_DpSelectRegister selectTmp = dap->select;
+  uint32_t csw = 0;
+
+  if (self->type != AccessPort_JTAG) {
+    log_error("Not a JTAG access port!");
+    return ADI_ERR_BAD_PARAMETER;
+  }
+  if (port > 7) {
+    log_error("Invalid JTAG-AP port %d!", port);
+    return ADI_ERR_BAD_PARAMETER;
+  }
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x0);
+  dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_AP_REG, JTAG_AP_REG_PORTSEL, 1u << port);
+  // 清除该端口的PSTA
+  dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_AP_REG, JTAG_AP_REG_PSTA, 1u << port);
+  // 5个TMS=1,进入Test-Logic-Reset
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x1);
+  dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_AP_REG, JTAG_AP_REG_BFIFO1,
+                             JTAG_AP_TMS_PACKET | (1u << JTAG_AP_TMS_MAX_BITS) | ((1u << JTAG_AP_TMS_MAX_BITS) - 1));
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x0);
+  dap->skillObj->SingleRead(dap->skillObj, SKILL_DAP_AP_REG, JTAG_AP_REG_CSW, &csw);
+  if (dap->skillObj->Commit(dap->skillObj) != ADPT_SUCCESS) {
+    // 清理指令队列
+    dap->skillObj->Cancel(dap->skillObj);
+    log_error("Select JTAG-AP port failed!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  dap->select = selectTmp;
+  ap->type.jtag.csw = csw;
+  ap->type.jtag.portSel = 1u << port;
+  INTERFACE_CONST_INIT(enum JTAG_TAP_State, ap->type.jtag.skillApi.currState, JTAG_TAP_RESET);
+  if ((csw & JTAG_AP_CSW_PORTCONNECTED) == 0) {
+    log_warn("JTAG-AP port %d is not connected.", port);
+    return ADI_FAILED;
+  }
+  return ADI_SUCCESS;
+}
+
+/**
+ * 读取并清除PSTA
+ */
+static int jtagApPortStatus(AccessPort self, uint8_t *status) {
+  assert(self != NULL && status != NULL);
+  struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
+  struct ADIv5_Dap *dap = ap->dap;
+  ADIv5_DpSelectRegister selectTmp = dap->select;
+  uint32_t psta = 0;
+
+  if (self->type != AccessPort_JTAG) {
+    log_error("Not a JTAG access port!");
+    return ADI_ERR_BAD_PARAMETER;
+  }
+  ADIv5_ApSelectBank(ap, &selectTmp, 0x0);
+  dap->skillObj->SingleRead(dap->skillObj, SKILL_DAP_AP_REG, JTAG_AP_REG_PSTA, &psta);
+  if (dap->skillObj->Commit(dap->skillObj) != ADPT_SUCCESS) {
+    // 清理指令队列
+    dap->skillObj->Cancel(dap->skillObj);
+    log_error("Read JTAG-AP PSTA register failed!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  dap->select = selectTmp;
+  if (psta & 0xFF) {
+    // 写1清除
+    dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_AP_REG, JTAG_AP_REG_PSTA, psta & 0xFF);
+    if (dap->skillObj->Commit(dap->skillObj) != ADPT_SUCCESS) {
+      // 清理指令队列
+      dap->skillObj->Cancel(dap->skillObj);
+      log_error("Clear JTAG-AP PSTA register failed!");
+      return ADI_ERR_INTERNAL_ERROR;
+    }
+  }
+  *status = psta & 0xFF;
+  return ADI_SUCCESS;
+}
+
+/**
+ * 初始化JTAG-AP
+ */
+void ADIv5_JtagApInit(struct ADIv5_AccessPort *ap) {
+  assert(ap != NULL);
+  INIT_LIST_HEAD(&ap->type.jtag.queue);
+  INIT_LIST_HEAD(&ap->type.jtag.skillApi.header.skills);
+  ap->type.jtag.skillApi.header.type = ADPT_SKILL_JTAG;
+  INTERFACE_CONST_INIT(enum JTAG_TAP_State, ap->type.jtag.skillApi.currState, JTAG_TAP_RESET);
+  ap->type.jtag.skillApi.Pins = jtagApPins;
+  ap->type.jtag.skillApi.ExchangeData = jtagApExchangeData;
+  ap->type.jtag.skillApi.Idle = jtagApIdle;
+  ap->type.jtag.skillApi.ToState = jtagApToState;
+  ap->type.jtag.skillApi.Commit = jtagApCommit;
+  ap->type.jtag.skillApi.Cancel = jtagApCancel;
+
+  INTERFACE_CONST_INIT(JtagSkill, ap->apApi.Interface.Jtag.Skill, &ap->type.jtag.skillApi);
+  ap->apApi.Interface.Jtag.SelectPort = jtagApSelectPort;
+  ap->apApi.Interface.Jtag.PortStatus = jtagApPortStatus;
+}
+
+/**
+ * 释放未执行的JTAG指令
+ */
+void ADIv5_JtagApRelease(struct ADIv5_AccessPort *ap) {
+  assert(ap != NULL);
+  struct jtagApCommand *cmd, *cmd_t;
+  list_for_each_entry_safe(cmd, cmd_t, &ap->type.jtag.queue, list_entry) {
+    list_del(&cmd->list_entry);
+    free(cmd);
+  }
+}
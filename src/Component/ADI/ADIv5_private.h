@@ -72,6 +72,10 @@
 #define DP_STAT_CDBGPWRUPACK 0x20000000 // Debug Power-up Acknowledge
 #define DP_CTRL_CSYSPWRUPREQ 0x40000000 // System Power-up Request
 #define DP_STAT_CSYSPWRUPACK 0x80000000 // System Power-up Acknowledge
+// CTRL/STAT中的状态位，JTAG-DP上粘滞标志写1清除，其余为只读
+#define DP_STAT_MASK                                                                                           \
+  (DP_STAT_STICKYORUN | DP_STAT_STICKYCMP | DP_STAT_STICKYERR | DP_STAT_READOK | DP_STAT_WDATAERR |            \
+   DP_STAT_CDBGRSTACK | DP_STAT_CDBGPWRUPACK | DP_STAT_CSYSPWRUPACK)
 
 // Debug Select Register definitions
 #define DP_SELECT_CTRLSELMSK 0x00000001   // CTRLSEL (SW Only)
@@ -102,6 +106,22 @@
 #define AP_CSW_MSTRDBG 0x20000000     // Master Type: Debug
 #define AP_CSW_RESERVED 0x01000000    // Reserved Value
 
+// JTAG-AP Control and Status Word definitions
+#define JTAG_AP_CSW_SRST_OUT 0x00000001      // 驱动SRST输出
+#define JTAG_AP_CSW_TRST_OUT 0x00000002      // 驱动TRST输出
+#define JTAG_AP_CSW_SRSTCONNECTED 0x00000004 // 选中端口的SRST已连接
+#define JTAG_AP_CSW_PORTCONNECTED 0x00000008 // 选中端口已连接并上电
+#define JTAG_AP_CSW_RFIFOCNT 0x07000000      // 读FIFO中的字节数
+#define JTAG_AP_CSW_WFIFOCNT 0x70000000      // 写FIFO中的字节数
+#define JTAG_AP_CSW_SERACTV 0x80000000       // JTAG引擎正在工作
+
+// JTAG引擎的命令字节
+#define JTAG_AP_TMS_PACKET 0x80  // TMS包,[5:0]中最高的1为结束标记,之下的位是低位先发的TMS
+#define JTAG_AP_TMS_MAX_BITS 5   // 每个TMS包最多的TMS位数
+#define JTAG_AP_TDI_RTDO 0x40    // TDI_TDO包:捕获TDO到读FIFO
+#define JTAG_AP_TDI_UTMS 0x20    // TDI_TDO包:最后一位TMS=1,离开SHIFT状态
+#define JTAG_AP_TDI_MAX_BITS 32768 // 每个TDI_TDO包最多的位数,长度为1字节(<=128位)或者2字节
+
 #define AP_CFG_LARGE_DATA 0x4
 #define AP_CFG_LARGE_ADDRESS 0x2
 #define AP_CFG_BIG_ENDIAN 0x1
@@ -166,14 +186,17 @@ typedef union {
 } ADIv5_DpCtrlStatRegister;
 
 // SELECT寄存器解析
-typedef union {
-  uint32_t regData;
-  struct {
-    uint32_t DP_BankSel : 4;
-    uint32_t AP_BankSel : 4;
-    uint32_t : 16;
-    uint32_t AP_Sel : 8;
-  } regInfo;
+typedef struct {
+  union {
+    uint32_t regData;
+    struct {
+      uint32_t DP_BankSel : 4;
+      uint32_t AP_BankSel : 4;
+      uint32_t : 16;
+      uint32_t AP_Sel : 8;
+    } regInfo;
+  };
+  uint32_t select1; // ADIv6的SELECT1寄存器，即AP寄存器地址的高32位，ADIv5下始终为0
 } ADIv5_DpSelectRegister;
 
 /**
@@ -228,6 +251,46 @@ union PackedTransferData {
   uint8_t data_8[4];
 };
 
+/**
+ * TAR影子寄存器
+ * 记录上一次访问之后TAR中的地址，地址相同时省略TAR的写入
+ */
+struct ADIv5_TarShadow {
+  uint64_t value; // TAR的值
+  uint8_t valid;  // 影子值是否可信，TAR状态未知时为0
+};
+
+#define ADIV5_MAX_AP 256 // AP的最大个数
+#define ADIV5_RECOVER_RETRY 3 // 传输出错后恢复并继续传输的最大次数
+
+/**
+ * AP的拓扑信息
+ * 记录AP的IDR以及MEM-AP探测到的配置，可以保存到缓存文件
+ */
+struct ADIv5_ApInfo {
+  uint32_t idr;                  // APIDR寄存器
+  uint32_t cfg;                  // CFG寄存器
+  uint64_t rom;                  // ROM Table基址
+  uint64_t base;                 // AP的基址，只用于ADIv6
+  uint8_t probed : 1;            // 是否已经探测过下面的配置
+  uint8_t packedTransfers : 1;   // 是否支持packed传输
+  uint8_t lessWordTransfers : 1; // 是否支持小于1个字的传输
+  uint8_t largeData128 : 1;      // 是否支持128位数据传输
+  uint8_t largeData256 : 1;      // 是否支持256位数据传输
+};
+
+/**
+ * DAP的拓扑信息
+ * 以DPIDR和TARGETID区分不同的目标，保存到缓存文件之后，再次连接时可以省略AP的搜索和探测
+ */
+struct ADIv5_Topology {
+  uint8_t scanned;                      // 是否已经获得AP列表
+  uint8_t loaded;                       // AP列表来自缓存文件，还没有重新搜索过
+  unsigned int count;                   // AP的个数
+  struct ADIv5_ApInfo ap[ADIV5_MAX_AP]; // AP信息
+  char *cachePath;                      // 缓存文件路径，NULL表示不使用缓存文件
+};
+
 /**
  * ADIv5 的DAP结构体
  */
@@ -235,15 +298,22 @@ struct ADIv5_Dap {
   struct list_head apList; // AP链表
   struct dap dapApi;
   DapSkill skillObj; // DAP接口对象
+  Adapter adapter;   // 所属的Adapter，用于判断当前的传输方式，为NULL时按照SW-DP处理
   ADIv5_DpSelectRegister select;     // SELECT寄存器
   ADIv5_DpCtrlStatRegister ctrlStat; // CTRL/STAT寄存器
   ADIv5_DpIdrRegister idr;           // DPIDR寄存器
+  uint32_t targetId;                 // TARGETID寄存器，DPv2之前为0
+  uint64_t rootBase;                 // ADIv6根组件的基址，来自BASEPTR0/1
+  uint8_t addrSize;                  // ADIv6 DP地址空间的位宽，来自DPIDR1.ASIZE
+  struct ADIv5_Topology topology;    // AP拓扑信息
+  uint8_t recoverDepth;              // 正在进行的出错恢复的嵌套层数
 };
 
 // AP定义
 struct ADIv5_AccessPort {
   ADIv5_ApIdrRegister idr; // APIDR寄存器
   unsigned int index;      // AP的索引
+  uint64_t base;           // ADIv6下AP的基址，ADIv5下为0
   struct list_head list_entry;
   struct accessPort apApi;
   struct ADIv5_Dap *dap;
@@ -251,20 +321,82 @@ struct ADIv5_AccessPort {
     // MEM-AP
     struct {
       ADIv5_ApCswRegister csw;
+      struct ADIv5_TarShadow tar; // TAR影子寄存器
+      uint8_t tarIncBits;         // TAR保证自增的低位宽度，默认10位，即1KB边界
+      struct memCache *cache;     // 内存缓存，写内存时通知缓存作废对应的行
+      // ROM Table遍历结果缓存
+      struct {
+        uint64_t base;                    // ROM Table基址
+        struct romComponent *components; // 组件数组
+        unsigned int count;               // 组件个数
+      } romCache;
       uint64_t rom; // ROM Table基址
       struct {
         uint8_t largeAddress : 1;      // 该AP是否支持64位地址访问，如果支持，则TAR和ROM寄存器是64位
         uint8_t largeData : 1;         // 是否支持大于32位数据传输
+        uint8_t largeData128 : 1;      // 是否支持128位数据传输
+        uint8_t largeData256 : 1;      // 是否支持256位数据传输
         uint8_t bigEndian : 1;         // 是否是大端字节序，ADI5.2废弃该功能，所以该位必须为0
         uint8_t packedTransfers : 1;   // 是否支持packed传输
         uint8_t lessWordTransfers : 1; // 是否支持小于1个字的传输
       } config;
+      // 事务状态
+      struct {
+        uint8_t active;                // 是否处于事务中
+        ADIv5_DpSelectRegister select; // 事务中SELECT寄存器的值，Commit成功后同步到DAP
+        ADIv5_ApCswRegister csw;       // 事务中CSW寄存器的值，Commit成功后同步到AP
+        struct ADIv5_TarShadow tar;    // 事务中TAR的值，Commit成功后同步到AP
+      } trans;
     } memory;
     //JTAG-AP
     struct {
-      // TODO 增加JTAG-AP相关属性
+      struct jtagSkill skillApi; // 通过JTAG-AP实现的JTAG能力集
+      struct list_head queue;    // JTAG指令队列
+      uint32_t csw;              // CSW影子寄存器
+      uint8_t portSel;           // PORTSEL影子寄存器
     } jtag;
   } type;
 };
 
+/**
+ * 选中AP的寄存器bank
+ * 参数:
+ * 	select:SELECT寄存器的值,和目标值不同时写入SELECT并更新
+ */
+void ADIv5_ApSelectBank(struct ADIv5_AccessPort *ap, ADIv5_DpSelectRegister *select, uint32_t bank);
+
+/**
+ * 初始化JTAG-AP的接口和JTAG能力集
+ */
+void ADIv5_JtagApInit(struct ADIv5_AccessPort *ap);
+
+/**
+ * 释放JTAG-AP中未执行的JTAG指令
+ */
+void ADIv5_JtagApRelease(struct ADIv5_AccessPort *ap);
+
+/**
+ * MEM-AP写内存时通知内存缓存
+ * 参数:
+ * 	cache:缓存对象
+ * 	addr:写入的起始地址
+ * 	len:写入的字节数
+ */
+void ADIv5_MemCacheWriteNotify(MemCache cache, uint64_t addr, uint64_t len);
+
+/**
+ * 从缓存文件中加载DAP的拓扑信息
+ * 参数:
+ * 	dap:DAP对象，根据DPIDR和TARGETID查找对应的记录
+ * 返回:
+ * 	ADI_SUCCESS:加载成功
+ * 	ADI_FAILED:没有设置缓存文件或者没有对应的记录
+ */
+int ADIv5_TopologyLoad(struct ADIv5_Dap *dap);
+
+/**
+ * 将DAP的拓扑信息保存到缓存文件，替换文件中对应的记录
+ */
+int ADIv5_TopologySave(struct ADIv5_Dap *dap);
+
 #endif /* SRC_ARCH_ARM_ADI_ADIV5_PRIVATE_H_ */
@@ -0,0 +1,340 @@
+/**
+ * Copyright (c) 2023, Virus.V <virusv@live.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of SmartOCD nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * Copyright 2023 Virus.V <virusv@live.com>
+ */
+
+
+#include "Library/log/log.h"
+#include "smartocd.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Component/ADI/ADIv5_private.h"
+
+#define ROM_ID_BLOCK_OFFSET 0xFBC // DEVARCH到CIDR3连续17个字
+#define ROM_ID_BLOCK_WORDS 17
+#define ROM_ENTRY_CHUNK 32      // 每轮读取的ROM Table表项个数
+#define ROM_MAX_DEPTH 8         // ROM Table的最大嵌套层数
+#define ROM_MAX_COMPONENTS 1024 // 最多识别的组件个数
+
+#define ROM_CLASS(cid) (((cid) >> 12) & 0xF)
+#define ROM_CLASS_ROM_TABLE 0x1
+#define ROM_CLASS_CORESIGHT 0x9
+#define ROM_DEVARCH_ROM_TABLE 0x47700AF7 // ARM设计的Class 0x9 ROM Table
+#define ROM_ENTRY_PRESENT 0x1
+
+/**
+ * 正在读取表项的ROM Table
+ */
+struct romTableWalk {
+  unsigned int index;      // 在组件数组中的索引
+  unsigned int maxEntries; // 表项的最大个数
+  unsigned int entryShift; // 表项大小，32位为2，64位为3
+  unsigned int next;       // 下一个要读取的表项
+  uint32_t *entries;       // 本轮读取的表项
+  int done;                // 是否已经遇到结束表项
+};
+
+/**
+ * 组件数组
+ */
+struct romWalker {
+  AccessPort ap;
+  struct romComponent *components;
+  unsigned int count;
+  unsigned int capacity;
+  uint64_t addrMask; // 不支持Large Address时只有低32位有效
+};
+
+/**
+ * 添加组件，已经存在的基址不再重复添加，防止ROM Table循环引用
+ */
+static int romAddComponent(struct romWalker *walker, uint64_t base, int parent, unsigned int depth) {
+  for (unsigned int i = 0; i < walker->count; i++) {
+    if (walker->components[i].base == base) {
+      return ADI_SUCCESS;
+    }
+  }
+  if (walker->count >= ROM_MAX_COMPONENTS) {
+    log_warn("Too many CoreSight components, ignore 0x%016" PRIX64 ".", base);
+    return ADI_SUCCESS;
+  }
+  if (walker->count == walker->capacity) {
+    unsigned int newCapacity = walker->capacity ? walker->capacity * 2 : 16;
+    struct romComponent *newComponents = realloc(walker->components, newCapacity * sizeof(struct romComponent));
+    if (newComponents == NULL) {
+      log_error("Failed to alloc component buffer!");
+      return ADI_ERR_INTERNAL_ERROR;
+    }
+    walker->components = newComponents;
+    walker->capacity = newCapacity;
+  }
+  memset(&walker->components[walker->count], 0, sizeof(struct romComponent));
+  walker->components[walker->count].base = base;
+  walker->components[walker->count].parent = parent;
+  walker->components[walker->count].depth = depth;
+  walker->count++;
+  return ADI_SUCCESS;
+}
+
+/**
+ * 在当前事务中读取组件的ID寄存器块
+ */
+static int romQueueIdBlock(AccessPort ap, uint64_t base, uint32_t *block) {
+  for (int i = 0; i < ROM_ID_BLOCK_WORDS; i++) {
+    if (ap->Interface.Memory.TransRead32(ap, base + ROM_ID_BLOCK_OFFSET + (i << 2), &block[i]) != ADI_SUCCESS) {
+      return ADI_FAILED;
+    }
+  }
+  return ADI_SUCCESS;
+}
+
+/**
+ * 解析ID寄存器块
+ */
+static void romParseIdBlock(struct romComponent *comp, const uint32_t *block) {
+  // 偏移相对0xFBC：DEVARCH 0，DEVID 3，DEVTYPE 4，PIDR4-7 5-8，PIDR0-3 9-12，CIDR0-3 13-16
+  comp->devArch = block[0];
+  comp->devId = block[3];
+  comp->devType = block[4];
+  comp->pid = (uint64_t)(block[5] & 0xff) << 32 | (block[12] & 0xff) << 24 | (block[11] & 0xff) << 16 |
+              (block[10] & 0xff) << 8 | (block[9] & 0xff);
+  comp->cid = (block[16] & 0xff) << 24 | (block[15] & 0xff) << 16 | (block[14] & 0xff) << 8 | (block[13] & 0xff);
+  if ((comp->cid & 0xFFFF0FFF) != 0xB105000D) {
+    log_warn("Invalid CID 0x%08X at 0x%016" PRIX64 ".", comp->cid, comp->base);
+    comp->cid = 0;
+  }
+}
+
+/**
+ * 识别一层的所有组件
+ * 所有组件的ID寄存器在一次事务中读取，失败时逐个读取，读取失败的组件CID为0
+ */
+static int romIdentifyLevel(struct romWalker *walker, unsigned int start, unsigned int end) {
+  AccessPort ap = walker->ap;
+  uint32_t *blocks = malloc((end - start) * ROM_ID_BLOCK_WORDS * sizeof(uint32_t));
+  unsigned int i;
+  if (blocks == NULL) {
+    log_error("Failed to alloc ID register buffer!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  if (ap->Interface.Memory.TransBegin(ap) == ADI_SUCCESS) {
+    for (i = start; i < end; i++) {
+      if (romQueueIdBlock(ap, walker->components[i].base, blocks + (i - start) * ROM_ID_BLOCK_WORDS) != ADI_SUCCESS) {
+        break;
+      }
+    }
+    if (i == end && ap->Interface.Memory.TransCommit(ap) == ADI_SUCCESS) {
+      for (i = start; i < end; i++) {
+        romParseIdBlock(&walker->components[i], blocks + (i - start) * ROM_ID_BLOCK_WORDS);
+      }
+      free(blocks);
+      return ADI_SUCCESS;
+    }
+    ap->Interface.Memory.TransCancel(ap);
+  }
+  log_warn("Identify components in one transaction failed, try one by one.");
+  for (i = start; i < end; i++) {
+    if (ap->Interface.Memory.TransBegin(ap) != ADI_SUCCESS) {
+      break;
+    }
+    if (romQueueIdBlock(ap, walker->components[i].base, blocks) == ADI_SUCCESS &&
+        ap->Interface.Memory.TransCommit(ap) == ADI_SUCCESS) {
+      romParseIdBlock(&walker->components[i], blocks);
+    } else {
+      ap->Interface.Memory.TransCancel(ap);
+      log_warn("Read ID registers of 0x%016" PRIX64 " failed.", walker->components[i].base);
+    }
+  }
+  free(blocks);
+  return ADI_SUCCESS;
+}
+
+/**
+ * 读取一层中所有ROM Table的表项，并将存在的组件加入下一层
+ * 每轮在一次事务中读取所有未结束的ROM Table的ROM_ENTRY_CHUNK个表项
+ */
+static int romExpandLevel(struct romWalker *walker, unsigned int start, unsigned int end) {
+  AccessPort ap = walker->ap;
+  struct romTableWalk *tables = calloc(end - start, sizeof(struct romTableWalk));
+  unsigned int tableCount = 0, pending;
+  int ret = ADI_SUCCESS;
+  if (tables == NULL) {
+    log_error("Failed to alloc ROM Table buffer!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  for (unsigned int i = start; i < end; i++) {
+    struct romComponent *comp = &walker->components[i];
+    struct romTableWalk *table = &tables[tableCount];
+    if (comp->cid == 0 || comp->depth >= ROM_MAX_DEPTH) {
+      continue;
+    }
+    if (ROM_CLASS(comp->cid) == ROM_CLASS_ROM_TABLE) {
+      // 表项位于0x000-0xEFC
+      table->maxEntries = 960;
+      table->entryShift = 2;
+    } else if (ROM_CLASS(comp->cid) == ROM_CLASS_CORESIGHT && comp->devArch == ROM_DEVARCH_ROM_TABLE) {
+      // 表项位于0x000-0x7FC：32位表项512个，DEVID.FORMAT为1时是64位表项，共256个
+      table->entryShift = (comp->devId & 0xF) == 1 ? 3 : 2;
+      table->maxEntries = (comp->devId & 0xF) == 1 ? 256 : 512;
+    } else {
+      continue;
+    }
+    table->index = i;
+    table->entries = malloc(ROM_ENTRY_CHUNK * sizeof(uint32_t) * 2);
+    if (table->entries == NULL) {
+      log_error("Failed to alloc ROM Table entry buffer!");
+      ret = ADI_ERR_INTERNAL_ERROR;
+      goto EXIT;
+    }
+    tableCount++;
+  }
+
+  do {
+    pending = 0;
+    if (ap->Interface.Memory.TransBegin(ap) != ADI_SUCCESS) {
+      ret = ADI_FAILED;
+      goto EXIT;
+    }
+    for (unsigned int t = 0; t < tableCount; t++) {
+      struct romTableWalk *table = &tables[t];
+      uint64_t base = walker->components[table->index].base;
+      if (table->done) {
+        continue;
+      }
+      for (unsigned int e = 0; e < ROM_ENTRY_CHUNK && table->next + e < table->maxEntries; e++) {
+        unsigned int words = 1u << (table->entryShift - 2);
+        for (unsigned int w = 0; w < words; w++) {
+          ap->Interface.Memory.TransRead32(ap, base + ((table->next + e) << table->entryShift) + (w << 2),
+                                           &table->entries[e * 2 + w]);
+        }
+      }
+      pending++;
+    }
+    if (pending == 0) {
+      ap->Interface.Memory.TransCancel(ap);
+      break;
+    }
+    if (ap->Interface.Memory.TransCommit(ap) != ADI_SUCCESS) {
+      log_error("Read ROM Table entries failed!");
+      ret = ADI_FAILED;
+      goto EXIT;
+    }
+    // 解析表项
+    for (unsigned int t = 0; t < tableCount; t++) {
+      struct romTableWalk *table = &tables[t];
+      const struct romComponent *parent = &walker->components[table->index];
+      uint64_t parentBase = parent->base;
+      unsigned int parentDepth = parent->depth;
+      if (table->done) {
+        continue;
+      }
+      for (unsigned int e = 0; e < ROM_ENTRY_CHUNK; e++, table->next++) {
+        uint64_t entry, offset;
+        if (table->next >= table->maxEntries) {
+          table->done = 1;
+          break;
+        }
+        if (table->entryShift == 3) {
+          entry = ((uint64_t)table->entries[e * 2 + 1] << 32) | table->entries[e * 2];
+          offset = entry & ~(uint64_t)0xFFF;
+        } else {
+          entry = table->entries[e * 2];
+          // 32位表项的偏移是有符号数
+          offset = (uint64_t)(int64_t)(int32_t)(entry & ~(uint64_t)0xFFF);
+        }
+        if (entry == 0) { // 表的结束
+          table->done = 1;
+          break;
+        }
+        if (!(entry & ROM_ENTRY_PRESENT)) {
+          continue;
+        }
+        // 添加组件可能使components重新分配，所以先保存父组件的信息
+        if ((ret = romAddComponent(walker, (parentBase + offset) & walker->addrMask, table->index,
+                                   parentDepth + 1)) != ADI_SUCCESS) {
+          goto EXIT;
+        }
+      }
+    }
+  } while (1);
+
+EXIT:
+  for (unsigned int t = 0; t < tableCount; t++) {
+    free(tables[t].entries);
+  }
+  free(tables);
+  return ret;
+}
+
+/**
+ * 遍历ROM Table
+ */
+int ADIv5_WalkRomTable(AccessPort self, uint64_t base, int refresh, const struct romComponent **components,
+                       unsigned int *count) {
+  assert(self != NULL && components != NULL && count != NULL);
+  struct ADIv5_AccessPort *ap = container_of(self, struct ADIv5_AccessPort, apApi);
+  struct romWalker walker;
+  unsigned int start, end;
+  int ret;
+  if (self->type != AccessPort_Memory) {
+    log_error("Not a memory access port!");
+    return ADI_ERR_BAD_PARAMETER;
+  }
+  base &= ~(uint64_t)0xFFF;
+  // 命中缓存
+  if (!refresh && ap->type.memory.romCache.components != NULL && ap->type.memory.romCache.base == base) {
+    *components = ap->type.memory.romCache.components;
+    *count = ap->type.memory.romCache.count;
+    return ADI_SUCCESS;
+  }
+  memset(&walker, 0, sizeof(walker));
+  walker.ap = self;
+  walker.addrMask = ap->type.memory.config.largeAddress ? ~(uint64_t)0 : 0xFFFFFFFFu;
+  if ((ret = romAddComponent(&walker, base, -1, 0)) != ADI_SUCCESS) {
+    return ret;
+  }
+  // 广度优先，每次处理一层
+  for (start = 0; start < walker.count; start = end) {
+    end = walker.count;
+    if ((ret = romIdentifyLevel(&walker, start, end)) != ADI_SUCCESS ||
+        (ret = romExpandLevel(&walker, start, end)) != ADI_SUCCESS) {
+      free(walker.components);
+      return ret;
+    }
+  }
+  free(ap->type.memory.romCache.components);
+  ap->type.memory.romCache.base = base;
+  ap->type.memory.romCache.components = walker.components;
+  ap->type.memory.romCache.count = walker.count;
+  *components = walker.components;
+  *count = walker.count;
+  return ADI_SUCCESS;
+}
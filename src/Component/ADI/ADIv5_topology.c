@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2023, Virus.V <virusv@live.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of SmartOCD nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * Copyright 2023 Virus.V <virusv@live.com>
+ */
+
+
+#include "Library/log/log.h"
+#include "smartocd.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Component/ADI/ADIv5_private.h"
+
+/**
+ * 拓扑缓存文件格式，每行一条记录:
+ * dap <DPIDR> <TARGETID> <AP个数>
+ * ap <索引> <IDR> <CFG> <ROM> <标志> [基址]
+ * ap记录属于它前面最近的dap记录，标志:bit0 已探测，bit1 packed，bit2 less word，bit3 128位，bit4 256位，
+ * 基址只用于ADIv6，没有时为0
+ */
+#define TOPO_FLAG_PROBED 0x1
+#define TOPO_FLAG_PACKED 0x2
+#define TOPO_FLAG_LESS_WORD 0x4
+#define TOPO_FLAG_LARGE128 0x8
+#define TOPO_FLAG_LARGE256 0x10
+
+#define TOPO_LINE_MAX 128
+
+/**
+ * 设置拓扑缓存文件
+ */
+int ADIv5_SetTopologyCache(DAP self, const char *path) {
+  assert(self != NULL);
+  struct ADIv5_Dap *dapObj = container_of(self, struct ADIv5_Dap, dapApi);
+  char *pathDup = NULL;
+  if (path != NULL) {
+    pathDup = strdup(path);
+    if (pathDup == NULL) {
+      log_error("Failed to alloc topology cache path!");
+      return ADI_ERR_INTERNAL_ERROR;
+    }
+  }
+  free(dapObj->topology.cachePath);
+  dapObj->topology.cachePath = pathDup;
+  return ADI_SUCCESS;
+}
+
+/**
+ * 从缓存文件中加载拓扑信息
+ * 没有DPIDR的DAP无法区分不同的目标，不使用缓存
+ */
+int ADIv5_TopologyLoad(struct ADIv5_Dap *dap) {
+  assert(dap != NULL);
+  char line[TOPO_LINE_MAX];
+  uint32_t dpidr, targetId, idr, cfg;
+  uint64_t rom, base;
+  unsigned int count = 0, index, flags;
+  int found = 0;
+  FILE *fp;
+
+  if (dap->topology.cachePath == NULL || dap->idr.regData == 0) {
+    return ADI_FAILED;
+  }
+  fp = fopen(dap->topology.cachePath, "r");
+  if (fp == NULL) {
+    return ADI_FAILED;
+  }
+  memset(dap->topology.ap, 0, sizeof(dap->topology.ap));
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (sscanf(line, "dap %" SCNx32 " %" SCNx32 " %u", &dpidr, &targetId, &count) == 3) {
+      if (found) {
+        break; // 对应的记录已经结束
+      }
+      found = dpidr == dap->idr.regData && targetId == dap->targetId && count <= ADIV5_MAX_AP;
+      continue;
+    }
+    if (!found) {
+      continue;
+    }
+    base = 0;
+    if (sscanf(line, "ap %u %" SCNx32 " %" SCNx32 " %" SCNx64 " %x %" SCNx64, &index, &idr, &cfg, &rom, &flags, &base) < 5 ||
+        index >= count) {
+      log_warn("Ignore bad topology cache line: %s", line);
+      continue;
+    }
+    dap->topology.ap[index].idr = idr;
+    dap->topology.ap[index].cfg = cfg;
+    dap->topology.ap[index].rom = rom;
+    dap->topology.ap[index].base = base;
+    dap->topology.ap[index].probed = !!(flags & TOPO_FLAG_PROBED);
+    dap->topology.ap[index].packedTransfers = !!(flags & TOPO_FLAG_PACKED);
+    dap->topology.ap[index].lessWordTransfers = !!(flags & TOPO_FLAG_LESS_WORD);
+    dap->topology.ap[index].largeData128 = !!(flags & TOPO_FLAG_LARGE128);
+    dap->topology.ap[index].largeData256 = !!(flags & TOPO_FLAG_LARGE256);
+  }
+  fclose(fp);
+  if (!found) {
+    return ADI_FAILED;
+  }
+  // AP列表必须连续，第一个IDR为0的AP之后的记录无效
+  for (index = 0; index < count && dap->topology.ap[index].idr != 0; index++)
+    ;
+  dap->topology.count = index;
+  dap->topology.scanned = 1;
+  dap->topology.loaded = 1;
+  log_info("Load DAP topology from cache, %d APs.", dap->topology.count);
+  return ADI_SUCCESS;
+}
+
+/**
+ * 保存拓扑信息到缓存文件
+ * 先写入临时文件，复制其他目标的记录，再替换原文件
+ */
+int ADIv5_TopologySave(struct ADIv5_Dap *dap) {
+  assert(dap != NULL);
+  char line[TOPO_LINE_MAX];
+  char *tmpPath;
+  uint32_t dpidr, targetId;
+  unsigned int count;
+  int skip = 0;
+  FILE *in, *out;
+
+  if (dap->topology.cachePath == NULL || dap->idr.regData == 0 || !dap->topology.scanned) {
+    return ADI_FAILED;
+  }
+  tmpPath = malloc(strlen(dap->topology.cachePath) + sizeof(".tmp"));
+  if (tmpPath == NULL) {
+    log_error("Failed to alloc topology cache path!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  strcpy(tmpPath, dap->topology.cachePath);
+  strcat(tmpPath, ".tmp");
+  out = fopen(tmpPath, "w");
+  if (out == NULL) {
+    log_warn("Failed to open topology cache file %s.", tmpPath);
+    free(tmpPath);
+    return ADI_FAILED;
+  }
+  // 复制其他目标的记录
+  in = fopen(dap->topology.cachePath, "r");
+  if (in != NULL) {
+    while (fgets(line, sizeof(line), in) != NULL) {
+      if (sscanf(line, "dap %" SCNx32 " %" SCNx32 " %u", &dpidr, &targetId, &count) == 3) {
+        skip = dpidr == dap->idr.regData && targetId == dap->targetId;
+      }
+      if (!skip) {
+        fputs(line, out);
+      }
+    }
+    fclose(in);
+  }
+  // 写入本目标的记录
+  fprintf(out, "dap %08" PRIx32 " %08" PRIx32 " %u\n", dap->idr.regData, dap->targetId, dap->topology.count);
+  for (unsigned int index = 0; index < dap->topology.count; index++) {
+    const struct ADIv5_ApInfo *info = &dap->topology.ap[index];
+    unsigned int flags = (info->probed ? TOPO_FLAG_PROBED : 0) | (info->packedTransfers ? TOPO_FLAG_PACKED : 0) |
+                         (info->lessWordTransfers ? TOPO_FLAG_LESS_WORD : 0) |
+                         (info->largeData128 ? TOPO_FLAG_LARGE128 : 0) | (info->largeData256 ? TOPO_FLAG_LARGE256 : 0);
+    fprintf(out, "ap %u %08" PRIx32 " %08" PRIx32 " %016" PRIx64 " %x %016" PRIx64 "\n", index, info->idr, info->cfg,
+            info->rom, flags, info->base);
+  }
+  if (fclose(out) != 0 || rename(tmpPath, dap->topology.cachePath) != 0) {
+    log_warn("Failed to write topology cache file %s.", dap->topology.cachePath);
+    remove(tmpPath);
+    free(tmpPath);
+    return ADI_FAILED;
+  }
+  free(tmpPath);
+  return ADI_SUCCESS;
+}
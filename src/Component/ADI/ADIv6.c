@@ -0,0 +1,312 @@
+/**
+ * Copyright (c) 2023, Virus.V <virusv@live.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of SmartOCD nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * Copyright 2023 Virus.V <virusv@live.com>
+ */
+
+
+#include "Library/log/log.h"
+#include "smartocd.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Component/ADI/ADIv6_private.h"
+
+// 一次执行中读取的ROM Table表项个数
+#define ADIV6_ENTRY_CHUNK 32
+
+/**
+ * DP地址空间中的组件
+ */
+struct dpComponent {
+  uint64_t base;       // 组件基址
+  unsigned int depth;  // 在ROM Table中的层级
+  uint32_t cidr1;      // CIDR1寄存器，Component Class在[7:4]
+  uint32_t devArch;    // DEVARCH寄存器
+  uint32_t devId;      // DEVID寄存器
+};
+
+/**
+ * DPv3初始化
+ */
+int ADIv6_DpInit(struct ADIv5_Dap *dap) {
+  assert(dap != NULL);
+  uint32_t dpidr1 = 0, basePtr0 = 0, basePtr1 = 0;
+  // DPIDR1位于bank 1，BASEPTR0位于bank 2
+  dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, DP_REG_DPIDR1 >> 4);
+  dap->skillObj->SingleRead(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_DPIDR1, &dpidr1);
+  dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, DP_REG_BASEPTR0 >> 4);
+  dap->skillObj->SingleRead(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_BASEPTR0, &basePtr0);
+  dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, 0);
+  if (dap->skillObj->Commit(dap->skillObj) != ADPT_SUCCESS) {
+    // 清理指令队列
+    dap->skillObj->Cancel(dap->skillObj);
+    log_error("Read DP DPIDR1/BASEPTR0 register failed!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  dap->addrSize = dpidr1 & ADIV6_DPIDR1_ASIZE;
+  // 地址空间大于32位时才有BASEPTR1和SELECT1
+  if (dap->addrSize > 32) {
+    dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, DP_REG_BASEPTR1 >> 4);
+    dap->skillObj->SingleRead(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_BASEPTR1, &basePtr1);
+    dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, DP_REG_SELECT1 >> 4);
+    dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT1, 0);
+    dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, 0);
+    if (dap->skillObj->Commit(dap->skillObj) != ADPT_SUCCESS) {
+      // 清理指令队列
+      dap->skillObj->Cancel(dap->skillObj);
+      log_error("Read DP BASEPTR1 register failed!");
+      return ADI_ERR_INTERNAL_ERROR;
+    }
+  }
+  dap->select.regData = 0;
+  dap->select.select1 = 0;
+  if ((basePtr0 & ADIV6_BASEPTR0_VALID) == 0) {
+    log_warn("DPv3 has no valid root component.");
+    dap->rootBase = 0;
+  } else {
+    dap->rootBase = ((uint64_t)basePtr1 << 32) | (basePtr0 & ADIV6_BASEPTR0_PTR);
+  }
+  log_debug("ADIv6 DP address size:%d, root component:0x%" PRIX64 ".", dap->addrSize, dap->rootBase);
+  return ADI_SUCCESS;
+}
+
+/**
+ * 按需写入SELECT和SELECT1
+ */
+void ADIv6_WriteSelect(struct ADIv5_Dap *dap, ADIv5_DpSelectRegister *select, const ADIv5_DpSelectRegister *target) {
+  assert(dap != NULL && select != NULL && target != NULL);
+  if (dap->addrSize > 32 && target->select1 != select->select1) {
+    // 选中DP bank 5写SELECT1，然后写入目标SELECT
+    dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT,
+                               (target->regData & ADIV6_SELECT_ADDR) | (DP_REG_SELECT1 >> 4));
+    dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT1, target->select1);
+    dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, target->regData);
+  } else if (target->regData != select->regData) {
+    dap->skillObj->SingleWrite(dap->skillObj, SKILL_DAP_DP_REG, DP_REG_SELECT, target->regData);
+  }
+  *select = *target;
+}
+
+/**
+ * 插入读DP地址空间中32位数据的指令
+ * SELECT选中addr所在的16字节，APACC的A[3:2]选中其中的字
+ */
+static void dpQueueRead(struct ADIv5_Dap *dap, uint64_t addr, uint32_t *data) {
+  ADIv5_DpSelectRegister target;
+  target.regData = (uint32_t)addr & ADIV6_SELECT_ADDR;
+  target.select1 = addr >> 32;
+  ADIv6_WriteSelect(dap, &dap->select, &target);
+  dap->skillObj->SingleRead(dap->skillObj, SKILL_DAP_AP_REG, addr & 0xC, data);
+}
+
+/**
+ * 执行指令队列，失败时SELECT的状态未知
+ */
+static int dpCommit(struct ADIv5_Dap *dap) {
+  if (dap->skillObj->Commit(dap->skillObj) != ADPT_SUCCESS) {
+    // 清理指令队列
+    dap->skillObj->Cancel(dap->skillObj);
+    dap->select.regData = ADIV6_SELECT_UNKNOWN;
+    dap->select.select1 = ADIV6_SELECT_UNKNOWN;
+    log_error("Execute DAP command failed!");
+    return ADI_ERR_INTERNAL_ERROR;
+  }
+  return ADI_SUCCESS;
+}
+
+/**
+ * 判断组件是否是ROM Table
+ * 返回:
+ * 	表项的个数，不是ROM Table时返回0
+ * 	wide:表项是否为64位
+ */
+static unsigned int romTableEntries(const struct dpComponent *comp, int *wide) {
+  unsigned int class = (comp->cidr1 >> 4) & 0xF;
+  *wide = 0;
+  if (class == 0x1) {
+    return 960; // 0x000 - 0xEFC
+  }
+  if (class == 0x9 && (comp->devArch & (ADIV6_DEVARCH_ARCHITECT | ADIV6_DEVARCH_PRESENT | ADIV6_DEVARCH_ARCHID)) ==
+                          (ADIV6_DEVARCH_ARM | ADIV6_DEVARCH_PRESENT | ADIV6_ARCHID_ROM_TABLE)) {
+    if ((comp->devId & 0xF) == 0x1) {
+      *wide = 1;
+      return 256; // 64位表项，0x000 - 0x7FC
+    }
+    return 512; // 0x000 - 0x7FC
+  }
+  return 0;
+}
+
+/**
+ * 判断组件是否是APv2
+ */
+static int isAccessPort(const struct dpComponent *comp) {
+  uint32_t archId = comp->devArch & ADIV6_DEVARCH_ARCHID;
+  if (((comp->cidr1 >> 4) & 0xF) != 0x9 ||
+      (comp->devArch & (ADIV6_DEVARCH_ARCHITECT | ADIV6_DEVARCH_PRESENT)) != (ADIV6_DEVARCH_ARM | ADIV6_DEVARCH_PRESENT)) {
+    return 0;
+  }
+  return archId == ADIV6_ARCHID_MEM_AP || archId == ADIV6_ARCHID_JTAG_AP || archId == ADIV6_ARCHID_UNKNOWN_AP;
+}
+
+/**
+ * 将子组件加入遍历列表，忽略重复的基址
+ */
+static void addComponent(struct dpComponent *comps, unsigned int *count, uint64_t base, unsigned int depth) {
+  for (unsigned int i = 0; i < *count; i++) {
+    if (comps[i].base == base) {
+      return;
+    }
+  }
+  if (*count >= ADIV6_MAX_COMPONENTS) {
+    log_warn("Too many components in DP address space, ignore 0x%" PRIX64 ".", base);
+    return;
+  }
+  memset(&comps[*count], 0, sizeof(struct dpComponent));
+  comps[*count].base = base;
+  comps[*count].depth = depth;
+  (*count)++;
+}
+
+/**
+ * 读取ROM Table的表项，把存在的子组件加入遍历列表
+ * 每次执行读取ADIV6_ENTRY_CHUNK个字，遇到值为0的表项结束
+ */
+static int romTableExpand(struct ADIv5_Dap *dap, struct dpComponent *comps, unsigned int *count, unsigned int index) {
+  uint32_t entries[ADIV6_ENTRY_CHUNK];
+  const uint64_t addrMask = dap->addrSize > 32 && dap->addrSize < 64 ? (1ull << dap->addrSize) - 1 :
+                            dap->addrSize >= 64 ? ~0ull : 0xFFFFFFFFull;
+  const uint64_t tableBase = comps[index].base;
+  const unsigned int depth = comps[index].depth;
+  const unsigned int class = (comps[index].cidr1 >> 4) & 0xF;
+  int wide;
+  unsigned int words = romTableEntries(&comps[index], &wide) << wide;
+
+  for (unsigned int word = 0; word < words; word += ADIV6_ENTRY_CHUNK) {
+    unsigned int chunk = words - word < ADIV6_ENTRY_CHUNK ? words - word : ADIV6_ENTRY_CHUNK;
+    for (unsigned int i = 0; i < chunk; i++) {
+      dpQueueRead(dap, tableBase + ((word + i) << 2), &entries[i]);
+    }
+    if (dpCommit(dap) != ADI_SUCCESS) {
+      return ADI_ERR_INTERNAL_ERROR;
+    }
+    for (unsigned int i = 0; i < chunk; i += 1 + wide) {
+      uint64_t offset;
+      if (entries[i] == 0 && (!wide || entries[i + 1] == 0)) {
+        return ADI_SUCCESS; // 表结束
+      }
+      // Class 0x1的bit0为PRESENT，Class 0x9的[1:0]为0b11时表示存在
+      if ((class == 0x1 && (entries[i] & 0x1) == 0) || (class == 0x9 && (entries[i] & 0x3) != 0x3)) {
+        continue;
+      }
+      // 表项中的地址是相对于ROM Table基址的有符号偏移
+      offset = wide ? ((uint64_t)entries[i + 1] << 32) | (entries[i] & 0xFFFFF000u) :
+                      (uint64_t)(int64_t)(int32_t)(entries[i] & 0xFFFFF000u);
+      addComponent(comps, count, (tableBase + offset) & addrMask, depth + 1);
+    }
+  }
+  return ADI_SUCCESS;
+}
+
+/**
+ * 遍历DP地址空间，获得所有AP
+ * 广度优先遍历，同一层所有组件的CIDR1、DEVARCH和DEVID在一次执行中读取，
+ * 所有AP的IDR在最后一次执行中读取
+ */
+int ADIv6_ApScan(struct ADIv5_Dap *dap) {
+  assert(dap != NULL);
+  struct dpComponent *comps;
+  uint32_t *idr;
+  unsigned int count = 0, levelStart = 0, apCount = 0;
+  int ret = ADI_ERR_INTERNAL_ERROR;
+
+  comps = calloc(ADIV6_MAX_COMPONENTS, sizeof(struct dpComponent));
+  idr = calloc(ADIV5_MAX_AP, sizeof(uint32_t));
+  if (comps == NULL || idr == NULL) {
+    log_error("Failed to alloc DP component buffer!");
+    goto EXIT;
+  }
+  addComponent(comps, &count, dap->rootBase, 0);
+  memset(dap->topology.ap, 0, sizeof(dap->topology.ap));
+  while (levelStart < count) {
+    unsigned int levelEnd = count;
+    // 识别这一层的所有组件
+    for (unsigned int i = levelStart; i < levelEnd; i++) {
+      dpQueueRead(dap, comps[i].base + 0xFF4, &comps[i].cidr1);
+      dpQueueRead(dap, comps[i].base + 0xFBC, &comps[i].devArch);
+      dpQueueRead(dap, comps[i].base + 0xFC8, &comps[i].devId);
+    }
+    if (dpCommit(dap) != ADI_SUCCESS) {
+      goto EXIT;
+    }
+    for (unsigned int i = levelStart; i < levelEnd; i++) {
+      int wide;
+      if (isAccessPort(&comps[i])) {
+        if (apCount >= ADIV5_MAX_AP) {
+          log_warn("Too many APs, ignore AP at 0x%" PRIX64 ".", comps[i].base);
+          continue;
+        }
+        dap->topology.ap[apCount++].base = comps[i].base;
+      } else if (romTableEntries(&comps[i], &wide) != 0) {
+        if (comps[i].depth >= ADIV6_MAX_DEPTH) {
+          log_warn("ROM Table at 0x%" PRIX64 " is too deep, ignored.", comps[i].base);
+          continue;
+        }
+        if (romTableExpand(dap, comps, &count, i) != ADI_SUCCESS) {
+          goto EXIT;
+        }
+      }
+    }
+    levelStart = levelEnd;
+  }
+  // 一次执行读取所有AP的IDR
+  for (unsigned int i = 0; i < apCount; i++) {
+    dpQueueRead(dap, dap->topology.ap[i].base + ADIV6_AP_REG_OFFSET + (AP_REG_IDR & 0xFC), &idr[i]);
+  }
+  if (apCount > 0 && dpCommit(dap) != ADI_SUCCESS) {
+    goto EXIT;
+  }
+  dap->topology.count = 0;
+  for (unsigned int i = 0; i < apCount; i++) {
+    if (idr[i] == 0) {
+      continue;
+    }
+    dap->topology.ap[dap->topology.count].base = dap->topology.ap[i].base;
+    dap->topology.ap[dap->topology.count].idr = idr[i];
+    log_debug("AP[%d] Base: 0x%" PRIX64 ", IDR: 0x%08X.", dap->topology.count, dap->topology.ap[i].base, idr[i]);
+    dap->topology.count++;
+  }
+  dap->topology.scanned = 1;
+  ret = ADI_SUCCESS;
+EXIT:
+  free(comps);
+  free(idr);
+  return ret;
+}
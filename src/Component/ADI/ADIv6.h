@@ -32,11 +32,22 @@
 #ifndef SRC_ARCH_ADI_ADIV6_H_
 #define SRC_ARCH_ADI_ADIV6_H_
 
-#ifdef _IMPORTED_ARM_ADI_DEFINES_
-#error "Already imported ADI defines!!"
-#endif
+/**
+ * ADIv6沿用ADIv5的DAP和AccessPort接口，ADIv5_CreateDap读取DPIDR后自动识别DPv3，
+ * 这里只增加DPv3和APv2的寄存器定义
+ */
+#include "Component/ADI/ADIv5.h"
+
+/* DPv3增加下列DP寄存器，格式同ADIv5: bank在[7:4], Addr在[3:2] */
+#define DP_REG_DPIDR1		0x10U	// DPIDR1 Register (RO)
+#define DP_REG_BASEPTR0		0x20U	// Base Pointer 0,根组件基址的低32位 (RO)
+#define DP_REG_BASEPTR1		0x30U	// Base Pointer 1,根组件基址的高32位 (RO)
+#define DP_REG_SELECT1		0x54U	// Select Register 1,AP地址的高32位 (WO)
 
-#define _IMPORTED_ARM_ADI_DEFINES_
-#define _IMPORTED_ARM_ADI_VERSION "ADIv6"
+/**
+ * APv2的寄存器是AP地址空间中4KB的一部分，ADIv5的AP寄存器地址(bank和Addr)
+ * 加上0xD00就是APv2中同一个寄存器的偏移，例如CSW为0xD00，IDR为0xDFC
+ */
+#define ADIV6_AP_REG_OFFSET	0xD00U
 
 #endif /* SRC_ARCH_ADI_ADIV6_H_ */
@@ -32,6 +32,50 @@
 #ifndef SRC_ARCH_ARM_ADI_ADIV6_PRIVATE_H_
 #define SRC_ARCH_ARM_ADI_ADIV6_PRIVATE_H_
 
+#include "Component/ADI/ADIv5_private.h"
 #include "Component/ADI/ADIv6.h"
 
+// DPIDR.Version为3表示DPv3，即ADIv6
+#define DAP_IS_ADIV6(dap) ((dap)->idr.regInfo.Version == 3)
+
+#define ADIV6_SELECT_ADDR 0xFFFFFFF0     // SELECT.ADDR[31:4]
+#define ADIV6_SELECT_UNKNOWN 0xFFFFFFFF  // SELECT状态未知，强制下次访问重写SELECT和SELECT1
+#define ADIV6_DPIDR1_ASIZE 0x0000007F    // DP地址空间的位宽
+#define ADIV6_BASEPTR0_VALID 0x00000001  // 根组件基址有效
+#define ADIV6_BASEPTR0_PTR 0xFFFFF000    // 根组件基址的[31:12]
+
+// CoreSight DEVARCH寄存器
+#define ADIV6_DEVARCH_ARCHITECT 0xFFE00000
+#define ADIV6_DEVARCH_ARM (JEP106_CODE_ARM << 21)
+#define ADIV6_DEVARCH_PRESENT 0x00100000
+#define ADIV6_DEVARCH_ARCHID 0x0000FFFF
+#define ADIV6_ARCHID_ROM_TABLE 0x0AF7 // Class 0x9 ROM Table
+#define ADIV6_ARCHID_MEM_AP 0x0A17    // APv2 MEM-AP
+#define ADIV6_ARCHID_JTAG_AP 0x0A27   // APv2 JTAG-AP
+#define ADIV6_ARCHID_UNKNOWN_AP 0x0A47 // 其他APv2
+
+#define ADIV6_MAX_DEPTH 8        // ROM Table最大嵌套层数
+#define ADIV6_MAX_COMPONENTS 256 // DP地址空间中最多遍历的组件个数
+
+/**
+ * DPv3初始化
+ * 读取DPIDR1和BASEPTR0/1，获得地址空间位宽和根组件基址，并清零SELECT1
+ */
+int ADIv6_DpInit(struct ADIv5_Dap *dap);
+
+/**
+ * 按需插入写SELECT和SELECT1的指令
+ * SELECT1位于DP bank 5，只在高32位地址改变并且地址空间大于32位时写入
+ * 参数:
+ * 	select:SELECT/SELECT1的影子值，写入后更新为target
+ * 	target:目标值
+ */
+void ADIv6_WriteSelect(struct ADIv5_Dap *dap, ADIv5_DpSelectRegister *select, const ADIv5_DpSelectRegister *target);
+
+/**
+ * 从根组件开始遍历DP地址空间中的ROM Table，获得所有AP的基址和IDR，
+ * 结果按发现的顺序写入拓扑信息
+ */
+int ADIv6_ApScan(struct ADIv5_Dap *dap);
+
 #endif /* SRC_ARCH_ARM_ADI_ADIV6_PRIVATE_H_ */
@@ -29,3 +29,1376 @@
  * Copyright 2023 Virus.V <virusv@live.com>
  */
 
+#include <stdlib.h>
+#include <string.h>
+
+#include "Component/RISC-V/dm_private.h"
+#include "Library/log/log.h"
+
+#define DM_OBJ_FROM_API(api) container_of((api), struct riscvDm, dmApi)
+
+static const char *cmderrString[] = {"none", "busy", "not supported", "exception", "halt/resume", "bus", "reserved", "other"};
+
+static void dmSequenceAdd(struct dmSequence *seq, uint32_t addr, uint32_t data) {
+  assert(seq->count < DM_SEQUENCE_MAX);
+  seq->writes[seq->count].addr = addr;
+  seq->writes[seq->count].data = data;
+  seq->count++;
+}
+
+/**
+ * 将progbuf的写加入序列，与影子相同时跳过
+ */
+static void dmSequenceProgbuf(struct riscvDm *dm, struct dmSequence *seq, unsigned int index, uint32_t insn) {
+  if ((dm->progbufValid & (1u << index)) && dm->progbuf[index] == insn) {
+    return;
+  }
+  dmSequenceAdd(seq, DM_PROGBUF0 + index, insn);
+  dm->progbuf[index] = insn;
+  dm->progbufValid |= 1u << index;
+}
+
+/**
+ * 将程序加入序列，程序没有占满program buffer或者没有隐含ebreak时，在末尾补充ebreak；
+ * 只写入与program buffer当前内容不同的指令
+ * 参数:
+ * 	insn:程序
+ * 	count:指令条数
+ */
+static int dmSequenceProgram(struct riscvDm *dm, struct dmSequence *seq, const uint32_t *insn, unsigned int count) {
+  unsigned int size = count;
+  if (count < dm->dmApi.progbufSize || !dm->dmApi.impebreak) {
+    size++;
+  }
+  if (size > dm->dmApi.progbufSize) {
+    log_error("Program buffer is too small, need %d, have %d.", size, dm->dmApi.progbufSize);
+    return RISCV_ERR_UNSUPPORT;
+  }
+  for (unsigned int i = 0; i < size; i++) {
+    dmSequenceProgbuf(dm, seq, i, i < count ? insn[i] : RV_EBREAK);
+  }
+  return RISCV_SUCCESS;
+}
+
+/**
+ * 序列执行失败时，program buffer的写可能被忽略，影子不再可信
+ */
+static void dmInvalidateProgbuf(struct riscvDm *dm) {
+  dm->progbufValid = 0;
+}
+
+/**
+ * 清除abstractcs.cmderr
+ */
+static int dmClearCmdErr(struct riscvDm *dm) {
+  dm->dmi->Write(dm->dmi, DM_ABSTRACTCS, ABSTRACTCS_CMDERR_CLEAR);
+  return dm->dmi->Commit(dm->dmi);
+}
+
+/**
+ * 等待抽象命令执行完毕
+ * 参数:
+ * 	cs:上一次读取的abstractcs，返回最后一次读取的值
+ */
+static int dmWaitIdle(struct riscvDm *dm, uint32_t *cs) {
+  int ret;
+  for (int i = 0; i < DM_BUSY_POLL && (*cs & ABSTRACTCS_BUSY); i++) {
+    dm->dmi->Read(dm->dmi, DM_ABSTRACTCS, cs);
+    ret = dm->dmi->Commit(dm->dmi);
+    if (ret != RISCV_SUCCESS) {
+      return ret;
+    }
+  }
+  if (*cs & ABSTRACTCS_BUSY) {
+    log_error("Wait for abstract command timeout, abstractcs: 0x%08X.", *cs);
+    return RISCV_ERR_TIMEOUT;
+  }
+  return RISCV_SUCCESS;
+}
+
+/**
+ * 检查cmderr，出错时清除cmderr
+ */
+static int dmCheckCmdErr(struct riscvDm *dm, uint32_t cs, uint32_t command) {
+  unsigned int cmderr = ABSTRACTCS_CMDERR(cs);
+  if (cmderr == CMDERR_NONE) {
+    return RISCV_SUCCESS;
+  }
+  dmClearCmdErr(dm);
+  if (cmderr != CMDERR_BUSY) {
+    log_error("Abstract command 0x%08X failed, cmderr: %d - %s.", command, cmderr, cmderrString[cmderr]);
+  }
+  return RISCV_ERR_CMDERR;
+}
+
+/**
+ * 将序列中的写加入DMI队列
+ * 返回:
+ * 	序列中最后一个抽象命令
+ */
+static uint32_t dmQueueSequence(struct riscvDm *dm, const struct dmSequence *seq) {
+  uint32_t command = 0;
+  for (unsigned int i = 0; i < seq->count; i++) {
+    dm->dmi->Write(dm->dmi, seq->writes[i].addr, seq->writes[i].data);
+    if (seq->writes[i].addr == DM_COMMAND) {
+      command = seq->writes[i].data;
+    }
+  }
+  return command;
+}
+
+/**
+ * 逐条执行序列，每个抽象命令之后等待其执行完毕并检查cmderr
+ */
+static int dmExecuteSlow(struct riscvDm *dm, const struct dmSequence *seq, uint32_t *result) {
+  uint32_t cs = 0;
+  int ret;
+  for (unsigned int i = 0; i < seq->count; i++) {
+    dm->dmi->Write(dm->dmi, seq->writes[i].addr, seq->writes[i].data);
+    if (seq->writes[i].addr != DM_COMMAND) {
+      continue;
+    }
+    dm->dmi->Read(dm->dmi, DM_ABSTRACTCS, &cs);
+    ret = dm->dmi->Commit(dm->dmi);
+    if (ret == RISCV_SUCCESS) {
+      ret = dmWaitIdle(dm, &cs);
+    }
+    if (ret == RISCV_SUCCESS) {
+      ret = dmCheckCmdErr(dm, cs, seq->writes[i].data);
+    }
+    if (ret != RISCV_SUCCESS) {
+      return ret;
+    }
+  }
+  if (result != NULL) {
+    dm->dmi->Read(dm->dmi, DM_DATA0, result);
+  }
+  return dm->dmi->Commit(dm->dmi);
+}
+
+/**
+ * 执行抽象命令序列
+ * 序列、abstractcs检查和data0读取作为一次DMI提交；
+ * 命令执行期间的访问会导致cmderr为busy，此时清除cmderr后逐条重新执行序列
+ * 参数:
+ * 	seq:抽象命令序列
+ * 	result:不为NULL时，返回序列执行之后data0的值
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_CMDERR:抽象命令执行失败
+ * 	或者其他错误
+ */
+static int dmExecuteSequence(struct riscvDm *dm, const struct dmSequence *seq, uint32_t *result) {
+  uint32_t cs = 0, data = 0, command = 0;
+  int ret;
+
+  command = dmQueueSequence(dm, seq);
+  dm->dmi->Read(dm->dmi, DM_ABSTRACTCS, &cs);
+  if (result != NULL) {
+    dm->dmi->Read(dm->dmi, DM_DATA0, &data);
+  }
+  ret = dm->dmi->Commit(dm->dmi);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  ret = dmWaitIdle(dm, &cs);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  if (ABSTRACTCS_CMDERR(cs) == CMDERR_BUSY) {
+    // 序列中的访问赶上了仍在执行的命令，序列中的操作都可以重复执行
+    log_debug("Abstract command busy, retry step by step.");
+    dmClearCmdErr(dm);
+    return dmExecuteSlow(dm, seq, result);
+  }
+  ret = dmCheckCmdErr(dm, cs, command);
+  if (ret == RISCV_SUCCESS && result != NULL) {
+    *result = data;
+  }
+  return ret;
+}
+
+/**
+ * 执行抽象命令序列，参见dmExecuteSequence
+ */
+static int dmExecute(struct riscvDm *dm, const struct dmSequence *seq, uint32_t *result) {
+  int ret = dmExecuteSequence(dm, seq, result);
+  if (ret != RISCV_SUCCESS) {
+    dmInvalidateProgbuf(dm);
+  }
+  return ret;
+}
+
+/**
+ * 轮询dmstatus，直到mask中的位被置位
+ * 参数:
+ * 	status:上一次读取的dmstatus，返回最后一次读取的值
+ */
+static int dmWaitStatus(struct riscvDm *dm, uint32_t mask, uint32_t *status) {
+  int ret;
+  for (int i = 0; i < DM_STATUS_POLL && (*status & mask) != mask; i++) {
+    dm->dmi->Read(dm->dmi, DM_DMSTATUS, status);
+    ret = dm->dmi->Commit(dm->dmi);
+    if (ret != RISCV_SUCCESS) {
+      return ret;
+    }
+  }
+  if ((*status & mask) != mask) {
+    log_error("Wait for dmstatus timeout, dmstatus: 0x%08X.", *status);
+    return RISCV_ERR_TIMEOUT;
+  }
+  return RISCV_SUCCESS;
+}
+
+/**
+ * 写dmcontrol并读dmstatus，等待mask置位之后撤销请求
+ */
+static int dmRequest(struct riscvDm *dm, uint32_t request, uint32_t mask) {
+  uint32_t status = 0;
+  int ret;
+
+  dm->dmi->Write(dm->dmi, DM_DMCONTROL, dm->control | request);
+  dm->dmi->Read(dm->dmi, DM_DMSTATUS, &status);
+  ret = dm->dmi->Commit(dm->dmi);
+  if (ret == RISCV_SUCCESS) {
+    ret = dmWaitStatus(dm, mask, &status);
+  }
+  // 撤销请求
+  dm->dmi->Write(dm->dmi, DM_DMCONTROL, dm->control);
+  if (dm->dmi->Commit(dm->dmi) != RISCV_SUCCESS && ret == RISCV_SUCCESS) {
+    ret = RISCV_ERR_INTERNAL_ERROR;
+  }
+  return ret;
+}
+
+/**
+ * 选中hart，之后的抽象命令和dmcontrol请求都作用于该hart
+ */
+static int dmSelectHart(struct riscvDm *dm, unsigned int hart) {
+  dm->control = DMCONTROL_DMACTIVE | DMCONTROL_HARTSEL(hart);
+  dm->hart = hart;
+  dm->regs = &dm->harts[hart];
+  dm->dmi->Write(dm->dmi, DM_DMCONTROL, dm->control);
+  return dm->dmi->Commit(dm->dmi);
+}
+
+/**
+ * 将hart array mask的写加入队列，只写入包含hart的window
+ * 参数:
+ * 	window:每个元素对应一个window中32个hart的mask
+ * 	clear:TRUE时将这些window清零
+ */
+static void dmQueueWindow(struct riscvDm *dm, const uint32_t *window, BOOL clear) {
+  for (unsigned int i = 0; i < DM_HART_MAX / DM_HAWINDOW_SIZE; i++) {
+    if (window[i] == 0) {
+      continue;
+    }
+    dm->dmi->Write(dm->dmi, DM_HAWINDOWSEL, i);
+    dm->dmi->Write(dm->dmi, DM_HAWINDOW, clear ? 0 : window[i]);
+  }
+}
+
+/**
+ * 向一组hart发出请求，等待全部hart的dmstatus中mask置位之后撤销请求
+ * 支持hart array mask时通过hawindow同时选中这组hart，否则在同一次提交中逐个选中，
+ * 两种方式下请求和状态读取都只需要一次DMI提交，与hart个数无关。结束之后恢复选中当前hart
+ */
+static int dmGroupRequest(struct riscvDm *dm, const unsigned int *harts, unsigned int count, uint32_t request,
+                          uint32_t mask) {
+  uint32_t window[DM_HART_MAX / DM_HAWINDOW_SIZE] = {0};
+  uint32_t status[DM_HART_MAX];
+  // 轮询状态时重新选中hart，需要保持haltreq，resumereq写0没有影响
+  uint32_t keep = request & DMCONTROL_HALTREQ;
+  uint32_t group = DMCONTROL_DMACTIVE | DMCONTROL_HASEL | DMCONTROL_HARTSEL(harts[0]);
+  unsigned int polled = dm->dmApi.hartArray ? 1 : count;
+  BOOL done = FALSE;
+  int ret = RISCV_SUCCESS;
+
+  for (unsigned int i = 0; i < count; i++) {
+    window[harts[i] / DM_HAWINDOW_SIZE] |= 1u << (harts[i] % DM_HAWINDOW_SIZE);
+  }
+  if (dm->dmApi.hartArray) {
+    dmQueueWindow(dm, window, FALSE);
+    dm->dmi->Write(dm->dmi, DM_DMCONTROL, group | request);
+  } else {
+    for (unsigned int i = 0; i < count; i++) {
+      dm->dmi->Write(dm->dmi, DM_DMCONTROL, DMCONTROL_DMACTIVE | DMCONTROL_HARTSEL(harts[i]) | request);
+    }
+  }
+  for (int poll = 0; poll < DM_STATUS_POLL && !done; poll++) {
+    if (dm->dmApi.hartArray) {
+      dm->dmi->Read(dm->dmi, DM_DMSTATUS, status);
+    } else {
+      for (unsigned int i = 0; i < count; i++) {
+        dm->dmi->Write(dm->dmi, DM_DMCONTROL, DMCONTROL_DMACTIVE | DMCONTROL_HARTSEL(harts[i]) | keep);
+        dm->dmi->Read(dm->dmi, DM_DMSTATUS, status + i);
+      }
+    }
+    ret = dm->dmi->Commit(dm->dmi);
+    if (ret != RISCV_SUCCESS) {
+      break;
+    }
+    done = TRUE;
+    for (unsigned int i = 0; i < polled; i++) {
+      if ((status[i] & mask) != mask) {
+        done = FALSE;
+      }
+    }
+  }
+  if (ret == RISCV_SUCCESS && !done) {
+    log_error("Wait for dmstatus of %d harts timeout.", count);
+    ret = RISCV_ERR_TIMEOUT;
+  }
+  // 撤销请求，清除hart array mask，恢复选中当前hart
+  if (dm->dmApi.hartArray) {
+    dm->dmi->Write(dm->dmi, DM_DMCONTROL, group);
+    dmQueueWindow(dm, window, TRUE);
+  } else {
+    for (unsigned int i = 0; i < count; i++) {
+      dm->dmi->Write(dm->dmi, DM_DMCONTROL, DMCONTROL_DMACTIVE | DMCONTROL_HARTSEL(harts[i]));
+    }
+  }
+  dm->dmi->Write(dm->dmi, DM_DMCONTROL, dm->control);
+  if (dm->dmi->Commit(dm->dmi) != RISCV_SUCCESS && ret == RISCV_SUCCESS) {
+    ret = RISCV_ERR_INTERNAL_ERROR;
+  }
+  return ret;
+}
+
+/**
+ * 通过抽象命令直接读写寄存器，不经过寄存器缓存
+ */
+static int dmRawReadGPR(struct riscvDm *dm, unsigned int regno, uint32_t *data) {
+  struct dmSequence seq = {0};
+  if (regno > 31) {
+    return RISCV_ERR_BAD_PARAMETER;
+  }
+  dmSequenceAdd(&seq, DM_COMMAND, AC_AARSIZE_32 | AC_TRANSFER | AC_REGNO_GPR(regno));
+  return dmExecute(dm, &seq, data);
+}
+
+static int dmRawWriteGPR(struct riscvDm *dm, unsigned int regno, uint32_t data) {
+  struct dmSequence seq = {0};
+  if (regno > 31) {
+    return RISCV_ERR_BAD_PARAMETER;
+  }
+  dmSequenceAdd(&seq, DM_DATA0, data);
+  dmSequenceAdd(&seq, DM_COMMAND, AC_AARSIZE_32 | AC_TRANSFER | AC_WRITE | AC_REGNO_GPR(regno));
+  return dmExecute(dm, &seq, NULL);
+}
+
+/**
+ * 通过program buffer读写CSR，会修改s0
+ */
+static int dmRawReadCSR(struct riscvDm *dm, unsigned int csr, uint32_t *data) {
+  struct dmSequence seq = {0};
+  // csrr s0, csr
+  const uint32_t program[] = {RV_CSRRS(RV_REG_S0, csr & 0xFFFu, RV_REG_ZERO)};
+  int ret = dmSequenceProgram(dm, &seq, program, 1);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  // 执行program buffer，然后将s0读到data0
+  dmSequenceAdd(&seq, DM_COMMAND, AC_POSTEXEC);
+  dmSequenceAdd(&seq, DM_COMMAND, AC_AARSIZE_32 | AC_TRANSFER | AC_REGNO_GPR(RV_REG_S0));
+  return dmExecute(dm, &seq, data);
+}
+
+static int dmRawWriteCSR(struct riscvDm *dm, unsigned int csr, uint32_t data) {
+  struct dmSequence seq = {0};
+  // csrw csr, s0
+  const uint32_t program[] = {RV_CSRRW(RV_REG_ZERO, csr & 0xFFFu, RV_REG_S0)};
+  int ret = dmSequenceProgram(dm, &seq, program, 1);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  // 写s0，然后执行program buffer
+  dmSequenceAdd(&seq, DM_DATA0, data);
+  dmSequenceAdd(&seq, DM_COMMAND, AC_AARSIZE_32 | AC_POSTEXEC | AC_TRANSFER | AC_WRITE | AC_REGNO_GPR(RV_REG_S0));
+  return dmExecute(dm, &seq, NULL);
+}
+
+/**
+ * 访问宽度转换为load/store指令的width字段
+ */
+static int dmMemoryWidth(uint32_t addr, unsigned int width, uint32_t *encode) {
+  switch (width) {
+  case 1:
+    *encode = 0;
+    break;
+  case 2:
+    *encode = 1;
+    break;
+  case 4:
+    *encode = 2;
+    break;
+  default:
+    log_error("Invalid memory access width %d.", width);
+    return RISCV_ERR_BAD_PARAMETER;
+  }
+  if (addr & (width - 1)) {
+    log_error("Address 0x%08X is not aligned to %d bytes.", addr, width);
+    return RISCV_ERR_BAD_PARAMETER;
+  }
+  return RISCV_SUCCESS;
+}
+
+/**
+ * 通过program buffer读写内存，会修改s0和s1
+ */
+static int dmRawReadMemory(struct riscvDm *dm, uint32_t addr, unsigned int width, uint32_t *data) {
+  struct dmSequence seq = {0};
+  uint32_t encode;
+  int ret = dmMemoryWidth(addr, width, &encode);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  // lb/lh/lw s0, 0(s0)
+  const uint32_t program[] = {RV_LOAD(RV_REG_S0, RV_REG_S0, encode, 0)};
+  ret = dmSequenceProgram(dm, &seq, program, 1);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  // 地址写入s0并执行program buffer，然后将s0读到data0
+  dmSequenceAdd(&seq, DM_DATA0, addr);
+  dmSequenceAdd(&seq, DM_COMMAND, AC_AARSIZE_32 | AC_POSTEXEC | AC_TRANSFER | AC_WRITE | AC_REGNO_GPR(RV_REG_S0));
+  dmSequenceAdd(&seq, DM_COMMAND, AC_AARSIZE_32 | AC_TRANSFER | AC_REGNO_GPR(RV_REG_S0));
+  ret = dmExecute(dm, &seq, data);
+  if (ret == RISCV_SUCCESS && width < 4) {
+    *data &= (1u << (width * 8)) - 1;
+  }
+  return ret;
+}
+
+static int dmRawWriteMemory(struct riscvDm *dm, uint32_t addr, unsigned int width, uint32_t data) {
+  struct dmSequence seq = {0};
+  uint32_t encode;
+  int ret = dmMemoryWidth(addr, width, &encode);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  // sb/sh/sw s1, 0(s0)
+  const uint32_t program[] = {RV_STORE(RV_REG_S1, RV_REG_S0, encode, 0)};
+  ret = dmSequenceProgram(dm, &seq, program, 1);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  // 地址写入s0，数据写入s1并执行program buffer
+  dmSequenceAdd(&seq, DM_DATA0, addr);
+  dmSequenceAdd(&seq, DM_COMMAND, AC_AARSIZE_32 | AC_TRANSFER | AC_WRITE | AC_REGNO_GPR(RV_REG_S0));
+  dmSequenceAdd(&seq, DM_DATA0, width < 4 ? data & ((1u << (width * 8)) - 1) : data);
+  dmSequenceAdd(&seq, DM_COMMAND, AC_AARSIZE_32 | AC_POSTEXEC | AC_TRANSFER | AC_WRITE | AC_REGNO_GPR(RV_REG_S1));
+  return dmExecute(dm, &seq, NULL);
+}
+
+/**
+ * 是否可以通过abstractauto和program buffer循环传输内存块
+ * 需要autoexecdata和能放下两条指令和ebreak的program buffer
+ */
+static BOOL dmAutoexecSupport(struct riscvDm *dm) {
+  if (!dm->dmApi.autoexec) {
+    return FALSE;
+  }
+  return (dm->dmApi.progbufSize > 2 || (dm->dmApi.progbufSize == 2 && dm->dmApi.impebreak)) ? TRUE : FALSE;
+}
+
+/**
+ * 在两次data0访问之间插入abstractcs读，给命令执行留出时间
+ */
+static void dmAutoexecDelay(struct riscvDm *dm, uint32_t *dummy) {
+  for (unsigned int i = 0; i < dm->acDelay; i++) {
+    dm->dmi->Read(dm->dmi, DM_ABSTRACTCS, dummy);
+  }
+}
+
+/**
+ * 将序列中的写加入DMI队列，每个抽象命令之后插入延时
+ */
+static void dmAutoexecQueue(struct riscvDm *dm, const struct dmSequence *seq, uint32_t *dummy) {
+  for (unsigned int i = 0; i < seq->count; i++) {
+    dm->dmi->Write(dm->dmi, seq->writes[i].addr, seq->writes[i].data);
+    if (seq->writes[i].addr == DM_COMMAND) {
+      dmAutoexecDelay(dm, dummy);
+    }
+  }
+}
+
+/**
+ * 提交autoexec传输，等待命令执行完毕并检查cmderr
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_DMI_BUSY:cmderr为busy，已清除，需要增加延时重试
+ * 	RISCV_ERR_CMDERR:抽象命令执行失败
+ * 	或者其他错误
+ */
+static int dmAutoexecCommit(struct riscvDm *dm, uint32_t *cs, uint32_t command) {
+  int ret = dm->dmi->Commit(dm->dmi);
+  if (ret == RISCV_SUCCESS) {
+    ret = dmWaitIdle(dm, cs);
+  }
+  if (ret != RISCV_SUCCESS) {
+    // 确保关闭autoexec
+    dmInvalidateProgbuf(dm);
+    dm->dmi->Write(dm->dmi, DM_ABSTRACTAUTO, 0);
+    dm->dmi->Commit(dm->dmi);
+    return ret;
+  }
+  if (ABSTRACTCS_CMDERR(*cs) == CMDERR_BUSY) {
+    // 出现busy时关闭autoexec的写可能被忽略，重新关闭
+    dmInvalidateProgbuf(dm);
+    dm->dmi->Write(dm->dmi, DM_ABSTRACTAUTO, 0);
+    dmClearCmdErr(dm);
+    return RISCV_ERR_DMI_BUSY;
+  }
+  ret = dmCheckCmdErr(dm, *cs, command);
+  if (ret != RISCV_SUCCESS) {
+    dmInvalidateProgbuf(dm);
+  }
+  return ret;
+}
+
+/**
+ * 一次提交读取count个数据，count至少为2
+ * program buffer:lw s1, 0(s0); addi s0, s0, width
+ * 命令每次将s1读到data0，然后执行program buffer预取下一个数据，读data0会再次触发命令；
+ * 最后两个数据在关闭autoexec之后读取，不会越界预取
+ */
+static int dmAutoexecReadChunk(struct riscvDm *dm, uint32_t addr, unsigned int width, uint32_t encode,
+                               unsigned int count, uint32_t *data) {
+  struct dmSequence seq = {0};
+  uint32_t cs = 0, dummy, command;
+  // 小于字宽度时使用lbu/lhu
+  const uint32_t program[] = {RV_LOAD(RV_REG_S1, RV_REG_S0, width < 4 ? encode | 0x4u : encode, 0),
+                              RV_ADDI(RV_REG_S0, RV_REG_S0, width)};
+  int ret = dmSequenceProgram(dm, &seq, program, 2);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  command = AC_AARSIZE_32 | AC_POSTEXEC | AC_TRANSFER | AC_REGNO_GPR(RV_REG_S1);
+  dmSequenceAdd(&seq, DM_DATA0, addr);
+  dmSequenceAdd(&seq, DM_COMMAND, AC_AARSIZE_32 | AC_POSTEXEC | AC_TRANSFER | AC_WRITE | AC_REGNO_GPR(RV_REG_S0));
+  dmSequenceAdd(&seq, DM_COMMAND, command);
+  dmAutoexecQueue(dm, &seq, &dummy);
+  dm->dmi->Write(dm->dmi, DM_ABSTRACTAUTO, ABSTRACTAUTO_AUTOEXECDATA0);
+  for (unsigned int i = 0; i < count - 2; i++) {
+    dmAutoexecDelay(dm, &dummy);
+    dm->dmi->Read(dm->dmi, DM_DATA0, data + i);
+  }
+  dmAutoexecDelay(dm, &dummy);
+  dm->dmi->Write(dm->dmi, DM_ABSTRACTAUTO, 0);
+  dm->dmi->Read(dm->dmi, DM_DATA0, data + count - 2);
+  // 最后一个数据已经在s1中
+  dm->dmi->Write(dm->dmi, DM_COMMAND, AC_AARSIZE_32 | AC_TRANSFER | AC_REGNO_GPR(RV_REG_S1));
+  dmAutoexecDelay(dm, &dummy);
+  dm->dmi->Read(dm->dmi, DM_DATA0, data + count - 1);
+  dm->dmi->Read(dm->dmi, DM_ABSTRACTCS, &cs);
+  return dmAutoexecCommit(dm, &cs, command);
+}
+
+/**
+ * 一次提交写入count个数据
+ * program buffer:sw s1, 0(s0); addi s0, s0, width
+ * 命令每次将data0写入s1，然后执行program buffer，写data0会再次触发命令
+ */
+static int dmAutoexecWriteChunk(struct riscvDm *dm, uint32_t addr, unsigned int width, uint32_t encode,
+                                unsigned int count, const uint32_t *data) {
+  struct dmSequence seq = {0};
+  uint32_t cs = 0, dummy, command;
+  const uint32_t program[] = {RV_STORE(RV_REG_S1, RV_REG_S0, encode, 0), RV_ADDI(RV_REG_S0, RV_REG_S0, width)};
+  int ret = dmSequenceProgram(dm, &seq, program, 2);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  command = AC_AARSIZE_32 | AC_POSTEXEC | AC_TRANSFER | AC_WRITE | AC_REGNO_GPR(RV_REG_S1);
+  dmSequenceAdd(&seq, DM_DATA0, addr);
+  dmSequenceAdd(&seq, DM_COMMAND, AC_AARSIZE_32 | AC_TRANSFER | AC_WRITE | AC_REGNO_GPR(RV_REG_S0));
+  dmSequenceAdd(&seq, DM_DATA0, data[0]);
+  dmSequenceAdd(&seq, DM_COMMAND, command);
+  dmAutoexecQueue(dm, &seq, &dummy);
+  dm->dmi->Write(dm->dmi, DM_ABSTRACTAUTO, ABSTRACTAUTO_AUTOEXECDATA0);
+  for (unsigned int i = 1; i < count; i++) {
+    dmAutoexecDelay(dm, &dummy);
+    dm->dmi->Write(dm->dmi, DM_DATA0, data[i]);
+  }
+  dmAutoexecDelay(dm, &dummy);
+  dm->dmi->Write(dm->dmi, DM_ABSTRACTAUTO, 0);
+  dm->dmi->Read(dm->dmi, DM_ABSTRACTCS, &cs);
+  return dmAutoexecCommit(dm, &cs, command);
+}
+
+/**
+ * 通过abstractauto分块传输内存块，cmderr为busy时增加延时并重试当前块
+ */
+static int dmAutoexecTransfer(struct riscvDm *dm, uint32_t addr, unsigned int width, uint32_t encode,
+                              unsigned int count, uint8_t *buff, BOOL isRead) {
+  uint32_t data[DM_AUTOEXEC_CHUNK];
+  unsigned int done = 0, retry = 0;
+  int ret;
+
+  while (done < count) {
+    unsigned int n = count - done > DM_AUTOEXEC_CHUNK ? DM_AUTOEXEC_CHUNK : count - done;
+    uint8_t *ptr = buff + done * width;
+    // 剩余一个数据时读操作不能使用autoexec
+    if (isRead && n == 1) {
+      ret = dmRawReadMemory(dm, addr + done * width, width, data);
+    } else if (isRead) {
+      ret = dmAutoexecReadChunk(dm, addr + done * width, width, encode, n, data);
+    } else {
+      for (unsigned int i = 0; i < n; i++) {
+        data[i] = 0;
+        for (unsigned int b = 0; b < width; b++) {
+          data[i] |= CAST(uint32_t, ptr[i * width + b]) << (b * 8);
+        }
+      }
+      ret = dmAutoexecWriteChunk(dm, addr + done * width, width, encode, n, data);
+    }
+    if (ret == RISCV_ERR_DMI_BUSY) {
+      if (++retry > DM_AUTOEXEC_RETRY || dm->acDelay >= DM_AUTOEXEC_DELAY_MAX) {
+        log_error("Abstract command is still busy after %d retries.", retry - 1);
+        return RISCV_ERR_TIMEOUT;
+      }
+      dm->acDelay = dm->acDelay * 2 + 1;
+      log_debug("Abstract command busy, increase delay to %d.", dm->acDelay);
+      continue;
+    }
+    if (ret != RISCV_SUCCESS) {
+      return ret;
+    }
+    if (isRead) {
+      for (unsigned int i = 0; i < n; i++) {
+        for (unsigned int b = 0; b < width; b++) {
+          ptr[i * width + b] = BYTE_IDX(data[i], b);
+        }
+      }
+    }
+    done += n;
+  }
+  return RISCV_SUCCESS;
+}
+
+/**
+ * 丢弃寄存器缓存
+ */
+static void dmRegCacheInvalidate(struct riscvDm *dm) {
+  memset(dm->regs, 0, sizeof(struct dmRegCache));
+}
+
+/**
+ * 探测是否支持aarpostincrement，需要hart处于halted状态，在第一次读取寄存器快照之前调用
+ * command寄存器只写，因此通过行为判断：带postincrement读s0之后打开autoexecdata0，
+ * 读一次data0触发命令再次执行，此时data0应为s1；同一次提交中直接读s0、s1作为对照。
+ * s0与s1的值相同时无法判断，保持未探测状态，下一次读取快照时重新探测
+ * 返回:
+ * 	RISCV_SUCCESS:探测完成或者暂时无法判断
+ * 	RISCV_ERR_DMI_BUSY:cmderr为busy，已清除，需要增加延时重试
+ * 	或者其他错误
+ */
+static int dmProbePostIncrement(struct riscvDm *dm) {
+  uint32_t cs = 0, dummy, next = 0, s0 = 0, s1 = 0;
+
+  int ret;
+
+  if (!dm->dmApi.autoexec) {
+    dm->postIncrementProbed = TRUE;
+    return RISCV_SUCCESS;
+  }
+  dm->dmi->Write(dm->dmi, DM_COMMAND, AC_AARSIZE_32 | AC_AARPOSTINCREMENT | AC_TRANSFER | AC_REGNO_GPR(RV_REG_S0));
+  dmAutoexecDelay(dm, &dummy);
+  dm->dmi->Write(dm->dmi, DM_ABSTRACTAUTO, ABSTRACTAUTO_AUTOEXECDATA0);
+  dmAutoexecDelay(dm, &dummy);
+  dm->dmi->Read(dm->dmi, DM_DATA0, &dummy);
+  dmAutoexecDelay(dm, &dummy);
+  dm->dmi->Write(dm->dmi, DM_ABSTRACTAUTO, 0);
+  dm->dmi->Read(dm->dmi, DM_DATA0, &next);
+  dm->dmi->Write(dm->dmi, DM_COMMAND, AC_AARSIZE_32 | AC_TRANSFER | AC_REGNO_GPR(RV_REG_S0));
+  dmAutoexecDelay(dm, &dummy);
+  dm->dmi->Read(dm->dmi, DM_DATA0, &s0);
+  dm->dmi->Write(dm->dmi, DM_COMMAND, AC_AARSIZE_32 | AC_TRANSFER | AC_REGNO_GPR(RV_REG_S1));
+  dmAutoexecDelay(dm, &dummy);
+  dm->dmi->Read(dm->dmi, DM_DATA0, &s1);
+  dm->dmi->Read(dm->dmi, DM_ABSTRACTCS, &cs);
+  ret = dm->dmi->Commit(dm->dmi);
+  if (ret == RISCV_SUCCESS) {
+    ret = dmWaitIdle(dm, &cs);
+  }
+  if (ret != RISCV_SUCCESS) {
+    dm->dmi->Write(dm->dmi, DM_ABSTRACTAUTO, 0);
+    dm->dmi->Commit(dm->dmi);
+    return ret;
+  }
+  if (ABSTRACTCS_CMDERR(cs) != CMDERR_NONE) {
+    // busy时关闭autoexec的写可能被忽略
+    dm->dmi->Write(dm->dmi, DM_ABSTRACTAUTO, 0);
+    dmClearCmdErr(dm);
+    if (ABSTRACTCS_CMDERR(cs) == CMDERR_BUSY) {
+      return RISCV_ERR_DMI_BUSY;
+    }
+    // 不支持postincrement的DM返回not supported
+    dm->postIncrementProbed = TRUE;
+    return RISCV_SUCCESS;
+  }
+  if (s0 == s1) {
+    return RISCV_SUCCESS;
+  }
+  dm->postIncrementProbed = TRUE;
+  INTERFACE_CONST_INIT(BOOL, dm->dmApi.postIncrement, next == s1 ? TRUE : FALSE);
+  log_info("Abstract command aarpostincrement: %d.", dm->dmApi.postIncrement);
+  return RISCV_SUCCESS;
+}
+
+/**
+ * 一次提交读取x1~x31
+ * 支持aarpostincrement和abstractauto时，只需要写一次命令，之后每次读data0会读取下一个寄存器；
+ * 否则每个寄存器一次命令加一次data0读
+ */
+static int dmRegCacheFillGpr(struct riscvDm *dm, struct dmRegCache *cache) {
+  uint32_t cs = 0, dummy, command;
+
+  if (dm->dmApi.postIncrement && dm->dmApi.autoexec) {
+    command = AC_AARSIZE_32 | AC_AARPOSTINCREMENT | AC_TRANSFER | AC_REGNO_GPR(1);
+    dm->dmi->Write(dm->dmi, DM_COMMAND, command);
+    dmAutoexecDelay(dm, &dummy);
+    dm->dmi->Write(dm->dmi, DM_ABSTRACTAUTO, ABSTRACTAUTO_AUTOEXECDATA0);
+    for (unsigned int i = 1; i < 31; i++) {
+      dmAutoexecDelay(dm, &dummy);
+      dm->dmi->Read(dm->dmi, DM_DATA0, cache->gpr + i);
+    }
+    dmAutoexecDelay(dm, &dummy);
+    dm->dmi->Write(dm->dmi, DM_ABSTRACTAUTO, 0);
+    dm->dmi->Read(dm->dmi, DM_DATA0, cache->gpr + 31);
+  } else {
+    for (unsigned int i = 1; i < 32; i++) {
+      command = AC_AARSIZE_32 | AC_TRANSFER | AC_REGNO_GPR(i);
+      dm->dmi->Write(dm->dmi, DM_COMMAND, command);
+      dmAutoexecDelay(dm, &dummy);
+      dm->dmi->Read(dm->dmi, DM_DATA0, cache->gpr + i);
+    }
+  }
+  cache->gpr[0] = 0;
+  log_debug("Register snapshot via %s.",
+            (dm->dmApi.postIncrement && dm->dmApi.autoexec) ? "aarpostincrement" : "abstract commands");
+  dm->dmi->Read(dm->dmi, DM_ABSTRACTCS, &cs);
+  return dmAutoexecCommit(dm, &cs, command);
+}
+
+/**
+ * 通过program buffer读取dpc，会修改s0
+ * 必须在GPR快照之后单独提交，这样busy重试时快照中的s0仍然是原值
+ */
+static int dmRegCacheFillDpc(struct riscvDm *dm, struct dmRegCache *cache) {
+  struct dmSequence seq = {0};
+  uint32_t cs = 0, dummy;
+  // csrr s0, dpc
+  const uint32_t program[] = {RV_CSRRS(RV_REG_S0, CSR_DPC, RV_REG_ZERO)};
+  int ret = dmSequenceProgram(dm, &seq, program, 1);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  dmSequenceAdd(&seq, DM_COMMAND, AC_POSTEXEC);
+  dmSequenceAdd(&seq, DM_COMMAND, AC_AARSIZE_32 | AC_TRANSFER | AC_REGNO_GPR(RV_REG_S0));
+  dmAutoexecQueue(dm, &seq, &dummy);
+  dm->dmi->Read(dm->dmi, DM_DATA0, &cache->dpc);
+  dm->dmi->Read(dm->dmi, DM_ABSTRACTCS, &cs);
+  return dmAutoexecCommit(dm, &cs, AC_AARSIZE_32 | AC_TRANSFER | AC_REGNO_GPR(RV_REG_S0));
+}
+
+/**
+ * 执行读取操作，cmderr为busy时增加acDelay重试
+ */
+static int dmRegCacheRetry(struct riscvDm *dm, int (*fill)(struct riscvDm *, struct dmRegCache *)) {
+  unsigned int retry = 0;
+  int ret;
+
+  for (;;) {
+    ret = dm->postIncrementProbed ? RISCV_SUCCESS : dmProbePostIncrement(dm);
+    if (ret == RISCV_SUCCESS) {
+      ret = fill(dm, dm->regs);
+    }
+    if (ret != RISCV_ERR_DMI_BUSY) {
+      return ret;
+    }
+    if (++retry > DM_AUTOEXEC_RETRY || dm->acDelay >= DM_AUTOEXEC_DELAY_MAX) {
+      log_error("Abstract command is still busy after %d retries.", retry - 1);
+      return RISCV_ERR_TIMEOUT;
+    }
+    dm->acDelay = dm->acDelay * 2 + 1;
+    log_debug("Abstract command busy, increase delay to %d.", dm->acDelay);
+  }
+}
+
+/**
+ * 读取寄存器快照，缓存有效时直接返回
+ * hart必须处于halted状态
+ */
+static int dmRegCacheLoad(struct riscvDm *dm) {
+  int ret;
+
+  if (dm->regs->valid) {
+    return RISCV_SUCCESS;
+  }
+  ret = dmRegCacheRetry(dm, dmRegCacheFillGpr);
+  if (ret != RISCV_SUCCESS) {
+    dmRegCacheInvalidate(dm);
+    return ret;
+  }
+  dm->regs->valid = TRUE;
+  dm->regs->dirty = 0;
+  dm->regs->dpcValid = FALSE;
+  dm->regs->dpcDirty = FALSE;
+  // 没有program buffer时无法读取dpc，之后通过CSR接口访问
+  if (dm->dmApi.progbufSize == 0) {
+    return RISCV_SUCCESS;
+  }
+  // s0的原值已经在快照中，读取dpc之前先标记为需要写回
+  dm->regs->dirty = 1u << RV_REG_S0;
+  if (dmRegCacheRetry(dm, dmRegCacheFillDpc) == RISCV_SUCCESS) {
+    dm->regs->dpcValid = TRUE;
+  } else {
+    log_warn("Failed to read dpc into register cache.");
+  }
+  return RISCV_SUCCESS;
+}
+
+/**
+ * 即将执行会修改mask中寄存器的操作，确保缓存中保存了这些寄存器的原值，并在恢复运行前写回
+ */
+static int dmRegCacheSpill(struct riscvDm *dm, uint32_t mask) {
+  int ret = dmRegCacheLoad(dm);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  dm->regs->dirty |= mask;
+  return RISCV_SUCCESS;
+}
+
+/**
+ * 一次提交写回修改过的dpc和GPR
+ */
+static int dmRegCacheFlush(struct riscvDm *dm) {
+  struct dmSequence seq = {0};
+  uint32_t dirty = dm->regs->dirty;
+  // csrw dpc, s0
+  const uint32_t program[] = {RV_CSRRW(RV_REG_ZERO, CSR_DPC, RV_REG_S0)};
+  int ret;
+
+  if (!dm->regs->valid) {
+    return RISCV_SUCCESS;
+  }
+  if (dm->regs->dpcDirty) {
+    ret = dmSequenceProgram(dm, &seq, program, 1);
+    if (ret != RISCV_SUCCESS) {
+      return ret;
+    }
+    dmSequenceAdd(&seq, DM_DATA0, dm->regs->dpc);
+    dmSequenceAdd(&seq, DM_COMMAND, AC_AARSIZE_32 | AC_POSTEXEC | AC_TRANSFER | AC_WRITE | AC_REGNO_GPR(RV_REG_S0));
+    dirty |= 1u << RV_REG_S0;
+  }
+  for (unsigned int i = 1; i < 32; i++) {
+    if (dirty & (1u << i)) {
+      dmSequenceAdd(&seq, DM_DATA0, dm->regs->gpr[i]);
+      dmSequenceAdd(&seq, DM_COMMAND, AC_AARSIZE_32 | AC_TRANSFER | AC_WRITE | AC_REGNO_GPR(i));
+    }
+  }
+  if (seq.count == 0) {
+    return RISCV_SUCCESS;
+  }
+  ret = dmExecute(dm, &seq, NULL);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  dm->regs->dirty = 0;
+  dm->regs->dpcDirty = FALSE;
+  return RISCV_SUCCESS;
+}
+
+int RISCV_DmReadGPR(DM self, unsigned int regno, uint32_t *data) {
+  assert(self != NULL && data != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  if (regno > 31) {
+    return RISCV_ERR_BAD_PARAMETER;
+  }
+  int ret = dmRegCacheLoad(dm);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  *data = dm->regs->gpr[regno];
+  return RISCV_SUCCESS;
+}
+
+int RISCV_DmWriteGPR(DM self, unsigned int regno, uint32_t data) {
+  assert(self != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  if (regno > 31) {
+    return RISCV_ERR_BAD_PARAMETER;
+  }
+  if (regno == 0) {
+    return RISCV_SUCCESS;
+  }
+  int ret = dmRegCacheLoad(dm);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  dm->regs->gpr[regno] = data;
+  dm->regs->dirty |= 1u << regno;
+  return RISCV_SUCCESS;
+}
+
+int RISCV_DmReadRegisters(DM self, uint32_t *gpr) {
+  assert(self != NULL && gpr != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  int ret = dmRegCacheLoad(dm);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  memcpy(gpr, dm->regs->gpr, sizeof(dm->regs->gpr));
+  return RISCV_SUCCESS;
+}
+
+int RISCV_DmReadCSR(DM self, unsigned int csr, uint32_t *data) {
+  assert(self != NULL && data != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  int ret = dmRegCacheSpill(dm, 1u << RV_REG_S0);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  if (csr == CSR_DPC && dm->regs->dpcValid) {
+    *data = dm->regs->dpc;
+    return RISCV_SUCCESS;
+  }
+  return dmRawReadCSR(dm, csr, data);
+}
+
+int RISCV_DmWriteCSR(DM self, unsigned int csr, uint32_t data) {
+  assert(self != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  int ret = dmRegCacheSpill(dm, 1u << RV_REG_S0);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  if (csr == CSR_DPC && dm->regs->dpcValid) {
+    dm->regs->dpc = data;
+    dm->regs->dpcDirty = TRUE;
+    return RISCV_SUCCESS;
+  }
+  return dmRawWriteCSR(dm, csr, data);
+}
+
+int RISCV_DmReadMemory(DM self, uint32_t addr, unsigned int width, uint32_t *data) {
+  assert(self != NULL && data != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  int ret = dmRegCacheSpill(dm, 1u << RV_REG_S0);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  return dmRawReadMemory(dm, addr, width, data);
+}
+
+int RISCV_DmWriteMemory(DM self, uint32_t addr, unsigned int width, uint32_t data) {
+  assert(self != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  int ret = dmRegCacheSpill(dm, (1u << RV_REG_S0) | (1u << RV_REG_S1));
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  return dmRawWriteMemory(dm, addr, width, data);
+}
+
+int RISCV_DmHalt(DM self) {
+  assert(self != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  int ret = dmRequest(dm, DMCONTROL_HALTREQ, DMSTATUS_ALLHALTED);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  // hart停止之后立即读取寄存器快照
+  ret = dmRegCacheLoad(dm);
+  if (ret != RISCV_SUCCESS) {
+    log_warn("Failed to load register cache.");
+  }
+  return RISCV_SUCCESS;
+}
+
+int RISCV_DmResume(DM self) {
+  assert(self != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  // 恢复运行之前写回修改过的寄存器
+  int ret = dmRegCacheFlush(dm);
+  if (ret != RISCV_SUCCESS) {
+    log_error("Failed to write back registers, hart is not resumed.");
+    return ret;
+  }
+  dmRegCacheInvalidate(dm);
+  return dmRequest(dm, DMCONTROL_RESUMEREQ, DMSTATUS_ALLRESUMEACK);
+}
+
+/**
+ * 检查hart编号是否有效
+ */
+static int dmCheckHarts(struct riscvDm *dm, const unsigned int *harts, unsigned int count) {
+  if (count == 0) {
+    return RISCV_ERR_BAD_PARAMETER;
+  }
+  for (unsigned int i = 0; i < count; i++) {
+    if (harts[i] >= dm->dmApi.hartCount) {
+      log_error("Hart %d does not exist.", harts[i]);
+      return RISCV_ERR_BAD_PARAMETER;
+    }
+  }
+  return RISCV_SUCCESS;
+}
+
+int RISCV_DmSelectHart(DM self, unsigned int hart) {
+  assert(self != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  int ret = dmCheckHarts(dm, &hart, 1);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  if (hart == dm->hart) {
+    return RISCV_SUCCESS;
+  }
+  return dmSelectHart(dm, hart);
+}
+
+int RISCV_DmHaltHarts(DM self, const unsigned int *harts, unsigned int count) {
+  assert(self != NULL && harts != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  int ret = dmCheckHarts(dm, harts, count);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  // 寄存器缓存在访问时才读取，避免逐个hart读取寄存器
+  return dmGroupRequest(dm, harts, count, DMCONTROL_HALTREQ, DMSTATUS_ALLHALTED);
+}
+
+int RISCV_DmResumeHarts(DM self, const unsigned int *harts, unsigned int count) {
+  assert(self != NULL && harts != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  unsigned int current = dm->hart;
+  int ret = dmCheckHarts(dm, harts, count);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  // 只有修改过寄存器的hart需要选中并写回
+  for (unsigned int i = 0; i < count; i++) {
+    struct dmRegCache *regs = &dm->harts[harts[i]];
+    if (!regs->valid || (regs->dirty == 0 && !regs->dpcDirty)) {
+      continue;
+    }
+    if (dm->hart != harts[i]) {
+      ret = dmSelectHart(dm, harts[i]);
+    }
+    if (ret == RISCV_SUCCESS) {
+      ret = dmRegCacheFlush(dm);
+    }
+    if (ret != RISCV_SUCCESS) {
+      log_error("Failed to write back registers of hart %d, harts are not resumed.", harts[i]);
+      break;
+    }
+  }
+  if (dm->hart != current && dmSelectHart(dm, current) != RISCV_SUCCESS && ret == RISCV_SUCCESS) {
+    ret = RISCV_ERR_INTERNAL_ERROR;
+  }
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  for (unsigned int i = 0; i < count; i++) {
+    memset(&dm->harts[harts[i]], 0, sizeof(struct dmRegCache));
+  }
+  return dmGroupRequest(dm, harts, count, DMCONTROL_RESUMEREQ, DMSTATUS_ALLRESUMEACK);
+}
+
+int RISCV_DmReset(DM self, BOOL halt) {
+  assert(self != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  uint32_t status = 0;
+  int ret;
+
+  // ndmreset复位全部hart
+  memset(dm->harts, 0, dm->dmApi.hartCount * sizeof(struct dmRegCache));
+  dm->dmi->Write(dm->dmi, DM_DMCONTROL,
+                 dm->control | DMCONTROL_NDMRESET | (halt ? DMCONTROL_SETRESETHALTREQ : DMCONTROL_CLRRESETHALTREQ));
+  dm->dmi->Write(dm->dmi, DM_DMCONTROL, dm->control);
+  dm->dmi->Read(dm->dmi, DM_DMSTATUS, &status);
+  ret = dm->dmi->Commit(dm->dmi);
+  if (ret == RISCV_SUCCESS && halt) {
+    ret = dmWaitStatus(dm, DMSTATUS_ALLHALTED, &status);
+  }
+  // 清除havereset和resethaltreq
+  dm->dmi->Write(dm->dmi, DM_DMCONTROL, dm->control | DMCONTROL_ACKHAVERESET | DMCONTROL_CLRRESETHALTREQ);
+  if (dm->dmi->Commit(dm->dmi) != RISCV_SUCCESS && ret == RISCV_SUCCESS) {
+    ret = RISCV_ERR_INTERNAL_ERROR;
+  }
+  return ret;
+}
+
+int RISCV_DmIsHalted(DM self, BOOL *halted) {
+  assert(self != NULL && halted != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  uint32_t status = 0;
+  int ret;
+
+  dm->dmi->Read(dm->dmi, DM_DMSTATUS, &status);
+  ret = dm->dmi->Commit(dm->dmi);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  *halted = (status & DMSTATUS_ALLHALTED) ? TRUE : FALSE;
+  if (!*halted && dm->regs->valid) {
+    // hart已经恢复运行，缓存的寄存器不再有效
+    if (dm->regs->dirty || dm->regs->dpcDirty) {
+      log_warn("Hart is running, discard modified registers.");
+    }
+    dmRegCacheInvalidate(dm);
+  }
+  return RISCV_SUCCESS;
+}
+
+int RISCV_DmReserveProgram(DM self, const uint32_t *insn, unsigned int count, unsigned int *id) {
+  assert(self != NULL && insn != NULL && id != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  // 程序之后还需要ebreak时，最多只能占用progbufSize - 1
+  unsigned int limit = dm->dmApi.impebreak ? dm->dmApi.progbufSize : dm->dmApi.progbufSize - 1;
+  if (count == 0 || dm->dmApi.progbufSize == 0 || count > limit) {
+    log_error("Program length %d exceeds program buffer size %d.", count, dm->dmApi.progbufSize);
+    return RISCV_ERR_BAD_PARAMETER;
+  }
+  for (unsigned int i = 0; i < DM_PROGRAM_MAX; i++) {
+    if (dm->programs[i].count == 0) {
+      memcpy(dm->programs[i].insn, insn, count * sizeof(uint32_t));
+      dm->programs[i].count = count;
+      *id = i;
+      return RISCV_SUCCESS;
+    }
+  }
+  log_error("No free program slot.");
+  return RISCV_ERR_INTERNAL_ERROR;
+}
+
+int RISCV_DmReleaseProgram(DM self, unsigned int id) {
+  assert(self != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  if (id >= DM_PROGRAM_MAX || dm->programs[id].count == 0) {
+    return RISCV_ERR_BAD_PARAMETER;
+  }
+  dm->programs[id].count = 0;
+  return RISCV_SUCCESS;
+}
+
+int RISCV_DmExecuteProgram(DM self, unsigned int id, uint32_t *s0, uint32_t *s1) {
+  assert(self != NULL && s0 != NULL && s1 != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  struct dmSequence seq = {0};
+  int ret;
+  if (id >= DM_PROGRAM_MAX || dm->programs[id].count == 0) {
+    return RISCV_ERR_BAD_PARAMETER;
+  }
+  ret = dmRegCacheSpill(dm, (1u << RV_REG_S0) | (1u << RV_REG_S1));
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  ret = dmSequenceProgram(dm, &seq, dm->programs[id].insn, dm->programs[id].count);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  // 写入s0、s1并执行程序，然后读回s0
+  dmSequenceAdd(&seq, DM_DATA0, *s0);
+  dmSequenceAdd(&seq, DM_COMMAND, AC_AARSIZE_32 | AC_TRANSFER | AC_WRITE | AC_REGNO_GPR(RV_REG_S0));
+  dmSequenceAdd(&seq, DM_DATA0, *s1);
+  dmSequenceAdd(&seq, DM_COMMAND, AC_AARSIZE_32 | AC_POSTEXEC | AC_TRANSFER | AC_WRITE | AC_REGNO_GPR(RV_REG_S1));
+  dmSequenceAdd(&seq, DM_COMMAND, AC_AARSIZE_32 | AC_TRANSFER | AC_REGNO_GPR(RV_REG_S0));
+  ret = dmExecute(dm, &seq, s0);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  return dmRawReadGPR(dm, RV_REG_S1, s1);
+}
+
+int RISCV_DmReadBlock(DM self, uint32_t addr, unsigned int width, unsigned int count, uint8_t *buff) {
+  assert(self != NULL && buff != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  uint32_t encode, data;
+  int ret = dmMemoryWidth(addr, width, &encode);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  if (RISCV_DmSbaSupport(dm, width)) {
+    return RISCV_DmSbaReadBlock(dm, addr, width, count, buff);
+  }
+  ret = dmRegCacheSpill(dm, (1u << RV_REG_S0) | (1u << RV_REG_S1));
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  if (count > 1 && dmAutoexecSupport(dm)) {
+    return dmAutoexecTransfer(dm, addr, width, encode, count, buff, TRUE);
+  }
+  for (unsigned int i = 0; i < count; i++) {
+    ret = dmRawReadMemory(dm, addr + i * width, width, &data);
+    if (ret != RISCV_SUCCESS) {
+      return ret;
+    }
+    for (unsigned int b = 0; b < width; b++) {
+      buff[i * width + b] = BYTE_IDX(data, b);
+    }
+  }
+  return RISCV_SUCCESS;
+}
+
+int RISCV_DmWriteBlock(DM self, uint32_t addr, unsigned int width, unsigned int count, const uint8_t *buff) {
+  assert(self != NULL && buff != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(self);
+  uint32_t encode, data;
+  int ret = dmMemoryWidth(addr, width, &encode);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  if (RISCV_DmSbaSupport(dm, width)) {
+    return RISCV_DmSbaWriteBlock(dm, addr, width, count, buff);
+  }
+  ret = dmRegCacheSpill(dm, (1u << RV_REG_S0) | (1u << RV_REG_S1));
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  if (count > 1 && dmAutoexecSupport(dm)) {
+    return dmAutoexecTransfer(dm, addr, width, encode, count, CAST(uint8_t *, buff), FALSE);
+  }
+  for (unsigned int i = 0; i < count; i++) {
+    data = 0;
+    for (unsigned int b = 0; b < width; b++) {
+      data |= CAST(uint32_t, buff[i * width + b]) << (b * 8);
+    }
+    ret = dmRawWriteMemory(dm, addr + i * width, width, data);
+    if (ret != RISCV_SUCCESS) {
+      return ret;
+    }
+  }
+  return RISCV_SUCCESS;
+}
+
+/**
+ * 枚举hart并探测是否支持hart array mask
+ * hartsel写全1之后读回得到实现的hartsel位数，然后每次提交探测DM_HART_CHUNK个hart，
+ * 直到anynonexistent置位。结束之后选中hart 0
+ */
+static int dmEnumerateHarts(struct riscvDm *dm) {
+  uint32_t control = 0, status[DM_HART_CHUNK];
+  unsigned int maxHarts, count = 0;
+  BOOL found = FALSE;
+
+  dm->dmi->Write(dm->dmi, DM_DMCONTROL, DMCONTROL_DMACTIVE | DMCONTROL_HASEL | DMCONTROL_HARTSEL_MASK);
+  dm->dmi->Read(dm->dmi, DM_DMCONTROL, &control);
+  if (dm->dmi->Commit(dm->dmi) != RISCV_SUCCESS) {
+    return RISCV_ERR_INTERNAL_ERROR;
+  }
+  maxHarts = DMCONTROL_GET_HARTSEL(control) + 1;
+  if (maxHarts > DM_HART_MAX) {
+    maxHarts = DM_HART_MAX;
+  }
+  for (unsigned int base = 0; base < maxHarts && !found; base += DM_HART_CHUNK) {
+    unsigned int n = maxHarts - base < DM_HART_CHUNK ? maxHarts - base : DM_HART_CHUNK;
+    for (unsigned int i = 0; i < n; i++) {
+      dm->dmi->Write(dm->dmi, DM_DMCONTROL, DMCONTROL_DMACTIVE | DMCONTROL_HARTSEL(base + i));
+      dm->dmi->Read(dm->dmi, DM_DMSTATUS, status + i);
+    }
+    if (dm->dmi->Commit(dm->dmi) != RISCV_SUCCESS) {
+      return RISCV_ERR_INTERNAL_ERROR;
+    }
+    for (unsigned int i = 0; i < n && !found; i++) {
+      if (status[i] & DMSTATUS_ANYNONEXISTENT) {
+        found = TRUE;
+      } else {
+        count++;
+      }
+    }
+  }
+  dm->harts = calloc(count, sizeof(struct dmRegCache));
+  if (dm->harts == NULL) {
+    log_error("Failed to allocate register cache for %d harts.", count);
+    return RISCV_ERR_INTERNAL_ERROR;
+  }
+  INTERFACE_CONST_INIT(unsigned int, dm->dmApi.hartCount, count);
+  // 只有一个hart时不需要hart array mask
+  INTERFACE_CONST_INIT(BOOL, dm->dmApi.hartArray, (count > 1 && (control & DMCONTROL_HASEL)) ? TRUE : FALSE);
+  return dmSelectHart(dm, 0);
+}
+
+DM RISCV_CreateDm(DMI dmi) {
+  assert(dmi != NULL);
+  struct riscvDm *dm;
+  uint32_t control = 0, status = 0, cs = 0, autoexec = 0, sbcs = 0;
+
+  dm = calloc(1, sizeof(struct riscvDm));
+  if (dm == NULL) {
+    log_error("Failed to create DM object!");
+    return NULL;
+  }
+  dm->dmi = dmi;
+  // 复位并激活DM
+  dmi->Write(dmi, DM_DMCONTROL, 0);
+  dmi->Write(dmi, DM_DMCONTROL, DMCONTROL_DMACTIVE);
+  dmi->Read(dmi, DM_DMCONTROL, &control);
+  if (dmi->Commit(dmi) != RISCV_SUCCESS) {
+    goto FAILED;
+  }
+  for (int i = 0; i < DM_STATUS_POLL && !(control & DMCONTROL_DMACTIVE); i++) {
+    dmi->Read(dmi, DM_DMCONTROL, &control);
+    if (dmi->Commit(dmi) != RISCV_SUCCESS) {
+      goto FAILED;
+    }
+  }
+  if (!(control & DMCONTROL_DMACTIVE)) {
+    log_error("Failed to activate Debug Module!");
+    goto FAILED;
+  }
+  // 选中hart 0，一次提交探测DM的能力
+  dm->control = DMCONTROL_DMACTIVE | DMCONTROL_HARTSEL(0);
+  dmi->Write(dmi, DM_DMCONTROL, dm->control);
+  dmi->Write(dmi, DM_ABSTRACTAUTO, 0xFFFFFFFFu);
+  dmi->Read(dmi, DM_ABSTRACTAUTO, &autoexec);
+  dmi->Write(dmi, DM_ABSTRACTAUTO, 0);
+  dmi->Read(dmi, DM_DMSTATUS, &status);
+  dmi->Read(dmi, DM_ABSTRACTCS, &cs);
+  dmi->Read(dmi, DM_SBCS, &sbcs);
+  if (dmi->Commit(dmi) != RISCV_SUCCESS) {
+    goto FAILED;
+  }
+  if (DMSTATUS_VERSION(status) < 2) {
+    log_error("Unsupported Debug Module version %d.", DMSTATUS_VERSION(status));
+    goto FAILED;
+  }
+  if (status & DMSTATUS_ANYNONEXISTENT) {
+    log_error("Hart 0 does not exist.");
+    goto FAILED;
+  }
+  INTERFACE_CONST_INIT(unsigned int, dm->dmApi.version, DMSTATUS_VERSION(status));
+  INTERFACE_CONST_INIT(unsigned int, dm->dmApi.dataCount, ABSTRACTCS_DATACOUNT(cs));
+  INTERFACE_CONST_INIT(unsigned int, dm->dmApi.progbufSize, ABSTRACTCS_PROGBUFSIZE(cs));
+  if (dm->dmApi.progbufSize > DM_PROGBUF_MAX) {
+    log_error("Unsupported program buffer size %d.", dm->dmApi.progbufSize);
+    goto FAILED;
+  }
+  INTERFACE_CONST_INIT(BOOL, dm->dmApi.impebreak, (status & DMSTATUS_IMPEBREAK) ? TRUE : FALSE);
+  INTERFACE_CONST_INIT(BOOL, dm->dmApi.autoexec, (autoexec & ABSTRACTAUTO_AUTOEXECDATA0) ? TRUE : FALSE);
+  INTERFACE_CONST_INIT(uint32_t, dm->dmApi.sbcs, SBCS_SBVERSION(sbcs) == 1 ? sbcs : 0);
+  if (dmEnumerateHarts(dm) != RISCV_SUCCESS) {
+    goto FAILED;
+  }
+  log_info("DM version:%d, datacount:%d, progbufsize:%d, impebreak:%d, autoexec:%d, sbcs:0x%08X, harts:%d, hasel:%d.",
+           dm->dmApi.version, dm->dmApi.dataCount, dm->dmApi.progbufSize, dm->dmApi.impebreak, dm->dmApi.autoexec,
+           dm->dmApi.sbcs, dm->dmApi.hartCount, dm->dmApi.hartArray);
+  return &dm->dmApi;
+
+FAILED:
+  dmi->Cancel(dmi);
+  free(dm->harts);
+  free(dm);
+  return NULL;
+}
+
+void RISCV_DestroyDm(DM *self) {
+  assert(self != NULL && *self != NULL);
+  struct riscvDm *dm = DM_OBJ_FROM_API(*self);
+  free(dm->harts);
+  free(dm);
+  *self = NULL;
+}
@@ -32,5 +32,411 @@
 #ifndef COMPONENT_RISC_V_DM_H_
 #define COMPONENT_RISC_V_DM_H_
 
+#include "smartocd.h"
+
+#include "Adapter/adapter_jtag.h"
+
+// DTM的JTAG指令
+#define RISCV_DTM_IDCODE 0x01U // IDCODE
+#define RISCV_DTM_DTMCS 0x10U  // DTM Control and Status
+#define RISCV_DTM_DMI 0x11U    // Debug Module Interface Access
+#define RISCV_DTM_BYPASS 0x1FU // BYPASS
+
+// 错误码
+enum {
+  RISCV_SUCCESS = 0,
+  RISCV_FAILED,
+  RISCV_ERR_INTERNAL_ERROR, // 不是由RISC-V调试逻辑造成的错误
+  RISCV_ERR_BAD_PARAMETER,  // 无效的参数
+  RISCV_ERR_UNSUPPORT,      // 不支持的操作
+  RISCV_ERR_TIMEOUT,        // 等待超时
+  RISCV_ERR_DMI_BUSY,       // 增加Idle周期重试之后DMI仍然busy
+  RISCV_ERR_DMI_FAILED,     // DMI操作返回失败
+  RISCV_ERR_CMDERR,         // 抽象命令执行失败
+  RISCV_ERR_SBERROR,        // System Bus Access总线错误
+};
+
+/* DMI对象 */
+typedef struct dmi *DMI;
+
+/**
+ * RISCV_DMI_READ - 读DM寄存器
+ * 会将该动作加入Pending队列，数据在Commit成功后写入data
+ * 参数:
+ * 	self:DMI对象
+ * 	addr:DM寄存器地址
+ * 	data:读取的数据
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	或者其他错误
+ */
+typedef int (*RISCV_DMI_READ)(IN DMI self, IN uint32_t addr, OUT uint32_t *data);
+
+/**
+ * RISCV_DMI_WRITE - 写DM寄存器
+ * 会将该动作加入Pending队列
+ * 参数:
+ * 	self:DMI对象
+ * 	addr:DM寄存器地址
+ * 	data:写入的数据
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	或者其他错误
+ */
+typedef int (*RISCV_DMI_WRITE)(IN DMI self, IN uint32_t addr, IN uint32_t data);
+
+/**
+ * RISCV_DMI_COMMIT - 执行Pending队列中的全部DMI访问
+ * DMI访问的结果在下一次扫描中返回，N次访问只需要N+1次DR扫描，并且只产生一次JTAG Commit；
+ * DMI返回busy时自动复位dmistat、增加Idle周期，并从第一个被忽略的访问继续
+ * 参数:
+ * 	self:DMI对象
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_DMI_BUSY:重试之后仍然busy
+ * 	RISCV_ERR_DMI_FAILED:DMI访问失败
+ * 	或者其他错误
+ */
+typedef int (*RISCV_DMI_COMMIT)(IN DMI self);
+
+/**
+ * RISCV_DMI_CANCEL - 清除Pending队列
+ * 参数:
+ * 	self:DMI对象
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ */
+typedef int (*RISCV_DMI_CANCEL)(IN DMI self);
+
+/* DMI接口 */
+struct dmi {
+  const unsigned int abits; // DM寄存器地址的位宽
+  RISCV_DMI_READ Read;
+  RISCV_DMI_WRITE Write;
+  RISCV_DMI_COMMIT Commit;
+  RISCV_DMI_CANCEL Cancel;
+};
+
+/**
+ * RISCV_CreateDmi - 通过JTAG DTM创建DMI对象
+ * 探测扫描链并选中DTM所在的TAP，读取dtmcs获得地址位宽和Idle周期
+ * 参数:
+ * 	skill:JTAG能力集
+ * 	tapIndex:DTM在扫描链上的序号，从离TDO最近的TAP开始计数
+ * 	irLen:DTM的IR长度，0表示自动探测
+ * 返回:
+ * 	DMI对象，失败返回NULL
+ */
+DMI RISCV_CreateDmi(IN JtagSkill skill, IN int tapIndex, IN int irLen);
+
+/**
+ * RISCV_DestroyDmi - 销毁DMI对象
+ * 参数:
+ * 	self:DMI对象的指针
+ */
+void RISCV_DestroyDmi(IN DMI *self);
+
+/* Debug Module对象 */
+typedef struct dm *DM;
+
+/* Debug Module的能力，在创建时探测 */
+struct dm {
+  const unsigned int version;     // dmstatus.version
+  const unsigned int dataCount;   // data寄存器个数
+  const unsigned int progbufSize; // program buffer的大小
+  const BOOL impebreak;           // program buffer之后是否隐含ebreak
+  const BOOL autoexec;            // 是否支持abstractauto.autoexecdata[0]，数据块传输和postincrement依赖该位
+  const BOOL postIncrement;       // 是否支持aarpostincrement，第一次读取寄存器快照时探测
+  const uint32_t sbcs;            // sbcs寄存器，0表示不支持System Bus Access
+  const unsigned int hartCount;   // hart个数
+  const BOOL hartArray;           // 是否支持hart array mask，可以同时选中多个hart
+};
+
+/**
+ * RISCV_CreateDm - 创建Debug Module对象
+ * 激活DM，探测DM的能力并枚举hart，之后选中hart 0
+ * 参数:
+ * 	dmi:DMI对象
+ * 返回:
+ * 	DM对象，失败返回NULL
+ */
+DM RISCV_CreateDm(IN DMI dmi);
+
+/**
+ * RISCV_DestroyDm - 销毁Debug Module对象
+ * 参数:
+ * 	self:DM对象的指针
+ */
+void RISCV_DestroyDm(IN DM *self);
+
+/**
+ * RISCV_DmHalt - 停止当前hart，并等待hart进入halted状态
+ * hart停止之后在一次DMI提交中读取全部GPR和dpc，之后的寄存器访问直接使用缓存
+ * 参数:
+ * 	self:DM对象
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_TIMEOUT:等待超时
+ * 	或者其他错误
+ */
+int RISCV_DmHalt(IN DM self);
+
+/**
+ * RISCV_DmResume - 恢复当前hart运行，并等待resumeack
+ * 恢复运行之前在一次DMI提交中写回修改过的寄存器，然后丢弃寄存器缓存
+ * 参数:
+ * 	self:DM对象
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_TIMEOUT:等待超时
+ * 	或者其他错误
+ */
+int RISCV_DmResume(IN DM self);
+
+/**
+ * RISCV_DmSelectHart - 选中hart，之后的操作都作用于该hart
+ * 每个hart有独立的寄存器缓存，切换hart不会丢弃缓存
+ * 参数:
+ * 	self:DM对象
+ * 	hart:hart编号，小于hartCount
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_BAD_PARAMETER:hart不存在
+ * 	或者其他错误
+ */
+int RISCV_DmSelectHart(IN DM self, IN unsigned int hart);
+
+/**
+ * RISCV_DmHaltHarts - 同时停止一组hart，并等待全部hart进入halted状态
+ * 支持hart array mask时通过hawindowsel/hawindow同时选中这组hart，否则在同一次DMI提交中逐个发出请求，
+ * 请求和状态查询的DMI提交次数与hart个数无关。寄存器缓存在第一次访问时读取
+ * 参数:
+ * 	self:DM对象
+ * 	harts:hart编号的数组
+ * 	count:hart个数
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_BAD_PARAMETER:hart不存在
+ * 	RISCV_ERR_TIMEOUT:等待超时
+ * 	或者其他错误
+ */
+int RISCV_DmHaltHarts(IN DM self, IN const unsigned int *harts, IN unsigned int count);
+
+/**
+ * RISCV_DmResumeHarts - 同时恢复一组hart运行，并等待全部hart的resumeack
+ * 先写回各hart修改过的寄存器，然后与RISCV_DmHaltHarts一样同时发出请求
+ * 参数:
+ * 	self:DM对象
+ * 	harts:hart编号的数组
+ * 	count:hart个数
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_BAD_PARAMETER:hart不存在
+ * 	RISCV_ERR_TIMEOUT:等待超时
+ * 	或者其他错误
+ */
+int RISCV_DmResumeHarts(IN DM self, IN const unsigned int *harts, IN unsigned int count);
+
+/**
+ * RISCV_DmReset - 通过ndmreset复位系统
+ * 参数:
+ * 	self:DM对象
+ * 	halt:复位之后是否停在第一条指令
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	或者其他错误
+ */
+int RISCV_DmReset(IN DM self, IN BOOL halt);
+
+/**
+ * RISCV_DmIsHalted - 当前hart是否处于halted状态
+ * 参数:
+ * 	self:DM对象
+ * 	halted:是否halted
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	或者其他错误
+ */
+int RISCV_DmIsHalted(IN DM self, OUT BOOL *halted);
+
+/**
+ * RISCV_DmReadGPR - 读通用寄存器，返回寄存器缓存中的值
+ * 参数:
+ * 	self:DM对象
+ * 	regno:寄存器编号，0~31
+ * 	data:读取的值
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_CMDERR:抽象命令执行失败
+ * 	或者其他错误
+ */
+int RISCV_DmReadGPR(IN DM self, IN unsigned int regno, OUT uint32_t *data);
+
+/**
+ * RISCV_DmWriteGPR - 写通用寄存器，只修改寄存器缓存，恢复运行前写回
+ * 参数:
+ * 	self:DM对象
+ * 	regno:寄存器编号，0~31
+ * 	data:写入的值
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_CMDERR:抽象命令执行失败
+ * 	或者其他错误
+ */
+int RISCV_DmWriteGPR(IN DM self, IN unsigned int regno, IN uint32_t data);
+
+/**
+ * RISCV_DmReadRegisters - 读全部通用寄存器，返回寄存器缓存中的值
+ * 参数:
+ * 	self:DM对象
+ * 	gpr:x0~x31的值，长度为32
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_CMDERR:抽象命令执行失败
+ * 	或者其他错误
+ */
+int RISCV_DmReadRegisters(IN DM self, OUT uint32_t *gpr);
+
+/**
+ * RISCV_DmReadCSR - 通过program buffer读CSR
+ * 被修改的s0由寄存器缓存保存，恢复运行前自动写回
+ * 参数:
+ * 	self:DM对象
+ * 	csr:CSR地址，与CSR指令中的一致
+ * 	data:读取的值
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_CMDERR:抽象命令执行失败
+ * 	或者其他错误
+ */
+int RISCV_DmReadCSR(IN DM self, IN unsigned int csr, OUT uint32_t *data);
+
+/**
+ * RISCV_DmWriteCSR - 通过program buffer写CSR
+ * 被修改的s0由寄存器缓存保存，恢复运行前自动写回
+ * 参数:
+ * 	self:DM对象
+ * 	csr:CSR地址，与CSR指令中的一致
+ * 	data:写入的值
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_CMDERR:抽象命令执行失败
+ * 	或者其他错误
+ */
+int RISCV_DmWriteCSR(IN DM self, IN unsigned int csr, IN uint32_t data);
+
+/**
+ * RISCV_DmReadMemory - 通过program buffer读内存
+ * 被修改的s0由寄存器缓存保存，恢复运行前自动写回
+ * 参数:
+ * 	self:DM对象
+ * 	addr:内存地址，需要按照width对齐
+ * 	width:访问宽度，1、2或者4字节
+ * 	data:读取的值
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_BAD_PARAMETER:无效的宽度或者地址未对齐
+ * 	RISCV_ERR_CMDERR:抽象命令执行失败
+ * 	或者其他错误
+ */
+int RISCV_DmReadMemory(IN DM self, IN uint32_t addr, IN unsigned int width, OUT uint32_t *data);
+
+/**
+ * RISCV_DmWriteMemory - 通过program buffer写内存
+ * 被修改的s0和s1由寄存器缓存保存，恢复运行前自动写回
+ * 参数:
+ * 	self:DM对象
+ * 	addr:内存地址，需要按照width对齐
+ * 	width:访问宽度，1、2或者4字节
+ * 	data:写入的值
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_BAD_PARAMETER:无效的宽度或者地址未对齐
+ * 	RISCV_ERR_CMDERR:抽象命令执行失败
+ * 	或者其他错误
+ */
+int RISCV_DmWriteMemory(IN DM self, IN uint32_t addr, IN unsigned int width, IN uint32_t data);
+
+/**
+ * RISCV_DmReadBlock - 读内存块
+ * 支持System Bus Access时通过SBA流水读取，hart运行时也可以访问；
+ * 否则支持abstractauto时在program buffer中执行自增的lw循环，每个数据只需要一次data0读；
+ * 都不支持时通过program buffer逐个读取。后两种方式需要hart处于halted状态，被修改的s0和s1恢复运行前自动写回
+ * 参数:
+ * 	self:DM对象
+ * 	addr:起始地址，需要按照width对齐
+ * 	width:单次访问宽度，1、2或者4字节
+ * 	count:访问次数
+ * 	buff:读取的数据，小端格式，长度为width * count
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_BAD_PARAMETER:无效的宽度或者地址未对齐
+ * 	RISCV_ERR_SBERROR:总线错误
+ * 	或者其他错误
+ */
+int RISCV_DmReadBlock(IN DM self, IN uint32_t addr, IN unsigned int width, IN unsigned int count, OUT uint8_t *buff);
+
+/**
+ * RISCV_DmWriteBlock - 写内存块
+ * 支持System Bus Access时通过SBA流水写入，hart运行时也可以访问；
+ * 否则支持abstractauto时在program buffer中执行自增的sw循环，每个数据只需要一次data0写；
+ * 都不支持时通过program buffer逐个写入。后两种方式需要hart处于halted状态，被修改的s0和s1恢复运行前自动写回
+ * 参数:
+ * 	self:DM对象
+ * 	addr:起始地址，需要按照width对齐
+ * 	width:单次访问宽度，1、2或者4字节
+ * 	count:访问次数
+ * 	buff:写入的数据，小端格式，长度为width * count
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_BAD_PARAMETER:无效的宽度或者地址未对齐
+ * 	RISCV_ERR_SBERROR:总线错误
+ * 	或者其他错误
+ */
+int RISCV_DmWriteBlock(IN DM self, IN uint32_t addr, IN unsigned int width, IN unsigned int count,
+                       IN const uint8_t *buff);
+
+/**
+ * RISCV_DmReserveProgram - 预留一段program buffer程序
+ * DM维护program buffer内容的影子，只写入发生变化的指令，
+ * 因此重复执行同一个程序时program buffer只需要写入一次
+ * 参数:
+ * 	self:DM对象
+ * 	insn:程序，不需要包含末尾的ebreak
+ * 	count:指令条数
+ * 	id:程序的id
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_BAD_PARAMETER:program buffer放不下该程序
+ * 	或者其他错误
+ */
+int RISCV_DmReserveProgram(IN DM self, IN const uint32_t *insn, IN unsigned int count, OUT unsigned int *id);
+
+/**
+ * RISCV_DmReleaseProgram - 释放预留的程序
+ * 参数:
+ * 	self:DM对象
+ * 	id:程序的id
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_BAD_PARAMETER:无效的id
+ */
+int RISCV_DmReleaseProgram(IN DM self, IN unsigned int id);
+
+/**
+ * RISCV_DmExecuteProgram - 执行预留的程序
+ * 执行前将s0、s1写入hart，执行后读回，s0、s1的原值恢复运行前自动写回
+ * 参数:
+ * 	self:DM对象
+ * 	id:程序的id
+ * 	s0:执行前s0的值，返回执行后的值
+ * 	s1:执行前s1的值，返回执行后的值
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_BAD_PARAMETER:无效的id
+ * 	RISCV_ERR_CMDERR:程序执行失败
+ * 	或者其他错误
+ */
+int RISCV_DmExecuteProgram(IN DM self, IN unsigned int id, IN OUT uint32_t *s0, IN OUT uint32_t *s1);
 
 #endif
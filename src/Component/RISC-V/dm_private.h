@@ -0,0 +1,246 @@
+/**
+ * Copyright (c) 2023, Virus.V <virusv@live.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of SmartOCD nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * Copyright 2023 Virus.V <virusv@live.com>
+ */
+
+#ifndef COMPONENT_RISC_V_DM_PRIVATE_H_
+#define COMPONENT_RISC_V_DM_PRIVATE_H_
+
+#include "Component/RISC-V/dm.h"
+#include "Library/jtag/scan_chain.h"
+#include "Library/misc/list.h"
+
+// dtmcs寄存器
+#define DTMCS_VERSION(x) ((x)&0xF)         // DTM版本，1表示0.13及之后的版本
+#define DTMCS_ABITS(x) (((x) >> 4) & 0x3F)  // DMI地址位宽
+#define DTMCS_DMISTAT(x) (((x) >> 10) & 0x3) // DMI状态
+#define DTMCS_IDLE(x) (((x) >> 12) & 0x7)   // 每次DMI访问之后建议在Run-Test/Idle等待的周期数
+#define DTMCS_DMIRESET (1u << 16)           // 清除DMI的粘滞错误状态
+#define DTMCS_DMIHARDRESET (1u << 17)       // 复位DTM
+
+// DMI操作
+#define DMI_OP_NOP 0x0
+#define DMI_OP_READ 0x1
+#define DMI_OP_WRITE 0x2
+// DMI操作状态
+#define DMI_STATUS_SUCCESS 0x0
+#define DMI_STATUS_FAILED 0x2
+#define DMI_STATUS_BUSY 0x3
+
+#define DMI_SCAN_BYTES 16     // 一次DMI扫描的缓冲区大小，最多34+63位
+#define DMI_BUSY_RETRY 8      // DMI busy时的最大重试次数
+#define DMI_IDLE_MAX 4096     // busy时Idle周期的最大值
+
+// DM寄存器地址
+#define DM_DATA0 0x04
+#define DM_DMCONTROL 0x10
+#define DM_DMSTATUS 0x11
+#define DM_HARTINFO 0x12
+#define DM_HAWINDOWSEL 0x14
+#define DM_HAWINDOW 0x15
+#define DM_ABSTRACTCS 0x16
+#define DM_COMMAND 0x17
+#define DM_ABSTRACTAUTO 0x18
+#define DM_PROGBUF0 0x20
+#define DM_SBCS 0x38
+#define DM_SBADDRESS0 0x39
+#define DM_SBDATA0 0x3C
+
+// dmcontrol寄存器
+#define DMCONTROL_HALTREQ (1u << 31)
+#define DMCONTROL_RESUMEREQ (1u << 30)
+#define DMCONTROL_ACKHAVERESET (1u << 28)
+#define DMCONTROL_HASEL (1u << 26)
+#define DMCONTROL_HARTSEL(x) ((((x)&0x3FFu) << 16) | ((((x) >> 10) & 0x3FFu) << 6))
+#define DMCONTROL_HARTSEL_MASK ((0x3FFu << 16) | (0x3FFu << 6))
+#define DMCONTROL_GET_HARTSEL(x) ((((x) >> 16) & 0x3FFu) | ((((x) >> 6) & 0x3FFu) << 10))
+#define DMCONTROL_SETRESETHALTREQ (1u << 3)
+#define DMCONTROL_CLRRESETHALTREQ (1u << 2)
+#define DMCONTROL_NDMRESET (1u << 1)
+#define DMCONTROL_DMACTIVE (1u << 0)
+
+// dmstatus寄存器
+#define DMSTATUS_VERSION(x) ((x)&0xF)
+#define DMSTATUS_IMPEBREAK (1u << 22)
+#define DMSTATUS_ALLRESUMEACK (1u << 17)
+#define DMSTATUS_ANYNONEXISTENT (1u << 14)
+#define DMSTATUS_ALLRUNNING (1u << 11)
+#define DMSTATUS_ALLHALTED (1u << 9)
+#define DMSTATUS_ANYHALTED (1u << 8)
+
+// abstractcs寄存器
+#define ABSTRACTCS_PROGBUFSIZE(x) (((x) >> 24) & 0x1F)
+#define ABSTRACTCS_BUSY (1u << 12)
+#define ABSTRACTCS_CMDERR(x) (((x) >> 8) & 0x7)
+#define ABSTRACTCS_CMDERR_CLEAR (0x7u << 8)
+#define ABSTRACTCS_DATACOUNT(x) ((x)&0xF)
+
+// sbcs寄存器
+#define SBCS_SBVERSION(x) (((x) >> 29) & 0x7)
+#define SBCS_SBBUSYERROR (1u << 22)
+#define SBCS_SBBUSY (1u << 21)
+#define SBCS_SBREADONADDR (1u << 20)
+#define SBCS_SBACCESS(x) (((x)&0x7u) << 17)
+#define SBCS_SBAUTOINCREMENT (1u << 16)
+#define SBCS_SBREADONDATA (1u << 15)
+#define SBCS_SBERROR(x) (((x) >> 12) & 0x7)
+#define SBCS_SBERROR_CLEAR (0x7u << 12)
+#define SBCS_SBASIZE(x) (((x) >> 5) & 0x7F)
+
+// abstractauto寄存器
+#define ABSTRACTAUTO_AUTOEXECDATA0 (1u << 0)
+
+// cmderr
+#define CMDERR_NONE 0
+#define CMDERR_BUSY 1
+
+// Access Register抽象命令
+#define AC_AARSIZE_32 (2u << 20)
+#define AC_AARPOSTINCREMENT (1u << 19)
+#define AC_POSTEXEC (1u << 18)
+#define AC_TRANSFER (1u << 17)
+#define AC_WRITE (1u << 16)
+#define AC_REGNO_GPR(x) (0x1000u + (x))
+
+// CSR地址
+#define CSR_DPC 0x7B1
+
+// 寄存器编号
+#define RV_REG_ZERO 0
+#define RV_REG_S0 8
+#define RV_REG_S1 9
+
+// program buffer中使用的指令
+#define RV_EBREAK 0x00100073u
+#define RV_CSRRW(rd, csr, rs1) (((csr) << 20) | ((rs1) << 15) | (0x1u << 12) | ((rd) << 7) | 0x73u)
+#define RV_CSRRS(rd, csr, rs1) (((csr) << 20) | ((rs1) << 15) | (0x2u << 12) | ((rd) << 7) | 0x73u)
+#define RV_LOAD(rd, rs1, width, imm) ((((imm)&0xFFFu) << 20) | ((rs1) << 15) | ((width) << 12) | ((rd) << 7) | 0x03u)
+#define RV_ADDI(rd, rs1, imm) ((((imm)&0xFFFu) << 20) | ((rs1) << 15) | ((rd) << 7) | 0x13u)
+#define RV_STORE(rs2, rs1, width, imm) \
+  (((((imm) >> 5) & 0x7Fu) << 25) | ((rs2) << 20) | ((rs1) << 15) | ((width) << 12) | (((imm)&0x1Fu) << 7) | 0x23u)
+
+#define DM_SEQUENCE_MAX 80 // 一个抽象命令序列最多包含的DMI写
+#define DM_PROGBUF_MAX 16  // program buffer的最大长度
+#define DM_PROGRAM_MAX 8   // 最多预留的程序个数
+#define DM_BUSY_POLL 100   // 等待抽象命令完成的最大轮询次数
+#define DM_STATUS_POLL 100 // 等待halt/resume的最大轮询次数
+#define DM_SBA_CHUNK 256    // 一次DMI提交中SBA传输的最大次数
+#define DM_SBA_RETRY 8      // sbbusyerror时的最大重试次数
+#define DM_SBA_DELAY_MAX 64 // 两次SBA数据访问之间插入的最大DMI读次数
+#define DM_AUTOEXEC_CHUNK 256    // 一次DMI提交中autoexec传输的最大次数
+#define DM_AUTOEXEC_RETRY 8      // autoexec传输cmderr为busy时的最大重试次数
+#define DM_AUTOEXEC_DELAY_MAX 64 // 两次data0访问之间插入的最大DMI读次数
+#define DM_HART_MAX 1024  // 支持的最大hart个数
+#define DM_HART_CHUNK 32  // 枚举hart时一次DMI提交探测的hart个数
+#define DM_HAWINDOW_SIZE 32 // 一个hart array window包含的hart个数
+
+/* 一个抽象命令序列：依次写入的DM寄存器，包括program buffer、data和command */
+struct dmSequence {
+  unsigned int count;
+  struct {
+    uint32_t addr;
+    uint32_t data;
+  } writes[DM_SEQUENCE_MAX];
+};
+
+/* halted hart的寄存器缓存 */
+struct dmRegCache {
+  BOOL valid;       // 缓存是否有效，hart恢复运行之后失效
+  uint32_t gpr[32]; // x0~x31
+  uint32_t dirty;   // 恢复运行前需要写回的GPR，每一位对应一个GPR
+  uint32_t dpc;
+  BOOL dpcValid;
+  BOOL dpcDirty;
+};
+
+/* Debug Module */
+struct riscvDm {
+  struct dm dmApi;
+  DMI dmi;
+  uint32_t control;     // dmcontrol的基础值:dmactive和hartsel
+  unsigned int sbDelay; // 两次SBA数据访问之间插入的sbcs读次数，sbbusyerror时增加
+  unsigned int acDelay; // autoexec传输时两次data0访问之间插入的abstractcs读次数，busy时增加
+  BOOL postIncrementProbed; // 是否已经探测aarpostincrement，需要hart处于halted状态
+  uint32_t progbuf[DM_PROGBUF_MAX]; // program buffer内容的影子，与之相同的写会被跳过
+  uint32_t progbufValid;            // 影子中有效的progbuf，每一位对应一个progbuf寄存器
+  struct {
+    uint32_t insn[DM_PROGBUF_MAX];
+    unsigned int count; // 0表示没有被预留
+  } programs[DM_PROGRAM_MAX]; // 预留的程序
+  unsigned int hart;           // 当前选中的hart
+  struct dmRegCache *harts;    // 每个hart的寄存器缓存，共hartCount个
+  struct dmRegCache *regs;     // 当前hart的寄存器缓存
+};
+
+/**
+ * 是否可以通过System Bus Access以width字节宽度访问内存
+ */
+BOOL RISCV_DmSbaSupport(struct riscvDm *dm, unsigned int width);
+
+/**
+ * 通过System Bus Access读内存块，hart运行时也可以访问
+ * 参数:
+ * 	addr:起始地址，需要按照width对齐
+ * 	width:单次访问宽度，1、2或者4字节
+ * 	count:访问次数
+ * 	buff:读取的数据，小端格式
+ */
+int RISCV_DmSbaReadBlock(struct riscvDm *dm, uint32_t addr, unsigned int width, unsigned int count, uint8_t *buff);
+
+/**
+ * 通过System Bus Access写内存块，hart运行时也可以访问
+ * 参数:
+ * 	addr:起始地址，需要按照width对齐
+ * 	width:单次访问宽度，1、2或者4字节
+ * 	count:访问次数
+ * 	buff:写入的数据，小端格式
+ */
+int RISCV_DmSbaWriteBlock(struct riscvDm *dm, uint32_t addr, unsigned int width, unsigned int count,
+                          const uint8_t *buff);
+
+/* Pending的DMI访问 */
+struct dmiCommand {
+  struct list_head list_entry;
+  uint32_t addr;    // DM寄存器地址
+  uint32_t data;    // 写入的数据
+  uint32_t *result; // 读取的数据
+  uint8_t op;       // DMI_OP_READ或者DMI_OP_WRITE
+};
+
+/* 通过JTAG DTM实现的DMI */
+struct riscvDmi {
+  struct dmi dmiApi;
+  JtagScanChain chain;    // 扫描链，选中DTM所在的TAP
+  unsigned int idle;      // 每次DMI访问之后在Run-Test/Idle等待的周期数，busy时增加
+  unsigned int scanBits;  // DMI扫描的位数:abits + 34
+  struct list_head queue; // Pending的DMI访问
+  unsigned int count;     // Pending的DMI访问个数
+};
+
+#endif
@@ -0,0 +1,218 @@
+/**
+ * Copyright (c) 2023, Virus.V <virusv@live.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of SmartOCD nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * Copyright 2023 Virus.V <virusv@live.com>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Component/RISC-V/dm_private.h"
+#include "Library/log/log.h"
+
+// SBA的sbaccess编码
+static int sbaAccessSize(unsigned int width) {
+  switch (width) {
+  case 1:
+    return 0;
+  case 2:
+    return 1;
+  case 4:
+    return 2;
+  default:
+    return -1;
+  }
+}
+
+BOOL RISCV_DmSbaSupport(struct riscvDm *dm, unsigned int width) {
+  uint32_t sbcs = dm->dmApi.sbcs;
+  int size = sbaAccessSize(width);
+  if (size < 0 || SBCS_SBVERSION(sbcs) != 1 || SBCS_SBASIZE(sbcs) == 0) {
+    return FALSE;
+  }
+  return (sbcs & (1u << size)) ? TRUE : FALSE;
+}
+
+/**
+ * 在两次SBA数据访问之间插入sbcs读，给总线访问留出时间
+ */
+static void sbaDelay(struct riscvDm *dm, uint32_t *dummy) {
+  for (unsigned int i = 0; i < dm->sbDelay; i++) {
+    dm->dmi->Read(dm->dmi, DM_SBCS, dummy);
+  }
+}
+
+/**
+ * 提交SBA传输，等待sbbusy清零并检查错误
+ * 参数:
+ * 	sbcs:提交中最后读取的sbcs
+ * 返回:
+ * 	RISCV_SUCCESS:成功
+ * 	RISCV_ERR_DMI_BUSY:出现sbbusyerror，已清除，需要增加延时重试
+ * 	RISCV_ERR_SBERROR:总线错误，已清除
+ * 	或者其他错误
+ */
+static int sbaCommit(struct riscvDm *dm, uint32_t *sbcs) {
+  int ret = dm->dmi->Commit(dm->dmi);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  for (int i = 0; i < DM_BUSY_POLL && (*sbcs & SBCS_SBBUSY); i++) {
+    dm->dmi->Read(dm->dmi, DM_SBCS, sbcs);
+    ret = dm->dmi->Commit(dm->dmi);
+    if (ret != RISCV_SUCCESS) {
+      return ret;
+    }
+  }
+  if (*sbcs & SBCS_SBBUSY) {
+    log_error("Wait for system bus timeout, sbcs: 0x%08X.", *sbcs);
+    return RISCV_ERR_TIMEOUT;
+  }
+  if (*sbcs & (SBCS_SBBUSYERROR | SBCS_SBERROR_CLEAR)) {
+    dm->dmi->Write(dm->dmi, DM_SBCS, SBCS_SBBUSYERROR | SBCS_SBERROR_CLEAR);
+    ret = dm->dmi->Commit(dm->dmi);
+    if (ret != RISCV_SUCCESS) {
+      return ret;
+    }
+  }
+  if (SBCS_SBERROR(*sbcs) != 0) {
+    log_error("System bus access failed, sberror: %d.", SBCS_SBERROR(*sbcs));
+    return RISCV_ERR_SBERROR;
+  }
+  if (*sbcs & SBCS_SBBUSYERROR) {
+    return RISCV_ERR_DMI_BUSY;
+  }
+  return RISCV_SUCCESS;
+}
+
+/**
+ * 读取count个数据
+ * 写sbaddress0触发第一次读，之后每次读sbdata0触发下一次读。最后一个数据的读取在第一次提交中触发，
+ * 等待sbbusy清零之后再关闭sbreadondata并读出，避免在总线访问进行中写sbcs
+ */
+static int sbaReadChunk(struct riscvDm *dm, uint32_t addr, unsigned int width, unsigned int count, uint32_t *data) {
+  uint32_t sbcs = 0, dummy;
+  uint32_t config = SBCS_SBACCESS(sbaAccessSize(width)) | SBCS_SBAUTOINCREMENT | SBCS_SBREADONADDR;
+  int ret;
+
+  dm->dmi->Write(dm->dmi, DM_SBCS,
+                 config | (count > 1 ? SBCS_SBREADONDATA : 0) | SBCS_SBBUSYERROR | SBCS_SBERROR_CLEAR);
+  dm->dmi->Write(dm->dmi, DM_SBADDRESS0, addr);
+  for (unsigned int i = 0; i < count - 1; i++) {
+    sbaDelay(dm, &dummy);
+    dm->dmi->Read(dm->dmi, DM_SBDATA0, data + i);
+  }
+  dm->dmi->Read(dm->dmi, DM_SBCS, &sbcs);
+  ret = sbaCommit(dm, &sbcs);
+  if (ret != RISCV_SUCCESS) {
+    return ret;
+  }
+  // 总线空闲，最后一个数据已经在sbdata0中
+  if (count > 1) {
+    dm->dmi->Write(dm->dmi, DM_SBCS, config);
+  }
+  dm->dmi->Read(dm->dmi, DM_SBDATA0, data + count - 1);
+  dm->dmi->Read(dm->dmi, DM_SBCS, &sbcs);
+  return sbaCommit(dm, &sbcs);
+}
+
+/**
+ * 一次提交写入count个数据
+ */
+static int sbaWriteChunk(struct riscvDm *dm, uint32_t addr, unsigned int width, unsigned int count,
+                         const uint32_t *data) {
+  uint32_t sbcs = 0, dummy;
+
+  dm->dmi->Write(dm->dmi, DM_SBCS,
+                 SBCS_SBACCESS(sbaAccessSize(width)) | SBCS_SBAUTOINCREMENT | SBCS_SBBUSYERROR | SBCS_SBERROR_CLEAR);
+  dm->dmi->Write(dm->dmi, DM_SBADDRESS0, addr);
+  for (unsigned int i = 0; i < count; i++) {
+    dm->dmi->Write(dm->dmi, DM_SBDATA0, data[i]);
+    sbaDelay(dm, &dummy);
+  }
+  dm->dmi->Read(dm->dmi, DM_SBCS, &sbcs);
+  return sbaCommit(dm, &sbcs);
+}
+
+/**
+ * 分块执行SBA传输，sbbusyerror时增加延时并重试当前块
+ */
+static int sbaTransfer(struct riscvDm *dm, uint32_t addr, unsigned int width, unsigned int count, uint8_t *buff,
+                       BOOL isRead) {
+  uint32_t data[DM_SBA_CHUNK];
+  unsigned int done = 0, retry = 0;
+  int ret;
+
+  while (done < count) {
+    unsigned int n = count - done > DM_SBA_CHUNK ? DM_SBA_CHUNK : count - done;
+    uint8_t *ptr = buff + done * width;
+    if (isRead) {
+      ret = sbaReadChunk(dm, addr + done * width, width, n, data);
+    } else {
+      for (unsigned int i = 0; i < n; i++) {
+        data[i] = 0;
+        for (unsigned int b = 0; b < width; b++) {
+          data[i] |= CAST(uint32_t, ptr[i * width + b]) << (b * 8);
+        }
+      }
+      ret = sbaWriteChunk(dm, addr + done * width, width, n, data);
+    }
+    if (ret == RISCV_ERR_DMI_BUSY) {
+      if (++retry > DM_SBA_RETRY || dm->sbDelay >= DM_SBA_DELAY_MAX) {
+        log_error("System bus is still busy after %d retries.", retry - 1);
+        return RISCV_ERR_TIMEOUT;
+      }
+      dm->sbDelay = dm->sbDelay * 2 + 1;
+      log_debug("System bus busy, increase delay to %d.", dm->sbDelay);
+      continue;
+    }
+    if (ret != RISCV_SUCCESS) {
+      return ret;
+    }
+    if (isRead) {
+      for (unsigned int i = 0; i < n; i++) {
+        for (unsigned int b = 0; b < width; b++) {
+          ptr[i * width + b] = BYTE_IDX(data[i], b);
+        }
+      }
+    }
+    done += n;
+  }
+  return RISCV_SUCCESS;
+}
+
+int RISCV_DmSbaReadBlock(struct riscvDm *dm, uint32_t addr, unsigned int width, unsigned int count, uint8_t *buff) {
+  assert(dm != NULL && buff != NULL);
+  return sbaTransfer(dm, addr, width, count, buff, TRUE);
+}
+
+int RISCV_DmSbaWriteBlock(struct riscvDm *dm, uint32_t addr, unsigned int width, unsigned int count,
+                          const uint8_t *buff) {
+  assert(dm != NULL && buff != NULL);
+  return sbaTransfer(dm, addr, width, count, CAST(uint8_t *, buff), FALSE);
+}
@@ -0,0 +1,295 @@
+/**
+ * Copyright (c) 2023, Virus.V <virusv@live.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of SmartOCD nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * Copyright 2023 Virus.V <virusv@live.com>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Component/RISC-V/dm_private.h"
+#include "Library/log/log.h"
+#include "Library/misc/bitstream.h"
+
+#define DMI_OBJ_FROM_API(api) container_of((api), struct riscvDmi, dmiApi)
+
+/**
+ * 读写dtmcs寄存器，结束后IR重新选中DMI
+ * 参数:
+ * 	dtmcs:写入的值，执行后为读取的值
+ */
+static int dtmcsAccess(struct riscvDmi *dmi, uint32_t *dtmcs) {
+  uint8_t data[4];
+  JtagSkill skill = dmi->chain->skill;
+
+  bitstream_Insert(data, 0, *dtmcs, 32);
+  JtagScanChainIrScan(dmi->chain, RISCV_DTM_DTMCS);
+  JtagScanChainDrScan(dmi->chain, data, 32);
+  JtagScanChainIrScan(dmi->chain, RISCV_DTM_DMI);
+  skill->ToState(skill, JTAG_TAP_IDLE);
+  if (JtagScanChainCommit(dmi->chain) != ADPT_SUCCESS) {
+    log_error("Access DTM dtmcs register failed!");
+    return RISCV_ERR_INTERNAL_ERROR;
+  }
+  *dtmcs = bitstream_Extract(data, 0, 32);
+  return RISCV_SUCCESS;
+}
+
+/**
+ * 清除DMI的粘滞错误状态
+ */
+static int dmiReset(struct riscvDmi *dmi) {
+  uint32_t dtmcs = DTMCS_DMIRESET;
+  return dtmcsAccess(dmi, &dtmcs);
+}
+
+/**
+ * 加入一次DMI扫描，扫描之后在Run-Test/Idle等待
+ */
+static int dmiQueueScan(struct riscvDmi *dmi, uint8_t *buff, uint8_t op, uint32_t addr, uint32_t data) {
+  JtagSkill skill = dmi->chain->skill;
+  memset(buff, 0, DMI_SCAN_BYTES);
+  bitstream_Insert(buff, 0, op, 2);
+  bitstream_Insert(buff, 2, data, 32);
+  bitstream_Insert(buff, 34, addr, dmi->dmiApi.abits);
+  if (JtagScanChainDrScan(dmi->chain, buff, dmi->scanBits) != ADPT_SUCCESS ||
+      skill->ToState(skill, JTAG_TAP_IDLE) != ADPT_SUCCESS ||
+      (dmi->idle > 0 && skill->Idle(skill, dmi->idle) != ADPT_SUCCESS)) {
+    return RISCV_ERR_INTERNAL_ERROR;
+  }
+  return RISCV_SUCCESS;
+}
+
+static int dmiRead(DMI self, uint32_t addr, uint32_t *data) {
+  assert(self != NULL && data != NULL);
+  struct riscvDmi *dmi = DMI_OBJ_FROM_API(self);
+  struct dmiCommand *cmd = calloc(1, sizeof(struct dmiCommand));
+  if (cmd == NULL) {
+    log_error("Failed to create a new DMI command object.");
+    return RISCV_ERR_INTERNAL_ERROR;
+  }
+  cmd->op = DMI_OP_READ;
+  cmd->addr = addr;
+  cmd->result = data;
+  list_add_tail(&cmd->list_entry, &dmi->queue);
+  dmi->count++;
+  return RISCV_SUCCESS;
+}
+
+static int dmiWrite(DMI self, uint32_t addr, uint32_t data) {
+  assert(self != NULL);
+  struct riscvDmi *dmi = DMI_OBJ_FROM_API(self);
+  struct dmiCommand *cmd = calloc(1, sizeof(struct dmiCommand));
+  if (cmd == NULL) {
+    log_error("Failed to create a new DMI command object.");
+    return RISCV_ERR_INTERNAL_ERROR;
+  }
+  cmd->op = DMI_OP_WRITE;
+  cmd->addr = addr;
+  cmd->data = data;
+  list_add_tail(&cmd->list_entry, &dmi->queue);
+  dmi->count++;
+  return RISCV_SUCCESS;
+}
+
+static int dmiCancel(DMI self) {
+  assert(self != NULL);
+  struct riscvDmi *dmi = DMI_OBJ_FROM_API(self);
+  struct dmiCommand *cmd, *cmd_t;
+  list_for_each_entry_safe(cmd, cmd_t, &dmi->queue, list_entry) {
+    list_del(&cmd->list_entry);
+    free(cmd);
+  }
+  dmi->count = 0;
+  return RISCV_SUCCESS;
+}
+
+/**
+ * 执行cmds[start]之后的全部DMI访问，最后加一次NOP扫描取回最后一次访问的结果
+ * 第i次扫描捕获的是第i-1次访问的结果，第0次扫描捕获的是cmds[start-1]的结果
+ * 参数:
+ * 	next:下一轮开始的访问，全部完成时为count
+ * 	busy:是否出现busy，出现busy时从next继续
+ * 返回:
+ * 	RISCV_SUCCESS:成功，或者出现busy
+ * 	RISCV_ERR_DMI_FAILED:DMI访问失败
+ */
+static int dmiExecute(struct riscvDmi *dmi, struct dmiCommand **cmds, unsigned int start, unsigned int count,
+                      uint8_t *buff, unsigned int *next, int *busy) {
+  unsigned int scans = count - start + 1;
+  for (unsigned int i = 0; i < scans; i++) {
+    struct dmiCommand *cmd = start + i < count ? cmds[start + i] : NULL;
+    if (dmiQueueScan(dmi, buff + i * DMI_SCAN_BYTES, cmd ? cmd->op : DMI_OP_NOP, cmd ? cmd->addr : 0,
+                     cmd ? cmd->data : 0) != RISCV_SUCCESS) {
+      JtagScanChainCancel(dmi->chain);
+      return RISCV_ERR_INTERNAL_ERROR;
+    }
+  }
+  if (JtagScanChainCommit(dmi->chain) != ADPT_SUCCESS) {
+    log_error("Execute DMI scans failed!");
+    return RISCV_ERR_INTERNAL_ERROR;
+  }
+  // 批量检查每次访问的状态
+  *busy = 0;
+  for (unsigned int i = 0; i < scans; i++) {
+    const uint8_t *scan = buff + i * DMI_SCAN_BYTES;
+    unsigned int status = bitstream_Extract(scan, 0, 2);
+    struct dmiCommand *prev = start + i > 0 ? cmds[start + i - 1] : NULL;
+    if (status == DMI_STATUS_BUSY) {
+      // 本次及之后的扫描都被忽略，上一次访问仍在进行，结果在下一轮的第一次扫描中取回
+      *next = start + i;
+      *busy = 1;
+      return RISCV_SUCCESS;
+    }
+    if (status != DMI_STATUS_SUCCESS) {
+      log_error("DMI %s 0x%02X failed!", prev && prev->op == DMI_OP_WRITE ? "write" : "read", prev ? prev->addr : 0);
+      return RISCV_ERR_DMI_FAILED;
+    }
+    if (prev != NULL && prev->op == DMI_OP_READ) {
+      *prev->result = bitstream_Extract(scan, 2, 32);
+    }
+  }
+  *next = count;
+  return RISCV_SUCCESS;
+}
+
+static int dmiCommit(DMI self) {
+  assert(self != NULL);
+  struct riscvDmi *dmi = DMI_OBJ_FROM_API(self);
+  struct dmiCommand **cmds, *cmd;
+  uint8_t *buff;
+  unsigned int count = 0, start = 0, retry = 0;
+  int busy, ret;
+
+  if (dmi->count == 0) {
+    return RISCV_SUCCESS;
+  }
+  cmds = malloc(dmi->count * sizeof(struct dmiCommand *));
+  buff = malloc((dmi->count + 1) * DMI_SCAN_BYTES);
+  if (cmds == NULL || buff == NULL) {
+    free(cmds);
+    free(buff);
+    dmiCancel(self);
+    log_error("Failed to alloc DMI scan buffer!");
+    return RISCV_ERR_INTERNAL_ERROR;
+  }
+  list_for_each_entry(cmd, &dmi->queue, list_entry) {
+    cmds[count++] = cmd;
+  }
+  for (;;) {
+    ret = dmiExecute(dmi, cmds, start, count, buff, &start, &busy);
+    if (ret != RISCV_SUCCESS || !busy) {
+      break;
+    }
+    // busy:清除粘滞状态，增加Idle周期之后从第一个被忽略的访问继续
+    if (++retry > DMI_BUSY_RETRY || dmi->idle >= DMI_IDLE_MAX) {
+      log_error("DMI is still busy after %d retries, idle %d.", retry - 1, dmi->idle);
+      ret = RISCV_ERR_DMI_BUSY;
+      break;
+    }
+    dmi->idle = dmi->idle * 2 + 1;
+    log_debug("DMI busy, increase idle cycles to %d.", dmi->idle);
+    if (dmiReset(dmi) != RISCV_SUCCESS) {
+      ret = RISCV_ERR_INTERNAL_ERROR;
+      break;
+    }
+  }
+  if (ret == RISCV_ERR_DMI_FAILED || ret == RISCV_ERR_DMI_BUSY) {
+    dmiReset(dmi);
+  }
+  free(cmds);
+  free(buff);
+  dmiCancel(self);
+  return ret;
+}
+
+DMI RISCV_CreateDmi(JtagSkill skill, int tapIndex, int irLen) {
+  assert(skill != NULL);
+  struct riscvDmi *dmi;
+  uint32_t dtmcs = 0;
+  int ret;
+
+  dmi = calloc(1, sizeof(struct riscvDmi));
+  if (dmi == NULL) {
+    log_error("Failed to create DMI object!");
+    return NULL;
+  }
+  INIT_LIST_HEAD(&dmi->queue);
+  dmi->chain = JtagCreateScanChain(skill);
+  if (dmi->chain == NULL) {
+    free(dmi);
+    return NULL;
+  }
+  // 探测扫描链，无法推断IR长度时需要手动指定
+  ret = JtagScanChainDetect(dmi->chain);
+  if (ret == ADPT_ERR_PROTOCOL_ERROR && irLen > 0) {
+    ret = JtagScanChainSetIrLen(dmi->chain, tapIndex, irLen);
+  }
+  if (ret != ADPT_SUCCESS || JtagScanChainSelect(dmi->chain, tapIndex) != ADPT_SUCCESS) {
+    log_error("Failed to select DTM on the scan chain!");
+    goto FAILED;
+  }
+  if (irLen > 0 && dmi->chain->taps[tapIndex].irLen != irLen) {
+    log_warn("DTM IR length is %d, not %d.", dmi->chain->taps[tapIndex].irLen, irLen);
+  }
+  if (dtmcsAccess(dmi, &dtmcs) != RISCV_SUCCESS) {
+    goto FAILED;
+  }
+  log_debug("DTM dtmcs:0x%08X.", dtmcs);
+  if (DTMCS_VERSION(dtmcs) != 1) {
+    log_error("Unsupported DTM version %d.", DTMCS_VERSION(dtmcs));
+    goto FAILED;
+  }
+  // 清除之前残留的错误状态
+  if (DTMCS_DMISTAT(dtmcs) != 0 && dmiReset(dmi) != RISCV_SUCCESS) {
+    goto FAILED;
+  }
+  INTERFACE_CONST_INIT(unsigned int, dmi->dmiApi.abits, DTMCS_ABITS(dtmcs));
+  dmi->scanBits = DTMCS_ABITS(dtmcs) + 34;
+  dmi->idle = DTMCS_IDLE(dtmcs);
+  dmi->dmiApi.Read = dmiRead;
+  dmi->dmiApi.Write = dmiWrite;
+  dmi->dmiApi.Commit = dmiCommit;
+  dmi->dmiApi.Cancel = dmiCancel;
+  log_info("DTM abits:%d, idle:%d.", dmi->dmiApi.abits, dmi->idle);
+  return &dmi->dmiApi;
+
+FAILED:
+  JtagDestroyScanChain(&dmi->chain);
+  free(dmi);
+  return NULL;
+}
+
+void RISCV_DestroyDmi(DMI *self) {
+  assert(self != NULL && *self != NULL);
+  struct riscvDmi *dmi = DMI_OBJ_FROM_API(*self);
+  dmiCancel(*self);
+  JtagDestroyScanChain(&dmi->chain);
+  free(dmi);
+  *self = NULL;
+}
@@ -29,3 +29,743 @@
  * Copyright 2023 Virus.V <virusv@live.com>
  */
 
+
+#include "Component/RISC-V/dm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Component/adapter/adapter_api.h"
+#include "Component/component.h"
+#include "Library/log/log.h"
+#include "Library/lua_api/api.h"
+#include "Library/lua_api/loop.h"
+#include "smartocd.h"
+
+#define RISCV_DMI_LUA_OBJECT_TYPE "arch.RISCV.DMI"
+#define RISCV_DM_LUA_OBJECT_TYPE "arch.RISCV.DM"
+#define RISCV_DM_WATCHER_LUA_OBJECT_TYPE "arch.RISCV.DM.Watcher"
+
+#define DM_WATCH_INTERVAL_MIN 1 // 状态监视的最小轮询间隔(ms)
+#define DM_WATCH_INTERVAL_MAX 8 // 状态没有变化时轮询间隔逐次加倍，直到该值(ms)，保证停止通知的延迟低于10ms
+
+/* hart状态监视器，在事件循环中轮询dmstatus，状态变化时调用Lua回调 */
+struct dmWatcher {
+  uv_timer_t timer;
+  lua_State *L;
+  DM dm;
+  int cbRef;             // 状态变化时的回调
+  int selfRef;           // 监视期间引用自身，防止被回收
+  BOOL halted;           // 最后一次通知的状态
+  unsigned int interval; // 下一次轮询的间隔
+};
+
+/**
+ * 通过JTAG DTM创建DMI对象
+ * 参数:
+ * 1# JTAG skill对象
+ * 2# DTM在扫描链上的序号(Optional，默认为0)
+ * 3# DTM的IR长度(Optional，默认自动探测)
+ * 返回值:
+ * 1# DMI对象
+ * 失败抛出错误
+ */
+static int luaApi_riscv_create_dmi(lua_State *L) {
+  void *udata = LuaApi_check_object_type(L, 1, SKILL_JTAG_LUA_OBJECT_TYPE);
+  if (udata == NULL) {
+    return luaL_error(L, "Not a vailed skill object!");
+  }
+  JtagSkill skillObj = *CAST(JtagSkill *, udata);
+  int tapIndex = CAST(int, luaL_optinteger(L, 2, 0));
+  int irLen = CAST(int, luaL_optinteger(L, 3, 0));
+
+  DMI *dmiObj = lua_newuserdatauv(L, sizeof(DMI), 1); // +1
+  *dmiObj = RISCV_CreateDmi(skillObj, tapIndex, irLen);
+  if (*dmiObj == NULL) {
+    return luaL_error(L, "Failed to create RISC-V DMI object.");
+  }
+
+  luaL_setmetatable(L, RISCV_DMI_LUA_OBJECT_TYPE);
+
+  // 引用JtagSkill对象
+  lua_pushvalue(L, 1);         // +1
+  lua_setiuservalue(L, -2, 1); // -1
+
+  return 1;
+}
+
+/**
+ * 读DM寄存器
+ * 1#:DMI对象
+ * 2#:寄存器地址
+ * 返回:
+ * 1#:寄存器的值
+ */
+static int luaApi_riscv_dmi_read_reg(lua_State *L) {
+  DMI dmiObj = *CAST(DMI *, luaL_checkudata(L, 1, RISCV_DMI_LUA_OBJECT_TYPE));
+  uint32_t addr = CAST(uint32_t, luaL_checkinteger(L, 2));
+  uint32_t data = 0;
+  dmiObj->Read(dmiObj, addr, &data);
+  if (dmiObj->Commit(dmiObj) != RISCV_SUCCESS) {
+    return luaL_error(L, "Read DM register 0x%02X failed!", addr);
+  }
+  lua_pushinteger(L, data);
+  return 1;
+}
+
+/**
+ * 写DM寄存器
+ * 1#:DMI对象
+ * 2#:寄存器地址
+ * 3#:写入的值
+ */
+static int luaApi_riscv_dmi_write_reg(lua_State *L) {
+  DMI dmiObj = *CAST(DMI *, luaL_checkudata(L, 1, RISCV_DMI_LUA_OBJECT_TYPE));
+  uint32_t addr = CAST(uint32_t, luaL_checkinteger(L, 2));
+  uint32_t data = CAST(uint32_t, luaL_checkinteger(L, 3));
+  dmiObj->Write(dmiObj, addr, data);
+  if (dmiObj->Commit(dmiObj) != RISCV_SUCCESS) {
+    return luaL_error(L, "Write DM register 0x%02X failed!", addr);
+  }
+  return 0;
+}
+
+/**
+ * 连续读多个DM寄存器，全部读取在一次提交中流水执行
+ * 1#:DMI对象
+ * 2#:起始寄存器地址
+ * 3#:寄存器个数
+ * 返回:
+ * 1#:寄存器值的数组
+ */
+static int luaApi_riscv_dmi_read_regs(lua_State *L) {
+  DMI dmiObj = *CAST(DMI *, luaL_checkudata(L, 1, RISCV_DMI_LUA_OBJECT_TYPE));
+  uint32_t addr = CAST(uint32_t, luaL_checkinteger(L, 2));
+  lua_Integer count = luaL_checkinteger(L, 3);
+  luaL_argcheck(L, count > 0, 3, "Count must be positive");
+
+  uint32_t *data = lua_newuserdatauv(L, count * sizeof(uint32_t), 0); // +1
+  for (lua_Integer i = 0; i < count; i++) {
+    dmiObj->Read(dmiObj, addr + i, data + i);
+  }
+  if (dmiObj->Commit(dmiObj) != RISCV_SUCCESS) {
+    return luaL_error(L, "Read DM registers 0x%02X-0x%02X failed!", addr, addr + count - 1);
+  }
+  lua_createtable(L, count, 0); // +1
+  for (lua_Integer i = 0; i < count; i++) {
+    lua_pushinteger(L, data[i]);
+    lua_rawseti(L, -2, i + 1);
+  }
+  return 1;
+}
+
+/**
+ * DMI垃圾回收函数
+ */
+static int luaApi_riscv_dmi_gc(lua_State *L) {
+  DMI *dmiObj = CAST(DMI *, luaL_checkudata(L, 1, RISCV_DMI_LUA_OBJECT_TYPE));
+  log_trace("[GC] RISC-V DMI");
+  if (*dmiObj != NULL) {
+    RISCV_DestroyDmi(dmiObj);
+  }
+  return 0;
+}
+
+/**
+ * 创建Debug Module对象
+ * 参数:
+ * 1# DMI对象
+ * 返回值:
+ * 1# DM对象
+ * 失败抛出错误
+ */
+static int luaApi_riscv_create_dm(lua_State *L) {
+  DMI dmiObj = *CAST(DMI *, luaL_checkudata(L, 1, RISCV_DMI_LUA_OBJECT_TYPE));
+
+  DM *dmObj = lua_newuserdatauv(L, sizeof(DM), 1); // +1
+  *dmObj = RISCV_CreateDm(dmiObj);
+  if (*dmObj == NULL) {
+    return luaL_error(L, "Failed to create RISC-V DM object.");
+  }
+
+  luaL_setmetatable(L, RISCV_DM_LUA_OBJECT_TYPE);
+
+  // 引用DMI对象
+  lua_pushvalue(L, 1);         // +1
+  lua_setiuservalue(L, -2, 1); // -1
+
+  return 1;
+}
+
+/**
+ * 停止hart
+ * 1#:DM对象
+ */
+static int luaApi_riscv_dm_halt(lua_State *L) {
+  DM dmObj = *CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  if (RISCV_DmHalt(dmObj) != RISCV_SUCCESS) {
+    return luaL_error(L, "Halt hart failed!");
+  }
+  return 0;
+}
+
+/**
+ * 选中hart，之后的操作都作用于该hart
+ * 1#:DM对象
+ * 2#:hart编号
+ */
+static int luaApi_riscv_dm_select_hart(lua_State *L) {
+  DM dmObj = *CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  unsigned int hart = CAST(unsigned int, luaL_checkinteger(L, 2));
+  if (RISCV_DmSelectHart(dmObj, hart) != RISCV_SUCCESS) {
+    return luaL_error(L, "Select hart %d failed!", hart);
+  }
+  return 0;
+}
+
+/**
+ * 将hart编号数组转换成C数组，参数为nil时返回全部hart
+ * 数组的内存由Lua管理，压入栈顶
+ */
+static unsigned int *luaApi_riscv_check_harts(lua_State *L, DM dmObj, int arg, unsigned int *count) {
+  unsigned int *harts;
+  if (lua_isnoneornil(L, arg)) {
+    *count = dmObj->hartCount;
+    harts = lua_newuserdatauv(L, *count * sizeof(unsigned int), 0);
+    for (unsigned int i = 0; i < *count; i++) {
+      harts[i] = i;
+    }
+    return harts;
+  }
+  luaL_checktype(L, arg, LUA_TTABLE);
+  lua_Integer len = luaL_len(L, arg);
+  luaL_argcheck(L, len > 0 && len <= dmObj->hartCount, arg, "Invalid hart count");
+  *count = CAST(unsigned int, len);
+  harts = lua_newuserdatauv(L, *count * sizeof(unsigned int), 0);
+  for (lua_Integer i = 0; i < len; i++) {
+    lua_geti(L, arg, i + 1);
+    harts[i] = CAST(unsigned int, luaL_checkinteger(L, -1));
+    lua_pop(L, 1);
+  }
+  return harts;
+}
+
+/**
+ * 同时停止一组hart
+ * 1#:DM对象
+ * 2#:hart编号数组，nil表示全部hart
+ */
+static int luaApi_riscv_dm_halt_harts(lua_State *L) {
+  DM dmObj = *CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  unsigned int count;
+  unsigned int *harts = luaApi_riscv_check_harts(L, dmObj, 2, &count);
+  if (RISCV_DmHaltHarts(dmObj, harts, count) != RISCV_SUCCESS) {
+    return luaL_error(L, "Halt harts failed!");
+  }
+  return 0;
+}
+
+/**
+ * 同时恢复一组hart运行
+ * 1#:DM对象
+ * 2#:hart编号数组，nil表示全部hart
+ */
+static int luaApi_riscv_dm_resume_harts(lua_State *L) {
+  DM dmObj = *CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  unsigned int count;
+  unsigned int *harts = luaApi_riscv_check_harts(L, dmObj, 2, &count);
+  if (RISCV_DmResumeHarts(dmObj, harts, count) != RISCV_SUCCESS) {
+    return luaL_error(L, "Resume harts failed!");
+  }
+  return 0;
+}
+
+/**
+ * 恢复hart运行
+ * 1#:DM对象
+ */
+static int luaApi_riscv_dm_run(lua_State *L) {
+  DM dmObj = *CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  if (RISCV_DmResume(dmObj) != RISCV_SUCCESS) {
+    return luaL_error(L, "Resume hart failed!");
+  }
+  return 0;
+}
+
+/**
+ * 复位系统
+ * 1#:DM对象
+ * 2#:复位后是否halt(Optional，默认为false)
+ */
+static int luaApi_riscv_dm_reset(lua_State *L) {
+  DM dmObj = *CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  BOOL halt = lua_toboolean(L, 2) ? TRUE : FALSE;
+  if (RISCV_DmReset(dmObj, halt) != RISCV_SUCCESS) {
+    return luaL_error(L, "Reset system failed!");
+  }
+  return 0;
+}
+
+/**
+ * hart是否处于halted状态
+ * 1#:DM对象
+ * 返回:
+ * 1#:是否halted
+ */
+static int luaApi_riscv_dm_is_halt(lua_State *L) {
+  DM dmObj = *CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  BOOL halted;
+  if (RISCV_DmIsHalted(dmObj, &halted) != RISCV_SUCCESS) {
+    return luaL_error(L, "Read dmstatus failed!");
+  }
+  lua_pushboolean(L, halted);
+  return 1;
+}
+
+/**
+ * 读写通用寄存器
+ * 1#:DM对象
+ * 2#:寄存器编号
+ * 3#:写入的值(Optional，为nil时读寄存器)
+ * 返回:
+ * 1#:读取的值
+ */
+static int luaApi_riscv_dm_access_gpr(lua_State *L) {
+  DM dmObj = *CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  unsigned int regno = CAST(unsigned int, luaL_checkinteger(L, 2));
+  uint32_t data = 0;
+  if (lua_isnoneornil(L, 3)) {
+    if (RISCV_DmReadGPR(dmObj, regno, &data) != RISCV_SUCCESS) {
+      return luaL_error(L, "Read GPR x%d failed!", regno);
+    }
+    lua_pushinteger(L, data);
+    return 1;
+  }
+  data = CAST(uint32_t, luaL_checkinteger(L, 3));
+  if (RISCV_DmWriteGPR(dmObj, regno, data) != RISCV_SUCCESS) {
+    return luaL_error(L, "Write GPR x%d failed!", regno);
+  }
+  return 0;
+}
+
+/**
+ * 读全部通用寄存器和pc，寄存器在hart停止时一次读取并缓存
+ * 1#:DM对象
+ * 返回:
+ * 1#:x0~x31的数组
+ * 2#:pc(dpc)
+ */
+static int luaApi_riscv_dm_read_registers(lua_State *L) {
+  DM dmObj = *CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  uint32_t gpr[32], pc;
+  if (RISCV_DmReadRegisters(dmObj, gpr) != RISCV_SUCCESS || RISCV_DmReadCSR(dmObj, 0x7B1, &pc) != RISCV_SUCCESS) {
+    return luaL_error(L, "Read registers failed!");
+  }
+  lua_createtable(L, 32, 0);
+  for (int i = 0; i < 32; i++) {
+    lua_pushinteger(L, gpr[i]);
+    lua_rawseti(L, -2, i + 1);
+  }
+  lua_pushinteger(L, pc);
+  return 2;
+}
+
+/**
+ * 读写CSR，被修改的s0恢复运行前自动写回
+ * 1#:DM对象
+ * 2#:CSR地址
+ * 3#:写入的值(Optional，为nil时读寄存器)
+ * 返回:
+ * 1#:读取的值
+ */
+static int luaApi_riscv_dm_access_csr(lua_State *L) {
+  DM dmObj = *CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  unsigned int csr = CAST(unsigned int, luaL_checkinteger(L, 2));
+  uint32_t data = 0;
+  if (lua_isnoneornil(L, 3)) {
+    if (RISCV_DmReadCSR(dmObj, csr, &data) != RISCV_SUCCESS) {
+      return luaL_error(L, "Read CSR 0x%03X failed!", csr);
+    }
+    lua_pushinteger(L, data);
+    return 1;
+  }
+  data = CAST(uint32_t, luaL_checkinteger(L, 3));
+  if (RISCV_DmWriteCSR(dmObj, csr, data) != RISCV_SUCCESS) {
+    return luaL_error(L, "Write CSR 0x%03X failed!", csr);
+  }
+  return 0;
+}
+
+/**
+ * 读写内存，被修改的s0和s1恢复运行前自动写回
+ * 1#:DM对象
+ * 2#:地址
+ * 3#:访问宽度:1、2、4
+ * 4#:写入的值(Optional，为nil时读内存)
+ * 返回:
+ * 1#:读取的值
+ */
+static int luaApi_riscv_dm_access_memory(lua_State *L) {
+  DM dmObj = *CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  uint32_t addr = CAST(uint32_t, luaL_checkinteger(L, 2));
+  unsigned int width = CAST(unsigned int, luaL_checkinteger(L, 3));
+  uint32_t data = 0;
+  if (lua_isnoneornil(L, 4)) {
+    if (RISCV_DmReadMemory(dmObj, addr, width, &data) != RISCV_SUCCESS) {
+      return luaL_error(L, "Read memory 0x%08X failed!", addr);
+    }
+    lua_pushinteger(L, data);
+    return 1;
+  }
+  data = CAST(uint32_t, luaL_checkinteger(L, 4));
+  if (RISCV_DmWriteMemory(dmObj, addr, width, data) != RISCV_SUCCESS) {
+    return luaL_error(L, "Write memory 0x%08X failed!", addr);
+  }
+  return 0;
+}
+
+/**
+ * 读取内存块，支持System Bus Access时hart运行中也可以读取
+ * 1#:DM对象
+ * 2#:起始地址
+ * 3#:单次访问宽度:1、2、4
+ * 4#:访问次数
+ * 返回:
+ * 1#:读取的数据 字符串形式
+ */
+static int luaApi_riscv_dm_block_read(lua_State *L) {
+  DM dmObj = *CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  uint32_t addr = CAST(uint32_t, luaL_checkinteger(L, 2));
+  unsigned int width = CAST(unsigned int, luaL_checkinteger(L, 3));
+  lua_Integer count = luaL_checkinteger(L, 4);
+  if (count < 0 || (width != 1 && width != 2 && width != 4)) {
+    return luaL_error(L, "Width or count is illegal!");
+  }
+  size_t buffLen = CAST(size_t, count) * width;
+  uint8_t *buff = CAST(uint8_t *, lua_newuserdatauv(L, buffLen, 0));
+  if (RISCV_DmReadBlock(dmObj, addr, width, CAST(unsigned int, count), buff) != RISCV_SUCCESS) {
+    return luaL_error(L, "Block read failed!");
+  }
+  lua_pushlstring(L, CAST(const char *, buff), buffLen);
+  return 1;
+}
+
+/**
+ * 写入内存块，支持System Bus Access时hart运行中也可以写入
+ * 1#:DM对象
+ * 2#:起始地址
+ * 3#:单次访问宽度:1、2、4
+ * 4#:要写的数据（字符串）
+ */
+static int luaApi_riscv_dm_block_write(lua_State *L) {
+  DM dmObj = *CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  uint32_t addr = CAST(uint32_t, luaL_checkinteger(L, 2));
+  unsigned int width = CAST(unsigned int, luaL_checkinteger(L, 3));
+  size_t buffLen;
+  const uint8_t *buff = CAST(const uint8_t *, luaL_checklstring(L, 4, &buffLen));
+  if (width != 1 && width != 2 && width != 4) {
+    return luaL_error(L, "Width is illegal!");
+  }
+  if (buffLen % width) {
+    return luaL_error(L, "The length of the data to be written is not a multiple of the width.");
+  }
+  if (RISCV_DmWriteBlock(dmObj, addr, width, CAST(unsigned int, buffLen / width), buff) != RISCV_SUCCESS) {
+    return luaL_error(L, "Block write failed!");
+  }
+  return 0;
+}
+
+/**
+ * 预留program buffer程序，重复执行时program buffer只写入一次
+ * 1#:DM对象
+ * 2#:指令数组，不需要包含末尾的ebreak
+ * 返回:
+ * 1#:程序id
+ */
+static int luaApi_riscv_dm_reserve_program(lua_State *L) {
+  DM dmObj = *CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  uint32_t insn[16];
+  unsigned int id;
+  luaL_checktype(L, 2, LUA_TTABLE);
+  lua_Integer count = luaL_len(L, 2);
+  luaL_argcheck(L, count > 0 && count <= 16, 2, "Invalid program length");
+  for (lua_Integer i = 0; i < count; i++) {
+    lua_geti(L, 2, i + 1);
+    insn[i] = CAST(uint32_t, luaL_checkinteger(L, -1));
+    lua_pop(L, 1);
+  }
+  if (RISCV_DmReserveProgram(dmObj, insn, CAST(unsigned int, count), &id) != RISCV_SUCCESS) {
+    return luaL_error(L, "Reserve program failed!");
+  }
+  lua_pushinteger(L, id);
+  return 1;
+}
+
+/**
+ * 释放预留的程序
+ * 1#:DM对象
+ * 2#:程序id
+ */
+static int luaApi_riscv_dm_release_program(lua_State *L) {
+  DM dmObj = *CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  unsigned int id = CAST(unsigned int, luaL_checkinteger(L, 2));
+  if (RISCV_DmReleaseProgram(dmObj, id) != RISCV_SUCCESS) {
+    return luaL_error(L, "Invalid program id %d.", id);
+  }
+  return 0;
+}
+
+/**
+ * 执行预留的程序，s0和s1的原值恢复运行前自动写回
+ * 1#:DM对象
+ * 2#:程序id
+ * 3#:执行前s0的值(Optional，默认为0)
+ * 4#:执行前s1的值(Optional，默认为0)
+ * 返回:
+ * 1#:执行后s0的值
+ * 2#:执行后s1的值
+ */
+static int luaApi_riscv_dm_execute_program(lua_State *L) {
+  DM dmObj = *CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  unsigned int id = CAST(unsigned int, luaL_checkinteger(L, 2));
+  uint32_t s0 = CAST(uint32_t, luaL_optinteger(L, 3, 0));
+  uint32_t s1 = CAST(uint32_t, luaL_optinteger(L, 4, 0));
+  if (RISCV_DmExecuteProgram(dmObj, id, &s0, &s1) != RISCV_SUCCESS) {
+    return luaL_error(L, "Execute program %d failed!", id);
+  }
+  lua_pushinteger(L, s0);
+  lua_pushinteger(L, s1);
+  return 2;
+}
+
+/**
+ * 获得DM的能力
+ * 1#:DM对象
+ * 返回:
+ * 1#:能力表
+ */
+static int luaApi_riscv_dm_get_feature(lua_State *L) {
+  DM dmObj = *CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  lua_createtable(L, 0, 9);
+  lua_pushinteger(L, dmObj->version);
+  lua_setfield(L, -2, "dm_version");
+  lua_pushinteger(L, dmObj->dataCount);
+  lua_setfield(L, -2, "datacount");
+  lua_pushinteger(L, dmObj->progbufSize);
+  lua_setfield(L, -2, "progbufsize");
+  lua_pushboolean(L, dmObj->impebreak);
+  lua_setfield(L, -2, "impebreak");
+  lua_pushboolean(L, dmObj->autoexec);
+  lua_setfield(L, -2, "autoexec");
+  lua_pushboolean(L, dmObj->postIncrement);
+  lua_setfield(L, -2, "aarpostincrement");
+  lua_pushinteger(L, dmObj->sbcs);
+  lua_setfield(L, -2, "sbcs");
+  lua_pushinteger(L, dmObj->hartCount);
+  lua_setfield(L, -2, "harts");
+  lua_pushboolean(L, dmObj->hartArray);
+  lua_setfield(L, -2, "hasel");
+  return 1;
+}
+
+/**
+ * 停止轮询并释放对自身的引用
+ */
+static void dmWatcherStop(struct dmWatcher *watcher) {
+  uv_timer_stop(&watcher->timer);
+  if (watcher->selfRef != LUA_NOREF) {
+    luaL_unref(watcher->L, LUA_REGISTRYINDEX, watcher->selfRef);
+    watcher->selfRef = LUA_NOREF;
+  }
+}
+
+/**
+ * 轮询一次dmstatus，状态变化时通知Lua并回到最小间隔，否则间隔加倍
+ */
+static void dmWatcherCallback(uv_timer_t *handle) {
+  struct dmWatcher *watcher = container_of(handle, struct dmWatcher, timer);
+  BOOL halted;
+
+  if (RISCV_DmIsHalted(watcher->dm, &halted) != RISCV_SUCCESS) {
+    log_warn("Failed to read hart status.");
+    halted = watcher->halted;
+  }
+  if (halted != watcher->halted) {
+    watcher->halted = halted;
+    watcher->interval = DM_WATCH_INTERVAL_MIN;
+    lua_pushboolean(watcher->L, halted);
+    LuaApi_do_callback(watcher->L, watcher->cbRef, 1);
+    // 回调中可能停止了监视
+    if (watcher->selfRef == LUA_NOREF) {
+      return;
+    }
+  } else if (watcher->interval < DM_WATCH_INTERVAL_MAX) {
+    watcher->interval = watcher->interval * 2 > DM_WATCH_INTERVAL_MAX ? DM_WATCH_INTERVAL_MAX : watcher->interval * 2;
+  }
+  uv_timer_start(&watcher->timer, dmWatcherCallback, watcher->interval, 0);
+}
+
+/**
+ * 创建hart状态监视器
+ * 1#:DM对象
+ * 2#:回调函数，参数为hart是否halted，只在状态变化时调用
+ * 返回:
+ * 1#:监视器对象
+ */
+static int luaApi_riscv_dm_create_watcher(lua_State *L) {
+  DM dmObj = *CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  luaL_argcheck(L, LuaApi_check_callable(L, 2), 2, "Must be an callable object");
+  struct loop *loop = LuaApi_loop_get_context(L);
+
+  struct dmWatcher **udata = lua_newuserdatauv(L, sizeof(struct dmWatcher *), 1); // +1
+  // uv句柄在关闭回调之前不能释放，所以不放在userdata中
+  struct dmWatcher *watcher = calloc(1, sizeof(struct dmWatcher));
+  if (watcher == NULL) {
+    return luaL_error(L, "Failed to create watcher.");
+  }
+  int ret = uv_timer_init(&loop->loop, &watcher->timer);
+  if (ret < 0) {
+    free(watcher);
+    return luaL_error(L, "uv_timer_init: %s: %s", uv_err_name(ret), uv_strerror(ret));
+  }
+  watcher->L = L;
+  watcher->dm = dmObj;
+  watcher->selfRef = LUA_NOREF;
+  lua_pushvalue(L, 2);
+  watcher->cbRef = luaL_ref(L, LUA_REGISTRYINDEX);
+  *udata = watcher;
+  luaL_setmetatable(L, RISCV_DM_WATCHER_LUA_OBJECT_TYPE);
+
+  // 引用DM对象
+  lua_pushvalue(L, 1);         // +1
+  lua_setiuservalue(L, -2, 1); // -1
+  return 1;
+}
+
+/**
+ * 开始监视
+ * 1#:监视器对象
+ * 2#:当前认为的状态(Optional，默认立即读取)，例如恢复运行之后传入false，
+ *    这样即使hart在第一次轮询之前就停止也会产生通知
+ */
+static int luaApi_riscv_dm_watcher_start(lua_State *L) {
+  struct dmWatcher *watcher = *CAST(struct dmWatcher **, luaL_checkudata(L, 1, RISCV_DM_WATCHER_LUA_OBJECT_TYPE));
+  if (lua_isnoneornil(L, 2)) {
+    if (RISCV_DmIsHalted(watcher->dm, &watcher->halted) != RISCV_SUCCESS) {
+      return luaL_error(L, "Read hart status failed!");
+    }
+  } else {
+    watcher->halted = lua_toboolean(L, 2) ? TRUE : FALSE;
+  }
+  if (watcher->selfRef == LUA_NOREF) {
+    lua_pushvalue(L, 1);
+    watcher->selfRef = luaL_ref(L, LUA_REGISTRYINDEX);
+  }
+  watcher->interval = DM_WATCH_INTERVAL_MIN;
+  int ret = uv_timer_start(&watcher->timer, dmWatcherCallback, 0, 0);
+  if (ret < 0) {
+    dmWatcherStop(watcher);
+    return luaL_error(L, "uv_timer_start: %s: %s", uv_err_name(ret), uv_strerror(ret));
+  }
+  return 0;
+}
+
+/**
+ * 停止监视
+ * 1#:监视器对象
+ */
+static int luaApi_riscv_dm_watcher_stop(lua_State *L) {
+  struct dmWatcher *watcher = *CAST(struct dmWatcher **, luaL_checkudata(L, 1, RISCV_DM_WATCHER_LUA_OBJECT_TYPE));
+  dmWatcherStop(watcher);
+  return 0;
+}
+
+static void dmWatcherClose(uv_handle_t *handle) {
+  free(container_of(CAST(uv_timer_t *, handle), struct dmWatcher, timer));
+}
+
+/**
+ * 监视器垃圾回收函数，关闭uv句柄之后释放内存
+ */
+static int luaApi_riscv_dm_watcher_gc(lua_State *L) {
+  struct dmWatcher *watcher = *CAST(struct dmWatcher **, luaL_checkudata(L, 1, RISCV_DM_WATCHER_LUA_OBJECT_TYPE));
+  log_trace("[GC] RISC-V DM Watcher");
+  uv_timer_stop(&watcher->timer);
+  luaL_unref(L, LUA_REGISTRYINDEX, watcher->cbRef);
+  uv_close(CAST(uv_handle_t *, &watcher->timer), dmWatcherClose);
+  return 0;
+}
+
+/**
+ * DM垃圾回收函数
+ */
+static int luaApi_riscv_dm_gc(lua_State *L) {
+  DM *dmObj = CAST(DM *, luaL_checkudata(L, 1, RISCV_DM_LUA_OBJECT_TYPE));
+  log_trace("[GC] RISC-V DM");
+  if (*dmObj != NULL) {
+    RISCV_DestroyDm(dmObj);
+  }
+  return 0;
+}
+
+// 模块静态函数
+static const luaL_Reg lib_riscv_f[] = {
+    {"CreateDmi", luaApi_riscv_create_dmi}, {"CreateDm", luaApi_riscv_create_dm}, {NULL, NULL}};
+
+// DMI的面向对象方法
+static const luaL_Reg lib_dmi_oo[] = {
+    {"ReadReg", luaApi_riscv_dmi_read_reg},
+    {"WriteReg", luaApi_riscv_dmi_write_reg},
+    {"ReadRegs", luaApi_riscv_dmi_read_regs},
+    {NULL, NULL}};
+
+// DM的面向对象方法
+static const luaL_Reg lib_dm_oo[] = {
+    {"Halt", luaApi_riscv_dm_halt},
+    {"Run", luaApi_riscv_dm_run},
+    {"Reset", luaApi_riscv_dm_reset},
+    {"IsHalt", luaApi_riscv_dm_is_halt},
+    {"SelectHart", luaApi_riscv_dm_select_hart},
+    {"HaltHarts", luaApi_riscv_dm_halt_harts},
+    {"ResumeHarts", luaApi_riscv_dm_resume_harts},
+    {"AccessGPR", luaApi_riscv_dm_access_gpr},
+    {"ReadRegisters", luaApi_riscv_dm_read_registers},
+    {"AccessCSR", luaApi_riscv_dm_access_csr},
+    {"AccessMemory", luaApi_riscv_dm_access_memory},
+    {"BlockRead", luaApi_riscv_dm_block_read},
+    {"BlockWrite", luaApi_riscv_dm_block_write},
+    {"ReserveProgram", luaApi_riscv_dm_reserve_program},
+    {"ReleaseProgram", luaApi_riscv_dm_release_program},
+    {"ExecuteProgram", luaApi_riscv_dm_execute_program},
+    {"GetFeature", luaApi_riscv_dm_get_feature},
+    {"CreateWatcher", luaApi_riscv_dm_create_watcher},
+    {NULL, NULL}};
+
+// 状态监视器的面向对象方法
+static const luaL_Reg lib_dm_watcher_oo[] = {
+    {"Start", luaApi_riscv_dm_watcher_start},
+    {"Stop", luaApi_riscv_dm_watcher_stop},
+    {NULL, NULL}};
+
+// 初始化RISC-V库
+int luaopen_riscv(lua_State *L) {
+  LuaApi_create_new_type(L, RISCV_DMI_LUA_OBJECT_TYPE, luaApi_riscv_dmi_gc, lib_dmi_oo, NULL);
+  LuaApi_create_new_type(L, RISCV_DM_LUA_OBJECT_TYPE, luaApi_riscv_dm_gc, lib_dm_oo, NULL);
+  LuaApi_create_new_type(L, RISCV_DM_WATCHER_LUA_OBJECT_TYPE, luaApi_riscv_dm_watcher_gc, lib_dm_watcher_oo, NULL);
+
+  lua_createtable(L, 0, sizeof(lib_riscv_f) / sizeof(lib_riscv_f[0]));
+  // 将函数注册进去
+  luaL_setfuncs(L, lib_riscv_f, 0);
+  return 1;
+}
+
+// 注册接口调用
+static int RegisterApi_RISCV(lua_State *L, void *opaque) {
+  luaL_requiref(L, "RISCV", luaopen_riscv, 0);
+  lua_pop(L, 1);
+
+  return 0;
+}
+
+COMPONENT_INIT(RISCV, RegisterApi_RISCV, NULL, COM_ADAPTER, 0);
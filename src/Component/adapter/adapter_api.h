@@ -40,6 +40,8 @@
 #define ADAPTER_LUA_OBJECT_TYPE "adapter"
 #define SKILL_DAP_LUA_OBJECT_TYPE "skill.dap"
 #define SKILL_JTAG_LUA_OBJECT_TYPE "skill.jtag"
+#define SKILL_DAP_BATCH_LUA_OBJECT_TYPE "skill.dap.batch"
+#define SKILL_JTAG_BATCH_LUA_OBJECT_TYPE "skill.jtag.batch"
 
 void LuaApi_jtag_skill_type_register(lua_State *L);
 void LuaApi_dap_skill_type_register(lua_State *L);
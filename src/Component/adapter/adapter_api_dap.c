@@ -32,6 +32,7 @@
 #include "Component/adapter/adapter_api.h"
 
 #include "Component/component.h"
+#include "Library/log/log.h"
 #include "Library/lua_api/api.h"
 
 /**
@@ -161,17 +162,320 @@ static int luaApi_adapter_dap_multi_write(lua_State *L) {
   return 0;
 }
 
+/* 批处理对象中记录的操作类型 */
+enum dap_batch_op_type {
+  DAP_BATCH_SINGLE_READ,  // 单次读
+  DAP_BATCH_SINGLE_WRITE, // 单次写
+  DAP_BATCH_MULTI_READ,   // 多次读
+  DAP_BATCH_MULTI_WRITE,  // 多次写
+};
+
+struct dap_batch_op {
+  enum dap_batch_op_type type;
+  enum dapRegType regType; // 寄存器类型 AP还是DP
+  int reg;                 // 寄存器号
+  int count;               // 读写次数
+  union {
+    uint32_t value;  // 单次读写的数据
+    uint32_t *buff;  // 多次读写的数据
+  } data;
+};
+
+/**
+ * DAP批处理对象
+ * 记录多个DAP寄存器操作，在Commit时一次性插入指令队列并执行，
+ * 整个批次只产生一次Commit，减少与仿真器的交互次数
+ */
+struct dap_batch {
+  DapSkill skillObj;        // 所属的DAP能力集
+  int count;                // 已记录的操作个数
+  int capacity;             // 操作数组容量
+  int resultCount;          // 会产生结果的操作个数
+  struct dap_batch_op *ops; // 操作数组
+};
+
+static struct dap_batch *luaApi_check_dap_batch(lua_State *L, int index) {
+  return CAST(struct dap_batch *, luaL_checkudata(L, index, SKILL_DAP_BATCH_LUA_OBJECT_TYPE));
+}
+
+/**
+ * 释放批处理对象中记录的全部操作
+ */
+static void dap_batch_clear(struct dap_batch *batch) {
+  for (int i = 0; i < batch->count; i++) {
+    if (batch->ops[i].type == DAP_BATCH_MULTI_READ || batch->ops[i].type == DAP_BATCH_MULTI_WRITE) {
+      free(batch->ops[i].data.buff);
+    }
+  }
+  batch->count = 0;
+  batch->resultCount = 0;
+}
+
+/**
+ * 在批处理对象中新增一个操作
+ * 先检查参数再占用操作槽，抛出错误时不会留下未初始化的操作
+ * 失败抛出错误
+ */
+static struct dap_batch_op *dap_batch_new_op(lua_State *L, struct dap_batch *batch, enum dap_batch_op_type type) {
+  enum dapRegType regType = (enum dapRegType)luaL_checkinteger(L, 2);
+  int reg = (int)luaL_checkinteger(L, 3);
+  struct dap_batch_op *op;
+  if (batch->count == batch->capacity) {
+    int newCapacity = batch->capacity ? batch->capacity << 1 : 16;
+    struct dap_batch_op *newOps = realloc(batch->ops, newCapacity * sizeof(struct dap_batch_op));
+    if (newOps == NULL) {
+      luaL_error(L, "Batch op buff alloc Failed!");
+      return NULL;
+    }
+    batch->ops = newOps;
+    batch->capacity = newCapacity;
+  }
+  op = &batch->ops[batch->count++];
+  op->type = type;
+  op->regType = regType;
+  op->reg = reg;
+  op->count = 1;
+  op->data.buff = NULL;
+  return op;
+}
+
+/**
+ * 创建DAP批处理对象
+ * 1#:DAP skill对象
+ * 返回:
+ * 1#:批处理对象
+ */
+static int luaApi_adapter_dap_batch(lua_State *L) {
+  DapSkill skillObj = *CAST(DapSkill *, luaL_checkudata(L, 1, SKILL_DAP_LUA_OBJECT_TYPE));
+
+  struct dap_batch *batch = CAST(struct dap_batch *, lua_newuserdatauv(L, sizeof(struct dap_batch), 1)); // +1
+  memset(batch, 0, sizeof(struct dap_batch));
+  batch->skillObj = skillObj;
+
+  luaL_setmetatable(L, SKILL_DAP_BATCH_LUA_OBJECT_TYPE);
+
+  // 引用skill对象，防止被回收
+  lua_pushvalue(L, 1);         // +1
+  lua_setiuservalue(L, -2, 1); // -1
+
+  return 1;
+}
+
+/**
+ * 记录DAP单次读寄存器
+ * 1#:批处理对象
+ * 2#:type寄存器类型 AP还是DP
+ * 3#:reg 寄存器号
+ * 返回:
+ * 1#:该操作的结果在Commit返回值中的序号
+ */
+static int luaApi_dap_batch_single_read(lua_State *L) {
+  struct dap_batch *batch = luaApi_check_dap_batch(L, 1);
+
+  dap_batch_new_op(L, batch, DAP_BATCH_SINGLE_READ)->data.value = 0;
+  lua_pushinteger(L, ++batch->resultCount);
+  return 1;
+}
+
+/**
+ * 记录DAP单次写寄存器
+ * 1#:批处理对象
+ * 2#:type寄存器类型 AP还是DP
+ * 3#:reg 寄存器号
+ * 4#:data 写的值
+ */
+static int luaApi_dap_batch_single_write(lua_State *L) {
+  struct dap_batch *batch = luaApi_check_dap_batch(L, 1);
+  uint32_t data = (uint32_t)luaL_checkinteger(L, 4);
+
+  dap_batch_new_op(L, batch, DAP_BATCH_SINGLE_WRITE)->data.value = data;
+  return 0;
+}
+
+/**
+ * 记录DAP多次读寄存器
+ * 1#:批处理对象
+ * 2#:type寄存器类型 AP还是DP
+ * 3#:reg 寄存器号
+ * 4#:count 读取次数
+ * 返回:
+ * 1#:该操作的结果在Commit返回值中的序号
+ */
+static int luaApi_dap_batch_multi_read(lua_State *L) {
+  struct dap_batch *batch = luaApi_check_dap_batch(L, 1);
+  int count = (int)luaL_checkinteger(L, 4);
+  struct dap_batch_op *op;
+
+  if (count <= 0) {
+    return luaL_error(L, "Multi-read count is illegal!");
+  }
+
+  op = dap_batch_new_op(L, batch, DAP_BATCH_MULTI_READ);
+  op->count = count;
+  op->data.buff = malloc(count * sizeof(uint32_t));
+  if (op->data.buff == NULL) {
+    batch->count--;
+    return luaL_error(L, "Multi-read buff alloc Failed!");
+  }
+
+  lua_pushinteger(L, ++batch->resultCount);
+  return 1;
+}
+
+/**
+ * 记录DAP多次写寄存器
+ * 1#:批处理对象
+ * 2#:type寄存器类型 AP还是DP
+ * 3#:reg 寄存器号
+ * 4#:data 写的数据(字符串)
+ */
+static int luaApi_dap_batch_multi_write(lua_State *L) {
+  struct dap_batch *batch = luaApi_check_dap_batch(L, 1);
+  size_t transCnt;
+  const char *data = luaL_checklstring(L, 4, &transCnt);
+  struct dap_batch_op *op;
+
+  if (transCnt == 0 || (transCnt & 0x3)) {
+    return luaL_error(L, "The length of the data to be written is not a multiple of the word.");
+  }
+
+  op = dap_batch_new_op(L, batch, DAP_BATCH_MULTI_WRITE);
+  op->count = (int)(transCnt >> 2);
+  op->data.buff = malloc(transCnt);
+  if (op->data.buff == NULL) {
+    batch->count--;
+    return luaL_error(L, "Multi-write buff alloc Failed!");
+  }
+  memcpy(op->data.buff, data, transCnt);
+
+  return 0;
+}
+
+/**
+ * 执行批处理对象中记录的全部操作
+ * 所有操作插入指令队列后只执行一次Commit，执行完毕后批处理对象被清空，可以继续记录
+ * 1#:批处理对象
+ * 2#:是否将结果拼接成一个字符串返回(Optional，默认false)
+ * 返回:
+ * 1#:按记录顺序排列的结果表，SingleRead的结果为整数，MultiRead的结果为字符串；
+ *    或者拼接后的字符串，SingleRead的结果按4字节拼接
+ */
+static int luaApi_dap_batch_commit(lua_State *L) {
+  struct dap_batch *batch = luaApi_check_dap_batch(L, 1);
+  DapSkill skillObj = batch->skillObj;
+  int packed = lua_toboolean(L, 2);
+  int ret = ADPT_SUCCESS;
+
+  for (int i = 0; i < batch->count && ret == ADPT_SUCCESS; i++) {
+    struct dap_batch_op *op = &batch->ops[i];
+    switch (op->type) {
+    case DAP_BATCH_SINGLE_READ:
+      ret = skillObj->SingleRead(skillObj, op->regType, op->reg, &op->data.value);
+      break;
+    case DAP_BATCH_SINGLE_WRITE:
+      ret = skillObj->SingleWrite(skillObj, op->regType, op->reg, op->data.value);
+      break;
+    case DAP_BATCH_MULTI_READ:
+      ret = skillObj->MultiRead(skillObj, op->regType, op->reg, op->count, op->data.buff);
+      break;
+    case DAP_BATCH_MULTI_WRITE:
+      ret = skillObj->MultiWrite(skillObj, op->regType, op->reg, op->count, op->data.buff);
+      break;
+    }
+  }
+
+  if (ret != ADPT_SUCCESS) {
+    skillObj->Cancel(skillObj);
+    dap_batch_clear(batch);
+    return luaL_error(L, "Insert to instruction queue failed!");
+  }
+
+  // 执行队列
+  if (skillObj->Commit(skillObj) != ADPT_SUCCESS) {
+    // 清理指令队列
+    skillObj->Cancel(skillObj);
+    dap_batch_clear(batch);
+    return luaL_error(L, "Execute the instruction queue failed!");
+  }
+
+  // 构造返回值
+  if (packed) {
+    luaL_Buffer buff;
+    luaL_buffinit(L, &buff);
+    for (int i = 0; i < batch->count; i++) {
+      struct dap_batch_op *op = &batch->ops[i];
+      if (op->type == DAP_BATCH_SINGLE_READ) {
+        luaL_addlstring(&buff, (const char *)&op->data.value, sizeof(uint32_t));
+      } else if (op->type == DAP_BATCH_MULTI_READ) {
+        luaL_addlstring(&buff, (const char *)op->data.buff, op->count * sizeof(uint32_t));
+      }
+    }
+    luaL_pushresult(&buff);
+  } else {
+    int idx = 1;
+    lua_createtable(L, batch->resultCount, 0);
+    for (int i = 0; i < batch->count; i++) {
+      struct dap_batch_op *op = &batch->ops[i];
+      if (op->type == DAP_BATCH_SINGLE_READ) {
+        lua_pushinteger(L, op->data.value);
+      } else if (op->type == DAP_BATCH_MULTI_READ) {
+        lua_pushlstring(L, (const char *)op->data.buff, op->count * sizeof(uint32_t));
+      } else {
+        continue;
+      }
+      lua_rawseti(L, -2, idx++);
+    }
+  }
+
+  dap_batch_clear(batch);
+  return 1;
+}
+
+/**
+ * 丢弃批处理对象中记录的全部操作
+ * 1#:批处理对象
+ */
+static int luaApi_dap_batch_reset(lua_State *L) {
+  dap_batch_clear(luaApi_check_dap_batch(L, 1));
+  return 0;
+}
+
+/**
+ * DAP批处理对象垃圾回收函数
+ */
+static int luaApi_dap_batch_gc(lua_State *L) {
+  struct dap_batch *batch = luaApi_check_dap_batch(L, 1);
+  log_trace("[GC] DAP batch");
+  dap_batch_clear(batch);
+  free(batch->ops);
+  batch->ops = NULL;
+  batch->capacity = 0;
+  return 0;
+}
+
 static const luaL_Reg lib_dap_skill_oo[] = {
     // DAP相关接口
     {"SingleRead", luaApi_adapter_dap_single_read},
     {"SingleWrite", luaApi_adapter_dap_single_write},
     {"MultiRead", luaApi_adapter_dap_multi_read},
     {"MultiWrite", luaApi_adapter_dap_multi_write},
+    {"Batch", luaApi_adapter_dap_batch},
+    {NULL, NULL}};
+
+static const luaL_Reg lib_dap_batch_oo[] = {
+    // DAP批处理接口
+    {"SingleRead", luaApi_dap_batch_single_read},
+    {"SingleWrite", luaApi_dap_batch_single_write},
+    {"MultiRead", luaApi_dap_batch_multi_read},
+    {"MultiWrite", luaApi_dap_batch_multi_write},
+    {"Commit", luaApi_dap_batch_commit},
+    {"Reset", luaApi_dap_batch_reset},
     {NULL, NULL}};
 
 /* 注册DAP能力集对象元表 */
 void LuaApi_dap_skill_type_register(lua_State *L) {
   LuaApi_create_new_type(L, SKILL_DAP_LUA_OBJECT_TYPE, NULL, lib_dap_skill_oo, NULL);
+  LuaApi_create_new_type(L, SKILL_DAP_BATCH_LUA_OBJECT_TYPE, luaApi_dap_batch_gc, lib_dap_batch_oo, NULL);
 }
 
 /* 创建DAP能力集对象 */
@@ -33,6 +33,8 @@
 
 #include "Component/component.h"
 #include "Library/jtag/jtag.h"
+#include "Library/jtag/scan_chain.h"
+#include "Library/log/log.h"
 #include "Library/lua_api/api.h"
 
 /**
@@ -154,18 +156,311 @@ static int luaApi_adapter_jtag_pins(lua_State *L) {
   return 1;
 }
 
+/**
+ * 探测JTAG扫描链
+ * 1#:JTAG skill对象
+ * 返回:
+ * 1#:TAP信息表，从离TDO最近的TAP开始，每一项为 {IDCODE = 整数, IrLen = 整数}
+ *    IDCODE为0表示该TAP没有IDCODE寄存器，IrLen为0表示无法推断IR长度
+ */
+static int luaApi_adapter_jtag_scan_chain(lua_State *L) {
+  JtagSkill skillObj = *CAST(JtagSkill *, luaL_checkudata(L, 1, SKILL_JTAG_LUA_OBJECT_TYPE));
+  JtagScanChain chain = JtagCreateScanChain(skillObj);
+  int ret;
+
+  if (chain == NULL) {
+    return luaL_error(L, "Failed to create scan chain object!");
+  }
+
+  ret = JtagScanChainDetect(chain);
+  if (ret != ADPT_SUCCESS && ret != ADPT_ERR_PROTOCOL_ERROR) {
+    JtagDestroyScanChain(&chain);
+    return luaL_error(L, "Detect JTAG scan chain failed!");
+  }
+
+  lua_createtable(L, chain->tapCount, 0);
+  for (int i = 0; i < chain->tapCount; i++) {
+    lua_createtable(L, 0, 2);
+    lua_pushinteger(L, chain->taps[i].idcode);
+    lua_setfield(L, -2, "IDCODE");
+    lua_pushinteger(L, chain->taps[i].irLen);
+    lua_setfield(L, -2, "IrLen");
+    lua_rawseti(L, -2, i + 1);
+  }
+  JtagDestroyScanChain(&chain);
+  return 1;
+}
+
+/* 批处理对象中记录的操作类型 */
+enum jtag_batch_op_type {
+  JTAG_BATCH_TO_STATE,      // 切换状态
+  JTAG_BATCH_IDLE,          // Idle等待
+  JTAG_BATCH_EXCHANGE_DATA, // 交换TDI TDO
+};
+
+struct jtag_batch_op {
+  enum jtag_batch_op_type type;
+  union {
+    enum JTAG_TAP_State state; // 目标状态
+    unsigned int cycles;       // 等待周期
+    struct {
+      uint8_t *data;         // TDI数据，执行后被TDO覆盖
+      size_t len;            // 缓冲区字节数
+      unsigned int bitCount; // 二进制位个数
+    } exchange;
+  } param;
+};
+
+/**
+ * JTAG批处理对象
+ * 记录多个JTAG操作，在Commit时一次性插入指令队列并执行，
+ * 整个批次只产生一次Commit，减少与仿真器的交互次数
+ */
+struct jtag_batch {
+  JtagSkill skillObj;          // 所属的JTAG能力集
+  int count;                   // 已记录的操作个数
+  int capacity;                // 操作数组容量
+  int resultCount;             // 会产生结果的操作个数
+  struct jtag_batch_op *ops;   // 操作数组
+};
+
+static struct jtag_batch *luaApi_check_jtag_batch(lua_State *L, int index) {
+  return CAST(struct jtag_batch *, luaL_checkudata(L, index, SKILL_JTAG_BATCH_LUA_OBJECT_TYPE));
+}
+
+/**
+ * 释放批处理对象中记录的全部操作
+ */
+static void jtag_batch_clear(struct jtag_batch *batch) {
+  for (int i = 0; i < batch->count; i++) {
+    if (batch->ops[i].type == JTAG_BATCH_EXCHANGE_DATA) {
+      free(batch->ops[i].param.exchange.data);
+    }
+  }
+  batch->count = 0;
+  batch->resultCount = 0;
+}
+
+/**
+ * 在批处理对象中新增一个操作
+ * 失败抛出错误
+ */
+static struct jtag_batch_op *jtag_batch_new_op(lua_State *L, struct jtag_batch *batch, enum jtag_batch_op_type type) {
+  if (batch->count == batch->capacity) {
+    int newCapacity = batch->capacity ? batch->capacity << 1 : 16;
+    struct jtag_batch_op *newOps = realloc(batch->ops, newCapacity * sizeof(struct jtag_batch_op));
+    if (newOps == NULL) {
+      luaL_error(L, "Batch op buff alloc Failed!");
+      return NULL;
+    }
+    batch->ops = newOps;
+    batch->capacity = newCapacity;
+  }
+  batch->ops[batch->count].type = type;
+  return &batch->ops[batch->count++];
+}
+
+/**
+ * 创建JTAG批处理对象
+ * 1#:JTAG skill对象
+ * 返回:
+ * 1#:批处理对象
+ */
+static int luaApi_adapter_jtag_batch(lua_State *L) {
+  JtagSkill skillObj = *CAST(JtagSkill *, luaL_checkudata(L, 1, SKILL_JTAG_LUA_OBJECT_TYPE));
+
+  struct jtag_batch *batch = CAST(struct jtag_batch *, lua_newuserdatauv(L, sizeof(struct jtag_batch), 1)); // +1
+  memset(batch, 0, sizeof(struct jtag_batch));
+  batch->skillObj = skillObj;
+
+  luaL_setmetatable(L, SKILL_JTAG_BATCH_LUA_OBJECT_TYPE);
+
+  // 引用skill对象，防止被回收
+  lua_pushvalue(L, 1);         // +1
+  lua_setiuservalue(L, -2, 1); // -1
+
+  return 1;
+}
+
+/**
+ * 记录JTAG状态机切换
+ * 1#:批处理对象
+ * 2#:状态
+ */
+static int luaApi_jtag_batch_to_state(lua_State *L) {
+  struct jtag_batch *batch = luaApi_check_jtag_batch(L, 1);
+  enum JTAG_TAP_State state = (enum JTAG_TAP_State)luaL_checkinteger(L, 2);
+
+  if (state < JTAG_TAP_RESET || state > JTAG_TAP_IRUPDATE) {
+    return luaL_error(L, "JTAG state machine new state is illegal!");
+  }
+
+  jtag_batch_new_op(L, batch, JTAG_BATCH_TO_STATE)->param.state = state;
+  return 0;
+}
+
+/**
+ * 记录Idle等待
+ * 1#:批处理对象
+ * 2#:cycles要进入Idle等待的周期
+ */
+static int luaApi_jtag_batch_idle_wait(lua_State *L) {
+  struct jtag_batch *batch = luaApi_check_jtag_batch(L, 1);
+  unsigned int cycles = (unsigned int)luaL_checkinteger(L, 2);
+
+  jtag_batch_new_op(L, batch, JTAG_BATCH_IDLE)->param.cycles = cycles;
+  return 0;
+}
+
+/**
+ * 记录交换TDI TDO
+ * 1#:批处理对象
+ * 2#:TDI数据字符串
+ * 3#:二进制位个数
+ * 返回:
+ * 1#:该操作的结果在Commit返回值中的序号
+ */
+static int luaApi_jtag_batch_exchange_data(lua_State *L) {
+  struct jtag_batch *batch = luaApi_check_jtag_batch(L, 1);
+  size_t str_len = 0;
+  const char *tdi_data = luaL_checklstring(L, 2, &str_len);
+  unsigned int bitCnt = (unsigned int)luaL_checkinteger(L, 3);
+  struct jtag_batch_op *op;
+
+  // 判断bit长度是否合法
+  if ((str_len << 3) < bitCnt) {
+    return luaL_error(L, "TDI data length is illegal!");
+  }
+
+  op = jtag_batch_new_op(L, batch, JTAG_BATCH_EXCHANGE_DATA);
+  op->param.exchange.data = malloc(str_len * sizeof(uint8_t));
+  if (op->param.exchange.data == NULL) {
+    batch->count--;
+    return luaL_error(L, "TDI data buff alloc Failed!");
+  }
+  memcpy(op->param.exchange.data, tdi_data, str_len * sizeof(uint8_t));
+  op->param.exchange.len = str_len;
+  op->param.exchange.bitCount = bitCnt;
+
+  lua_pushinteger(L, ++batch->resultCount);
+  return 1;
+}
+
+/**
+ * 执行批处理对象中记录的全部操作
+ * 所有操作插入指令队列后只执行一次Commit，执行完毕后批处理对象被清空，可以继续记录
+ * 1#:批处理对象
+ * 2#:是否将结果拼接成一个字符串返回(Optional，默认false)
+ * 返回:
+ * 1#:按记录顺序排列的TDO数据表，或拼接后的字符串
+ */
+static int luaApi_jtag_batch_commit(lua_State *L) {
+  struct jtag_batch *batch = luaApi_check_jtag_batch(L, 1);
+  JtagSkill skillObj = batch->skillObj;
+  int packed = lua_toboolean(L, 2);
+  int ret = ADPT_SUCCESS;
+
+  for (int i = 0; i < batch->count && ret == ADPT_SUCCESS; i++) {
+    struct jtag_batch_op *op = &batch->ops[i];
+    switch (op->type) {
+    case JTAG_BATCH_TO_STATE:
+      ret = skillObj->ToState(skillObj, op->param.state);
+      break;
+    case JTAG_BATCH_IDLE:
+      ret = skillObj->Idle(skillObj, op->param.cycles);
+      break;
+    case JTAG_BATCH_EXCHANGE_DATA:
+      ret = skillObj->ExchangeData(skillObj, op->param.exchange.data, op->param.exchange.bitCount);
+      break;
+    }
+  }
+
+  if (ret != ADPT_SUCCESS) {
+    skillObj->Cancel(skillObj);
+    jtag_batch_clear(batch);
+    return luaL_error(L, "Insert to instruction queue failed!");
+  }
+
+  // 执行队列
+  if (skillObj->Commit(skillObj) != ADPT_SUCCESS) {
+    // 清理指令队列
+    skillObj->Cancel(skillObj);
+    jtag_batch_clear(batch);
+    return luaL_error(L, "Execute the instruction queue failed!");
+  }
+
+  // 构造返回值
+  if (packed) {
+    luaL_Buffer buff;
+    luaL_buffinit(L, &buff);
+    for (int i = 0; i < batch->count; i++) {
+      if (batch->ops[i].type == JTAG_BATCH_EXCHANGE_DATA) {
+        luaL_addlstring(&buff, (const char *)batch->ops[i].param.exchange.data, batch->ops[i].param.exchange.len);
+      }
+    }
+    luaL_pushresult(&buff);
+  } else {
+    int idx = 1;
+    lua_createtable(L, batch->resultCount, 0);
+    for (int i = 0; i < batch->count; i++) {
+      if (batch->ops[i].type == JTAG_BATCH_EXCHANGE_DATA) {
+        lua_pushlstring(L, (const char *)batch->ops[i].param.exchange.data, batch->ops[i].param.exchange.len);
+        lua_rawseti(L, -2, idx++);
+      }
+    }
+  }
+
+  jtag_batch_clear(batch);
+  return 1;
+}
+
+/**
+ * 丢弃批处理对象中记录的全部操作
+ * 1#:批处理对象
+ */
+static int luaApi_jtag_batch_reset(lua_State *L) {
+  jtag_batch_clear(luaApi_check_jtag_batch(L, 1));
+  return 0;
+}
+
+/**
+ * JTAG批处理对象垃圾回收函数
+ */
+static int luaApi_jtag_batch_gc(lua_State *L) {
+  struct jtag_batch *batch = luaApi_check_jtag_batch(L, 1);
+  log_trace("[GC] JTAG batch");
+  jtag_batch_clear(batch);
+  free(batch->ops);
+  batch->ops = NULL;
+  batch->capacity = 0;
+  return 0;
+}
+
 static const luaL_Reg lib_jtag_skill_oo[] = {
     // JTAG相关接口
     {"ExchangeData", luaApi_adapter_jtag_exchange_data},
     {"Idle", luaApi_adapter_jtag_idle_wait},
     {"ToState", luaApi_adapter_jtag_status_change},
     {"Pins", luaApi_adapter_jtag_pins},
+    {"Batch", luaApi_adapter_jtag_batch},
+    {"ScanChain", luaApi_adapter_jtag_scan_chain},
+
+    {NULL, NULL}};
+
+static const luaL_Reg lib_jtag_batch_oo[] = {
+    // JTAG批处理接口
+    {"ExchangeData", luaApi_jtag_batch_exchange_data},
+    {"Idle", luaApi_jtag_batch_idle_wait},
+    {"ToState", luaApi_jtag_batch_to_state},
+    {"Commit", luaApi_jtag_batch_commit},
+    {"Reset", luaApi_jtag_batch_reset},
 
     {NULL, NULL}};
 
 /* 注册JTAG能力集对象元表 */
 void LuaApi_jtag_skill_type_register(lua_State *L) {
   LuaApi_create_new_type(L, SKILL_JTAG_LUA_OBJECT_TYPE, NULL, lib_jtag_skill_oo, NULL);
+  LuaApi_create_new_type(L, SKILL_JTAG_BATCH_LUA_OBJECT_TYPE, luaApi_jtag_batch_gc, lib_jtag_batch_oo, NULL);
 }
 
 /* 创建JTAG能力集对象 */
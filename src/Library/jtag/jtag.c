@@ -33,9 +33,30 @@
 
 #include "log/log.h"
 
-// 判断一个状态是不是在某个阶段中
-#define JTAG_IN_DR(state) (JTAG_TAP_DRSELECT <= (state) && (state) <= JTAG_TAP_DRUPDATE)
-#define JTAG_IN_IR(state) (JTAG_TAP_IRSELECT <= (state) && (state) <= JTAG_TAP_IRUPDATE)
+/**
+ * 任意两个TAP状态之间切换的TMS时序表，tmsPathTable[fromState][toState]
+ * 每一项的格式与TMS_SeqInfo相同：高8位为时序信息（最低位先发送），低8位为时序个数
+ * 路径不经过除目标状态以外的SHIFT状态，避免移位数据寄存器
+ */
+static const TMS_SeqInfo tmsPathTable[16][16] = {
+    /* from/to       RESET   IDLE    DRSEL   DRCAP   DRSHIFT DREXIT1 DRPAUSE DREXIT2 DRUPD   IRSEL   IRCAP   IRSHIFT IREXIT1 IRPAUSE IREXIT2 IRUPD */
+    /* RESET     */ {0x0000, 0x0001, 0x0202, 0x0203, 0x0204, 0x0A04, 0x0A05, 0x2A06, 0x1A05, 0x0603, 0x0604, 0x0605, 0x1605, 0x1606, 0x5607, 0x3606},
+    /* IDLE      */ {0x0703, 0x0000, 0x0101, 0x0102, 0x0103, 0x0503, 0x0504, 0x1505, 0x0D04, 0x0302, 0x0303, 0x0304, 0x0B04, 0x0B05, 0x2B06, 0x1B05},
+    /* DRSELECT  */ {0x0302, 0x0303, 0x0000, 0x0001, 0x0002, 0x0202, 0x0203, 0x0A04, 0x0603, 0x0101, 0x0102, 0x0103, 0x0503, 0x0504, 0x1505, 0x0D04},
+    /* DRCAPTURE */ {0x1F05, 0x0303, 0x0703, 0x0000, 0x0001, 0x0101, 0x0102, 0x0503, 0x0302, 0x0F04, 0x0F05, 0x0F06, 0x2F06, 0x2F07, 0xAF08, 0x6F07},
+    /* DRSHIFT   */ {0x1F05, 0x0303, 0x0703, 0x0704, 0x0000, 0x0101, 0x0102, 0x0503, 0x0302, 0x0F04, 0x0F05, 0x0F06, 0x2F06, 0x2F07, 0xAF08, 0x6F07},
+    /* DREXIT1   */ {0x0F04, 0x0102, 0x0302, 0x0303, 0x0304, 0x0000, 0x0001, 0x0202, 0x0101, 0x0703, 0x0704, 0x0705, 0x1705, 0x1706, 0x5707, 0x3706},
+    /* DRPAUSE   */ {0x1F05, 0x0303, 0x0703, 0x0704, 0x0102, 0x1705, 0x0000, 0x0101, 0x0302, 0x0F04, 0x0F05, 0x0F06, 0x2F06, 0x2F07, 0xAF08, 0x6F07},
+    /* DREXIT2   */ {0x0F04, 0x0102, 0x0302, 0x0303, 0x0001, 0x0B04, 0x0B05, 0x0000, 0x0101, 0x0703, 0x0704, 0x0705, 0x1705, 0x1706, 0x5707, 0x3706},
+    /* DRUPDATE  */ {0x0703, 0x0001, 0x0101, 0x0102, 0x0103, 0x0503, 0x0504, 0x1505, 0x0000, 0x0302, 0x0303, 0x0304, 0x0B04, 0x0B05, 0x2B06, 0x1B05},
+    /* IRSELECT  */ {0x0101, 0x0102, 0x0503, 0x0504, 0x0505, 0x1505, 0x1506, 0x5507, 0x3506, 0x0000, 0x0001, 0x0002, 0x0202, 0x0203, 0x0A04, 0x0603},
+    /* IRCAPTURE */ {0x1F05, 0x0303, 0x0703, 0x0704, 0x0705, 0x1705, 0x1706, 0x5707, 0x3706, 0x0F04, 0x0000, 0x0001, 0x0101, 0x0102, 0x0503, 0x0302},
+    /* IRSHIFT   */ {0x1F05, 0x0303, 0x0703, 0x0704, 0x0705, 0x1705, 0x1706, 0x5707, 0x3706, 0x0F04, 0x0F05, 0x0000, 0x0101, 0x0102, 0x0503, 0x0302},
+    /* IREXIT1   */ {0x0F04, 0x0102, 0x0302, 0x0303, 0x0304, 0x0B04, 0x0B05, 0x2B06, 0x1B05, 0x0703, 0x0704, 0x0705, 0x0000, 0x0001, 0x0202, 0x0101},
+    /* IRPAUSE   */ {0x1F05, 0x0303, 0x0703, 0x0704, 0x0705, 0x1705, 0x1706, 0x5707, 0x3706, 0x0F04, 0x0F05, 0x0102, 0x2F06, 0x0000, 0x0101, 0x0302},
+    /* IREXIT2   */ {0x0F04, 0x0102, 0x0302, 0x0303, 0x0304, 0x0B04, 0x0B05, 0x2B06, 0x1B05, 0x0703, 0x0704, 0x0001, 0x1705, 0x1706, 0x0000, 0x0101},
+    /* IRUPDATE  */ {0x0703, 0x0001, 0x0101, 0x0102, 0x0103, 0x0503, 0x0504, 0x1505, 0x0D04, 0x0302, 0x0303, 0x0304, 0x0B04, 0x0B05, 0x2B06, 0x0000},
+};
 
 /**
  * 用于产生在当前状态到指定状态的TMS时序
@@ -45,141 +66,50 @@
 TMS_SeqInfo JtagGetTmsSequence(enum JTAG_TAP_State fromState, enum JTAG_TAP_State toState) {
   assert(fromState >= JTAG_TAP_RESET && fromState <= JTAG_TAP_IRUPDATE);
   assert(toState >= JTAG_TAP_RESET && toState <= JTAG_TAP_IRUPDATE);
-  int sequence, idx;
-#define _SET_BIT_(x) (sequence |= ((x) << idx))
-  for (sequence = 0, idx = 8; fromState != toState; sequence++, idx++) {
-    switch (fromState) {
-      case JTAG_TAP_RESET:
-        // 复位状态只有一个指向下一个相邻的状态，直接赋值
-        fromState = JTAG_TAP_IDLE;
-        _SET_BIT_(0);  // TMS =0 切换到IDLE状态
-        break;
-      case JTAG_TAP_IDLE:
-        fromState = JTAG_TAP_DRSELECT;
-        _SET_BIT_(1);
-        break;
-      case JTAG_TAP_DRSELECT:
-        if (JTAG_IN_DR(toState)) {
-          fromState = JTAG_TAP_DRCAPTURE;
-          _SET_BIT_(0);
-        } else {
-          fromState = JTAG_TAP_IRSELECT;
-          _SET_BIT_(1);
-        }
-        break;
-      case JTAG_TAP_DRCAPTURE:
-        if (toState == JTAG_TAP_DRSHIFT) {
-          fromState = JTAG_TAP_DRSHIFT;
-          _SET_BIT_(0);
-        } else {
-          fromState = JTAG_TAP_DREXIT1;
-          _SET_BIT_(1);
-        }
-        break;
-
-      case JTAG_TAP_DRSHIFT:
-        fromState = JTAG_TAP_DREXIT1;
-        _SET_BIT_(1);
-        break;
-
-      case JTAG_TAP_DREXIT1:
-        if (toState == JTAG_TAP_DRPAUSE || toState == JTAG_TAP_DREXIT2) {
-          fromState = JTAG_TAP_DRPAUSE;
-          _SET_BIT_(0);
-        } else {
-          fromState = JTAG_TAP_DRUPDATE;
-          _SET_BIT_(1);
-        }
-        break;
-
-      case JTAG_TAP_DRPAUSE:
-        fromState = JTAG_TAP_DREXIT2;
-        _SET_BIT_(1);
-        break;
-
-      case JTAG_TAP_DREXIT2:
-        if (toState == JTAG_TAP_DRSHIFT) {
-          fromState = JTAG_TAP_DRSHIFT;
-          _SET_BIT_(0);
-        } else {
-          fromState = JTAG_TAP_DRUPDATE;
-          _SET_BIT_(1);
-        }
-        break;
-
-      case JTAG_TAP_DRUPDATE:
-        if (toState == JTAG_TAP_IDLE) {
-          fromState = JTAG_TAP_IDLE;
-          _SET_BIT_(0);
-        } else {
-          fromState = JTAG_TAP_DRSELECT;
-          _SET_BIT_(1);
-        }
-        break;
-
-      case JTAG_TAP_IRSELECT:
-        if (JTAG_IN_IR(toState)) {
-          fromState = JTAG_TAP_IRCAPTURE;
-          _SET_BIT_(0);
-        } else {
-          fromState = JTAG_TAP_RESET;
-          _SET_BIT_(1);
-        }
-        break;
-
-      case JTAG_TAP_IRCAPTURE:
-        if (toState == JTAG_TAP_IRSHIFT) {
-          fromState = JTAG_TAP_IRSHIFT;
-          _SET_BIT_(0);
-        } else {
-          fromState = JTAG_TAP_IREXIT1;
-          _SET_BIT_(1);
-        }
-        break;
-
-      case JTAG_TAP_IRSHIFT:
-        fromState = JTAG_TAP_IREXIT1;
-        _SET_BIT_(1);
-        break;
-
-      case JTAG_TAP_IREXIT1:
-        if (toState == JTAG_TAP_IRPAUSE || toState == JTAG_TAP_IREXIT2) {
-          fromState = JTAG_TAP_IRPAUSE;
-          _SET_BIT_(0);
-        } else {
-          fromState = JTAG_TAP_IRUPDATE;
-          _SET_BIT_(1);
-        }
-        break;
-
-      case JTAG_TAP_IRPAUSE:
-        fromState = JTAG_TAP_IREXIT2;
-        _SET_BIT_(1);
-        break;
-
-      case JTAG_TAP_IREXIT2:
-        if (toState == JTAG_TAP_IRSHIFT) {
-          fromState = JTAG_TAP_IRSHIFT;
-          _SET_BIT_(0);
-        } else {
-          fromState = JTAG_TAP_IRUPDATE;
-          _SET_BIT_(1);
-        }
-        break;
+  return tmsPathTable[fromState][toState];
+}
 
-      case JTAG_TAP_IRUPDATE:
-        if (toState == JTAG_TAP_IDLE) {
-          fromState = JTAG_TAP_IDLE;
-          _SET_BIT_(0);
-        } else {
-          fromState = JTAG_TAP_DRSELECT;
-          _SET_BIT_(1);
-        }
-        break;
+/**
+ * 将多个连续的状态切换合并成一段TMS时序
+ * 每一段路径从上一个目标状态出发，结果按最低位先发送的顺序紧密排列在tmsBuff中
+ * 返回值：TMS时序位数，缓冲区不足时返回-1
+ */
+int JtagGetTmsPath(enum JTAG_TAP_State fromState, const enum JTAG_TAP_State *states, int count, uint8_t *tmsBuff,
+                   int buffBits) {
+  assert(fromState >= JTAG_TAP_RESET && fromState <= JTAG_TAP_IRUPDATE);
+  assert(states != NULL || count == 0);
+  assert(tmsBuff != NULL || buffBits == 0);
+  uint32_t acc = 0; // 尚未写入缓冲区的时序
+  int accBits = 0;  // acc中的有效位数
+  int total = 0;    // 时序总位数
+
+  for (int i = 0; i < count; i++) {
+    assert(states[i] >= JTAG_TAP_RESET && states[i] <= JTAG_TAP_IRUPDATE);
+    TMS_SeqInfo seq = tmsPathTable[fromState][states[i]];
+    int seqBits = seq & 0xff;
+
+    fromState = states[i];
+    if (seqBits == 0) {
+      continue;
+    }
+    if (total + seqBits > buffBits) {
+      return -1;
+    }
+    acc |= (uint32_t)(seq >> 8) << accBits;
+    accBits += seqBits;
+    total += seqBits;
+    // 写入完整的字节
+    while (accBits >= 8) {
+      *tmsBuff++ = acc & 0xff;
+      acc >>= 8;
+      accBits -= 8;
     }
   }
-#undef _SET_BIT_
-  return (TMS_SeqInfo)(sequence & 0xFFFF);
+
+  if (accBits > 0) {
+    *tmsBuff = acc & ((1u << accBits) - 1);
+  }
+  return total;
 }
 
 /**
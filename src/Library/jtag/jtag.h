@@ -73,6 +73,21 @@ typedef uint16_t TMS_SeqInfo;
  */
 TMS_SeqInfo JtagGetTmsSequence(IN enum JTAG_TAP_State fromState, IN enum JTAG_TAP_State toState);
 
+/**
+ * 将一组连续的状态切换合并成一段TMS时序
+ * 参数:
+ * 	fromState:JTAG状态机的当前状态
+ * 	states:依次要转换到的JTAG状态机状态
+ * 	count:states中的状态个数
+ * 	tmsBuff:存放TMS时序的缓冲区，最低位先发送
+ * 	buffBits:缓冲区能容纳的TMS位数
+ * 返回:
+ * 	TMS时序的总位数，缓冲区不足时返回-1
+ * 	执行完毕后JTAG状态机的状态为states[count-1]
+ */
+int JtagGetTmsPath(IN enum JTAG_TAP_State fromState, IN const enum JTAG_TAP_State *states, IN int count,
+                   OUT uint8_t *tmsBuff, IN int buffBits);
+
 /**
  * 获得当前状态通过一个给定TMS信号时切换到的状态
  * 参数:
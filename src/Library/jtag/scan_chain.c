@@ -0,0 +1,402 @@
+/**
+ * Copyright (c) 2023, Virus.V <virusv@live.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of SmartOCD nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * Copyright 2023 Virus.V <virusv@live.com>
+ */
+
+#include "Library/jtag/scan_chain.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Library/log/log.h"
+#include "Library/misc/bitstream.h"
+
+// 探测IR总长度和BYPASS个数时，先移入的0的个数
+#define IR_FLUSH_BITS JTAG_SCAN_CHAIN_MAX_IR_BITS
+#define DR_FLUSH_BITS (JTAG_SCAN_CHAIN_MAX_TAPS + 1)
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/* 等待Commit后同步数据的扫描 */
+struct pendingScan {
+  struct list_head list_entry;
+  unsigned int capacity; // 数据区的字节数
+  uint8_t *userData;     // 用户数据缓冲区，为NULL时不需要同步
+  int offset;            // 用户数据在填充后的数据中的偏移
+  unsigned int bitCount; // 用户数据的位数
+  uint8_t data[];        // 填充后的数据
+};
+
+/* 查找第一个等于val的位，从start开始，找不到返回-1 */
+static int findBit(const uint8_t *data, int start, int end, int val) {
+  for (int i = start; i < end; i++) {
+    if (bitstream_GetBit(data, i) == val) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* 回收全部Pending的扫描，数据区留给之后的扫描复用 */
+static void recyclePendingScan(JtagScanChain chain) {
+  list_splice_init(&chain->pendingList, &chain->freeList);
+}
+
+/* 释放链表中的全部扫描 */
+static void freeScanList(struct list_head *head) {
+  struct pendingScan *scan, *scan_t;
+  list_for_each_entry_safe(scan, scan_t, head, list_entry) {
+    list_del(&scan->list_entry);
+    free(scan);
+  }
+}
+
+/**
+ * 获得一个Pending扫描，数据区全部填充1(BYPASS)
+ * 优先复用回收的扫描，扫描的长度不变时不会分配内存
+ */
+static struct pendingScan *newPendingScan(JtagScanChain chain, unsigned int totalBits) {
+  unsigned int bytes = (totalBits + 7) >> 3;
+  struct pendingScan *scan, *found = NULL;
+  list_for_each_entry(scan, &chain->freeList, list_entry) {
+    if (scan->capacity >= bytes) {
+      found = scan;
+      break;
+    }
+  }
+  if (found != NULL) {
+    scan = found;
+    list_del(&scan->list_entry);
+  } else {
+    scan = malloc(sizeof(struct pendingScan) + bytes);
+    if (scan == NULL) {
+      log_error("Failed to create a new pending scan object.");
+      return NULL;
+    }
+    scan->capacity = bytes;
+  }
+  memset(scan->data, 0xFF, bytes);
+  scan->userData = NULL;
+  scan->offset = 0;
+  scan->bitCount = 0;
+  list_add_tail(&scan->list_entry, &chain->pendingList);
+  return scan;
+}
+
+JtagScanChain JtagCreateScanChain(JtagSkill skill) {
+  assert(skill != NULL);
+  JtagScanChain chain = calloc(1, sizeof(struct jtagScanChain));
+  if (chain == NULL) {
+    log_error("Failed to create scan chain object.");
+    return NULL;
+  }
+  chain->skill = skill;
+  chain->currTap = -1;
+  INIT_LIST_HEAD(&chain->pendingList);
+  INIT_LIST_HEAD(&chain->freeList);
+  return chain;
+}
+
+void JtagDestroyScanChain(JtagScanChain *chain) {
+  assert(chain != NULL);
+  if (*chain == NULL) {
+    return;
+  }
+  freeScanList(&(*chain)->pendingList);
+  freeScanList(&(*chain)->freeList);
+  free(*chain);
+  *chain = NULL;
+}
+
+/**
+ * 从IR捕获值推断每个TAP的IR长度
+ * IEEE 1149.1规定IR捕获值的最低两位为01，每个TAP的起始位置必然满足该规则，
+ * 只有满足规则的位置个数与TAP个数相同时，才能唯一确定IR长度
+ */
+static int inferIrLength(JtagScanChain chain, const uint8_t *capture) {
+  int starts[JTAG_SCAN_CHAIN_MAX_TAPS];
+  int count = 0;
+
+  if (chain->tapCount == 1) {
+    chain->taps[0].irLen = chain->irTotal;
+    return ADPT_SUCCESS;
+  }
+
+  for (int i = 0; i + 1 < chain->irTotal; i++) {
+    if (bitstream_GetBit(capture, i) == 1 && bitstream_GetBit(capture, i + 1) == 0) {
+      if (count == chain->tapCount) {
+        return ADPT_ERR_PROTOCOL_ERROR;
+      }
+      starts[count++] = i;
+    }
+  }
+
+  if (count != chain->tapCount || starts[0] != 0) {
+    return ADPT_ERR_PROTOCOL_ERROR;
+  }
+
+  for (int i = 0; i < count; i++) {
+    int end = i + 1 < count ? starts[i + 1] : chain->irTotal;
+    chain->taps[i].irLen = end - starts[i];
+  }
+  return ADPT_SUCCESS;
+}
+
+int JtagScanChainDetect(JtagScanChain chain) {
+  assert(chain != NULL);
+  JtagSkill skill = chain->skill;
+  // IDCODE扫描：全部TAP都是IDCODE时最长
+  uint8_t idBuff[(JTAG_SCAN_CHAIN_MAX_TAPS + 1) << 2];
+  uint8_t irBuff[(IR_FLUSH_BITS << 1) >> 3];
+  uint8_t drBuff[((DR_FLUSH_BITS << 1) + 7) >> 3];
+  int idBits = sizeof(idBuff) << 3;
+  int pos, bypassCount, ret;
+
+  chain->tapCount = 0;
+  chain->irTotal = 0;
+  chain->currTap = -1;
+
+  // 复位后每个TAP的DR为IDCODE(最低位为1)或者BYPASS(1位0)，移入全1作为结束标记
+  memset(idBuff, 0xFF, sizeof(idBuff));
+  skill->ToState(skill, JTAG_TAP_RESET);
+  skill->ToState(skill, JTAG_TAP_DRSHIFT);
+  skill->ExchangeData(skill, idBuff, idBits);
+  skill->ToState(skill, JTAG_TAP_IDLE);
+
+  // IR先移入全0，再移入全1，第一个1出现的位置减去全0的个数就是IR总长度
+  // 最后IR中全部为1，UPDATE之后全部TAP进入BYPASS
+  memset(irBuff, 0x00, IR_FLUSH_BITS >> 3);
+  memset(irBuff + (IR_FLUSH_BITS >> 3), 0xFF, IR_FLUSH_BITS >> 3);
+  skill->ToState(skill, JTAG_TAP_IRSHIFT);
+  skill->ExchangeData(skill, irBuff, IR_FLUSH_BITS << 1);
+  skill->ToState(skill, JTAG_TAP_IDLE);
+
+  // 全部BYPASS，DR长度等于TAP个数
+  memset(drBuff, 0x00, sizeof(drBuff));
+  bitstream_Insert(drBuff, DR_FLUSH_BITS, ~0ull, DR_FLUSH_BITS);
+  skill->ToState(skill, JTAG_TAP_DRSHIFT);
+  skill->ExchangeData(skill, drBuff, DR_FLUSH_BITS << 1);
+  skill->ToState(skill, JTAG_TAP_IDLE);
+
+  ret = skill->Commit(skill);
+  if (ret != ADPT_SUCCESS) {
+    skill->Cancel(skill);
+    log_error("Scan chain detect failed!");
+    return ret;
+  }
+
+  // 解析IDCODE
+  for (pos = 0; pos < idBits && chain->tapCount < JTAG_SCAN_CHAIN_MAX_TAPS;) {
+    uint32_t idcode;
+    if (bitstream_GetBit(idBuff, pos) == 0) {
+      chain->taps[chain->tapCount++].idcode = 0;
+      pos++;
+      continue;
+    }
+    if (pos + 32 > idBits) {
+      break;
+    }
+    idcode = (uint32_t)bitstream_Extract(idBuff, pos, 32);
+    if (idcode == 0xFFFFFFFF) {
+      break;
+    }
+    chain->taps[chain->tapCount++].idcode = idcode;
+    pos += 32;
+  }
+
+  // 检查BYPASS个数
+  bypassCount = findBit(drBuff, DR_FLUSH_BITS, DR_FLUSH_BITS << 1, 1);
+  if (bypassCount < 0) {
+    log_error("Scan chain broken, TDO stuck at 0?");
+    chain->tapCount = 0;
+    return ADPT_FAILED;
+  }
+  bypassCount -= DR_FLUSH_BITS;
+  if (chain->tapCount == 0 || bypassCount != chain->tapCount) {
+    log_error("Scan chain TAP count mismatch, IDCODE scan: %d, BYPASS scan: %d.", chain->tapCount, bypassCount);
+    chain->tapCount = 0;
+    return ADPT_FAILED;
+  }
+
+  // IR总长度
+  chain->irTotal = findBit(irBuff, IR_FLUSH_BITS, IR_FLUSH_BITS << 1, 1);
+  if (chain->irTotal < 0) {
+    log_error("IR chain length exceeds %d bits.", JTAG_SCAN_CHAIN_MAX_IR_BITS);
+    chain->irTotal = 0;
+    return ADPT_FAILED;
+  }
+  chain->irTotal -= IR_FLUSH_BITS;
+
+  for (int i = 0; i < chain->tapCount; i++) {
+    chain->taps[i].irLen = 0;
+  }
+  ret = inferIrLength(chain, irBuff);
+  for (int i = 0; i < chain->tapCount; i++) {
+    log_debug("TAP #%d: IDCODE 0x%08X, IR length %d.", i, chain->taps[i].idcode, chain->taps[i].irLen);
+  }
+  if (ret != ADPT_SUCCESS) {
+    log_warn("Can not infer IR length from capture value, total IR length is %d.", chain->irTotal);
+  }
+  return ret;
+}
+
+int JtagScanChainSetIrLen(JtagScanChain chain, int tapIndex, int irLen) {
+  assert(chain != NULL);
+  int total = 0;
+
+  if (tapIndex < 0 || tapIndex >= chain->tapCount || irLen <= 0 || irLen > 32) {
+    return ADPT_ERR_BAD_PARAMETER;
+  }
+  for (int i = 0; i < chain->tapCount; i++) {
+    total += i == tapIndex ? irLen : chain->taps[i].irLen;
+  }
+  if (total > JTAG_SCAN_CHAIN_MAX_IR_BITS) {
+    return ADPT_ERR_BAD_PARAMETER;
+  }
+
+  chain->taps[tapIndex].irLen = irLen;
+  chain->irTotal = total;
+  // 需要重新计算填充
+  chain->currTap = -1;
+  return ADPT_SUCCESS;
+}
+
+int JtagScanChainSelect(JtagScanChain chain, int tapIndex) {
+  assert(chain != NULL);
+  int pre = 0, total = 0;
+
+  if (tapIndex < 0 || tapIndex >= chain->tapCount) {
+    return ADPT_ERR_BAD_PARAMETER;
+  }
+  for (int i = 0; i < chain->tapCount; i++) {
+    if (chain->taps[i].irLen <= 0) {
+      log_error("The IR length of TAP #%d is unknown.", i);
+      return ADPT_ERR_BAD_PARAMETER;
+    }
+    if (i < tapIndex) {
+      pre += chain->taps[i].irLen;
+    }
+    total += chain->taps[i].irLen;
+  }
+
+  chain->irTotal = total;
+  chain->irPre = pre;
+  chain->irPost = total - pre - chain->taps[tapIndex].irLen;
+  chain->drPre = tapIndex;
+  chain->drPost = chain->tapCount - tapIndex - 1;
+  chain->currTap = tapIndex;
+  return ADPT_SUCCESS;
+}
+
+int JtagScanChainIrScan(JtagScanChain chain, uint32_t instr) {
+  assert(chain != NULL);
+  JtagSkill skill = chain->skill;
+  struct pendingScan *scan;
+  int ret;
+
+  if (chain->currTap < 0) {
+    log_error("No TAP selected.");
+    return ADPT_FAILED;
+  }
+
+  scan = newPendingScan(chain, chain->irTotal);
+  if (scan == NULL) {
+    return ADPT_ERR_INTERNAL_ERROR;
+  }
+  // 其他TAP为BYPASS指令(全1)，超过32位的部分保持为1
+  bitstream_Insert(scan->data, chain->irPre, instr, MIN(chain->taps[chain->currTap].irLen, 32));
+
+  ret = skill->ToState(skill, JTAG_TAP_IRSHIFT);
+  if (ret != ADPT_SUCCESS) {
+    return ret;
+  }
+  return skill->ExchangeData(skill, scan->data, chain->irTotal);
+}
+
+int JtagScanChainDrScan(JtagScanChain chain, uint8_t *data, unsigned int bitCount) {
+  assert(chain != NULL);
+  JtagSkill skill = chain->skill;
+  struct pendingScan *scan;
+  int ret;
+
+  if (chain->currTap < 0) {
+    log_error("No TAP selected.");
+    return ADPT_FAILED;
+  }
+
+  ret = skill->ToState(skill, JTAG_TAP_DRSHIFT);
+  if (ret != ADPT_SUCCESS) {
+    return ret;
+  }
+
+  // 没有其他TAP时不需要填充
+  if (chain->drPre == 0 && chain->drPost == 0) {
+    return skill->ExchangeData(skill, data, bitCount);
+  }
+
+  scan = newPendingScan(chain, bitCount + chain->drPre + chain->drPost);
+  if (scan == NULL) {
+    return ADPT_ERR_INTERNAL_ERROR;
+  }
+  bitstream_Copy(scan->data, chain->drPre, data, 0, bitCount);
+  scan->userData = data;
+  scan->offset = chain->drPre;
+  scan->bitCount = bitCount;
+
+  return skill->ExchangeData(skill, scan->data, bitCount + chain->drPre + chain->drPost);
+}
+
+int JtagScanChainCommit(JtagScanChain chain) {
+  assert(chain != NULL);
+  JtagSkill skill = chain->skill;
+  struct pendingScan *scan;
+  int ret;
+
+  ret = skill->Commit(skill);
+  if (ret != ADPT_SUCCESS) {
+    skill->Cancel(skill);
+    recyclePendingScan(chain);
+    return ret;
+  }
+
+  // 同步DR扫描捕获的数据
+  list_for_each_entry(scan, &chain->pendingList, list_entry) {
+    if (scan->userData != NULL) {
+      bitstream_Copy(scan->userData, 0, scan->data, scan->offset, scan->bitCount);
+    }
+  }
+  recyclePendingScan(chain);
+  return ADPT_SUCCESS;
+}
+
+int JtagScanChainCancel(JtagScanChain chain) {
+  assert(chain != NULL);
+  recyclePendingScan(chain);
+  return chain->skill->Cancel(chain->skill);
+}
@@ -0,0 +1,174 @@
+/**
+ * Copyright (c) 2023, Virus.V <virusv@live.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of SmartOCD nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * Copyright 2023 Virus.V <virusv@live.com>
+ */
+
+#ifndef SRC_JTAG_SCAN_CHAIN_H_
+#define SRC_JTAG_SCAN_CHAIN_H_
+
+#include "smartocd.h"
+
+#include "Adapter/adapter_jtag.h"
+#include "Library/jtag/jtag.h"
+#include "Library/misc/list.h"
+
+// 扫描链上最多支持的TAP个数
+#define JTAG_SCAN_CHAIN_MAX_TAPS 32
+// 扫描链上全部TAP的IR长度之和的最大值
+#define JTAG_SCAN_CHAIN_MAX_IR_BITS 256
+
+/* 扫描链上的TAP */
+struct jtagTap {
+  uint32_t idcode; // IDCODE，0表示该TAP复位后默认选中BYPASS寄存器
+  int irLen;       // IR长度
+};
+
+/**
+ * JTAG扫描链对象
+ * TAP的序号从离TDO最近的TAP开始，从0计数
+ * 选中某一个TAP之后，其他TAP处于BYPASS状态，IR和DR扫描时自动填充前后的BYPASS位
+ */
+struct jtagScanChain {
+  JtagSkill skill;                                 // JTAG能力集
+  int tapCount;                                    // TAP个数
+  struct jtagTap taps[JTAG_SCAN_CHAIN_MAX_TAPS];   // TAP信息
+  int irTotal;                                     // 全部TAP的IR长度之和
+  int currTap;                                     // 当前选中的TAP，-1为未选中
+  int irPre, irPost;                               // 选中的TAP前后的IR位数
+  int drPre, drPost;                               // 选中的TAP前后的BYPASS位数
+  struct list_head pendingList;                    // 等待Commit后同步数据的扫描
+  struct list_head freeList;                       // Commit之后回收的扫描，复用数据区，避免每次扫描都分配内存
+};
+
+typedef struct jtagScanChain *JtagScanChain;
+
+/**
+ * JtagCreateScanChain - 创建扫描链对象
+ * 参数:
+ * 	skill:JTAG能力集
+ * 返回:
+ * 	扫描链对象，失败返回NULL
+ */
+JtagScanChain JtagCreateScanChain(IN JtagSkill skill);
+
+/**
+ * JtagDestroyScanChain - 销毁扫描链对象
+ * 参数:
+ * 	chain:扫描链对象的指针
+ */
+void JtagDestroyScanChain(IN JtagScanChain *chain);
+
+/**
+ * JtagScanChainDetect - 自动探测扫描链上的TAP个数、IDCODE和IR长度
+ * 探测过程会复位TAP状态机，结束后全部TAP处于BYPASS状态，状态机在IDLE状态
+ * 当无法从IR捕获值推断出每个TAP的IR长度时，返回ADPT_ERR_PROTOCOL_ERROR，
+ * 此时TAP个数和IDCODE有效，需要通过JtagScanChainSetIrLen手动指定IR长度
+ * 参数:
+ * 	chain:扫描链对象
+ * 返回:
+ * 	ADPT_SUCCESS:成功
+ * 	ADPT_FAILED:失败
+ * 	或者其他错误
+ */
+int JtagScanChainDetect(IN JtagScanChain chain);
+
+/**
+ * JtagScanChainSetIrLen - 手动指定TAP的IR长度
+ * 参数:
+ * 	chain:扫描链对象
+ * 	tapIndex:TAP序号
+ * 	irLen:IR长度
+ * 返回:
+ * 	ADPT_SUCCESS:成功
+ * 	ADPT_ERR_BAD_PARAMETER:参数错误
+ */
+int JtagScanChainSetIrLen(IN JtagScanChain chain, IN int tapIndex, IN int irLen);
+
+/**
+ * JtagScanChainSelect - 选中扫描链上的一个TAP，预先计算IR和DR的填充
+ * 参数:
+ * 	chain:扫描链对象
+ * 	tapIndex:TAP序号
+ * 返回:
+ * 	ADPT_SUCCESS:成功
+ * 	ADPT_ERR_BAD_PARAMETER:参数错误
+ */
+int JtagScanChainSelect(IN JtagScanChain chain, IN int tapIndex);
+
+/**
+ * JtagScanChainIrScan - 向选中的TAP写入指令，其他TAP写入BYPASS
+ * 会将该动作加入Pending队列，执行后状态机处于IREXIT1状态
+ * 参数:
+ * 	chain:扫描链对象
+ * 	instr:指令
+ * 返回:
+ * 	ADPT_SUCCESS:成功
+ * 	ADPT_FAILED:失败
+ * 	或者其他错误
+ */
+int JtagScanChainIrScan(IN JtagScanChain chain, IN uint32_t instr);
+
+/**
+ * JtagScanChainDrScan - 与选中的TAP交换DR数据
+ * 会将该动作加入Pending队列，执行后状态机处于DREXIT1状态
+ * 捕获的数据在JtagScanChainCommit成功后写回data
+ * 参数:
+ * 	chain:扫描链对象
+ * 	data:数据缓冲区，必须可读可写，LSB先发送
+ * 	bitCount:DR的二进制位个数
+ * 返回:
+ * 	ADPT_SUCCESS:成功
+ * 	ADPT_FAILED:失败
+ * 	或者其他错误
+ */
+int JtagScanChainDrScan(IN JtagScanChain chain, IN OUT uint8_t *data, IN unsigned int bitCount);
+
+/**
+ * JtagScanChainCommit - 提交Pending的动作，并同步DR扫描的数据
+ * 参数:
+ * 	chain:扫描链对象
+ * 返回:
+ * 	ADPT_SUCCESS:成功
+ * 	ADPT_FAILED:失败
+ * 	或者其他错误
+ */
+int JtagScanChainCommit(IN JtagScanChain chain);
+
+/**
+ * JtagScanChainCancel - 清除Pending的动作
+ * 参数:
+ * 	chain:扫描链对象
+ * 返回:
+ * 	ADPT_SUCCESS:成功
+ * 	ADPT_FAILED:失败
+ * 	或者其他错误
+ */
+int JtagScanChainCancel(IN JtagScanChain chain);
+
+#endif /* SRC_JTAG_SCAN_CHAIN_H_ */
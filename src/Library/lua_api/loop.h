@@ -38,6 +38,7 @@
 #define STREAM_LUA_OBJECT_TYPE "stream"
 #define TCP_STREAM_LUA_OBJECT_TYPE "stream.tcp"
 #define TIMER_LUA_OBJECT_TYPE "timer"
+#define SESSION_LUA_OBJECT_TYPE "session"
 
 /* Loop 对象，事件驱动 */
 struct loop {
@@ -0,0 +1,471 @@
+/**
+ * Copyright (c) 2023, Virus.V <virusv@live.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of SmartOCD nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * Copyright 2023 Virus.V <virusv@live.com>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "lua.h"
+#include "lauxlib.h"
+#include "lualib.h"
+#include "uv.h"
+
+#include "Component/component.h"
+#include "Library/lua_api/loop.h"
+#include "Library/lua_api/api.h"
+#include "Library/log/log.h"
+
+#include "smartocd.h"
+
+/* 会话脚本返回值拷贝到主状态机时，table的最大嵌套深度 */
+#define SESSION_COPY_MAX_DEPTH 16
+/* libuv线程池最大线程数 */
+#define SESSION_MAX_THREADPOOL 1024
+
+struct session_manager;
+
+/**
+ * 会话对象
+ * 每个会话拥有独立的Lua状态机，其中创建的仿真器对象拥有各自的指令队列，
+ * 脚本在libuv线程池中执行，多个会话的USB传输互不阻塞
+ */
+struct session {
+  lua_State *L;                 // 会话独立的Lua状态机
+  int index;                    // 会话序号，从1开始
+  int status;                   // 上一次脚本执行的状态
+  int nresults;                 // 上一次脚本执行的返回值个数
+  uv_work_t work;               // 线程池任务
+  struct session_manager *mgr;  // 所属的会话管理器
+};
+
+/**
+ * 会话管理器对象
+ */
+struct session_manager {
+  lua_State *L;               // 主状态机
+  int count;                  // 会话个数
+  int pending;                // 正在执行的会话个数
+  int cb_ref;                 // 全部会话执行结束后的回调
+  int self_ref;               // 执行期间引用自身，防止被回收
+  int result_ref;             // 汇总结果表
+  char *script;               // 正在执行的脚本路径
+  struct session *sessions;   // 会话数组
+};
+
+static struct session_manager *luaApi_check_session(lua_State *L, int index) {
+  return (struct session_manager *)LuaApi_must_object_type(L, index, SESSION_LUA_OBJECT_TYPE, "Must session object");
+}
+
+/**
+ * 初始化会话的Lua状态机，在保护模式下执行
+ * 参数:
+ * 1#:会话序号
+ * 2#:会话参数
+ */
+static int session_state_init(lua_State *L) {
+  int index = (int)lua_tointeger(L, 1);
+
+  luaL_openlibs(L);
+
+  // 设置搜索路径
+  lua_getglobal(L, "package");
+  lua_getfield(L, -1, "path");
+  lua_pushstring(L, "scripts/?.lua;");
+  lua_insert(L, -2);
+  lua_concat(L, 2);
+  lua_setfield(L, -2, "path");
+  lua_pop(L, 1);
+
+  // 注册SmartOCD API接口
+  component_init(L);
+
+  // 会话序号和参数
+  lua_pushinteger(L, index);
+  lua_setglobal(L, "SESSION_INDEX");
+  lua_pushvalue(L, 2);
+  lua_setglobal(L, "SESSION_ARG");
+
+  return 0;
+}
+
+/**
+ * 将会话状态机中的值拷贝到主状态机栈顶
+ * 只支持nil、boolean、number、string和table，其他类型转换为字符串
+ */
+static void session_copy_value(lua_State *from, int idx, lua_State *to, int depth) {
+  idx = lua_absindex(from, idx);
+  luaL_checkstack(to, 3, "Could not expand stack.");
+
+  switch (lua_type(from, idx)) {
+  case LUA_TBOOLEAN:
+    lua_pushboolean(to, lua_toboolean(from, idx));
+    break;
+  case LUA_TNUMBER:
+    if (lua_isinteger(from, idx)) {
+      lua_pushinteger(to, lua_tointeger(from, idx));
+    } else {
+      lua_pushnumber(to, lua_tonumber(from, idx));
+    }
+    break;
+  case LUA_TSTRING: {
+    size_t len;
+    const char *str = lua_tolstring(from, idx, &len);
+    lua_pushlstring(to, str, len);
+    break;
+  }
+  case LUA_TTABLE:
+    if (depth >= SESSION_COPY_MAX_DEPTH) {
+      lua_pushnil(to);
+      break;
+    }
+    lua_newtable(to);
+    lua_pushnil(from);
+    while (lua_next(from, idx) != 0) {
+      session_copy_value(from, -2, to, depth + 1);
+      session_copy_value(from, -1, to, depth + 1);
+      if (lua_isnil(to, -2)) {
+        lua_pop(to, 2);
+      } else {
+        lua_rawset(to, -3);
+      }
+      lua_pop(from, 1);
+    }
+    break;
+  case LUA_TNIL:
+  case LUA_TNONE:
+    lua_pushnil(to);
+    break;
+  default:
+    lua_pushstring(to, luaL_typename(from, idx));
+    break;
+  }
+}
+
+/* 错误处理函数，附加调用栈 */
+static int session_msghandler(lua_State *L) {
+  const char *msg = lua_tostring(L, 1);
+  if (msg == NULL) {
+    msg = lua_pushfstring(L, "(error object is a %s value)", luaL_typename(L, 1));
+  }
+  luaL_traceback(L, L, msg, 1);
+  return 1;
+}
+
+/**
+ * 在线程池中执行会话脚本
+ * 只访问会话自己的状态机，不能访问主状态机
+ */
+static void session_work_cb(uv_work_t *req) {
+  struct session *session = container_of(req, struct session, work);
+  lua_State *L = session->L;
+  int base;
+
+  lua_settop(L, 0);
+  lua_pushcfunction(L, session_msghandler);
+  base = lua_gettop(L);
+
+  session->status = luaL_loadfile(L, session->mgr->script);
+  if (session->status == LUA_OK) {
+    session->status = lua_pcall(L, 0, LUA_MULTRET, base);
+  }
+  session->nresults = lua_gettop(L) - base;
+}
+
+/**
+ * 会话脚本执行结束，在loop线程中汇总结果
+ * 结果表的每一项为：{ok = boolean, results = {...}} 或 {ok = false, error = string}
+ */
+static void session_after_work_cb(uv_work_t *req, int status) {
+  struct session *session = container_of(req, struct session, work);
+  struct session_manager *mgr = session->mgr;
+  lua_State *L = mgr->L;
+
+  lua_rawgeti(L, LUA_REGISTRYINDEX, mgr->result_ref); // +1
+  lua_createtable(L, 0, 2);                           // +1
+  if (status == UV_ECANCELED) {
+    lua_pushboolean(L, 0);
+    lua_setfield(L, -2, "ok");
+    lua_pushstring(L, "canceled");
+    lua_setfield(L, -2, "error");
+  } else if (session->status != LUA_OK) {
+    lua_pushboolean(L, 0);
+    lua_setfield(L, -2, "ok");
+    session_copy_value(session->L, -1, L, 0);
+    lua_setfield(L, -2, "error");
+    log_warn("Session #%d failed: %s", session->index, lua_tostring(session->L, -1));
+  } else {
+    lua_pushboolean(L, 1);
+    lua_setfield(L, -2, "ok");
+    lua_createtable(L, session->nresults, 0);
+    for (int i = 0; i < session->nresults; i++) {
+      session_copy_value(session->L, i - session->nresults, L, 0);
+      lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "results");
+  }
+  lua_rawseti(L, -2, session->index); // -1
+  lua_pop(L, 1);                      // -1
+  lua_settop(session->L, 0);
+
+  if (--mgr->pending > 0) {
+    return;
+  }
+
+  // 全部会话执行结束
+  free(mgr->script);
+  mgr->script = NULL;
+  if (mgr->cb_ref != LUA_NOREF) {
+    int cb_ref = mgr->cb_ref;
+    mgr->cb_ref = LUA_NOREF;
+    lua_rawgeti(L, LUA_REGISTRYINDEX, mgr->result_ref);
+    luaL_unref(L, LUA_REGISTRYINDEX, mgr->result_ref);
+    mgr->result_ref = LUA_NOREF;
+    LuaApi_do_callback(L, cb_ref, 1);
+    luaL_unref(L, LUA_REGISTRYINDEX, cb_ref);
+  }
+  luaL_unref(L, LUA_REGISTRYINDEX, mgr->self_ref);
+  mgr->self_ref = LUA_NOREF;
+}
+
+/* 关闭全部会话的状态机 */
+static void session_close_all(struct session_manager *mgr) {
+  if (mgr->sessions == NULL) {
+    return;
+  }
+  for (int i = 0; i < mgr->count; i++) {
+    if (mgr->sessions[i].L) {
+      lua_close(mgr->sessions[i].L);
+    }
+  }
+  free(mgr->sessions);
+  mgr->sessions = NULL;
+  mgr->count = 0;
+}
+
+/**
+ * 创建会话管理器
+ * 1#:会话参数表，每一项创建一个会话，在会话中可以通过全局变量SESSION_ARG获得，
+ *    一般为仿真器的序列号等信息(string, number, boolean)
+ * 返回:
+ * 1#:会话管理器对象
+ */
+static int luaApi_session_create(lua_State *L) {
+  struct session_manager *mgr;
+  int count;
+  char poolSize[16];
+
+  luaL_checktype(L, 1, LUA_TTABLE);
+  count = (int)luaL_len(L, 1);
+  luaL_argcheck(L, count > 0, 1, "Session list is empty");
+
+  mgr = (struct session_manager *)lua_newuserdata(L, sizeof(struct session_manager));
+  memset(mgr, 0, sizeof(struct session_manager));
+  mgr->L = L;
+  mgr->cb_ref = LUA_NOREF;
+  mgr->self_ref = LUA_NOREF;
+  mgr->result_ref = LUA_NOREF;
+  luaL_setmetatable(L, SESSION_LUA_OBJECT_TYPE);
+
+  mgr->sessions = calloc(count, sizeof(struct session));
+  if (mgr->sessions == NULL) {
+    return luaL_error(L, "Session buff alloc failed!");
+  }
+  mgr->count = count;
+
+  for (int i = 0; i < count; i++) {
+    struct session *session = &mgr->sessions[i];
+    session->index = i + 1;
+    session->mgr = mgr;
+    session->work.data = session;
+    session->L = luaL_newstate();
+    if (session->L == NULL) {
+      session_close_all(mgr);
+      return luaL_error(L, "Session #%d: create lua state failed!", i + 1);
+    }
+
+    lua_pushcfunction(session->L, session_state_init);
+    lua_pushinteger(session->L, session->index);
+    lua_geti(L, 1, session->index);
+    session_copy_value(L, -1, session->L, 0);
+    lua_pop(L, 1);
+    if (lua_pcall(session->L, 2, 0, 0) != LUA_OK) {
+      lua_pushstring(L, lua_tostring(session->L, -1));
+      session_close_all(mgr);
+      return luaL_error(L, "Session #%d: init failed: %s", i + 1, lua_tostring(L, -1));
+    }
+  }
+
+  // 每个会话的脚本会阻塞在USB传输上，线程池大小要能容纳全部会话
+  // 注意：该环境变量只在线程池第一次使用之前生效
+  if (getenv("UV_THREADPOOL_SIZE") == NULL) {
+    snprintf(poolSize, sizeof(poolSize), "%d", count < SESSION_MAX_THREADPOOL ? count : SESSION_MAX_THREADPOOL);
+    setenv("UV_THREADPOOL_SIZE", poolSize, 0);
+  }
+
+  return 1;
+}
+
+/**
+ * 在全部会话中并行执行同一个脚本
+ * 1#:会话管理器对象
+ * 2#:脚本路径
+ * 3#:全部会话执行结束后的回调函数(Optional)，参数为汇总结果表
+ * 当没有指定回调函数时，该函数会运行loop直到全部会话执行结束，并返回汇总结果表，
+ * 此时不能在loop的回调中调用
+ * 返回:
+ * 1#:汇总结果表(没有回调函数时)，以会话序号为索引，每一项为
+ *    {ok = true, results = {...}} 或 {ok = false, error = "..."}
+ */
+static int luaApi_session_run(lua_State *L) {
+  struct session_manager *mgr = luaApi_check_session(L, 1);
+  const char *script = luaL_checkstring(L, 2);
+  int hasCallback = !lua_isnoneornil(L, 3);
+  struct loop *loop = LuaApi_loop_get_context(L);
+  int queued = 0;
+
+  if (hasCallback) {
+    luaL_argcheck(L, LuaApi_check_callable(L, 3), 3, "Must be an callable object");
+  }
+  if (mgr->pending > 0) {
+    return luaL_error(L, "Sessions are busy!");
+  }
+  if (mgr->count == 0) {
+    return luaL_error(L, "Sessions are closed!");
+  }
+
+  mgr->script = strdup(script);
+  if (mgr->script == NULL) {
+    return luaL_error(L, "Script path alloc failed!");
+  }
+
+  lua_createtable(L, mgr->count, 0);
+  mgr->result_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  if (hasCallback) {
+    lua_pushvalue(L, 3);
+    mgr->cb_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  }
+  lua_pushvalue(L, 1);
+  mgr->self_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+  mgr->pending = mgr->count;
+  for (int i = 0; i < mgr->count; i++) {
+    int ret = uv_queue_work(&loop->loop, &mgr->sessions[i].work, session_work_cb, session_after_work_cb);
+    if (ret < 0) {
+      log_error("Session #%d: uv_queue_work: %s", i + 1, uv_strerror(ret));
+      // 没有入队的会话当作取消处理
+      mgr->pending -= mgr->count - i;
+      if (queued == 0) {
+        luaL_unref(L, LUA_REGISTRYINDEX, mgr->result_ref);
+        luaL_unref(L, LUA_REGISTRYINDEX, mgr->cb_ref);
+        luaL_unref(L, LUA_REGISTRYINDEX, mgr->self_ref);
+        mgr->result_ref = mgr->cb_ref = mgr->self_ref = LUA_NOREF;
+        free(mgr->script);
+        mgr->script = NULL;
+        return luaL_error(L, "uv_queue_work: %s: %s", uv_err_name(ret), uv_strerror(ret));
+      }
+      break;
+    }
+    queued++;
+  }
+
+  if (hasCallback) {
+    return 0;
+  }
+
+  // 同步等待全部会话执行结束
+  while (mgr->pending > 0) {
+    uv_run(&loop->loop, UV_RUN_ONCE);
+  }
+  lua_rawgeti(L, LUA_REGISTRYINDEX, mgr->result_ref);
+  luaL_unref(L, LUA_REGISTRYINDEX, mgr->result_ref);
+  mgr->result_ref = LUA_NOREF;
+  return 1;
+}
+
+/**
+ * 获得会话个数
+ * 1#:会话管理器对象
+ */
+static int luaApi_session_count(lua_State *L) {
+  struct session_manager *mgr = luaApi_check_session(L, 1);
+  lua_pushinteger(L, mgr->count);
+  return 1;
+}
+
+/**
+ * 关闭全部会话，释放会话中的仿真器对象
+ * 1#:会话管理器对象
+ */
+static int luaApi_session_close(lua_State *L) {
+  struct session_manager *mgr = luaApi_check_session(L, 1);
+  if (mgr->pending > 0) {
+    return luaL_error(L, "Sessions are busy!");
+  }
+  session_close_all(mgr);
+  return 0;
+}
+
+static int luaApi_session_gc(lua_State *L) {
+  struct session_manager *mgr = luaApi_check_session(L, 1);
+  log_trace("[GC] Session");
+  // 执行期间持有自身引用，此时pending一定为0
+  session_close_all(mgr);
+  return 0;
+}
+
+// 模块静态函数
+static const luaL_Reg lib_session_f[] = {
+  {"Create", luaApi_session_create},
+  {NULL, NULL}
+};
+
+// 模块的面向对象方法
+static const luaL_Reg lib_session_oo[] = {
+    {"Run", luaApi_session_run},
+    {"Count", luaApi_session_count},
+    {"Close", luaApi_session_close},
+    {NULL, NULL}};
+
+static int luaopen_session(lua_State *L) {
+  LuaApi_create_new_type(L, SESSION_LUA_OBJECT_TYPE, luaApi_session_gc, lib_session_oo, NULL);
+  luaL_newlib(L, lib_session_f);
+  return 1;
+}
+
+// 注册接口调用
+static int RegisterApi_LoopSession(lua_State *L, void *opaque) {
+  luaL_requiref(L, "Loop.session", luaopen_session, 0);
+  lua_pop(L, 1);
+
+  return 0;
+}
+COMPONENT_INIT(EVENT_LOOP_SESSION, RegisterApi_LoopSession, NULL, COM_LOOP, 5);
@@ -0,0 +1,152 @@
+/**
+ * Copyright (c) 2023, Virus.V <virusv@live.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of SmartOCD nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * Copyright 2023 Virus.V <virusv@live.com>
+ */
+
+#include "Library/misc/bitstream.h"
+
+#include <string.h>
+
+#include "Library/misc/misc.h"
+#include "smartocd.h"
+
+// 每次处理的位数，保证源和目的的起始位偏移都在一个字节之内时不超过64位
+#define BITSTREAM_CHUNK_BITS 56
+
+// 从缓冲区读取byteCnt个字节，组成小端的64位数
+static inline uint64_t loadBytes(const uint8_t *data, unsigned int byteCnt) {
+  uint64_t val = 0;
+  for (unsigned int i = 0; i < byteCnt; i++) {
+    val |= (uint64_t)data[i] << (i << 3);
+  }
+  return val;
+}
+
+// 将64位数的低byteCnt个字节按小端写入缓冲区
+static inline void storeBytes(uint8_t *data, uint64_t val, unsigned int byteCnt) {
+  for (unsigned int i = 0; i < byteCnt; i++) {
+    data[i] = (uint8_t)(val >> (i << 3));
+  }
+}
+
+static inline uint64_t lowMask(unsigned int bitCount) {
+  return bitCount >= 64 ? ~0ull : (1ull << bitCount) - 1;
+}
+
+uint64_t bitstream_Extract(const uint8_t *src, unsigned int offset, unsigned int bitCount) {
+  assert(bitCount <= 64);
+  uint64_t val;
+  unsigned int shift;
+
+  if (bitCount == 0) {
+    return 0;
+  }
+  src += offset >> 3;
+  shift = offset & 0x7;
+  // 起始偏移加上位数可能超过64位，分两次读取
+  if (shift + bitCount <= 64) {
+    val = loadBytes(src, (shift + bitCount + 7) >> 3) >> shift;
+  } else {
+    val = loadBytes(src, 8) >> shift;
+    val |= (uint64_t)src[8] << (64 - shift);
+  }
+  return val & lowMask(bitCount);
+}
+
+void bitstream_Insert(uint8_t *dst, unsigned int offset, uint64_t value, unsigned int bitCount) {
+  assert(bitCount <= 64);
+  unsigned int shift, byteCnt;
+  uint64_t mask, word;
+
+  if (bitCount == 0) {
+    return;
+  }
+  dst += offset >> 3;
+  shift = offset & 0x7;
+  value &= lowMask(bitCount);
+  if (shift + bitCount > 64) {
+    // 先写入低位部分，剩下的高位写入第9个字节
+    unsigned int lowBits = 64 - shift;
+    bitstream_Insert(dst, shift, value, lowBits);
+    bitstream_Insert(dst + 8, 0, value >> lowBits, bitCount - lowBits);
+    return;
+  }
+  byteCnt = (shift + bitCount + 7) >> 3;
+  mask = lowMask(bitCount) << shift;
+  word = loadBytes(dst, byteCnt);
+  word = (word & ~mask) | (value << shift);
+  storeBytes(dst, word, byteCnt);
+}
+
+void bitstream_Copy(uint8_t *dst, unsigned int dstOffset, const uint8_t *src, unsigned int srcOffset,
+                    unsigned int bitCount) {
+  if (bitCount == 0) {
+    return;
+  }
+  dst += dstOffset >> 3;
+  dstOffset &= 0x7;
+  src += srcOffset >> 3;
+  srcOffset &= 0x7;
+
+  // 两边都按字节对齐时直接拷贝整字节
+  if (dstOffset == 0 && srcOffset == 0) {
+    unsigned int bytes = bitCount >> 3;
+    memmove(dst, src, bytes);
+    if (bitCount & 0x7) {
+      bitstream_Insert(dst + bytes, 0, src[bytes], bitCount & 0x7);
+    }
+    return;
+  }
+
+  // 每次搬运56位，源和目的指针都前进7个字节，起始位偏移不变
+  while (bitCount >= BITSTREAM_CHUNK_BITS) {
+    bitstream_Insert(dst, dstOffset, bitstream_Extract(src, srcOffset, BITSTREAM_CHUNK_BITS), BITSTREAM_CHUNK_BITS);
+    dst += BITSTREAM_CHUNK_BITS >> 3;
+    src += BITSTREAM_CHUNK_BITS >> 3;
+    bitCount -= BITSTREAM_CHUNK_BITS;
+  }
+  if (bitCount > 0) {
+    bitstream_Insert(dst, dstOffset, bitstream_Extract(src, srcOffset, bitCount), bitCount);
+  }
+}
+
+unsigned int bitstream_Concat(uint8_t *dst, unsigned int dstBits, const uint8_t *src, unsigned int srcBits) {
+  bitstream_Copy(dst, dstBits, src, 0, srcBits);
+  return dstBits + srcBits;
+}
+
+void bitstream_Reverse(uint8_t *dst, const uint8_t *src, unsigned int bitCount) {
+  // 每次从源位流尾部取出32位，翻转后写到目的位流头部
+  for (unsigned int pos = 0; pos < bitCount;) {
+    unsigned int n = bitCount - pos >= 32 ? 32 : bitCount - pos;
+    uint32_t word = (uint32_t)bitstream_Extract(src, bitCount - pos - n, n);
+    bitstream_Insert(dst, pos, misc_BitReverse(word) >> (32 - n), n);
+    pos += n;
+  }
+}
@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2023, Virus.V <virusv@live.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of SmartOCD nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * Copyright 2023 Virus.V <virusv@live.com>
+ */
+
+#ifndef SRC_MISC_BITSTREAM_H_
+#define SRC_MISC_BITSTREAM_H_
+
+#include <stdint.h>
+
+/**
+ * 二进制位流操作
+ * 位流按字节存放，每个字节内最低位在前，即第n位位于data[n/8]的第(n%8)位，
+ * 与JTAG移位、CMSIS-DAP和MPSSE的LSB数据格式一致
+ */
+
+/**
+ * bitstream_GetBit - 获得位流的第n位
+ * 参数:
+ * 	data:位流
+ * 	n:第几位，从0开始
+ * 返回:
+ * 	0或者1
+ */
+static inline int bitstream_GetBit(const uint8_t *data, unsigned int n) {
+  return (data[n >> 3] >> (n & 0x7)) & 0x1;
+}
+
+/**
+ * bitstream_SetBit - 设置位流的第n位
+ * 参数:
+ * 	data:位流
+ * 	n:第几位，从0开始
+ * 	val:要设置的值，只使用最低位
+ */
+static inline void bitstream_SetBit(uint8_t *data, unsigned int n, int val) {
+  data[n >> 3] = (data[n >> 3] & ~(1u << (n & 0x7))) | ((val & 0x1) << (n & 0x7));
+}
+
+/**
+ * bitstream_Copy - 带偏移的位流拷贝，目的位流中拷贝范围以外的位保持不变
+ * 参数:
+ * 	dst:目的位流
+ * 	dstOffset:目的位流的起始位
+ * 	src:源位流
+ * 	srcOffset:源位流的起始位
+ * 	bitCount:拷贝的位数
+ */
+void bitstream_Copy(uint8_t *dst, unsigned int dstOffset, const uint8_t *src, unsigned int srcOffset,
+                    unsigned int bitCount);
+
+/**
+ * bitstream_Concat - 将src追加到dst位流的末尾
+ * 参数:
+ * 	dst:目的位流
+ * 	dstBits:目的位流当前的位数
+ * 	src:要追加的位流
+ * 	srcBits:要追加的位数
+ * 返回:
+ * 	追加后目的位流的位数
+ */
+unsigned int bitstream_Concat(uint8_t *dst, unsigned int dstBits, const uint8_t *src, unsigned int srcBits);
+
+/**
+ * bitstream_Extract - 从位流的任意位置取出最多64位
+ * 参数:
+ * 	src:源位流
+ * 	offset:起始位
+ * 	bitCount:位数，不大于64
+ * 返回:
+ * 	取出的数据，最低位为起始位
+ */
+uint64_t bitstream_Extract(const uint8_t *src, unsigned int offset, unsigned int bitCount);
+
+/**
+ * bitstream_Insert - 向位流的任意位置写入最多64位
+ * 参数:
+ * 	dst:目的位流
+ * 	offset:起始位
+ * 	value:要写入的数据，最低位写入起始位
+ * 	bitCount:位数，不大于64
+ */
+void bitstream_Insert(uint8_t *dst, unsigned int offset, uint64_t value, unsigned int bitCount);
+
+/**
+ * bitstream_Reverse - 位流按位镜像翻转，dst的第i位为src的第(bitCount-1-i)位
+ * 参数:
+ * 	dst:目的位流，不能与src重叠
+ * 	src:源位流
+ * 	bitCount:位数
+ */
+void bitstream_Reverse(uint8_t *dst, const uint8_t *src, unsigned int bitCount);
+
+#endif /* SRC_MISC_BITSTREAM_H_ */
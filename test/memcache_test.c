@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2023, Virus.V <virusv@live.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of SmartOCD nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * Copyright 2023 Virus.V <virusv@live.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ctest.h"
+#include "smartocd.h"
+#include "Library/log/log.h"
+
+#include "Component/ADI/ADIv5_private.h"
+
+#define FAKE_MEM_SIZE 0x2000u
+
+// 模拟目标内存，测试中直接修改用来模拟目标内容的变化
+static uint8_t fakeMem[FAKE_MEM_SIZE];
+
+static int fakeReadBuffer(AccessPort self, uint64_t addr, enum dataSize size, unsigned int len, uint8_t *buff) {
+  (void)self;
+  (void)size;
+  if (addr + len > FAKE_MEM_SIZE) {
+    return ADI_FAILED;
+  }
+  memcpy(buff, fakeMem + addr, len);
+  return ADI_SUCCESS;
+}
+
+static int fakeWriteBuffer(AccessPort self, uint64_t addr, enum dataSize size, unsigned int len, uint8_t *buff) {
+  (void)self;
+  (void)size;
+  if (addr + len > FAKE_MEM_SIZE) {
+    return ADI_FAILED;
+  }
+  memcpy(fakeMem + addr, buff, len);
+  return ADI_SUCCESS;
+}
+
+CTEST_DATA(memcache) {
+  struct ADIv5_AccessPort ap;
+  MemCache cache;
+};
+
+CTEST_SETUP(memcache) {
+  memset(&data->ap, 0, sizeof(data->ap));
+  INTERFACE_CONST_INIT(enum AccessPortType, data->ap.apApi.type, AccessPort_Memory);
+  data->ap.apApi.Interface.Memory.ReadBuffer = fakeReadBuffer;
+  data->ap.apApi.Interface.Memory.WriteBuffer = fakeWriteBuffer;
+  for (unsigned int i = 0; i < FAKE_MEM_SIZE; i++) {
+    fakeMem[i] = (uint8_t)i;
+  }
+  data->cache = ADIv5_CreateMemCache(&data->ap.apApi);
+  ADIv5_MemCacheSetRegion(data->cache, 0, FAKE_MEM_SIZE, MemCache_Cacheable);
+  ADIv5_MemCacheEnable(data->cache, TRUE);
+}
+
+CTEST_TEARDOWN(memcache) {
+  ADIv5_DestroyMemCache(&data->cache);
+}
+
+/**
+ * 写入从缓存行中间开始，该行必须作废
+ */
+CTEST2(memcache, write_starts_mid_line) {
+  uint8_t buff[64];
+  ASSERT_EQUAL(ADI_SUCCESS, ADIv5_MemCacheRead(data->cache, 0x1000, 64, buff));
+  memset(fakeMem + 0x1010, 0xA5, 64);
+  ADIv5_MemCacheWriteNotify(data->cache, 0x1010, 64);
+  ASSERT_EQUAL(ADI_SUCCESS, ADIv5_MemCacheRead(data->cache, 0x1010, 1, buff));
+  ASSERT_EQUAL(0xA5, buff[0]);
+}
+
+/**
+ * 不可缓存区域从缓存行中间开始，整行都不能缓存
+ */
+CTEST2(memcache, region_starts_mid_line) {
+  uint8_t buff[64];
+  ADIv5_MemCacheSetRegion(data->cache, 0x1810, 4, MemCache_Never);
+  ASSERT_EQUAL(ADI_SUCCESS, ADIv5_MemCacheRead(data->cache, 0x1800, 64, buff));
+  fakeMem[0x1810] = 0x5A;
+  ASSERT_EQUAL(ADI_SUCCESS, ADIv5_MemCacheRead(data->cache, 0x1810, 1, buff));
+  ASSERT_EQUAL(0x5A, buff[0]);
+}
+
+/**
+ * 写入覆盖了易变区域，但是两端都在区域之外，需要作废全部缓存
+ */
+CTEST2(memcache, write_spans_volatile_region) {
+  uint8_t buff[64];
+  ADIv5_MemCacheSetRegion(data->cache, 0x1400, 4, MemCache_Volatile);
+  ASSERT_EQUAL(ADI_SUCCESS, ADIv5_MemCacheRead(data->cache, 0x0000, 64, buff));
+  fakeMem[0] = 0xC3;
+  ADIv5_MemCacheWriteNotify(data->cache, 0x1300, 0x200);
+  ASSERT_EQUAL(ADI_SUCCESS, ADIv5_MemCacheRead(data->cache, 0x0000, 1, buff));
+  ASSERT_EQUAL(0xC3, buff[0]);
+}